@@ -96,9 +96,12 @@ typedef struct engine_memory_stats_t {
   uint32_t autopath_cache_entries;
   uint32_t autopath_cache_limit;
   uint32_t autopath_table_entries;
-  uint32_t reserved_u32;
+  uint32_t xp3_blob_cache_entries;
 
-  uint64_t reserved_u64[4];
+  uint64_t xp3_blob_cache_bytes;
+  uint64_t xp3_blob_cache_limit_bytes;
+  uint64_t xp3_blob_cache_hits;
+  uint64_t xp3_blob_cache_misses;
   void* reserved_ptr[4];
 } engine_memory_stats_t;
 
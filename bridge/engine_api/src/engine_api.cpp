@@ -2113,6 +2113,14 @@ engine_result_t engine_get_memory_stats(engine_handle_t handle,
   out_stats->autopath_cache_limit = TVPGetAutoPathCacheLimit();
   out_stats->autopath_table_entries = TVPGetAutoPathTableCount();
 
+  tTVPXP3BlobCacheStats blob_stats{};
+  TVPGetXP3BlobCacheStats(blob_stats);
+  out_stats->xp3_blob_cache_bytes = blob_stats.Bytes;
+  out_stats->xp3_blob_cache_limit_bytes = blob_stats.Limit;
+  out_stats->xp3_blob_cache_entries = blob_stats.Entries;
+  out_stats->xp3_blob_cache_hits = blob_stats.Hits;
+  out_stats->xp3_blob_cache_misses = blob_stats.Misses;
+
   PSB::PSBMediaCacheStats psb_stats{};
   if (PSB::GetPSBMediaCacheStats(psb_stats)) {
     out_stats->psb_cache_bytes = psb_stats.bytesInUse;
@@ -156,19 +156,19 @@ final class EngineMemoryStats extends Struct {
   external int autopathTableEntries;
 
   @Uint32()
-  external int reservedU32;
+  external int xp3BlobCacheEntries;
 
   @Uint64()
-  external int reservedU640;
+  external int xp3BlobCacheBytes;
 
   @Uint64()
-  external int reservedU641;
+  external int xp3BlobCacheLimitBytes;
 
   @Uint64()
-  external int reservedU642;
+  external int xp3BlobCacheHits;
 
   @Uint64()
-  external int reservedU643;
+  external int xp3BlobCacheMisses;
 
   external Pointer<Void> reservedPtr0;
   external Pointer<Void> reservedPtr1;
@@ -46,6 +46,11 @@ class EngineMemoryStatsData {
     required this.autopathCacheEntries,
     required this.autopathCacheLimit,
     required this.autopathTableEntries,
+    this.xp3BlobCacheBytes = 0,
+    this.xp3BlobCacheLimitBytes = 0,
+    this.xp3BlobCacheEntries = 0,
+    this.xp3BlobCacheHits = 0,
+    this.xp3BlobCacheMisses = 0,
   });
 
   final int selfUsedMb;
@@ -64,6 +69,11 @@ class EngineMemoryStatsData {
   final int autopathCacheEntries;
   final int autopathCacheLimit;
   final int autopathTableEntries;
+  final int xp3BlobCacheBytes;
+  final int xp3BlobCacheLimitBytes;
+  final int xp3BlobCacheEntries;
+  final int xp3BlobCacheHits;
+  final int xp3BlobCacheMisses;
 }
 
 class EngineInputEventData {
@@ -489,6 +499,11 @@ class EngineFfiBridge {
         autopathCacheEntries: stats.ref.autopathCacheEntries,
         autopathCacheLimit: stats.ref.autopathCacheLimit,
         autopathTableEntries: stats.ref.autopathTableEntries,
+        xp3BlobCacheBytes: stats.ref.xp3BlobCacheBytes,
+        xp3BlobCacheLimitBytes: stats.ref.xp3BlobCacheLimitBytes,
+        xp3BlobCacheEntries: stats.ref.xp3BlobCacheEntries,
+        xp3BlobCacheHits: stats.ref.xp3BlobCacheHits,
+        xp3BlobCacheMisses: stats.ref.xp3BlobCacheMisses,
       );
     } finally {
       calloc.free(stats);
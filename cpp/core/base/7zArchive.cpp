@@ -2,14 +2,22 @@
 #include "StorageIntf.h"
 #include "UtilStreams.h"
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 extern "C" {
 #include <7zip/C/7z.h>
 #include <7zip/C/7zFile.h>
 #include <7zip/C/7zCrc.h>
+#include <7zip/C/LzmaDec.h>
+#include <7zip/C/Lzma2Dec.h>
 }
 
 #include "StorageImpl.h"
+#include "EventIntf.h"
+#include "MsgIntf.h"
 
 static ISzAlloc allocImp = { [](ISzAllocPtr p, size_t size) -> void * {
                                 return malloc(size);
@@ -79,14 +87,506 @@ public:
     }
 };
 
+//---------------------------------------------------------------------------
+// solid folder cache
+//---------------------------------------------------------------------------
+/*
+        decoded 7z folders ( solid blocks ), shared by all archives and
+        byte-budgeted. sibling files of a solid block are then served from
+        one decode. the memory governor lowers the budget under pressure.
+        small files of folders too large to be cached as a whole are cached
+        one by one in the same table.
+*/
+#define TVP_7Z_FOLDERCACHE_TOTAL_LIMIT (32 * 1024 * 1024)
+// read without the cache lock when deciding how to open a file
+static std::atomic<tjs_uint64> TVP7zFolderCacheLimit{
+    TVP_7Z_FOLDERCACHE_TOTAL_LIMIT
+};
+
+// folders larger than this are never decoded as a whole if they can be
+// streamed
+#define TVP_7Z_STREAM_THRESHOLD (16 * 1024 * 1024)
+// files of such folders larger than this are streamed; smaller ones are
+// decoded by the folder cursor of the archive and cached one by one
+#define TVP_7Z_MEMBER_STREAM_THRESHOLD (2 * 1024 * 1024)
+
+//---------------------------------------------------------------------------
+struct tTVP7zFolderKey {
+    tjs_uint64 ArchiveSerial;
+    tjs_uint32 FolderIndex;
+    tjs_uint32 FileIndex; // a single file, or TVP_7Z_WHOLE_FOLDER
+
+    bool operator==(const tTVP7zFolderKey &rhs) const {
+        return ArchiveSerial == rhs.ArchiveSerial &&
+            FolderIndex == rhs.FolderIndex && FileIndex == rhs.FileIndex;
+    }
+};
+#define TVP_7Z_WHOLE_FOLDER ((tjs_uint32)-1)
+
+//---------------------------------------------------------------------------
+class tTVP7zFolderKeyHashFunc {
+public:
+    static tjs_uint32 Make(const tTVP7zFolderKey &val) {
+        tjs_uint32 v = (tjs_uint32)val.ArchiveSerial * 0x9E3779B1;
+        v ^= val.FolderIndex + (v << 6) + (v >> 2);
+        v ^= val.FileIndex * 0x85EBCA6B + (v << 6) + (v >> 2);
+        return v;
+    }
+};
+
+//---------------------------------------------------------------------------
+class tTVP7zFolderData {
+    std::atomic<tjs_int> RefCount;
+    Byte *Data; // allocated by allocImp
+    size_t Size;
+
+public:
+    tTVP7zFolderData(Byte *data, size_t size) :
+        RefCount(1), Data(data), Size(size) {}
+
+    ~tTVP7zFolderData() { ISzAlloc_Free(&allocImp, Data); }
+
+    const Byte *GetData() const { return Data; }
+
+    size_t GetSize() const { return Size; }
+
+    void AddRef() { RefCount.fetch_add(1, std::memory_order_relaxed); }
+
+    void Release() {
+        if(RefCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete this;
+    }
+};
+
+//---------------------------------------------------------------------------
+// a file within a decoded folder
+class tTVP7zFolderStream : public tTVPMemoryStream {
+    tTVP7zFolderData *Folder;
+
+public:
+    tTVP7zFolderStream(tTVP7zFolderData *folder, size_t offset, tjs_uint size) :
+        tTVPMemoryStream(folder->GetData() + offset, size), Folder(folder) {
+        Folder->AddRef();
+    }
+
+    ~tTVP7zFolderStream() override { Folder->Release(); }
+};
+
+//---------------------------------------------------------------------------
+typedef tTJSRefHolder<tTVP7zFolderData> tTVP7zFolderDataHolder;
+
+typedef tTJSHashTable<tTVP7zFolderKey, tTVP7zFolderDataHolder,
+                      tTVP7zFolderKeyHashFunc>
+    tTVP7zFolderCache;
+static tTVP7zFolderCache TVP7zFolderCache;
+static tjs_uint64 TVP7zFolderCacheTotalBytes = 0;
+
+static tTJSCriticalSection TVP7zFolderCacheCS;
+
+//---------------------------------------------------------------------------
+static void TVPCheck7zFolderCacheLimit() {
+    tTJSCriticalSectionHolder cs_holder(TVP7zFolderCacheCS);
+
+    while(TVP7zFolderCacheTotalBytes > TVP7zFolderCacheLimit.load()) {
+        // chop last folder
+        tTVP7zFolderCache::tIterator i;
+        i = TVP7zFolderCache.GetLast();
+        if(!i.IsNull()) {
+            TVP7zFolderCacheTotalBytes -=
+                i.GetValue().GetObjectNoAddRef()->GetSize();
+            TVP7zFolderCache.ChopLast(1);
+        } else {
+            break;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+void TVPClear7zFolderCache() {
+    tTJSCriticalSectionHolder cs_holder(TVP7zFolderCacheCS);
+
+    TVP7zFolderCache.Clear();
+    TVP7zFolderCacheTotalBytes = 0;
+}
+
+//---------------------------------------------------------------------------
+void TVPSet7zFolderCacheLimit(tjs_uint64 bytes) {
+    tTJSCriticalSectionHolder cs_holder(TVP7zFolderCacheCS);
+
+    TVP7zFolderCacheLimit = bytes;
+    TVPCheck7zFolderCacheLimit();
+}
+
+//---------------------------------------------------------------------------
+tjs_uint64 TVPGet7zFolderCacheTotalBytes() {
+    tTJSCriticalSectionHolder cs_holder(TVP7zFolderCacheCS);
+    return TVP7zFolderCacheTotalBytes;
+}
+
+//---------------------------------------------------------------------------
+static void TVPPurge7zFolderCache(tjs_uint64 serial) {
+    // remove folders of a destroyed archive
+    tTJSCriticalSectionHolder cs_holder(TVP7zFolderCacheCS);
+
+    std::vector<tTVP7zFolderKey> keys;
+    for(tTVP7zFolderCache::tIterator i = TVP7zFolderCache.GetFirst();
+        !i.IsNull(); ++i) {
+        if(i.GetKey().ArchiveSerial == serial)
+            keys.push_back(i.GetKey());
+    }
+    for(const tTVP7zFolderKey &key : keys) {
+        tTVP7zFolderDataHolder *ptr = TVP7zFolderCache.Find(key);
+        if(ptr)
+            TVP7zFolderCacheTotalBytes -= ptr->GetObjectNoAddRef()->GetSize();
+        TVP7zFolderCache.Delete(key);
+    }
+}
+
+//---------------------------------------------------------------------------
+struct tTVPClear7zFolderCacheCallback : public tTVPCompactEventCallbackIntf {
+    void OnCompact(tjs_int level) override {
+        if(level >= TVP_COMPACT_LEVEL_MINIMIZE)
+            TVPClear7zFolderCache();
+    }
+} static TVPClear7zFolderCacheCallback;
+
+static std::once_flag TVPClear7zFolderCacheCallbackInit;
+
+//---------------------------------------------------------------------------
+static tTVP7zFolderData *TVPSearchFrom7zFolderCache(const tTVP7zFolderKey &key,
+                                                    tjs_uint32 hash) {
+    tTJSCriticalSectionHolder cs_holder(TVP7zFolderCacheCS);
+
+    tTVP7zFolderDataHolder *ptr =
+        TVP7zFolderCache.FindAndTouchWithHash(key, hash);
+    if(ptr)
+        return ptr->GetObject(); // add-refed
+    return nullptr;
+}
+
+//---------------------------------------------------------------------------
+static void TVPPushTo7zFolderCache(const tTVP7zFolderKey &key, tjs_uint32 hash,
+                                   tTVP7zFolderData *data) {
+    // folders are pushed from the loader threads too
+    std::call_once(TVPClear7zFolderCacheCallbackInit, [] {
+        TVPAddCompactEventHook(&TVPClear7zFolderCacheCallback);
+    });
+
+    tTJSCriticalSectionHolder cs_holder(TVP7zFolderCacheCS);
+
+    if(TVP7zFolderCache.FindWithHash(key, hash))
+        return; // another thread decoded it first
+
+    tTVP7zFolderDataHolder holder(data);
+    TVP7zFolderCache.AddWithHash(key, hash, holder);
+    TVP7zFolderCacheTotalBytes += data->GetSize();
+
+    TVPCheck7zFolderCacheLimit();
+}
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+// tTVP7zStreamingStream : sequentially decodes one file of a large folder
+//---------------------------------------------------------------------------
+#define k_Copy 0
+#define k_LZMA2 0x21
+#define k_LZMA 0x30101
+
+class tTVP7zStreamingStream : public tTJSBinaryStream {
+    tTVPArchive *Owner;
+    // false for the folder cursor held by the archive itself; the packed
+    // stream is then closed between reads, so that the archive is not
+    // kept alive by its own cursor
+    bool HoldOwner;
+    tjs_uint64 PackStart, PackSize; // packed stream in the archive
+    UInt32 MethodID;
+    std::vector<Byte> Props;
+
+    tjs_uint64 FileOffset; // file start in the unpacked folder
+    tjs_uint64 FileSize;
+    tjs_uint64 CurPos; // current position in the file
+
+    // decoder state; created on first read, recreated to seek backward
+    TArchiveStream *Pack = nullptr;
+    tjs_uint64 PackPos = 0; // position of the closed packed stream
+    CLzmaDec Lzma;
+    CLzma2Dec Lzma2;
+    bool DecoderAllocated = false;
+    tjs_uint64 DecodedPos = 0; // next output position in the folder
+
+    static const size_t InBufferSize = 64 * 1024;
+    std::vector<Byte> InBuffer;
+    size_t InPos = 0, InSize = 0;
+
+    void FreeDecoder() {
+        if(DecoderAllocated) {
+            if(MethodID == k_LZMA)
+                LzmaDec_Free(&Lzma, &allocImp);
+            else
+                Lzma2Dec_Free(&Lzma2, &allocImp);
+            DecoderAllocated = false;
+        }
+        delete Pack;
+        Pack = nullptr;
+    }
+
+    void Restart() {
+        FreeDecoder();
+        SRes res;
+        if(MethodID == k_LZMA) {
+            LzmaDec_Construct(&Lzma);
+            res = LzmaDec_Allocate(&Lzma, Props.data(), (unsigned)Props.size(),
+                                   &allocImp);
+            if(res == SZ_OK)
+                LzmaDec_Init(&Lzma);
+        } else {
+            Lzma2Dec_Construct(&Lzma2);
+            res = Props.size() == 1
+                ? Lzma2Dec_Allocate(&Lzma2, Props[0], &allocImp)
+                : SZ_ERROR_UNSUPPORTED;
+            if(res == SZ_OK)
+                Lzma2Dec_Init(&Lzma2);
+        }
+        if(res != SZ_OK)
+            TVPThrowExceptionMessage(TVPUncompressionFailed);
+        DecoderAllocated = true;
+        Pack = new TArchiveStream(Owner, PackStart, PackSize);
+        DecodedPos = 0;
+        InPos = InSize = 0;
+    }
+
+    // decodes up to 'size' bytes into 'dest'; returns decoded bytes
+    size_t Decode(Byte *dest, size_t size) {
+        size_t done = 0;
+        while(done < size) {
+            if(InPos == InSize) {
+                InSize = Pack->Read(InBuffer.data(), (tjs_uint)InBufferSize);
+                InPos = 0;
+            }
+            SizeT outlen = size - done;
+            SizeT inlen = InSize - InPos;
+            ELzmaStatus status;
+            SRes res;
+            if(MethodID == k_LZMA)
+                res = LzmaDec_DecodeToBuf(&Lzma, dest + done, &outlen,
+                                          InBuffer.data() + InPos, &inlen,
+                                          LZMA_FINISH_ANY, &status);
+            else
+                res = Lzma2Dec_DecodeToBuf(&Lzma2, dest + done, &outlen,
+                                           InBuffer.data() + InPos, &inlen,
+                                           LZMA_FINISH_ANY, &status);
+            if(res != SZ_OK)
+                TVPThrowExceptionMessage(TVPUncompressionFailed);
+            InPos += inlen;
+            done += outlen;
+            DecodedPos += outlen;
+            if(outlen == 0 && inlen == 0)
+                break; // end of stream or truncated input
+        }
+        return done;
+    }
+
+public:
+    tTVP7zStreamingStream(tTVPArchive *owner, tjs_uint64 packstart,
+                          tjs_uint64 packsize, UInt32 methodid,
+                          const Byte *props, size_t propssize,
+                          tjs_uint64 fileoffset, tjs_uint64 filesize,
+                          bool holdowner = true) :
+        Owner(owner), HoldOwner(holdowner), PackStart(packstart),
+        PackSize(packsize),
+        MethodID(methodid), Props(props, props + propssize),
+        FileOffset(fileoffset), FileSize(filesize), CurPos(0),
+        InBuffer(InBufferSize) {
+        if(HoldOwner)
+            Owner->AddRef();
+    }
+
+    ~tTVP7zStreamingStream() override {
+        FreeDecoder();
+        if(HoldOwner)
+            Owner->Release();
+    }
+
+    tjs_uint64 Seek(tjs_int64 offset, tjs_int whence) override {
+        tjs_int64 newpos = CurPos;
+        switch(whence) {
+            case TJS_BS_SEEK_SET:
+                newpos = offset;
+                break;
+            case TJS_BS_SEEK_CUR:
+                newpos = offset + CurPos;
+                break;
+            case TJS_BS_SEEK_END:
+                newpos = offset + FileSize;
+                break;
+        }
+        if(newpos >= 0 && newpos <= (tjs_int64)FileSize)
+            CurPos = newpos;
+        return CurPos;
+    }
+
+    tjs_uint Read(void *buffer, tjs_uint read_size) override {
+        if(CurPos + read_size > FileSize)
+            read_size = (tjs_uint)(FileSize - CurPos);
+        if(!read_size)
+            return 0;
+
+        tjs_uint64 target = FileOffset + CurPos;
+        if(!DecoderAllocated || DecodedPos > target) {
+            Restart(); // LZMA can only go forward
+        } else if(!Pack) {
+            Pack = new TArchiveStream(Owner, PackStart, PackSize);
+            Pack->SetPosition(PackPos);
+        }
+
+        // skip to the target position
+        if(DecodedPos < target) {
+            std::vector<Byte> skip(
+                (size_t)std::min<tjs_uint64>(target - DecodedPos, 256 * 1024));
+            while(DecodedPos < target) {
+                size_t one = (size_t)std::min<tjs_uint64>(target - DecodedPos,
+                                                          skip.size());
+                if(Decode(skip.data(), one) != one)
+                    TVPThrowExceptionMessage(TVPUncompressionFailed);
+            }
+        }
+
+        size_t done = Decode((Byte *)buffer, read_size);
+        CurPos += done;
+
+        if(!HoldOwner) {
+            PackPos = Pack->GetPosition();
+            delete Pack;
+            Pack = nullptr;
+        }
+        return (tjs_uint)done;
+    }
+
+    tjs_uint Write(const void *buffer, tjs_uint write_size) override {
+        return 0;
+    }
+
+    tjs_uint64 GetSize() override { return FileSize; }
+};
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+// SevenZipArchive
+//---------------------------------------------------------------------------
 class SevenZipArchive : public tTVPArchive, public SevenZipStreamWrap {
     std::vector<std::pair<ttstr, tjs_uint>> filelist;
+    tjs_uint64 Serial; // identifies this archive in the folder cache
+    std::mutex ExtractMutex; // the archive stream is shared
+
+    // sequential decoder over one large folder, guarded by ExtractMutex
+    std::unique_ptr<tTVP7zStreamingStream> Cursor;
+    UInt32 CursorFolder = (UInt32)-1;
+
+    static tjs_uint64 NextSerial() {
+        static std::atomic<tjs_uint64> serial{ 0 };
+        return ++serial;
+    }
+
+    tTVP7zFolderData *DecodeFolder(tjs_uint fileIndex, size_t &offset) {
+        // decode the whole folder containing 'fileIndex'
+        std::lock_guard<std::mutex> lk(ExtractMutex);
+        UInt32 blockIndex = (UInt32)-1;
+        Byte *outBuffer = nullptr;
+        size_t outBufferSize = 0;
+        size_t outSizeProcessed = 0;
+        offset = 0;
+        SRes res = SzArEx_Extract(&db, &lookStream.vt, fileIndex, &blockIndex,
+                                  &outBuffer, &outBufferSize, &offset,
+                                  &outSizeProcessed, &allocImp, &allocImp);
+        if(res != SZ_OK) {
+            ISzAlloc_Free(&allocImp, outBuffer);
+            TVPThrowExceptionMessage(TVPUncompressionFailed);
+        }
+        return new tTVP7zFolderData(outBuffer, outBufferSize);
+    }
+
+    template <typename TCreateCursor>
+    tTVP7zFolderData *DecodeFileByCursor(UInt32 fileIndex, UInt32 folderIndex,
+                                         UInt64 folderSize,
+                                         TCreateCursor createcursor) {
+        // decode a small file of a large folder. the cursor only moves
+        // forward, and every small file it passes is cached on the way, so
+        // that reading the folder's files in any order does not decode the
+        // folder from its start again for each of them.
+        std::lock_guard<std::mutex> lk(ExtractMutex);
+
+        tTVP7zFolderKey key{ Serial, folderIndex, fileIndex };
+        tjs_uint32 hash = tTVP7zFolderKeyHashFunc::Make(key);
+        tTVP7zFolderData *result = TVPSearchFrom7zFolderCache(key, hash);
+        if(result)
+            return result; // decoded by another thread meanwhile
+
+        UInt32 first = db.FolderToFile[folderIndex];
+        UInt64 target = db.UnpackPositions[fileIndex] -
+            db.UnpackPositions[first];
+        if(!Cursor || CursorFolder != folderIndex ||
+           Cursor->GetPosition() > target) {
+            Cursor.reset(createcursor());
+            CursorFolder = folderIndex;
+        }
+
+        try {
+            for(UInt32 i = first; i < db.NumFiles && !result; i++) {
+                if(db.FileToFolder[i] == (UInt32)-1)
+                    continue; // empty files and directories
+                if(db.FileToFolder[i] != folderIndex)
+                    break;
+                UInt64 offset = db.UnpackPositions[i] - db.UnpackPositions[first];
+                UInt64 size = SzArEx_GetFileSize(&db, i);
+                if(offset < Cursor->GetPosition())
+                    continue; // already passed
+                if(i != fileIndex &&
+                   (size > TVP_7Z_MEMBER_STREAM_THRESHOLD ||
+                    size > TVP7zFolderCacheLimit.load()))
+                    continue; // streamed when opened; just skipped over
+
+                tTVP7zFolderKey ikey{ Serial, folderIndex, i };
+                tjs_uint32 ihash = tTVP7zFolderKeyHashFunc::Make(ikey);
+                tTVP7zFolderData *data = nullptr;
+                if(i != fileIndex) {
+                    data = TVPSearchFrom7zFolderCache(ikey, ihash);
+                    if(data) {
+                        data->Release(); // still cached; no need to decode
+                        continue;
+                    }
+                }
+
+                Byte *buf = (Byte *)ISzAlloc_Alloc(&allocImp, (size_t)size);
+                if(!buf)
+                    TVPThrowExceptionMessage(TVPUncompressionFailed);
+                data = new tTVP7zFolderData(buf, (size_t)size);
+                Cursor->SetPosition(offset);
+                if(Cursor->Read(buf, (tjs_uint)size) != size) {
+                    data->Release();
+                    TVPThrowExceptionMessage(TVPUncompressionFailed);
+                }
+                TVPPushTo7zFolderCache(ikey, ihash, data);
+                if(i == fileIndex)
+                    result = data;
+                else
+                    data->Release();
+            }
+        } catch(...) {
+            Cursor.reset();
+            throw;
+        }
+        if(!result)
+            TVPThrowExceptionMessage(TVPUncompressionFailed);
+        if(Cursor->GetPosition() >= folderSize)
+            Cursor.reset(); // nothing left to read in this folder
+        return result;
+    }
 
 public:
     SevenZipArchive(const ttstr &name, tTJSBinaryStream *st) :
-        tTVPArchive(name), SevenZipStreamWrap(st) {}
+        tTVPArchive(name), SevenZipStreamWrap(st), Serial(NextSerial()) {}
 
-    ~SevenZipArchive() override {}
+    ~SevenZipArchive() override { TVPPurge7zFolderCache(Serial); }
 
     tjs_uint GetCount() override { return filelist.size(); }
 
@@ -112,35 +612,77 @@ public:
 
         if(SzGetNextFolderItem(&folder, &sd) != SZ_OK)
             return nullptr;
-        if(folder.NumCoders == 1) {
+
+        UInt64 folderSize = SzAr_GetFolderUnpackSize(p, folderIndex);
+        UInt64 fileOffset = db.UnpackPositions[fileIndex] -
+            db.UnpackPositions[db.FolderToFile[folderIndex]];
+
+        if(folder.NumCoders == 1 && folder.NumPackStreams == 1) {
             UInt64 startPos = db.dataPos;
             const UInt64 *packPositions =
                 p->PackPositions + p->FoStartPackStreamIndex[folderIndex];
             UInt64 offset = packPositions[0];
             UInt64 inSize = packPositions[1] - offset;
-#define k_Copy 0
-            if(folder.Coders[0].MethodID == k_Copy && inSize == fileSize) {
+            const CSzCoderInfo &coder = folder.Coders[0];
+            if(coder.MethodID == k_Copy && inSize == fileSize) {
                 return new TArchiveStream(this, startPos + offset, inSize);
             }
+
+            // large solid folder; never decoded as a whole
+            tjs_uint64 limit = TVP7zFolderCacheLimit.load();
+            if((coder.MethodID == k_LZMA || coder.MethodID == k_LZMA2) &&
+               (folderSize > TVP_7Z_STREAM_THRESHOLD || folderSize > limit)) {
+                if(fileSize > TVP_7Z_MEMBER_STREAM_THRESHOLD ||
+                   fileSize > limit) {
+                    // decode just up to and through this file
+                    return new tTVP7zStreamingStream(
+                        this, startPos + offset, inSize, coder.MethodID,
+                        data + coder.PropsOffset, coder.PropsSize, fileOffset,
+                        fileSize);
+                }
+
+                tTVP7zFolderKey key{ Serial, folderIndex, fileIndex };
+                tjs_uint32 hash = tTVP7zFolderKeyHashFunc::Make(key);
+                tTVP7zFolderData *filedata =
+                    TVPSearchFrom7zFolderCache(key, hash);
+                if(!filedata) {
+                    filedata = DecodeFileByCursor(
+                        fileIndex, folderIndex, folderSize, [&] {
+                            return new tTVP7zStreamingStream(
+                                this, startPos + offset, inSize,
+                                coder.MethodID, data + coder.PropsOffset,
+                                coder.PropsSize, 0, folderSize, false);
+                        });
+                }
+                tTJSBinaryStream *out = new tTVP7zFolderStream(
+                    filedata, 0, (tjs_uint)fileSize);
+                filedata->Release();
+                return out;
+            }
         }
 
-        UInt32 blockIndex;
-        Byte *outBuffer = nullptr;
-        size_t outBufferSize;
-        size_t offset, outSizeProcessed;
-        SRes res = SzArEx_Extract(&db, &lookStream.vt, fileIndex, &blockIndex,
-                                  &outBuffer, &outBufferSize, &offset,
-                                  &outSizeProcessed, &allocImp, &allocImp);
-        tTVPMemoryStream *mem;
-        if(offset == 0 && fileSize <= outBufferSize) {
-            mem = new tTVPMemoryStream(outBuffer, outBufferSize);
-        } else {
-            Byte *buf = new Byte[fileSize];
-            memcpy(buf, outBuffer, fileSize);
-            mem = new tTVPMemoryStream(buf, fileSize);
-            delete outBuffer;
+        if(fileSize != (tjs_uint)fileSize)
+            TVPThrowExceptionMessage(TVPUncompressionFailed);
+
+        tTVP7zFolderKey key{ Serial, folderIndex, TVP_7Z_WHOLE_FOLDER };
+        tjs_uint32 hash = tTVP7zFolderKeyHashFunc::Make(key);
+        tTVP7zFolderData *folderdata = TVPSearchFrom7zFolderCache(key, hash);
+        if(!folderdata) {
+            size_t offset;
+            folderdata = DecodeFolder(fileIndex, offset);
+            fileOffset = offset;
+            if(folderdata->GetSize() <= TVP7zFolderCacheLimit.load())
+                TVPPushTo7zFolderCache(key, hash, folderdata);
         }
-        return mem;
+        if(fileOffset + fileSize > folderdata->GetSize()) {
+            folderdata->Release();
+            TVPThrowExceptionMessage(TVPUncompressionFailed);
+        }
+
+        tTJSBinaryStream *out = new tTVP7zFolderStream(
+            folderdata, (size_t)fileOffset, (tjs_uint)fileSize);
+        folderdata->Release();
+        return out;
     }
 
     bool Open(bool normalizeFileName) {
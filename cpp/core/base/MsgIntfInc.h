@@ -205,6 +205,7 @@ TVP_MSG_DEFINE(TVPUnsupportedEntropyCodingMethod,
                "Unsupported entropy coding method")
 TVP_MSG_DEFINE(TVPInvalidTlgHeaderOrVersion,
                "Invalid TLG header or unsupported TLG version.")
+TVP_MSG_DEFINE(TVPTlgInvalidBlockSize, "Invalid TLG block size.")
 TVP_MSG_DEFINE(TVPTlgMalformedTagMissionColonAfterNameLength,
                "Malformed TLG SDS tag structure, missing colon after "
                "name length")
@@ -13,6 +13,8 @@
 #include <algorithm>
 #include <stdexcept>
 #include <memory>
+#include <map>
+#include <mutex>
 #include "StorageIntf.h"
 #include "tjsUtils.h"
 #include "MsgIntf.h"
@@ -22,6 +24,7 @@
 #include "SysInitIntf.h"
 #include "XP3Archive.h"
 #include "TickCount.h"
+#include "ThreadPool.h"
 #include "ncbind.hpp"
 
 #define TVP_DEFAULT_ARCHIVE_CACHE_NUM 128
@@ -155,6 +158,7 @@ class tTVPStorageMediaManager {
         tHashTable;
 
     tHashTable HashTable;
+    tTJSCriticalSection CS; // guards HashTable and the current directories
 
 public:
     tTVPStorageMediaManager();
@@ -206,6 +210,9 @@ void tTVPStorageMediaManager::ThrowUnsupportedMediaType(const ttstr &name) {
 //---------------------------------------------------------------------------
 tTVPStorageMediaManager::tMediaRecord *
 tTVPStorageMediaManager::GetMediaRecord(const ttstr &name) {
+    // records are not removed while the media are in use, so the pointer
+    // stays valid after the lock is released
+    tTJSCSH csh(CS);
     tMediaRecord *rec = HashTable.Find(*(tMediaNameString *)&name);
     if(!rec)
         ThrowUnsupportedMediaType(name);
@@ -217,6 +224,8 @@ void tTVPStorageMediaManager::Register(iTVPStorageMedia *media) {
     ttstr medianame;
     media->GetName(medianame);
 
+    tTJSCSH csh(CS);
+
     tMediaRecord *rec = HashTable.Find(*(tMediaNameString *)&medianame);
     if(rec) return;
 
@@ -230,6 +239,8 @@ void tTVPStorageMediaManager::Unregister(iTVPStorageMedia *media) {
     ttstr medianame;
     media->GetName(medianame);
 
+    tTJSCSH csh(CS);
+
     tMediaRecord *rec = HashTable.Find(*(tMediaNameString *)&medianame);
     if(!rec)
         TVPThrowExceptionMessage(TVPMediaNameIsNotRegistered, medianame);
@@ -343,31 +354,37 @@ ttstr tTVPStorageMediaManager::NormalizeStorageName(const ttstr &name,
     path = pa;
 
     // supply omitted and normalize
-    if(media.IsEmpty()) {
-        media = TVPCurrentMedia;
-        if(media.IsEmpty()) media = TJS_W("file");
-    } else {
-        // normalize media name ( make them all small )
-        //        tjs_char *p = media.Independ();
-        //        while(*p) {
-        //            if(*p >= TJS_W('A') && *p <= TJS_W('Z'))
-        //                *p += (TJS_W('a') - TJS_W('A'));
-        //            p++;
-        //        }
-    }
+    iTVPStorageMedia *mediaintf;
+    {
+        // current directories may change on the main thread
+        tTJSCSH csh(CS);
+        if(media.IsEmpty()) {
+            media = TVPCurrentMedia;
+            if(media.IsEmpty()) media = TJS_W("file");
+        } else {
+            // normalize media name ( make them all small )
+            //        tjs_char *p = media.Independ();
+            //        while(*p) {
+            //            if(*p >= TJS_W('A') && *p <= TJS_W('Z'))
+            //                *p += (TJS_W('a') - TJS_W('A'));
+            //            p++;
+            //        }
+        }
 
-    tMediaRecord *mediarec = GetMediaRecord(media);
+        tMediaRecord *mediarec = GetMediaRecord(media);
+        mediaintf = mediarec->MediaIntf.GetObjectNoAddRef();
 
-    if(domain.IsEmpty())
-        domain = mediarec->CurrentDomain;
-    mediarec->MediaIntf.GetObjectNoAddRef()->NormalizeDomainName(domain);
+        if(domain.IsEmpty())
+            domain = mediarec->CurrentDomain;
 
-    if(path.IsEmpty()) {
-        path = TJS_W("/");
-    } else if(path.c_str()[0] != TJS_W('/')) {
-        path = mediarec->CurrentPath + path;
+        if(path.IsEmpty()) {
+            path = TJS_W("/");
+        } else if(path.c_str()[0] != TJS_W('/')) {
+            path = mediarec->CurrentPath + path;
+        }
     }
-    mediarec->MediaIntf.GetObjectNoAddRef()->NormalizePathName(path);
+    mediaintf->NormalizeDomainName(domain);
+    mediaintf->NormalizePathName(path);
 
     // compress redudant path accesses
     if(inarc_name_found) {
@@ -449,6 +466,7 @@ void tTVPStorageMediaManager::SetCurrentDirectory(const ttstr &name) {
     ttstr media, domain, path;
     NormalizeStorageName(name, &media, &domain, &path);
 
+    tTJSCSH csh(CS);
     tMediaRecord *rec = GetMediaRecord(media);
     rec->CurrentDomain = domain;
     rec->CurrentPath = path;
@@ -621,10 +639,7 @@ tTJSBinaryStream *tTVPArchive::CreateStream(const ttstr &name) {
     if(name.IsEmpty())
         return nullptr;
 
-    if(!Init) {
-        Init = true;
-        AddToHash();
-    }
+    std::call_once(HashInit, [this] { AddToHash(); });
 
     tjs_uint *p = Hash.Find(name);
     if(!p)
@@ -639,10 +654,7 @@ bool tTVPArchive::IsExistent(const ttstr &name) {
     if(name.IsEmpty())
         return false;
 
-    if(!Init) {
-        Init = true;
-        AddToHash();
-    }
+    std::call_once(HashInit, [this] { AddToHash(); });
 
     return Hash.Find(name) != nullptr;
 }
@@ -719,13 +731,17 @@ public:
 
     tTVPArchive *Get(ttstr name) {
         name = TVPNormalizeStorageName(name);
-        tTJSCSH csh(CS);
         tjs_uint32 hash = tTJSHashCache<ttstr, tHolder>::MakeHash(name);
-        tHolder *ptr = ArchiveCache.FindAndTouchWithHash(name, hash);
-        if(ptr) {
-            return ptr->GetObject();
+        {
+            tTJSCSH csh(CS);
+            tHolder *ptr = ArchiveCache.FindAndTouchWithHash(name, hash);
+            if(ptr) {
+                return ptr->GetObject();
+            }
         }
 
+        // the archive is opened without the lock held; opening a nested
+        // archive creates a stream, which takes TVPCreateStreamCS
         TVPAddLog(ttstr(TJS_W("(info) ArchiveCache miss: ")) + name);
 
         if(!TVPIsExistentStorageNoSearch(name)) {
@@ -736,6 +752,14 @@ public:
         if(!arc) {
             TVPThrowExceptionMessage(TVPCannotFindStorage, name);
         }
+
+        tTJSCSH csh(CS);
+        tHolder *ptr = ArchiveCache.FindWithHash(name, hash);
+        if(ptr) {
+            // opened by another thread meanwhile
+            arc->Release();
+            return ptr->GetObject();
+        }
         tHolder holder(arc);
         ArchiveCache.AddWithHash(name, hash, holder);
         return arc;
@@ -760,8 +784,6 @@ static tTVPAtExit TVPClearArchiveCacheAtExit(TVP_ATEXIT_PRI_SHUTDOWN,
 //---------------------------------------------------------------------------
 bool TVPIsExistentStorageNoSearchNoNormalize(const ttstr &name) {
     // does name contain > ?
-    tTJSCriticalSectionHolder cs_holder(TVPCreateStreamCS);
-
     const tjs_char *sharp_pos = TJS_strchr(name.c_str(), TVPArchiveDelimiter);
     if(sharp_pos) {
         // this storagename indicates a file in an archive
@@ -915,15 +937,110 @@ extern ttstr TVPChopStorageExt(const ttstr &name) {
 //---------------------------------------------------------------------------
 #define TVP_AUTO_PATH_HASH_SIZE 1024
 std::vector<ttstr> TVPAutoPathList;
-tTJSHashCache<ttstr, ttstr> TVPAutoPathCache(TVP_DEFAULT_AUTOPATH_CACHE_NUM);
-tTJSHashTable<ttstr, ttstr, tTJSHashFunc<ttstr>, TVP_AUTO_PATH_HASH_SIZE>
-    TVPAutoPathTable;
-bool AutoPathTableInit = false;
+
+//---------------------------------------------------------------------------
+// tTVPAutoPathCache : results of TVPGetPlacedPath
+//---------------------------------------------------------------------------
+/*
+        name resolution runs on the main thread and on the loader threads.
+        the cache is split into shards by the name hash, each with its own
+        lock, so that concurrent lookups rarely wait for each other.
+*/
+class tTVPAutoPathCache {
+    static const tjs_uint ShardCount = 8;
+    typedef tTJSHashCache<ttstr, ttstr> tCache;
+
+    struct tShard {
+        tTJSCriticalSection CS;
+        tCache Cache{ TVP_DEFAULT_AUTOPATH_CACHE_NUM / ShardCount };
+    } Shards[ShardCount];
+
+    std::atomic<tjs_uint> MaxCount{ TVP_DEFAULT_AUTOPATH_CACHE_NUM };
+    // incremented by Clear(); results resolved before a clear are dropped
+    std::atomic<tjs_uint> Generation{ 0 };
+
+    tShard &GetShard(tjs_uint32 hash) {
+        return Shards[(hash >> 16) % ShardCount];
+    }
+
+public:
+    [[nodiscard]] tjs_uint GetGeneration() const { return Generation; }
+
+    bool Find(const ttstr &name, ttstr &placed) {
+        tjs_uint32 hash = tCache::MakeHash(name);
+        tShard &shard = GetShard(hash);
+        tTJSCSH csh(shard.CS);
+        ttstr *p = shard.Cache.FindAndTouchWithHash(name, hash);
+        if(!p)
+            return false;
+        placed = *p;
+        return true;
+    }
+
+    void Add(const ttstr &name, const ttstr &placed, tjs_uint generation) {
+        tjs_uint32 hash = tCache::MakeHash(name);
+        tShard &shard = GetShard(hash);
+        tTJSCSH csh(shard.CS);
+        if(generation != Generation)
+            return; // the search paths changed while resolving
+        shard.Cache.AddWithHash(name, hash, placed);
+    }
+
+    void Delete(const ttstr &name) {
+        tjs_uint32 hash = tCache::MakeHash(name);
+        tShard &shard = GetShard(hash);
+        tTJSCSH csh(shard.CS);
+        shard.Cache.DeleteWithHash(name, hash);
+    }
+
+    void Clear() {
+        Generation++;
+        for(tShard &shard : Shards) {
+            tTJSCSH csh(shard.CS);
+            shard.Cache.Clear();
+        }
+    }
+
+    void SetMaxCount(tjs_uint max_count) {
+        MaxCount = max_count;
+        tjs_uint one = std::max<tjs_uint>(
+            1, (max_count + ShardCount - 1) / ShardCount);
+        for(tShard &shard : Shards) {
+            tTJSCSH csh(shard.CS);
+            shard.Cache.SetMaxCount(one);
+        }
+    }
+
+    tjs_uint GetCount() {
+        tjs_uint count = 0;
+        for(tShard &shard : Shards) {
+            tTJSCSH csh(shard.CS);
+            count += shard.Cache.GetCount();
+        }
+        return count;
+    }
+
+    [[nodiscard]] tjs_uint GetMaxCount() const { return MaxCount; }
+} static TVPAutoPathCache;
+
+//---------------------------------------------------------------------------
+// auto path table; maps storage names to the auto path which contains them.
+// the table is rebuilt as a whole and published as a read-only snapshot, so
+// that readers need no lock. null means that the table must be rebuilt.
+//---------------------------------------------------------------------------
+typedef tTJSHashTable<ttstr, ttstr, tTJSHashFunc<ttstr>,
+                      TVP_AUTO_PATH_HASH_SIZE>
+    tTVPAutoPathTable;
+static std::shared_ptr<const tTVPAutoPathTable> TVPAutoPathTable;
+// incremented whenever TVPAutoPathList changes; guarded by TVPCreateStreamCS
+static tjs_uint TVPAutoPathListGeneration = 0;
 
 //---------------------------------------------------------------------------
 static void TVPInvalidateAutoPathTable() {
-    TVPAutoPathTable.Clear();
-    AutoPathTableInit = false;
+    // called with TVPCreateStreamCS held
+    TVPAutoPathListGeneration++;
+    std::atomic_store(&TVPAutoPathTable,
+                      std::shared_ptr<const tTVPAutoPathTable>());
 }
 
 //---------------------------------------------------------------------------
@@ -938,10 +1055,8 @@ static void TVPClearAutoPathCache() {
 //---------------------------------------------------------------------------
 struct tTVPClearAutoPathCacheCallback : public tTVPCompactEventCallbackIntf {
     void OnCompact(tjs_int level) override {
-        if(level >= TVP_COMPACT_LEVEL_DEACTIVATE) {
-            tTJSCriticalSectionHolder cs_holder(TVPCreateStreamCS);
+        if(level >= TVP_COMPACT_LEVEL_DEACTIVATE)
             TVPClearAutoPathSearchCache();
-        }
     }
 } static TVPClearAutoPathCacheCallback;
 
@@ -986,14 +1101,25 @@ void TVPRemoveAutoPath(const ttstr &name) {
 }
 
 //---------------------------------------------------------------------------
-static tjs_uint TVPRebuildAutoPathTable() {
-    // rebuild auto path table
-    if(AutoPathTableInit)
-        return 0;
+static std::shared_ptr<const tTVPAutoPathTable> TVPGetAutoPathTable() {
+    // returns the auto path table, rebuilding it if needed
+    std::shared_ptr<const tTVPAutoPathTable> current =
+        std::atomic_load(&TVPAutoPathTable);
+    if(current)
+        return current;
 
-    tTJSCriticalSectionHolder cs_holder(TVPCreateStreamCS);
+    // the table is built without any lock held; opening the archives takes
+    // the archive cache lock and, for nested archives, TVPCreateStreamCS.
+    // threads that miss the table at the same time each build one.
+    std::vector<ttstr> pathlist;
+    tjs_uint generation;
+    {
+        tTJSCriticalSectionHolder cs_holder(TVPCreateStreamCS);
+        pathlist = TVPAutoPathList;
+        generation = TVPAutoPathListGeneration;
+    }
 
-    TVPAutoPathTable.Clear();
+    auto table = std::make_shared<tTVPAutoPathTable>();
 
     tjs_uint64 tick = TVPGetTickCount();
     TVPAddLog((const tjs_char *)TVPInfoRebuildingAutoPath);
@@ -1001,7 +1127,7 @@ static tjs_uint TVPRebuildAutoPathTable() {
     tjs_uint totalcount = 0;
 
     std::vector<ttstr>::iterator it;
-    for(it = TVPAutoPathList.begin(); it != TVPAutoPathList.end(); it++) {
+    for(it = pathlist.begin(); it != pathlist.end(); it++) {
         const ttstr &path = *it;
         tjs_uint count = 0;
 
@@ -1036,7 +1162,7 @@ static tjs_uint TVPRebuildAutoPathTable() {
                             if(!TJS_strchr(name.c_str() + in_arc_name_len,
                                            TJS_W('/'))) {
                                 ttstr sname = TVPExtractStorageName(name);
-                                TVPAutoPathTable.Add(sname, path);
+                                table->Add(sname, path);
                                 count++;
                             }
                         } else {
@@ -1060,7 +1186,7 @@ static tjs_uint TVPRebuildAutoPathTable() {
 
             TVPStorageMediaManager.GetListAt(path, &lister);
             for(auto &i : lister.list) {
-                TVPAutoPathTable.Add(i, path);
+                table->Add(i, path);
                 count++;
             }
         }
@@ -1077,13 +1203,20 @@ static tjs_uint TVPRebuildAutoPathTable() {
 
     TVPAddLog(ttstr(TJS_W("(info) Total ")) + ttstr((tjs_int)totalcount) +
               TJS_W(" file(s) found, ") +
-              ttstr((tjs_int)TVPAutoPathTable.GetCount()) +
+              ttstr((tjs_int)table->GetCount()) +
               TJS_W(" file(s) activated.") + TJS_W(" (") +
               ttstr((tjs_int)(endtick - tick)) + TJS_W("ms)"));
 
-    AutoPathTableInit = true;
+    {
+        // a table built from an outdated path list is used for this lookup
+        // only; the next lookup builds it again
+        tTJSCriticalSectionHolder cs_holder(TVPCreateStreamCS);
+        if(generation == TVPAutoPathListGeneration)
+            std::atomic_store(&TVPAutoPathTable,
+                              std::shared_ptr<const tTVPAutoPathTable>(table));
+    }
 
-    return totalcount;
+    return table;
 }
 //---------------------------------------------------------------------------
 
@@ -1102,21 +1235,23 @@ ttstr TVPGetPlacedPath(const ttstr &name) {
     }
 #endif
 
-    ttstr *incache = TVPAutoPathCache.FindAndTouch(name);
-    if(incache) {
-        if(*incache == TVP_AUTOPATH_CACHE_MISS_MARKER)
+    ttstr incache;
+    if(TVPAutoPathCache.Find(name, incache)) {
+        if(incache == TVP_AUTOPATH_CACHE_MISS_MARKER)
             return {};
-        return *incache; // found in cache
+        return incache; // found in cache
     }
 
-    tTJSCriticalSectionHolder cs_holder(TVPCreateStreamCS);
+    // this may run on several threads at once; the search itself only
+    // reads the published auto path table and the archive cache
+    tjs_uint generation = TVPAutoPathCache.GetGeneration();
 
     ttstr normalized(TVPNormalizeStorageName(name));
 
     bool found = TVPIsExistentStorageNoSearchNoNormalize(normalized);
     if(found) {
         // found in current folder
-        TVPAutoPathCache.Add(name, normalized);
+        TVPAutoPathCache.Add(name, normalized, generation);
         return normalized;
     }
 
@@ -1125,17 +1260,17 @@ ttstr TVPGetPlacedPath(const ttstr &name) {
 
     ttstr storagename = TVPExtractStorageName(normalized);
 
-    TVPRebuildAutoPathTable(); // ensure auto path table
-    ttstr *result = TVPAutoPathTable.Find(storagename);
+    std::shared_ptr<const tTVPAutoPathTable> table = TVPGetAutoPathTable();
+    ttstr *result = table->Find(storagename);
     if(result) {
         // found in table
         ttstr found = *result + storagename;
-        TVPAutoPathCache.Add(name, found);
+        TVPAutoPathCache.Add(name, found, generation);
         return found;
     }
 
     // not found
-    TVPAutoPathCache.Add(name, TVP_AUTOPATH_CACHE_MISS_MARKER);
+    TVPAutoPathCache.Add(name, TVP_AUTOPATH_CACHE_MISS_MARKER, generation);
     return {};
 }
 //---------------------------------------------------------------------------
@@ -1172,8 +1307,6 @@ bool TVPIsExistentStorage(const ttstr &name) {
 //---------------------------------------------------------------------------
 static tTJSBinaryStream *_TVPCreateStream(const ttstr &_name,
                                           tjs_uint32 flags) {
-    tTJSCriticalSectionHolder cs_holder(TVPCreateStreamCS);
-
     ttstr name;
 
     tjs_uint32 access = flags & TJS_BS_ACCESS_MASK;
@@ -1203,6 +1336,8 @@ static tTJSBinaryStream *_TVPCreateStream(const ttstr &_name,
         try {
             ttstr in_arc_name(sharp_pos + 1);
             tTVPArchive::NormalizeInArchiveStorageName(in_arc_name);
+            // not every archive type can create streams concurrently
+            tTJSCriticalSectionHolder cs_holder(TVPCreateStreamCS);
             stream = arc->CreateStream(in_arc_name);
         } catch(...) {
             arc->Release();
@@ -1275,29 +1410,141 @@ void TVPClearStorageCaches() {
 void TVPSetAutoPathCacheMaxCount(tjs_uint max_count) {
     if(max_count < 1)
         max_count = 1;
-    tTJSCriticalSectionHolder cs_holder(TVPCreateStreamCS);
     TVPAutoPathCache.SetMaxCount(max_count);
 }
 
-tjs_uint TVPGetAutoPathCacheCount() {
-    tTJSCriticalSectionHolder cs_holder(TVPCreateStreamCS);
-    return TVPAutoPathCache.GetCount();
-}
+tjs_uint TVPGetAutoPathCacheCount() { return TVPAutoPathCache.GetCount(); }
 
-tjs_uint TVPGetAutoPathCacheLimit() {
-    tTJSCriticalSectionHolder cs_holder(TVPCreateStreamCS);
-    return TVPAutoPathCache.GetMaxCount();
-}
+tjs_uint TVPGetAutoPathCacheLimit() { return TVPAutoPathCache.GetMaxCount(); }
 
 tjs_uint TVPGetAutoPathTableCount() {
-    tTJSCriticalSectionHolder cs_holder(TVPCreateStreamCS);
-    return TVPAutoPathTable.GetCount();
+    std::shared_ptr<const tTVPAutoPathTable> table =
+        std::atomic_load(&TVPAutoPathTable);
+    return table ? table->GetCount() : 0;
 }
 
 void TVPRemoveFromStorageCache(const ttstr &name) {
     TVPAutoPathCache.Delete(name);
 }
 
+//---------------------------------------------------------------------------
+// storage prefetch
+//---------------------------------------------------------------------------
+#define TVP_PREFETCH_IO_THREADS 2
+// at most this much of each storage is read; large media is streamed
+// anyway, and its head is what the consumer reads first
+#define TVP_PREFETCH_MAX_BYTES (8 * 1024 * 1024)
+
+struct tTVPPrefetchRequest {
+    tTVPCancelToken Token;
+    std::atomic<tjs_int> Remaining{ 0 };
+};
+
+static std::mutex TVPPrefetchMutex;
+static std::map<tjs_int, std::shared_ptr<tTVPPrefetchRequest>>
+    TVPPrefetchRequests;
+static tjs_int TVPPrefetchLastId = 0;
+static tTVPThreadPool *TVPPrefetchPool = nullptr;
+static std::once_flag TVPPrefetchPoolOnce;
+
+static tTVPThreadPool &TVPGetPrefetchPool() {
+    // I/O bound; kept apart from the CPU worker pool so that reads do not
+    // hold decoding work up
+    std::call_once(TVPPrefetchPoolOnce, [] {
+        TVPPrefetchPool = new tTVPThreadPool(TVP_PREFETCH_IO_THREADS);
+    });
+    return *TVPPrefetchPool;
+}
+
+static void TVPStopPrefetchPool() {
+    if(TVPPrefetchPool)
+        TVPPrefetchPool->Stop();
+}
+
+static tTVPAtExit TVPStopPrefetchPoolAtExit(TVP_ATEXIT_PRI_PREPARE,
+                                            TVPStopPrefetchPool);
+
+static void TVPPrefetchOne(const ttstr &name, const tTVPCancelToken &token) {
+    // called from the I/O threads
+    if(token.IsCancelled())
+        return;
+    try {
+        std::unique_ptr<tTJSBinaryStream> stream(
+            TVPCreateStream(name, TJS_BS_READ));
+        tjs_uint64 left =
+            std::min<tjs_uint64>(stream->GetSize(), TVP_PREFETCH_MAX_BYTES);
+        std::vector<tjs_uint8> buf(
+            (size_t)std::min<tjs_uint64>(left, 256 * 1024));
+        while(left && !token.IsCancelled()) {
+            tjs_uint one = stream->Read(
+                buf.data(), (tjs_uint)std::min<tjs_uint64>(left, buf.size()));
+            if(!one)
+                break;
+            left -= one;
+        }
+    } catch(...) {
+        // prefetch is only a hint; the real open reports errors
+    }
+}
+
+tjs_int TVPPrefetchStorages(const std::vector<ttstr> &names,
+                            tjs_int priority) {
+    // resolve the names here, on the calling thread; the I/O threads only
+    // open and read
+    std::vector<ttstr> placed;
+    placed.reserve(names.size());
+    for(const ttstr &name : names) {
+        ttstr p = TVPGetPlacedPath(name);
+        if(!p.IsEmpty())
+            placed.emplace_back(p.c_str()); // do not share the cached string
+    }
+    if(placed.empty())
+        return 0;
+
+    auto req = std::make_shared<tTVPPrefetchRequest>();
+    req->Remaining = (tjs_int)placed.size();
+    tjs_int id;
+    {
+        std::lock_guard<std::mutex> lk(TVPPrefetchMutex);
+        id = ++TVPPrefetchLastId;
+        if(id <= 0)
+            id = TVPPrefetchLastId = 1;
+        TVPPrefetchRequests[id] = req;
+    }
+
+    tTVPThreadPool &pool = TVPGetPrefetchPool();
+    for(ttstr &name : placed) {
+        // moved, so that only the I/O thread holds the string
+        pool.Post(
+            [id, req, name = std::move(name)]() {
+                TVPPrefetchOne(name, req->Token);
+                if(--req->Remaining == 0) {
+                    std::lock_guard<std::mutex> lk(TVPPrefetchMutex);
+                    TVPPrefetchRequests.erase(id);
+                }
+            },
+            priority);
+    }
+    return id;
+}
+
+void TVPCancelStoragePrefetch(tjs_int id) {
+    // queued tasks of cancelled requests still run, but return at once
+    std::lock_guard<std::mutex> lk(TVPPrefetchMutex);
+    if(id == 0) {
+        for(auto &i : TVPPrefetchRequests)
+            i.second->Token.Cancel();
+        TVPPrefetchRequests.clear();
+        return;
+    }
+    auto it = TVPPrefetchRequests.find(id);
+    if(it != TVPPrefetchRequests.end()) {
+        it->second->Token.Cancel();
+        TVPPrefetchRequests.erase(it);
+    }
+}
+//---------------------------------------------------------------------------
+
 //---------------------------------------------------------------------------
 // tTJSNC_Storages
 //---------------------------------------------------------------------------
@@ -1439,6 +1686,49 @@ TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/ clearArchiveCache) {
 }
 TJS_END_NATIVE_STATIC_METHOD_DECL(/*func. name*/ clearArchiveCache)
 //----------------------------------------------------------------------
+TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/ prefetch) {
+    // prefetch(storages, priority = 0); 'storages' is a storage name or
+    // an array of storage names. returns the request id.
+    if(numparams < 1)
+        return TJS_E_BADPARAMCOUNT;
+
+    std::vector<ttstr> names;
+    if(param[0]->Type() == tvtObject) {
+        tTJSVariantClosure clo = param[0]->AsObjectClosureNoAddRef();
+        tTJSVariant v;
+        clo.PropGet(0, TJS_W("count"), nullptr, &v, nullptr);
+        tjs_int count = v;
+        names.reserve(count);
+        for(tjs_int i = 0; i < count; i++) {
+            clo.PropGetByNum(0, i, &v, nullptr);
+            if(v.Type() != tvtVoid)
+                names.emplace_back(v);
+        }
+    } else {
+        names.emplace_back(*param[0]);
+    }
+
+    tjs_int priority = 0;
+    if(numparams >= 2 && param[1]->Type() != tvtVoid)
+        priority = *param[1];
+
+    tjs_int id = TVPPrefetchStorages(names, priority);
+    if(result)
+        *result = id;
+    return TJS_S_OK;
+}
+TJS_END_NATIVE_STATIC_METHOD_DECL(/*func. name*/ prefetch)
+//----------------------------------------------------------------------
+TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/ cancelPrefetch) {
+    // cancelPrefetch(id = 0); 0 cancels all pending requests
+    tjs_int id = 0;
+    if(numparams >= 1 && param[0]->Type() != tvtVoid)
+        id = *param[0];
+    TVPCancelStoragePrefetch(id);
+    return TJS_S_OK;
+}
+TJS_END_NATIVE_STATIC_METHOD_DECL(/*func. name*/ cancelPrefetch)
+//----------------------------------------------------------------------
 TJS_END_NATIVE_MEMBERS
 }
 
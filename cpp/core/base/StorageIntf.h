@@ -13,6 +13,8 @@
 
 #include "tjsNative.h"
 #include "tjsHashSearch.h"
+#include <atomic>
+#include <mutex>
 #include <vector>
 
 //---------------------------------------------------------------------------
@@ -31,26 +33,24 @@ ttstr TVPStringFromBMPUnicode(const tjs_uint16 *src, tjs_int maxlen = -1);
 //---------------------------------------------------------------------------
 class tTVPArchive {
 private:
-    tjs_uint RefCount;
+    std::atomic<tjs_uint> RefCount;
 
 public:
     //-- constructor
     tTVPArchive(const ttstr &name) {
         ArchiveName = name;
-        Init = false;
         RefCount = 1;
     }
 
     virtual ~tTVPArchive() {}
 
     //-- AddRef and Release
+    // archives are shared by the streams opened on background threads
     void AddRef() { RefCount++; }
 
     void Release() {
-        if(RefCount == 1)
+        if(--RefCount == 0)
             delete this;
-        else
-            RefCount--;
     }
 
     //-- must be implemented by delivered class
@@ -67,7 +67,7 @@ public:
     //-- others, implemented in this class
 private:
     tTJSHashTable<ttstr, tjs_uint, tTJSHashFunc<ttstr>, 1024> Hash;
-    bool Init;
+    std::once_flag HashInit; // Hash is built on first lookup
 
 public:
     ttstr ArchiveName;
@@ -75,8 +75,13 @@ public:
 public:
     static void NormalizeInArchiveStorageName(ttstr &name);
 
-private:
-    void AddToHash();
+protected:
+    virtual void AddToHash();
+
+    void AddToHash(const ttstr &name, tjs_uint32 hash, tjs_uint idx) {
+        // 'hash' must be tTJSHashFunc<ttstr>::Make(name)
+        Hash.AddWithHash(name, hash, idx);
+    }
 
 public:
     tTJSBinaryStream *CreateStream(const ttstr &name);
@@ -294,6 +299,34 @@ tjs_uint TVPGetAutoPathTableCount();
 extern tjs_uint TVPSegmentCacheLimit; // XP3 segment cache limit, in bytes.
 tjs_uint TVPGetXP3SegmentCacheTotalBytes();
 
+// XP3 blob cache: whole in-archive files after decompression and extraction
+// filter, shared by every handle which opens the same content.
+extern tjs_uint TVPXP3BlobCacheLimit; // total limit, in bytes ( 0 = off )
+extern tjs_uint TVPXP3BlobCacheOneLimit; // max size of a cached file
+struct tTVPXP3BlobCacheStats {
+    tjs_uint64 Bytes;
+    tjs_uint64 Limit;
+    tjs_uint Entries;
+    tjs_uint64 Hits;
+    tjs_uint64 Misses;
+};
+void TVPGetXP3BlobCacheStats(tTVPXP3BlobCacheStats &stats);
+
+// 7z solid folder cache, in bytes.
+void TVPSet7zFolderCacheLimit(tjs_uint64 bytes);
+tjs_uint64 TVPGet7zFolderCacheTotalBytes();
+void TVPClear7zFolderCache();
+
+// asynchronous storage prefetch. the storages are opened and read on
+// background I/O threads, which warms archive handles, XP3 index lookups,
+// the segment/blob caches and the OS page cache before the storages are
+// actually needed. requests with higher priority run first.
+// returns the request id, or 0 when nothing was queued.
+tjs_int TVPPrefetchStorages(const std::vector<ttstr> &names,
+                            tjs_int priority = 0);
+// cancels the request 'id'; 0 cancels all pending requests.
+void TVPCancelStoragePrefetch(tjs_int id = 0);
+
 void TVPAutoMountSiblingXP3Archives();
 void TVPBoostAutoMountPaths();
 
@@ -3,8 +3,11 @@
 
 #if defined(__APPLE__) || defined(__linux__) || defined(__ANDROID__)
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <cstddef>
+#include <cstdint>
 
 inline void *TVPMmapAlloc(size_t size) {
     static const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
@@ -24,7 +27,32 @@ inline void TVPMmapFree(void *mem) {
     munmap(base, totalSize);
 }
 
+// Maps a whole local file read-only. Returns nullptr (and leaves size
+// untouched) when the file cannot be mapped, e.g. the file does not exist,
+// is empty, or does not fit into the address space of a 32-bit process.
+inline const void *TVPMmapFileReadOnly(const char *path, uint64_t &size) {
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return nullptr;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size <= 0 ||
+       (uint64_t)(size_t)st.st_size != (uint64_t)st.st_size) {
+        close(fd);
+        return nullptr;
+    }
+    void *ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps its own reference to the file
+    if(ptr == MAP_FAILED) return nullptr;
+    size = (uint64_t)st.st_size;
+    return ptr;
+}
+
+inline void TVPMunmapFile(const void *ptr, uint64_t size) {
+    if(!ptr) return;
+    munmap(const_cast<void *>(ptr), (size_t)size);
+}
+
 #define TVP_USE_MMAP_TEMP 1
+#define TVP_USE_MMAP_FILE 1
 #endif
 
 #endif
@@ -12,18 +12,25 @@
 #include "tjsCommHead.h"
 
 #include "XP3Archive.h"
+#include "XP3IndexCache.h"
+#include "XP3SegmentCodec.h"
 #include "MsgIntf.h"
 #include "DebugIntf.h"
 #include "EventIntf.h"
 #include "UtilStreams.h"
 #include "SysInitIntf.h"
+#include "ThreadPool.h"
 
 #include <zlib.h>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 
 #include "TVPMmapAlloc.h"
 
 bool TVPAllowExtractProtectedStorage = true;
+bool TVPXP3ArchiveUseMmap = true;
+tjs_int TVPXP3SegmentReadAhead = 2;
 
 //---------------------------------------------------------------------------
 // archive filter related
@@ -31,6 +38,8 @@ bool TVPAllowExtractProtectedStorage = true;
 tTVPXP3ArchiveExtractionFilter TVPXP3ArchiveExtractionFilter = nullptr;
 
 void TVPSetXP3ArchiveExtractionFilter(tTVPXP3ArchiveExtractionFilter filter) {
+    if(TVPXP3ArchiveExtractionFilter != filter)
+        TVPClearXP3BlobCache(); // cached contents are filtered ones
     TVPXP3ArchiveExtractionFilter = filter;
 }
 //---------------------------------------------------------------------------
@@ -38,6 +47,9 @@ void TVPSetXP3ArchiveExtractionFilter(tTVPXP3ArchiveExtractionFilter filter) {
 static tTVPXP3ArchiveContentFilter TVPXP3ArchiveContentFilter = nullptr;
 
 void TVPSetXP3ArchiveContentFilter(tTVPXP3ArchiveContentFilter filter) {
+    // the filters are reinstalled whenever the filter setup changes, even
+    // when the same function is installed again
+    TVPClearXP3BlobCache();
     TVPXP3ArchiveContentFilter = filter;
 }
 
@@ -428,6 +440,7 @@ void tTVPXP3Archive::Init(tTJSBinaryStream *st, tjs_int64 off,
                    (flags & TVP_XP3_FILE_PROTECTED))
                     TVPThrowExceptionMessage(
                         TVPSpecifiedStorageHadBeenProtected);
+                item.Flags = flags;
                 item.OrgSize = ReadI64FromMem(indexdata + ch_info_start + 4);
                 item.ArcSize = ReadI64FromMem(indexdata + ch_info_start + 12);
 
@@ -457,11 +470,10 @@ void tTVPXP3Archive::Init(tTJSBinaryStream *st, tjs_int64 off,
                     tTVPXP3ArchiveSegment seg;
                     tjs_uint32 flags = ReadI32FromMem(indexdata + pos_base);
 
-                    if((flags & TVP_XP3_SEGM_ENCODE_METHOD_MASK) ==
-                       TVP_XP3_SEGM_ENCODE_RAW)
+                    seg.Method = flags & TVP_XP3_SEGM_ENCODE_METHOD_MASK;
+                    if(seg.Method == TVP_XP3_SEGM_ENCODE_RAW)
                         seg.IsCompressed = false;
-                    else if((flags & TVP_XP3_SEGM_ENCODE_METHOD_MASK) ==
-                            TVP_XP3_SEGM_ENCODE_ZLIB)
+                    else if(TVPGetXP3SegmentCodec(seg.Method))
                         seg.IsCompressed = true;
                     else
                         TVPThrowExceptionMessage(
@@ -526,13 +538,293 @@ void tTVPXP3Archive::Init(tTJSBinaryStream *st, tjs_int64 off,
 tTVPXP3Archive::tTVPXP3Archive(const ttstr &name, tTJSBinaryStream *st,
                                tjs_int64 offset, bool normalizeFileName) :
     tTVPArchive(name) {
-    if(!st)
-        st = TVPCreateStream(name);
-    Init(st, offset, normalizeFileName);
+    if(normalizeFileName && LoadIndexCache()) {
+        // index adopted from the cache; the archive stream is not needed
+        delete st;
+    } else {
+        if(!st)
+            st = TVPCreateStream(name);
+        Init(st, offset, normalizeFileName);
+        if(normalizeFileName)
+            SaveIndexCache();
+    }
+    MapArchive();
+}
+
+//---------------------------------------------------------------------------
+tTVPXP3Archive::~tTVPXP3Archive() {
+    TVPFreeArchiveHandlePoolByPointer(this);
+#ifdef TVP_USE_MMAP_FILE
+    TVPMunmapFile(MappedData, MappedSize);
+#endif
+}
+
+//---------------------------------------------------------------------------
+void tTVPXP3Archive::MapArchive() {
+    // map the whole archive storage once, so that in-archive streams can
+    // read segments straight from the page cache instead of issuing a
+    // read per access through the archive handle cache.
+#ifdef TVP_USE_MMAP_FILE
+    if(!TVPXP3ArchiveUseMmap)
+        return;
+
+    // only plain local files can be mapped; archives in archives or on
+    // other media use the handle cache as before.
+    ttstr localname = TVPGetLocallyAccessibleName(ArchiveName);
+    if(localname.IsEmpty())
+        return;
+
+    tjs_uint64 size = 0;
+    tTJSNarrowStringHolder holder(localname.c_str());
+    const void *data = TVPMmapFileReadOnly(holder, size);
+    if(!data)
+        return;
+
+    // every segment must lie inside the mapping; otherwise leave the
+    // archive on the stream path which reports errors per read.
+    for(const tArchiveItem &item : ItemVector) {
+        for(const tTVPXP3ArchiveSegment &seg : item.Segments) {
+            tjs_uint64 len = seg.IsCompressed ? seg.ArcSize : seg.OrgSize;
+            if(seg.Start > size || len > size - seg.Start) {
+                TVPMunmapFile(data, size);
+                return;
+            }
+        }
+    }
+
+    MappedData = (const tjs_uint8 *)data;
+    MappedSize = size;
+#endif
+}
+
+//---------------------------------------------------------------------------
+bool tTVPXP3Archive::LoadIndexCache() {
+    if(!TVPLoadXP3IndexCache(ArchiveName, ItemVector, NameHashes))
+        return false;
+
+    if(!TVPAllowExtractProtectedStorage) {
+        for(const tArchiveItem &item : ItemVector) {
+            if(item.Flags & TVP_XP3_FILE_PROTECTED) {
+                ItemVector.clear();
+                NameHashes.clear();
+                TVPThrowExceptionMessage(TVPSpecifiedStorageHadBeenProtected);
+            }
+        }
+    }
+
+    Count = (tjs_int)ItemVector.size();
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void tTVPXP3Archive::SaveIndexCache() {
+    NameHashes.resize(ItemVector.size());
+    for(size_t i = 0; i < ItemVector.size(); i++)
+        NameHashes[i] = tTJSHashFunc<ttstr>::Make(ItemVector[i].Name);
+    TVPSaveXP3IndexCache(ArchiveName, ItemVector, NameHashes);
+}
+
+//---------------------------------------------------------------------------
+void tTVPXP3Archive::AddToHash() {
+    // names are normalized when the hashes are known; skip rehashing them
+    if(NameHashes.size() != ItemVector.size()) {
+        tTVPArchive::AddToHash();
+        return;
+    }
+    for(size_t i = 0; i < ItemVector.size(); i++)
+        tTVPArchive::AddToHash(ItemVector[i].Name, NameHashes[i], (tjs_uint)i);
 }
 
 //---------------------------------------------------------------------------
-tTVPXP3Archive::~tTVPXP3Archive() { TVPFreeArchiveHandlePoolByPointer(this); }
+// tTVPXP3ArchiveMappedStream : zero-copy view of a stored (uncompressed,
+// unfiltered) file in a mapped archive
+//---------------------------------------------------------------------------
+class tTVPXP3ArchiveMappedStream : public tTVPMemoryStream {
+    tTVPXP3Archive *Owner;
+
+public:
+    tTVPXP3ArchiveMappedStream(tTVPXP3Archive *owner, const tjs_uint8 *block,
+                               tjs_uint size) :
+        tTVPMemoryStream(block, size), Owner(owner) {
+        Owner->AddRef(); // keep the mapping alive
+    }
+
+    ~tTVPXP3ArchiveMappedStream() override { Owner->Release(); }
+};
+
+//---------------------------------------------------------------------------
+// XP3 blob cache
+//---------------------------------------------------------------------------
+/*
+        whole in-archive files, after decompression and after the extraction
+        filter, keyed by their content ( file hash and size ) and in-archive
+        name. the extraction filter sees only these, so the result can be
+        shared by every archive and handle holding the same file. files of
+        archives without file hashes are keyed by archive name as well.
+*/
+#define TVP_BLOBCACHE_ONE_LIMIT (256 * 1024)
+#define TVP_BLOBCACHE_TOTAL_LIMIT (8 * 1024 * 1024)
+tjs_uint TVPXP3BlobCacheLimit = TVP_BLOBCACHE_TOTAL_LIMIT;
+tjs_uint TVPXP3BlobCacheOneLimit = TVP_BLOBCACHE_ONE_LIMIT;
+
+//---------------------------------------------------------------------------
+struct tTVPXP3BlobKey {
+    ttstr ArchiveName; // empty when FileHash identifies the content
+    ttstr Name; // in-archive name
+    tjs_uint32 FileHash;
+    tjs_uint64 OrgSize;
+
+    bool operator==(const tTVPXP3BlobKey &rhs) const {
+        return FileHash == rhs.FileHash && OrgSize == rhs.OrgSize &&
+            Name == rhs.Name && ArchiveName == rhs.ArchiveName;
+    }
+};
+
+//---------------------------------------------------------------------------
+class tTVPXP3BlobKeyHashFunc {
+public:
+    static tjs_uint32 Make(const tTVPXP3BlobKey &val) {
+        tjs_uint32 v = tTJSHashFunc<ttstr>::Make(val.Name);
+        if(!val.ArchiveName.IsEmpty())
+            v ^= tTJSHashFunc<ttstr>::Make(val.ArchiveName) << 1;
+        v ^= val.FileHash;
+        v ^= (tjs_uint32)val.OrgSize << 3;
+        return v;
+    }
+};
+
+//---------------------------------------------------------------------------
+class tTVPXP3Blob {
+    std::atomic<tjs_int> RefCount;
+    tjs_uint Size;
+    tjs_uint8 *Data;
+
+public:
+    explicit tTVPXP3Blob(tjs_uint size) :
+        RefCount(1), Size(size), Data(new tjs_uint8[size ? size : 1]) {}
+
+    ~tTVPXP3Blob() { delete[] Data; }
+
+    tjs_uint8 *GetData() const { return Data; }
+
+    tjs_uint GetSize() const { return Size; }
+
+    void AddRef() { RefCount.fetch_add(1, std::memory_order_relaxed); }
+
+    void Release() {
+        if(RefCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete this;
+    }
+};
+
+//---------------------------------------------------------------------------
+class tTVPXP3BlobStream : public tTVPMemoryStream {
+    tTVPXP3Blob *Blob;
+
+public:
+    explicit tTVPXP3BlobStream(tTVPXP3Blob *blob) :
+        tTVPMemoryStream(blob->GetData(), blob->GetSize()), Blob(blob) {
+        Blob->AddRef();
+    }
+
+    ~tTVPXP3BlobStream() override { Blob->Release(); }
+};
+
+//---------------------------------------------------------------------------
+typedef tTJSRefHolder<tTVPXP3Blob> tTVPXP3BlobHolder;
+
+typedef tTJSHashTable<tTVPXP3BlobKey, tTVPXP3BlobHolder,
+                      tTVPXP3BlobKeyHashFunc>
+    tTVPXP3BlobCache;
+static tTVPXP3BlobCache TVPXP3BlobCache;
+static tjs_uint TVPXP3BlobCacheTotalBytes = 0;
+static tjs_uint64 TVPXP3BlobCacheHits = 0;
+static tjs_uint64 TVPXP3BlobCacheMisses = 0;
+
+static tTJSCriticalSection TVPXP3BlobCacheCS;
+
+//---------------------------------------------------------------------------
+static void TVPCheckXP3BlobCacheLimit() {
+    tTJSCriticalSectionHolder cs_holder(TVPXP3BlobCacheCS);
+
+    while(TVPXP3BlobCacheTotalBytes > TVPXP3BlobCacheLimit) {
+        // chop last blob
+        tTVPXP3BlobCache::tIterator i;
+        i = TVPXP3BlobCache.GetLast();
+        if(!i.IsNull()) {
+            tjs_uint size = i.GetValue().GetObjectNoAddRef()->GetSize();
+            TVPXP3BlobCacheTotalBytes -= size;
+            TVPXP3BlobCache.ChopLast(1);
+        } else {
+            break;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+void TVPClearXP3BlobCache() {
+    tTJSCriticalSectionHolder cs_holder(TVPXP3BlobCacheCS);
+
+    TVPXP3BlobCache.Clear();
+    TVPXP3BlobCacheTotalBytes = 0;
+}
+
+//---------------------------------------------------------------------------
+void TVPGetXP3BlobCacheStats(tTVPXP3BlobCacheStats &stats) {
+    tTJSCriticalSectionHolder cs_holder(TVPXP3BlobCacheCS);
+
+    stats.Bytes = TVPXP3BlobCacheTotalBytes;
+    stats.Limit = TVPXP3BlobCacheLimit;
+    stats.Entries = TVPXP3BlobCache.GetCount();
+    stats.Hits = TVPXP3BlobCacheHits;
+    stats.Misses = TVPXP3BlobCacheMisses;
+}
+
+//---------------------------------------------------------------------------
+struct tTVPClearXP3BlobCacheCallback : public tTVPCompactEventCallbackIntf {
+    void OnCompact(tjs_int level) override {
+        // kept across deactivation; dropped only under memory pressure
+        if(level >= TVP_COMPACT_LEVEL_MINIMIZE)
+            TVPClearXP3BlobCache();
+    }
+} static TVPClearXP3BlobCacheCallback;
+
+static std::once_flag TVPClearXP3BlobCacheCallbackInit;
+
+//---------------------------------------------------------------------------
+static tTVPXP3Blob *TVPSearchFromXP3BlobCache(const tTVPXP3BlobKey &key,
+                                              tjs_uint32 hash) {
+    tTJSCriticalSectionHolder cs_holder(TVPXP3BlobCacheCS);
+
+    tTVPXP3BlobHolder *ptr = TVPXP3BlobCache.FindAndTouchWithHash(key, hash);
+    if(ptr) {
+        TVPXP3BlobCacheHits++;
+        return ptr->GetObject(); // add-refed
+    }
+    TVPXP3BlobCacheMisses++;
+    return nullptr;
+}
+
+//---------------------------------------------------------------------------
+static void TVPPushToXP3BlobCache(const tTVPXP3BlobKey &key, tjs_uint32 hash,
+                                  tTVPXP3Blob *blob) {
+    // blobs are pushed from the loader threads too
+    std::call_once(TVPClearXP3BlobCacheCallbackInit, [] {
+        TVPAddCompactEventHook(&TVPClearXP3BlobCacheCallback);
+    });
+
+    tTJSCriticalSectionHolder cs_holder(TVPXP3BlobCacheCS);
+
+    if(TVPXP3BlobCache.FindWithHash(key, hash))
+        return; // another thread materialized it first
+
+    tTVPXP3BlobHolder holder(blob);
+    TVPXP3BlobCache.AddWithHash(key, hash, holder);
+    TVPXP3BlobCacheTotalBytes += blob->GetSize();
+
+    TVPCheckXP3BlobCacheLimit();
+}
+//---------------------------------------------------------------------------
 
 tTVPArchive *tTVPXP3Archive::Create(const ttstr &name, tTJSBinaryStream *st,
                                     bool normalizeFileName) {
@@ -556,7 +848,66 @@ tTJSBinaryStream *tTVPXP3Archive::CreateStreamByIndex(tjs_uint idx) {
 
     tArchiveItem &item = ItemVector[idx];
 
-    tTJSBinaryStream *stream = TVPGetCachedArchiveHandle(this, ArchiveName);
+    if(MappedData && !TVPXP3ArchiveExtractionFilter &&
+       !TVPXP3ArchiveContentFilter && item.Segments.size() == 1 &&
+       !item.Segments[0].IsCompressed &&
+       item.OrgSize == (tjs_uint)item.OrgSize) {
+        // stored file in a mapped archive; hand out a view of the mapping
+        return new tTVPXP3ArchiveMappedStream(
+            this, MappedData + item.Segments[0].Start, (tjs_uint)item.OrgSize);
+    }
+
+    bool compressed = false;
+    for(const tTVPXP3ArchiveSegment &seg : item.Segments)
+        compressed = compressed || seg.IsCompressed;
+
+    if(!TVPXP3ArchiveContentFilter && item.OrgSize <= TVPXP3BlobCacheOneLimit &&
+       item.OrgSize <= TVPXP3BlobCacheLimit &&
+       (compressed || TVPXP3ArchiveExtractionFilter)) {
+        // small file which costs more than a copy to read; serve it from
+        // the blob cache
+        tTVPXP3BlobKey key;
+        if(!item.FileHash)
+            key.ArchiveName = ArchiveName;
+        key.Name = item.Name;
+        key.FileHash = item.FileHash;
+        key.OrgSize = item.OrgSize;
+        tjs_uint32 hash = tTVPXP3BlobKeyHashFunc::Make(key);
+
+        tTVPXP3Blob *blob = TVPSearchFromXP3BlobCache(key, hash);
+        if(!blob) {
+            // materialize through a regular in-archive stream
+            tTJSBinaryStream *stream =
+                MappedData ? nullptr
+                           : TVPGetCachedArchiveHandle(this, ArchiveName);
+            tTVPXP3ArchiveStream *in;
+            try {
+                in = new tTVPXP3ArchiveStream(this, idx, &(item.Segments),
+                                              stream, item.OrgSize);
+            } catch(...) {
+                if(stream)
+                    TVPReleaseCachedArchiveHandle(this, stream);
+                throw;
+            }
+            blob = new tTVPXP3Blob((tjs_uint)item.OrgSize);
+            try {
+                in->ReadBuffer(blob->GetData(), (tjs_uint)item.OrgSize);
+            } catch(...) {
+                delete in;
+                blob->Release();
+                throw;
+            }
+            delete in;
+            TVPPushToXP3BlobCache(key, hash, blob);
+        }
+
+        tTJSBinaryStream *out = new tTVPXP3BlobStream(blob);
+        blob->Release();
+        return out;
+    }
+
+    tTJSBinaryStream *stream =
+        MappedData ? nullptr : TVPGetCachedArchiveHandle(this, ArchiveName);
 
     tTVPXP3ArchiveStream *out;
     try {
@@ -575,7 +926,8 @@ tTJSBinaryStream *tTVPXP3Archive::CreateStreamByIndex(tjs_uint idx) {
             }
         }
     } catch(...) {
-        TVPReleaseCachedArchiveHandle(this, stream);
+        if(stream)
+            TVPReleaseCachedArchiveHandle(this, stream);
         throw;
     }
 
@@ -667,7 +1019,7 @@ public:
 
 //---------------------------------------------------------------------------
 class tTVPSegmentData {
-    tjs_int RefCount;
+    std::atomic<tjs_int> RefCount;
     tjs_uint Size;
     tjs_uint8 *Data;
 
@@ -688,27 +1040,41 @@ public:
         }
     }
 
-    void SetData(unsigned long outsize, tTJSBinaryStream *instream,
-                 unsigned long insize) {
+    bool Decode(tjs_uint32 method, tjs_uint outsize, const tjs_uint8 *indata,
+                tjs_uint insize) {
+        // does not throw; may be called from worker threads
+        const tTVPXP3SegmentCodec *codec = TVPGetXP3SegmentCodec(method);
+        if(!codec)
+            return false;
 #ifdef TVP_USE_MMAP_TEMP
-        tjs_uint8 *indata = (tjs_uint8 *)TVPMmapAlloc(insize);
+        Data = (tjs_uint8 *)TVPMmapAlloc(outsize);
 #else
-        tjs_uint8 *indata = new tjs_uint8[insize];
+        Data = new(std::nothrow) tjs_uint8[outsize];
 #endif
-        try {
-            instream->Read(indata, insize);
+        if(!Data)
+            return false;
+        if(!codec->Decode(Data, outsize, indata, insize))
+            return false;
+        Size = outsize;
+        return true;
+    }
 
+    void SetData(tjs_uint32 method, tjs_uint outsize, const tjs_uint8 *indata,
+                 tjs_uint insize) {
+        if(!Decode(method, outsize, indata, insize))
+            TVPThrowExceptionMessage(TVPUncompressionFailed);
+    }
+
+    void SetData(tjs_uint32 method, tjs_uint outsize,
+                 tTJSBinaryStream *instream, tjs_uint insize) {
 #ifdef TVP_USE_MMAP_TEMP
-            Data = (tjs_uint8 *)TVPMmapAlloc(outsize);
+        tjs_uint8 *indata = (tjs_uint8 *)TVPMmapAlloc(insize);
 #else
-            Data = new tjs_uint8[outsize];
+        tjs_uint8 *indata = new tjs_uint8[insize];
 #endif
-            unsigned long destlen = outsize;
-            int result = uncompress((unsigned char *)Data, &outsize,
-                                    (unsigned char *)indata, insize);
-            if(result != Z_OK || destlen != outsize)
-                TVPThrowExceptionMessage(TVPUncompressionFailed);
-            Size = outsize;
+        try {
+            instream->Read(indata, insize);
+            SetData(method, outsize, indata, insize);
         } catch(...) {
 #ifdef TVP_USE_MMAP_TEMP
             TVPMmapFree(indata);
@@ -728,14 +1094,11 @@ public:
 
     tjs_uint GetSize() const { return Size; }
 
-    void AddRef() { RefCount++; }
+    void AddRef() { RefCount.fetch_add(1, std::memory_order_relaxed); }
 
     void Release() {
-        if(RefCount == 1) {
+        if(RefCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
             delete this;
-        } else {
-            RefCount--;
-        }
     }
 };
 
@@ -829,6 +1192,62 @@ static void TVPPushToSegmentCache(const tTVPSegmentCacheSearchData &sdata,
 }
 //---------------------------------------------------------------------------
 
+//---------------------------------------------------------------------------
+// tTVPSegmentPrefetch : a compressed segment being inflated on a worker
+//---------------------------------------------------------------------------
+struct tTVPSegmentPrefetch {
+    enum { psQueued, psRunning, psDone };
+
+    std::atomic<tjs_int> State{ psQueued };
+    std::mutex Mutex;
+    std::condition_variable Cond;
+
+    tjs_uint32 Method = TVP_XP3_SEGM_ENCODE_RAW;
+    tjs_uint OrgSize = 0;
+    const tjs_uint8 *Input = nullptr; // mapped storage or InputBuffer
+    tjs_uint InputSize = 0;
+    std::vector<tjs_uint8> InputBuffer;
+
+    tTVPSegmentData *Result = nullptr; // nullptr on failure
+
+    ~tTVPSegmentPrefetch() {
+        if(Result)
+            Result->Release();
+    }
+
+    bool TryStart() {
+        tjs_int expected = psQueued;
+        return State.compare_exchange_strong(expected, psRunning);
+    }
+
+    bool TryCancel() {
+        tjs_int expected = psQueued;
+        return State.compare_exchange_strong(expected, psDone);
+    }
+
+    void Run() {
+        // State must be psRunning
+        auto *data = new tTVPSegmentData;
+        if(!data->Decode(Method, OrgSize, Input, InputSize)) {
+            data->Release();
+            data = nullptr;
+        }
+        std::vector<tjs_uint8>().swap(InputBuffer);
+        {
+            std::lock_guard<std::mutex> lk(Mutex);
+            Result = data;
+            State = psDone;
+        }
+        Cond.notify_all();
+    }
+
+    void Wait() {
+        std::unique_lock<std::mutex> lk(Mutex);
+        Cond.wait(lk, [this] { return State == psDone; });
+    }
+};
+//---------------------------------------------------------------------------
+
 //---------------------------------------------------------------------------
 // tTVPXP3ArchiveStream : stream class for in-archive storage
 //---------------------------------------------------------------------------
@@ -850,13 +1269,18 @@ tTVPXP3ArchiveStream::tTVPXP3ArchiveStream(
 
     Owner = owner;
     Owner->AddRef(); // hook
+    Mapped = Owner->GetMappedData();
     Stream = stream;
     OrgSize = orgsize;
 }
 
 //---------------------------------------------------------------------------
 tTVPXP3ArchiveStream::~tTVPXP3ArchiveStream() {
-    TVPReleaseCachedArchiveHandle(Owner, Stream);
+    // workers may still read the owner's mapped storage
+    for(tjs_int i = 0; i < (tjs_int)Prefetches.size(); i++)
+        CancelPrefetch(i);
+    if(Stream)
+        TVPReleaseCachedArchiveHandle(Owner, Stream);
     Owner->Release(); // unhook
     if(SegmentData)
         SegmentData->Release();
@@ -869,7 +1293,7 @@ void tTVPXP3ArchiveStream::EnsureSegment() {
         return;
 
     if(LastOpenedSegmentNum == CurSegmentNum) {
-        if(!CurSegment->IsCompressed)
+        if(!CurSegment->IsCompressed && !Mapped)
             Stream->SetPosition(CurSegment->Start + SegmentPos);
         return;
     }
@@ -884,10 +1308,11 @@ void tTVPXP3ArchiveStream::EnsureSegment() {
 
         if(CurSegment->OrgSize >= TVP_SEGCACHE_ONE_LIMIT) {
             // too large to cache
-            Stream->SetPosition(CurSegment->Start);
-            SegmentData = new tTVPSegmentData;
-            SegmentData->SetData((tjs_uint)CurSegment->OrgSize, Stream,
-                                 (tjs_uint)CurSegment->ArcSize);
+            SegmentData = TakePrefetchedSegment();
+            if(!SegmentData) {
+                SegmentData = new tTVPSegmentData;
+                LoadSegmentData(SegmentData);
+            }
         } else {
             // search thru segment cache
             tTVPSegmentCacheSearchData sdata;
@@ -901,16 +1326,20 @@ void tTVPXP3ArchiveStream::EnsureSegment() {
             SegmentData = TVPSearchFromSegmentCache(sdata, hash);
             if(!SegmentData) {
                 // not found in cache
-                Stream->SetPosition(CurSegment->Start);
-                SegmentData = new tTVPSegmentData;
-                SegmentData->SetData((tjs_uint)CurSegment->OrgSize, Stream,
-                                     (tjs_uint)CurSegment->ArcSize);
+                SegmentData = TakePrefetchedSegment();
+                if(!SegmentData) {
+                    SegmentData = new tTVPSegmentData;
+                    LoadSegmentData(SegmentData);
+                }
 
                 // add to cache
                 TVPPushToSegmentCache(sdata, hash, SegmentData);
             }
         }
-    } else {
+
+        // the stream position is free to move here
+        ScheduleReadAhead();
+    } else if(!Mapped) {
         // not a compressed segment
 
         Stream->SetPosition(CurSegment->Start + SegmentPos);
@@ -920,6 +1349,108 @@ void tTVPXP3ArchiveStream::EnsureSegment() {
     LastOpenedSegmentNum = CurSegmentNum;
 }
 
+//---------------------------------------------------------------------------
+void tTVPXP3ArchiveStream::LoadSegmentData(tTVPSegmentData *data) {
+    // inflate current segment into 'data'
+    if(Mapped) {
+        data->SetData(CurSegment->Method, (tjs_uint)CurSegment->OrgSize,
+                      Mapped + CurSegment->Start,
+                      (tjs_uint)CurSegment->ArcSize);
+    } else {
+        Stream->SetPosition(CurSegment->Start);
+        data->SetData(CurSegment->Method, (tjs_uint)CurSegment->OrgSize, Stream,
+                      (tjs_uint)CurSegment->ArcSize);
+    }
+}
+
+//---------------------------------------------------------------------------
+tTVPSegmentData *tTVPXP3ArchiveStream::TakePrefetchedSegment() {
+    // take the read-ahead result of current segment, if any
+    if(Prefetches.empty() || !Prefetches[CurSegmentNum])
+        return nullptr;
+    std::shared_ptr<tTVPSegmentPrefetch> p =
+        std::move(Prefetches[CurSegmentNum]);
+
+    if(p->TryStart())
+        p->Run(); // not picked up by any worker yet; inflate here
+    else
+        p->Wait();
+
+    if(!p->Result)
+        TVPThrowExceptionMessage(TVPUncompressionFailed);
+    tTVPSegmentData *data = p->Result;
+    p->Result = nullptr;
+    return data;
+}
+
+//---------------------------------------------------------------------------
+void tTVPXP3ArchiveStream::ScheduleReadAhead() {
+    // queue inflation of the compressed segments following current one
+    tjs_int count = (tjs_int)Segments->size();
+    if(TVPXP3SegmentReadAhead <= 0 || count <= 1)
+        return;
+    if(Prefetches.empty())
+        Prefetches.resize(count);
+
+    tjs_int last = std::min(count - 1, CurSegmentNum + TVPXP3SegmentReadAhead);
+
+    // drop requests which are out of the window (after seeking)
+    for(tjs_int i = 0; i < count; i++) {
+        if(Prefetches[i] && (i <= CurSegmentNum || i > last))
+            CancelPrefetch(i);
+    }
+
+    for(tjs_int i = CurSegmentNum + 1; i <= last; i++) {
+        const tTVPXP3ArchiveSegment &seg = Segments->operator[](i);
+        if(!seg.IsCompressed || Prefetches[i])
+            continue;
+
+        if(seg.OrgSize < TVP_SEGCACHE_ONE_LIMIT) {
+            // no need to inflate what is already in the segment cache
+            tTVPSegmentCacheSearchData sdata;
+            sdata.Name = Owner->GetName();
+            sdata.StorageIndex = StorageIndex;
+            sdata.SegmentIndex = i;
+            tTVPSegmentData *cached = TVPSearchFromSegmentCache(
+                sdata, tTVPSegmentCacheSearchHashFunc::Make(sdata));
+            if(cached) {
+                cached->Release();
+                continue;
+            }
+        }
+
+        auto p = std::make_shared<tTVPSegmentPrefetch>();
+        p->Method = seg.Method;
+        p->OrgSize = (tjs_uint)seg.OrgSize;
+        p->InputSize = (tjs_uint)seg.ArcSize;
+        if(Mapped) {
+            p->Input = Mapped + seg.Start;
+        } else {
+            // compressed data is read here; only inflation goes to workers
+            p->InputBuffer.resize(p->InputSize);
+            Stream->SetPosition(seg.Start);
+            Stream->ReadBuffer(p->InputBuffer.data(), p->InputSize);
+            p->Input = p->InputBuffer.data();
+        }
+        Prefetches[i] = p;
+
+        // nearer segments first
+        TVPGetWorkerThreadPool().Post(
+            [p] {
+                if(p->TryStart())
+                    p->Run();
+            },
+            CurSegmentNum - i);
+    }
+}
+
+//---------------------------------------------------------------------------
+void tTVPXP3ArchiveStream::CancelPrefetch(tjs_int index) {
+    std::shared_ptr<tTVPSegmentPrefetch> p = std::move(Prefetches[index]);
+    if(p && !p->TryCancel())
+        p->Wait(); // already running
+}
+
 //---------------------------------------------------------------------------
 void tTVPXP3ArchiveStream::SeekToPosition(tjs_uint64 pos) {
     // open segment at 'pos' and seek
@@ -1016,6 +1547,10 @@ tjs_uint tTVPXP3ArchiveStream::Read(void *buffer, tjs_uint read_size) {
             // memory
             memcpy((tjs_uint8 *)buffer + write_size,
                    SegmentData->GetData() + (tjs_uint)SegmentPos, one_size);
+        } else if(Mapped) {
+            // read directly from mapped archive storage
+            memcpy((tjs_uint8 *)buffer + write_size,
+                   Mapped + CurSegment->Start + SegmentPos, one_size);
         } else {
             // read directly from stream
             Stream->ReadBuffer((tjs_uint8 *)buffer + write_size, one_size);
@@ -13,6 +13,7 @@
 #define XP3ArchiveH
 
 #include "StorageIntf.h"
+#include <memory>
 
 /*[*/
 //---------------------------------------------------------------------------
@@ -78,10 +79,16 @@ TJS_EXP_FUNC_DEF(void, TVPSetXP3ArchiveContentFilter,
 #define TVP_XP3_SEGM_ENCODE_METHOD_MASK 0x07
 #define TVP_XP3_SEGM_ENCODE_RAW 0
 #define TVP_XP3_SEGM_ENCODE_ZLIB 1
+#define TVP_XP3_SEGM_ENCODE_ZSTD 2
+#define TVP_XP3_SEGM_ENCODE_LZ4 3
 
 //---------------------------------------------------------------------------
 extern bool TVPIsXP3Archive(const ttstr &name); // check XP3 archive
 extern void TVPClearXP3SegmentCache(); // clear XP3 segment cache
+extern void TVPClearXP3BlobCache(); // clear XP3 blob cache
+extern bool TVPXP3ArchiveUseMmap; // map local XP3 archives into memory
+extern tjs_int TVPXP3SegmentReadAhead;
+// number of compressed segments inflated ahead on worker threads (0 = off)
 //---------------------------------------------------------------------------
 struct tTVPXP3ArchiveSegment {
     tjs_uint64 Start; // start position in archive storage
@@ -90,6 +97,7 @@ struct tTVPXP3ArchiveSegment {
     tjs_uint64 OrgSize; // original segment (uncompressed) size
     tjs_uint64 ArcSize; // in-archive segment (compressed) size
     bool IsCompressed; // is compressed ?
+    tjs_uint32 Method; // TVP_XP3_SEGM_ENCODE_*
 };
 
 //---------------------------------------------------------------------------
@@ -97,6 +105,7 @@ class tTVPXP3Archive : public tTVPArchive {
 public:
     struct tArchiveItem {
         ttstr Name;
+        tjs_uint32 Flags{}; // TVP_XP3_FILE_*
         tjs_uint32 FileHash{};
         tjs_uint64 OrgSize{}; // original ( uncompressed ) size
         tjs_uint64 ArcSize{}; // in-archive size
@@ -111,6 +120,10 @@ public:
 
     std::vector<tArchiveItem> ItemVector;
 
+    // tTJSHashFunc<ttstr> values of item names, parallel to ItemVector;
+    // kept only when the index came from or went to the index cache
+    std::vector<tjs_uint32> NameHashes;
+
     void Init(tTJSBinaryStream *st, tjs_int64 offset,
               bool normalizeName = true);
 
@@ -142,6 +155,25 @@ public:
 
     tTJSBinaryStream *CreateStreamByIndex(tjs_uint idx) override;
 
+    // whole archive storage mapped read-only, or nullptr when the archive
+    // is accessed through the handle cache
+    [[nodiscard]] const tjs_uint8 *GetMappedData() const { return MappedData; }
+
+    [[nodiscard]] tjs_uint64 GetMappedSize() const { return MappedSize; }
+
+private:
+    const tjs_uint8 *MappedData = nullptr;
+    tjs_uint64 MappedSize = 0;
+
+    void MapArchive();
+
+    bool LoadIndexCache();
+
+    void SaveIndexCache();
+
+protected:
+    void AddToHash() override;
+
 private:
     static bool FindChunk(const tjs_uint8 *data, const tjs_uint8 *name,
                           tjs_uint &start, tjs_uint &size);
@@ -158,6 +190,7 @@ private:
 // tTVPXP3ArchiveStream  : XP3 In-Archive Stream Implmentation
 //---------------------------------------------------------------------------
 class tTVPSegmentData;
+struct tTVPSegmentPrefetch;
 
 class tTVPXP3ArchiveStream : public tTJSBinaryStream {
     tTVPXP3Archive *Owner;
@@ -174,6 +207,8 @@ class tTVPXP3ArchiveStream : public tTJSBinaryStream {
 
     tjs_int LastOpenedSegmentNum;
 
+    const tjs_uint8 *Mapped; // owner's mapped archive storage, if any
+
     tjs_uint64 CurPos; // current position in absolute file position
 
     tjs_uint64 SegmentRemain; // remain bytes in current segment
@@ -184,6 +219,9 @@ class tTVPXP3ArchiveStream : public tTJSBinaryStream {
     bool SegmentOpened;
     tTJSVariant FilterContext;
 
+    std::vector<std::shared_ptr<tTVPSegmentPrefetch>> Prefetches;
+    // read-ahead requests, indexed by segment number
+
 public:
     tTVPXP3ArchiveStream(tTVPXP3Archive *owner, tjs_int storageindex,
                          std::vector<tTVPXP3ArchiveSegment> *segments,
@@ -197,6 +235,10 @@ private:
     void EnsureSegment(); // ensure accessing to current segment
     void SeekToPosition(tjs_uint64 pos); // open segment at 'pos' and seek
     bool OpenNextSegment();
+    void LoadSegmentData(tTVPSegmentData *data);
+    tTVPSegmentData *TakePrefetchedSegment();
+    void ScheduleReadAhead();
+    void CancelPrefetch(tjs_int index);
 
 public:
     tjs_uint64 Seek(tjs_int64 offset, tjs_int whence) override;
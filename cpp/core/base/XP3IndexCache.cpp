@@ -0,0 +1,368 @@
+//---------------------------------------------------------------------------
+// XP3 index cache
+//---------------------------------------------------------------------------
+#include "tjsCommHead.h"
+
+#include "XP3IndexCache.h"
+#include "XP3SegmentCodec.h"
+#include "StorageImpl.h"
+#include "SysInitImpl.h"
+#include "DebugIntf.h"
+#include "TVPMmapAlloc.h"
+
+#include <zlib.h>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+bool TVPXP3IndexCacheEnabled = true;
+
+//---------------------------------------------------------------------------
+// on-disk layout
+//---------------------------------------------------------------------------
+/*
+        header | item table | segment table | name table
+
+        all integers are host endian; the cache is never shared between
+        machines. the name table holds the archive's storage name first,
+        followed by every item name, without terminators. tables are
+        8-byte aligned so that the file can be used in place when mapped.
+*/
+#define TVP_XP3_INDEX_CACHE_VERSION 1
+
+namespace {
+const char TVPXP3IndexCacheMagic[8] = { 'K', 'R', 'X', 'P', '3', 'I', 'D', 'X' };
+
+struct tTVPXP3IndexCacheHeader {
+    char Magic[8];
+    tjs_uint32 Version;
+    tjs_uint32 CharSize; // sizeof(tjs_char)
+    tjs_uint64 ArchiveSize;
+    tjs_int64 ArchiveMTime;
+    tjs_uint32 ArchiveNameLength; // in characters
+    tjs_uint32 ItemCount;
+    tjs_uint32 SegmentCount;
+    tjs_uint32 Checksum; // adler32 of everything after the header
+    tjs_uint64 ItemTableOffset;
+    tjs_uint64 SegmentTableOffset;
+    tjs_uint64 NameTableOffset;
+    tjs_uint64 TotalSize;
+};
+
+struct tTVPXP3IndexCacheItem {
+    tjs_uint64 OrgSize;
+    tjs_uint64 ArcSize;
+    tjs_uint32 NameOffset; // in characters, from the name table
+    tjs_uint32 NameLength;
+    tjs_uint32 NameHash; // tTJSHashFunc<ttstr>::Make(Name)
+    tjs_uint32 FileHash;
+    tjs_uint32 Flags;
+    tjs_uint32 FirstSegment;
+    tjs_uint32 SegmentCount;
+    tjs_uint32 Reserved;
+};
+
+struct tTVPXP3IndexCacheSegment {
+    tjs_uint64 Start;
+    tjs_uint64 Offset;
+    tjs_uint64 OrgSize;
+    tjs_uint64 ArcSize;
+    tjs_uint32 Flags; // TVP_XP3_SEGM_ENCODE_*
+    tjs_uint32 Reserved;
+};
+
+static_assert(sizeof(tTVPXP3IndexCacheHeader) % 8 == 0, "");
+static_assert(sizeof(tTVPXP3IndexCacheItem) % 8 == 0, "");
+static_assert(sizeof(tTVPXP3IndexCacheSegment) % 8 == 0, "");
+
+//---------------------------------------------------------------------------
+// archive storage name -> cache key
+//---------------------------------------------------------------------------
+struct tTVPXP3IndexCacheKey {
+    std::filesystem::path CachePath;
+    tjs_uint64 ArchiveSize = 0;
+    tjs_int64 ArchiveMTime = 0;
+};
+
+bool TVPGetXP3IndexCacheKey(const ttstr &arcname, tTVPXP3IndexCacheKey &key) {
+    if(!TVPXP3IndexCacheEnabled || TVPNativeDataPath.IsEmpty())
+        return false;
+
+    // only local archives have a reliable size and modification time
+    ttstr localname = TVPGetLocallyAccessibleName(arcname);
+    if(localname.IsEmpty())
+        return false;
+
+    std::error_code ec;
+    std::filesystem::path arcpath =
+        std::filesystem::u8path(localname.AsStdString());
+    key.ArchiveSize = std::filesystem::file_size(arcpath, ec);
+    if(ec)
+        return false;
+    auto mtime = std::filesystem::last_write_time(arcpath, ec);
+    if(ec)
+        return false;
+    key.ArchiveMTime = (tjs_int64)mtime.time_since_epoch().count();
+
+    char filename[32];
+    std::snprintf(filename, sizeof(filename), "%08x%08x.idx",
+                  (unsigned)tTJSHashFunc<ttstr>::Make(arcname),
+                  (unsigned)arcname.GetLen());
+    key.CachePath = std::filesystem::u8path(TVPNativeDataPath.AsStdString()) /
+        "xp3index" / filename;
+    return true;
+}
+
+tjs_uint64 TVPAlignXP3IndexCache(tjs_uint64 v) { return (v + 7) & ~(tjs_uint64)7; }
+
+//---------------------------------------------------------------------------
+// read-only view of a cache file
+//---------------------------------------------------------------------------
+class tTVPXP3IndexCacheFile {
+    const tjs_uint8 *Data = nullptr;
+    tjs_uint64 Size = 0;
+#ifdef TVP_USE_MMAP_FILE
+    bool Mapped = false;
+#endif
+    std::vector<tjs_uint8> Buffer;
+
+public:
+    explicit tTVPXP3IndexCacheFile(const std::filesystem::path &path) {
+#ifdef TVP_USE_MMAP_FILE
+        Data = (const tjs_uint8 *)TVPMmapFileReadOnly(path.u8string().c_str(),
+                                                      Size);
+        if(Data) {
+            Mapped = true;
+            return;
+        }
+#endif
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if(!in)
+            return;
+        std::streamoff len = in.tellg();
+        if(len <= 0)
+            return;
+        Buffer.resize((size_t)len);
+        in.seekg(0);
+        if(!in.read((char *)Buffer.data(), len))
+            return;
+        Data = Buffer.data();
+        Size = (tjs_uint64)len;
+    }
+
+    ~tTVPXP3IndexCacheFile() {
+#ifdef TVP_USE_MMAP_FILE
+        if(Mapped)
+            TVPMunmapFile(Data, Size);
+#endif
+    }
+
+    [[nodiscard]] const tjs_uint8 *GetData() const { return Data; }
+
+    [[nodiscard]] tjs_uint64 GetSize() const { return Size; }
+};
+} // namespace
+
+//---------------------------------------------------------------------------
+// TVPLoadXP3IndexCache
+//---------------------------------------------------------------------------
+bool TVPLoadXP3IndexCache(const ttstr &arcname,
+                          std::vector<tTVPXP3Archive::tArchiveItem> &items,
+                          std::vector<tjs_uint32> &namehashes) {
+    tTVPXP3IndexCacheKey key;
+    if(!TVPGetXP3IndexCacheKey(arcname, key))
+        return false;
+
+    std::error_code ec;
+    if(!std::filesystem::exists(key.CachePath, ec))
+        return false;
+
+    tTVPXP3IndexCacheFile file(key.CachePath);
+    const tjs_uint8 *data = file.GetData();
+    tjs_uint64 size = file.GetSize();
+    if(!data || size < sizeof(tTVPXP3IndexCacheHeader))
+        return false;
+
+    // validate the header against the current archive file
+    const auto *hdr = (const tTVPXP3IndexCacheHeader *)data;
+    if(memcmp(hdr->Magic, TVPXP3IndexCacheMagic, sizeof(hdr->Magic)) ||
+       hdr->Version != TVP_XP3_INDEX_CACHE_VERSION ||
+       hdr->CharSize != sizeof(tjs_char) || hdr->TotalSize != size ||
+       hdr->ArchiveSize != key.ArchiveSize ||
+       hdr->ArchiveMTime != key.ArchiveMTime)
+        return false;
+
+    tjs_uint64 itemtablesize =
+        (tjs_uint64)hdr->ItemCount * sizeof(tTVPXP3IndexCacheItem);
+    tjs_uint64 segtablesize =
+        (tjs_uint64)hdr->SegmentCount * sizeof(tTVPXP3IndexCacheSegment);
+    if(hdr->ItemTableOffset != sizeof(tTVPXP3IndexCacheHeader) ||
+       hdr->SegmentTableOffset < hdr->ItemTableOffset + itemtablesize ||
+       hdr->NameTableOffset < hdr->SegmentTableOffset + segtablesize ||
+       hdr->NameTableOffset > size)
+        return false;
+
+    tjs_uint64 namecount = (size - hdr->NameTableOffset) / sizeof(tjs_char);
+    if(hdr->ArchiveNameLength > namecount)
+        return false;
+
+    uLong checksum = adler32(0L, Z_NULL, 0);
+    checksum = adler32(checksum, data + sizeof(tTVPXP3IndexCacheHeader),
+                       (uInt)(size - sizeof(tTVPXP3IndexCacheHeader)));
+    if((tjs_uint32)checksum != hdr->Checksum)
+        return false;
+
+    const auto *names = (const tjs_char *)(data + hdr->NameTableOffset);
+    if(ttstr(names, hdr->ArchiveNameLength) != arcname)
+        return false; // hash collision in the cache file name
+
+    const auto *itemtable =
+        (const tTVPXP3IndexCacheItem *)(data + hdr->ItemTableOffset);
+    const auto *segtable =
+        (const tTVPXP3IndexCacheSegment *)(data + hdr->SegmentTableOffset);
+
+    // adopt the index; names are already normalized and sorted
+    std::vector<tTVPXP3Archive::tArchiveItem> newitems(hdr->ItemCount);
+    std::vector<tjs_uint32> newhashes(hdr->ItemCount);
+    for(tjs_uint32 i = 0; i < hdr->ItemCount; i++) {
+        const tTVPXP3IndexCacheItem &rec = itemtable[i];
+        if((tjs_uint64)rec.NameOffset + rec.NameLength > namecount ||
+           (tjs_uint64)rec.FirstSegment + rec.SegmentCount > hdr->SegmentCount)
+            return false;
+
+        tTVPXP3Archive::tArchiveItem &item = newitems[i];
+        item.Name = ttstr(names + rec.NameOffset, rec.NameLength);
+        item.Flags = rec.Flags;
+        item.FileHash = rec.FileHash;
+        item.OrgSize = rec.OrgSize;
+        item.ArcSize = rec.ArcSize;
+        item.Segments.resize(rec.SegmentCount);
+        for(tjs_uint32 s = 0; s < rec.SegmentCount; s++) {
+            const tTVPXP3IndexCacheSegment &srec =
+                segtable[rec.FirstSegment + s];
+            tTVPXP3ArchiveSegment &seg = item.Segments[s];
+            seg.Start = srec.Start;
+            seg.Offset = srec.Offset;
+            seg.OrgSize = srec.OrgSize;
+            seg.ArcSize = srec.ArcSize;
+            seg.Method = srec.Flags & TVP_XP3_SEGM_ENCODE_METHOD_MASK;
+            seg.IsCompressed = seg.Method != TVP_XP3_SEGM_ENCODE_RAW;
+            if(seg.IsCompressed && !TVPGetXP3SegmentCodec(seg.Method))
+                return false; // let the archive reject it as usual
+        }
+        newhashes[i] = rec.NameHash;
+    }
+
+    items.swap(newitems);
+    namehashes.swap(newhashes);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// TVPSaveXP3IndexCache
+//---------------------------------------------------------------------------
+void TVPSaveXP3IndexCache(const ttstr &arcname,
+                          const std::vector<tTVPXP3Archive::tArchiveItem> &items,
+                          const std::vector<tjs_uint32> &namehashes) {
+    tTVPXP3IndexCacheKey key;
+    if(!TVPGetXP3IndexCacheKey(arcname, key))
+        return;
+
+    try {
+        tjs_uint64 segcount = 0;
+        tjs_uint64 namecount = arcname.GetLen();
+        for(const auto &item : items) {
+            segcount += item.Segments.size();
+            namecount += item.Name.GetLen();
+        }
+        if(items.size() != namehashes.size() || items.size() > 0xffffffffu ||
+           segcount > 0xffffffffu || namecount > 0xffffffffu)
+            return;
+
+        tTVPXP3IndexCacheHeader hdr{};
+        memcpy(hdr.Magic, TVPXP3IndexCacheMagic, sizeof(hdr.Magic));
+        hdr.Version = TVP_XP3_INDEX_CACHE_VERSION;
+        hdr.CharSize = sizeof(tjs_char);
+        hdr.ArchiveSize = key.ArchiveSize;
+        hdr.ArchiveMTime = key.ArchiveMTime;
+        hdr.ArchiveNameLength = arcname.GetLen();
+        hdr.ItemCount = (tjs_uint32)items.size();
+        hdr.SegmentCount = (tjs_uint32)segcount;
+        hdr.ItemTableOffset = sizeof(hdr);
+        hdr.SegmentTableOffset = TVPAlignXP3IndexCache(
+            hdr.ItemTableOffset + items.size() * sizeof(tTVPXP3IndexCacheItem));
+        hdr.NameTableOffset = TVPAlignXP3IndexCache(
+            hdr.SegmentTableOffset +
+            segcount * sizeof(tTVPXP3IndexCacheSegment));
+        hdr.TotalSize = hdr.NameTableOffset + namecount * sizeof(tjs_char);
+
+        std::vector<tjs_uint8> image((size_t)hdr.TotalSize, 0);
+        auto *itemtable =
+            (tTVPXP3IndexCacheItem *)(image.data() + hdr.ItemTableOffset);
+        auto *segtable =
+            (tTVPXP3IndexCacheSegment *)(image.data() + hdr.SegmentTableOffset);
+        auto *names = (tjs_char *)(image.data() + hdr.NameTableOffset);
+
+        tjs_uint32 nameofs = 0;
+        memcpy(names, arcname.c_str(), arcname.GetLen() * sizeof(tjs_char));
+        nameofs += arcname.GetLen();
+
+        tjs_uint32 segidx = 0;
+        for(size_t i = 0; i < items.size(); i++) {
+            const tTVPXP3Archive::tArchiveItem &item = items[i];
+            tTVPXP3IndexCacheItem &rec = itemtable[i];
+            rec.OrgSize = item.OrgSize;
+            rec.ArcSize = item.ArcSize;
+            rec.NameOffset = nameofs;
+            rec.NameLength = item.Name.GetLen();
+            rec.NameHash = namehashes[i];
+            rec.FileHash = item.FileHash;
+            rec.Flags = item.Flags;
+            rec.FirstSegment = segidx;
+            rec.SegmentCount = (tjs_uint32)item.Segments.size();
+
+            if(rec.NameLength)
+                memcpy(names + nameofs, item.Name.c_str(),
+                       rec.NameLength * sizeof(tjs_char));
+            nameofs += rec.NameLength;
+
+            for(const tTVPXP3ArchiveSegment &seg : item.Segments) {
+                tTVPXP3IndexCacheSegment &srec = segtable[segidx++];
+                srec.Start = seg.Start;
+                srec.Offset = seg.Offset;
+                srec.OrgSize = seg.OrgSize;
+                srec.ArcSize = seg.ArcSize;
+                srec.Flags = seg.IsCompressed ? seg.Method
+                                              : TVP_XP3_SEGM_ENCODE_RAW;
+            }
+        }
+
+        uLong checksum = adler32(0L, Z_NULL, 0);
+        checksum = adler32(checksum, image.data() + sizeof(hdr),
+                           (uInt)(image.size() - sizeof(hdr)));
+        hdr.Checksum = (tjs_uint32)checksum;
+        memcpy(image.data(), &hdr, sizeof(hdr));
+
+        // write to a temporary file and rename it over, so that a reader
+        // never sees a partially written cache
+        std::error_code ec;
+        std::filesystem::create_directories(key.CachePath.parent_path(), ec);
+        std::filesystem::path tmppath = key.CachePath;
+        tmppath += ".tmp";
+        {
+            std::ofstream out(tmppath, std::ios::binary | std::ios::trunc);
+            if(!out)
+                return;
+            out.write((const char *)image.data(), (std::streamsize)image.size());
+            if(!out)
+                return;
+        }
+        std::filesystem::rename(tmppath, key.CachePath, ec);
+        if(ec)
+            std::filesystem::remove(tmppath, ec);
+    } catch(...) {
+        // the cache is an optimization only
+    }
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,37 @@
+//---------------------------------------------------------------------------
+// XP3 index cache
+//---------------------------------------------------------------------------
+/*
+        persistent on-disk cache of parsed XP3 indices.
+
+        each local archive gets one flat, versioned binary file keyed by
+        its storage name, size and modification time. the file holds
+        pre-normalized, pre-sorted names together with their name hashes,
+        segment lists and file hashes, so that tTVPXP3Archive can adopt the
+        index without inflating and parsing the archive's own index chunk.
+*/
+//---------------------------------------------------------------------------
+#ifndef XP3IndexCacheH
+#define XP3IndexCacheH
+
+#include "XP3Archive.h"
+
+//---------------------------------------------------------------------------
+extern bool TVPXP3IndexCacheEnabled; // use persistent XP3 index cache
+//---------------------------------------------------------------------------
+
+// loads cached index of the archive 'arcname' into 'items' and 'namehashes'.
+// returns false when the archive is not a local file or there is no valid
+// cache entry for the current archive file.
+bool TVPLoadXP3IndexCache(const ttstr &arcname,
+                          std::vector<tTVPXP3Archive::tArchiveItem> &items,
+                          std::vector<tjs_uint32> &namehashes);
+
+// stores the index of the archive 'arcname'. 'items' must be normalized and
+// sorted. failures are silently ignored.
+void TVPSaveXP3IndexCache(const ttstr &arcname,
+                          const std::vector<tTVPXP3Archive::tArchiveItem> &items,
+                          const std::vector<tjs_uint32> &namehashes);
+//---------------------------------------------------------------------------
+
+#endif
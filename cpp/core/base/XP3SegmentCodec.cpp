@@ -0,0 +1,156 @@
+//---------------------------------------------------------------------------
+// XP3 segment codecs
+//---------------------------------------------------------------------------
+#include "tjsCommHead.h"
+
+#include "XP3SegmentCodec.h"
+#include "XP3Archive.h"
+
+#include <libdeflate.h>
+#include <zstd.h>
+#include <lz4.h>
+#include <lz4hc.h>
+#include <climits>
+#include <memory>
+
+//---------------------------------------------------------------------------
+// zlib ( libdeflate )
+//---------------------------------------------------------------------------
+struct tTVPLibDeflateDecompressorDeleter {
+    void operator()(libdeflate_decompressor *d) const {
+        libdeflate_free_decompressor(d);
+    }
+};
+
+static bool TVPZlibDecode(tjs_uint8 *out, tjs_uint outsize,
+                          const tjs_uint8 *in, tjs_uint insize) {
+    // decompressors are not thread safe but are reusable; keep one per
+    // thread
+    thread_local std::unique_ptr<libdeflate_decompressor,
+                                 tTVPLibDeflateDecompressorDeleter>
+        decompressor;
+    if(!decompressor) {
+        decompressor.reset(libdeflate_alloc_decompressor());
+        if(!decompressor)
+            return false;
+    }
+
+    size_t actual = 0;
+    libdeflate_result result = libdeflate_zlib_decompress(
+        decompressor.get(), in, insize, out, outsize, &actual);
+    return result == LIBDEFLATE_SUCCESS && actual == outsize;
+}
+
+static tjs_uint TVPZlibEncodeBound(tjs_uint insize) {
+    // passing nullptr gives a bound valid for any compression level
+    return (tjs_uint)libdeflate_zlib_compress_bound(nullptr, insize);
+}
+
+static tjs_uint TVPZlibEncode(tjs_uint8 *out, tjs_uint outsize,
+                              const tjs_uint8 *in, tjs_uint insize,
+                              tjs_int level) {
+    libdeflate_compressor *c =
+        libdeflate_alloc_compressor(level < 0 ? 9 : level);
+    if(!c)
+        return 0;
+    size_t size = libdeflate_zlib_compress(c, in, insize, out, outsize);
+    libdeflate_free_compressor(c);
+    return (tjs_uint)size;
+}
+
+static const tTVPXP3SegmentCodec TVPZlibSegmentCodec = {
+    "zlib", TVPZlibDecode, TVPZlibEncodeBound, TVPZlibEncode
+};
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+// zstd
+//---------------------------------------------------------------------------
+static bool TVPZstdDecode(tjs_uint8 *out, tjs_uint outsize,
+                          const tjs_uint8 *in, tjs_uint insize) {
+    size_t size = ZSTD_decompress(out, outsize, in, insize);
+    return !ZSTD_isError(size) && size == outsize;
+}
+
+static tjs_uint TVPZstdEncodeBound(tjs_uint insize) {
+    return (tjs_uint)ZSTD_compressBound(insize);
+}
+
+static tjs_uint TVPZstdEncode(tjs_uint8 *out, tjs_uint outsize,
+                              const tjs_uint8 *in, tjs_uint insize,
+                              tjs_int level) {
+    size_t size = ZSTD_compress(out, outsize, in, insize,
+                                level < 0 ? ZSTD_CLEVEL_DEFAULT : level);
+    return ZSTD_isError(size) ? 0 : (tjs_uint)size;
+}
+
+static const tTVPXP3SegmentCodec TVPZstdSegmentCodec = {
+    "zstd", TVPZstdDecode, TVPZstdEncodeBound, TVPZstdEncode
+};
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+// lz4
+//---------------------------------------------------------------------------
+static bool TVPLz4Decode(tjs_uint8 *out, tjs_uint outsize,
+                         const tjs_uint8 *in, tjs_uint insize) {
+    if(outsize > (tjs_uint)LZ4_MAX_INPUT_SIZE ||
+       insize > (tjs_uint)LZ4_MAX_INPUT_SIZE)
+        return false;
+    int size = LZ4_decompress_safe((const char *)in, (char *)out, (int)insize,
+                                   (int)outsize);
+    return size >= 0 && (tjs_uint)size == outsize;
+}
+
+static tjs_uint TVPLz4EncodeBound(tjs_uint insize) {
+    if(insize > (tjs_uint)LZ4_MAX_INPUT_SIZE)
+        return 0;
+    return (tjs_uint)LZ4_compressBound((int)insize);
+}
+
+static tjs_uint TVPLz4Encode(tjs_uint8 *out, tjs_uint outsize,
+                             const tjs_uint8 *in, tjs_uint insize,
+                             tjs_int level) {
+    if(insize > (tjs_uint)LZ4_MAX_INPUT_SIZE)
+        return 0;
+    int cap = outsize > (tjs_uint)INT_MAX ? INT_MAX : (int)outsize;
+    // HC trades encode time for the same decode speed; repacking is
+    // offline, so use it by default
+    int size =
+        LZ4_compress_HC((const char *)in, (char *)out, (int)insize, cap,
+                        level < 0 ? LZ4HC_CLEVEL_DEFAULT : level);
+    return size > 0 ? (tjs_uint)size : 0;
+}
+
+static const tTVPXP3SegmentCodec TVPLz4SegmentCodec = {
+    "lz4", TVPLz4Decode, TVPLz4EncodeBound, TVPLz4Encode
+};
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+// codec table
+//---------------------------------------------------------------------------
+static const tTVPXP3SegmentCodec
+    *TVPXP3SegmentCodecs[TVP_XP3_SEGM_ENCODE_METHOD_MASK + 1] = {
+        nullptr, // TVP_XP3_SEGM_ENCODE_RAW
+        &TVPZlibSegmentCodec, // TVP_XP3_SEGM_ENCODE_ZLIB
+        &TVPZstdSegmentCodec, // TVP_XP3_SEGM_ENCODE_ZSTD
+        &TVPLz4SegmentCodec, // TVP_XP3_SEGM_ENCODE_LZ4
+    };
+
+//---------------------------------------------------------------------------
+void TVPRegisterXP3SegmentCodec(tjs_uint32 method,
+                                const tTVPXP3SegmentCodec *codec) {
+    if(method == TVP_XP3_SEGM_ENCODE_RAW ||
+       method > TVP_XP3_SEGM_ENCODE_METHOD_MASK)
+        return;
+    TVPXP3SegmentCodecs[method] = codec;
+}
+
+//---------------------------------------------------------------------------
+const tTVPXP3SegmentCodec *TVPGetXP3SegmentCodec(tjs_uint32 method) {
+    if(method > TVP_XP3_SEGM_ENCODE_METHOD_MASK)
+        return nullptr;
+    return TVPXP3SegmentCodecs[method];
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,51 @@
+//---------------------------------------------------------------------------
+// XP3 segment codecs
+//---------------------------------------------------------------------------
+/*
+        XP3 segments carry their encoding in the low bits of the segment
+        flags (TVP_XP3_SEGM_ENCODE_*). each non-raw method is served by a
+        codec registered here; tTVPXP3Archive accepts only segments whose
+        method has a codec.
+
+        built-in codecs:
+                TVP_XP3_SEGM_ENCODE_ZLIB : zlib stream, decoded by libdeflate
+                TVP_XP3_SEGM_ENCODE_ZSTD : zstd frame
+                TVP_XP3_SEGM_ENCODE_LZ4  : raw lz4 block
+*/
+//---------------------------------------------------------------------------
+#ifndef XP3SegmentCodecH
+#define XP3SegmentCodecH
+
+#include "tjsTypes.h"
+
+//---------------------------------------------------------------------------
+struct tTVPXP3SegmentCodec {
+    const char *Name;
+
+    // decode 'insize' bytes at 'in' into exactly 'outsize' bytes at 'out'.
+    // returns false on corrupted input. must not throw; called from worker
+    // threads.
+    bool (*Decode)(tjs_uint8 *out, tjs_uint outsize, const tjs_uint8 *in,
+                   tjs_uint insize);
+
+    // upper bound of the encoded size of 'insize' bytes.
+    tjs_uint (*EncodeBound)(tjs_uint insize);
+
+    // encode 'insize' bytes at 'in' into 'out' which has 'outsize' bytes.
+    // 'level' < 0 selects the codec's default. returns the encoded size,
+    // or zero on failure. may be nullptr for decode-only codecs.
+    tjs_uint (*Encode)(tjs_uint8 *out, tjs_uint outsize, const tjs_uint8 *in,
+                       tjs_uint insize, tjs_int level);
+};
+//---------------------------------------------------------------------------
+
+// registers (or replaces, or removes with nullptr) the codec for 'method'.
+// must be called before any archive using the method is opened.
+void TVPRegisterXP3SegmentCodec(tjs_uint32 method,
+                                const tTVPXP3SegmentCodec *codec);
+
+// returns the codec for 'method', or nullptr if the method is unknown.
+const tTVPXP3SegmentCodec *TVPGetXP3SegmentCodec(tjs_uint32 method);
+//---------------------------------------------------------------------------
+
+#endif
@@ -1,7 +1,9 @@
 #include "tjsCommHead.h"
 #include "StorageIntf.h"
 #include "UtilStreams.h"
+#include "MsgIntf.h"
 #include <algorithm>
+#include <vector>
 
 #ifndef NOUNCRYPT
 #define NOUNCRYPT
@@ -2036,6 +2038,240 @@ int ZEXPORT unzSetOffset(unzFile file, uLong pos) {
     return unzSetOffset64(file, pos);
 }
 
+//---------------------------------------------------------------------------
+// tTVPZipInflateStream : seekable streaming reader of one deflated member
+//---------------------------------------------------------------------------
+/*
+        inflates the member on demand instead of holding the whole member in
+        memory. while decoding forward, the inflate state is recorded at a
+        deflate block boundary every 'Span' output bytes (the position in the
+        packed data, the pending bits and the last 32KB window; see zlib's
+        examples/zran.c). a seek restarts from the nearest checkpoint, so it
+        never has to decode more than one span.
+*/
+#define TVP_ZIP_STREAM_THRESHOLD (4 * 1024 * 1024)
+
+class tTVPZipInflateStream : public tTJSBinaryStream {
+    static const tjs_uint WindowSize = 32768;
+    static const tjs_uint InBufferSize = 64 * 1024;
+
+    struct tCheckpoint {
+        tjs_uint64 Out; // position in the unpacked member
+        tjs_uint64 In; // position in the packed data
+        int Bits; // bits of In-1 not consumed yet
+        std::vector<Byte> Window; // last 32KB of the output before Out
+    };
+
+    tTVPArchive *Owner;
+    tjs_uint64 PackStart, PackSize;
+    tjs_uint64 FileSize;
+    tjs_uint64 Span; // output distance between checkpoints
+    tjs_uint64 CurPos = 0;
+
+    // decoder state; created on first read
+    TArchiveStream *Pack = nullptr;
+    z_stream Z;
+    bool ZInited = false;
+    bool StreamEnd = false;
+    tjs_uint64 Fed = 0; // packed bytes given to inflate
+    tjs_uint64 DecodedPos = 0; // next output position
+    std::vector<Byte> InBuffer;
+    std::vector<Byte> Window; // ring buffer receiving the output
+    tjs_uint WindowPos = 0;
+
+    std::vector<tCheckpoint> Checkpoints; // sorted by Out
+
+    void ResetDecoder() {
+        if(ZInited)
+            inflateReset(&Z);
+        else {
+            memset(&Z, 0, sizeof(Z));
+            if(inflateInit2(&Z, -MAX_WBITS) != Z_OK)
+                TVPThrowExceptionMessage(TVPUncompressionFailed);
+            ZInited = true;
+        }
+        if(!Pack)
+            Pack = new TArchiveStream(Owner, PackStart, PackSize);
+        Z.next_in = nullptr;
+        Z.avail_in = 0;
+        StreamEnd = false;
+    }
+
+    void Restart() {
+        ResetDecoder();
+        Pack->SetPosition(0);
+        Fed = 0;
+        DecodedPos = 0;
+        WindowPos = 0;
+    }
+
+    void Restore(const tCheckpoint &cp) {
+        ResetDecoder();
+        Pack->SetPosition(cp.In - (cp.Bits ? 1 : 0));
+        if(cp.Bits) {
+            Byte c;
+            if(Pack->Read(&c, 1) != 1)
+                TVPThrowExceptionMessage(TVPUncompressionFailed);
+            inflatePrime(&Z, cp.Bits, c >> (8 - cp.Bits));
+        }
+        if(inflateSetDictionary(&Z, cp.Window.data(), WindowSize) != Z_OK)
+            TVPThrowExceptionMessage(TVPUncompressionFailed);
+        Fed = cp.In;
+        DecodedPos = cp.Out;
+        // the checkpoint window is oldest-first, matching the ring from 0
+        memcpy(Window.data(), cp.Window.data(), WindowSize);
+        WindowPos = 0;
+    }
+
+    void AddCheckpoint(tjs_uint ringpos) {
+        tCheckpoint cp;
+        cp.Out = DecodedPos;
+        cp.In = Fed - Z.avail_in;
+        cp.Bits = Z.data_type & 7;
+        cp.Window.resize(WindowSize);
+        // unroll the ring; bytes before the member start are never
+        // referenced by a valid stream
+        memcpy(cp.Window.data(), Window.data() + ringpos, WindowSize - ringpos);
+        memcpy(cp.Window.data() + WindowSize - ringpos, Window.data(), ringpos);
+        Checkpoints.push_back(std::move(cp));
+    }
+
+    // inflates up to 'size' bytes (at most up to the end of the ring) into
+    // the ring; 'out' receives the start of the produced bytes.
+    tjs_uint Inflate(tjs_uint size, const Byte *&out) {
+        if(StreamEnd)
+            return 0;
+        if(WindowPos == WindowSize)
+            WindowPos = 0;
+        size = std::min(size, WindowSize - WindowPos);
+        out = Window.data() + WindowPos;
+        Z.next_out = Window.data() + WindowPos;
+        Z.avail_out = size;
+        while(Z.avail_out) {
+            if(!Z.avail_in) {
+                tjs_uint one = (tjs_uint)std::min<tjs_uint64>(
+                    InBufferSize, PackSize - Fed);
+                if(one)
+                    one = Pack->Read(InBuffer.data(), one);
+                if(!one)
+                    TVPThrowExceptionMessage(TVPUncompressionFailed);
+                Fed += one;
+                Z.next_in = InBuffer.data();
+                Z.avail_in = one;
+            }
+            uInt before = Z.avail_out;
+            int ret = inflate(&Z, Z_BLOCK);
+            DecodedPos += before - Z.avail_out;
+            if(ret == Z_STREAM_END) {
+                StreamEnd = true;
+                break;
+            }
+            if(ret != Z_OK && ret != Z_BUF_ERROR)
+                TVPThrowExceptionMessage(TVPUncompressionFailed);
+            // at a block boundary that is not the end of the last block?
+            if((Z.data_type & 128) && !(Z.data_type & 64)) {
+                tjs_uint64 last =
+                    Checkpoints.empty() ? 0 : Checkpoints.back().Out;
+                if(DecodedPos >= last + Span)
+                    AddCheckpoint((tjs_uint)(Z.next_out - Window.data()));
+            }
+        }
+        WindowPos = (tjs_uint)(Z.next_out - Window.data());
+        return size - Z.avail_out;
+    }
+
+    // brings the decoder to the output position 'target'
+    void SeekDecoder(tjs_uint64 target) {
+        // the last checkpoint at or before the target
+        auto it = std::upper_bound(
+            Checkpoints.begin(), Checkpoints.end(), target,
+            [](tjs_uint64 pos, const tCheckpoint &cp) { return pos < cp.Out; });
+        const tCheckpoint *cp = it == Checkpoints.begin() ? nullptr : &*(it - 1);
+
+        if(!ZInited || DecodedPos > target) {
+            if(cp)
+                Restore(*cp);
+            else
+                Restart();
+        } else if(cp && cp->Out > DecodedPos) {
+            Restore(*cp); // jump over the spans between
+        }
+
+        while(DecodedPos < target) {
+            const Byte *p;
+            tjs_uint one = (tjs_uint)std::min<tjs_uint64>(target - DecodedPos,
+                                                          WindowSize);
+            if(!Inflate(one, p))
+                TVPThrowExceptionMessage(TVPUncompressionFailed);
+        }
+    }
+
+public:
+    tTVPZipInflateStream(tTVPArchive *owner, tjs_uint64 packstart,
+                         tjs_uint64 packsize, tjs_uint64 filesize) :
+        Owner(owner), PackStart(packstart), PackSize(packsize),
+        FileSize(filesize), InBuffer(InBufferSize), Window(WindowSize) {
+        // 1MB spans, widened for very large members so that the
+        // checkpoints stay within about 2MB
+        Span = std::max<tjs_uint64>(1024 * 1024,
+                                    FileSize / (2 * 1024 * 1024 / WindowSize));
+        Owner->AddRef();
+    }
+
+    ~tTVPZipInflateStream() override {
+        if(ZInited)
+            inflateEnd(&Z);
+        delete Pack;
+        Owner->Release();
+    }
+
+    tjs_uint64 Seek(tjs_int64 offset, tjs_int whence) override {
+        tjs_int64 newpos = CurPos;
+        switch(whence) {
+            case TJS_BS_SEEK_SET:
+                newpos = offset;
+                break;
+            case TJS_BS_SEEK_CUR:
+                newpos = offset + CurPos;
+                break;
+            case TJS_BS_SEEK_END:
+                newpos = offset + FileSize;
+                break;
+        }
+        if(newpos >= 0 && newpos <= (tjs_int64)FileSize)
+            CurPos = newpos;
+        return CurPos;
+    }
+
+    tjs_uint Read(void *buffer, tjs_uint read_size) override {
+        if(CurPos + read_size > FileSize)
+            read_size = (tjs_uint)(FileSize - CurPos);
+        if(!read_size)
+            return 0;
+
+        SeekDecoder(CurPos);
+
+        tjs_uint done = 0;
+        while(done < read_size) {
+            const Byte *p;
+            tjs_uint one = Inflate(read_size - done, p);
+            if(!one)
+                break;
+            memcpy((Byte *)buffer + done, p, one);
+            done += one;
+        }
+        CurPos += done;
+        return done;
+    }
+
+    tjs_uint Write(const void *buffer, tjs_uint write_size) override {
+        return 0;
+    }
+
+    tjs_uint64 GetSize() override { return FileSize; }
+};
+//---------------------------------------------------------------------------
+
 class ZipArchive : public tTVPArchive {
     unzFile uf;
     typedef std::pair<ttstr, unz64_file_pos> FileEntry;
@@ -2094,7 +2330,6 @@ tTVPArchive *TVPOpenZIPArchive(const ttstr &name, tTJSBinaryStream *st,
 tTJSBinaryStream *ZipArchive::CreateStreamByIndex(tjs_uint idx) {
     if(unzGoToFilePos64(uf, &filelist[idx].second) != UNZ_OK)
         return nullptr;
-    // decompress and hold in memory for random access
     unz_file_info file_info;
     if(unzGetCurrentFileInfo(uf, &file_info, nullptr, 0, nullptr, 0) != UNZ_OK)
         return nullptr;
@@ -2110,7 +2345,22 @@ tTJSBinaryStream *ZipArchive::CreateStreamByIndex(tjs_uint idx) {
         return new TArchiveStream(
             this, file_info.offset_curfile + SIZEZIPLOCALHEADER + iSizeVar,
             file_info.uncompressed_size);
+    } else if(file_info.compression_method == Z_DEFLATED &&
+              !(file_info.flag & 1) &&
+              file_info.uncompressed_size > TVP_ZIP_STREAM_THRESHOLD) {
+        // large member; inflate on demand
+        uInt iSizeVar;
+        ZPOS64_T offset_local_extrafield;
+        uInt size_local_extrafield;
+        if(unz64local_CheckCurrentFileCoherencyHeader(
+               (unz64_s *)uf, &iSizeVar, &offset_local_extrafield,
+               &size_local_extrafield) != UNZ_OK)
+            return nullptr;
+        return new tTVPZipInflateStream(
+            this, file_info.offset_curfile + SIZEZIPLOCALHEADER + iSizeVar,
+            file_info.compressed_size, file_info.uncompressed_size);
     } else {
+        // decompress and hold in memory for random access
         if(unzOpenCurrentFile(uf) != UNZ_OK)
             return nullptr;
         tTVPMemoryStream *mem = new tTVPMemoryStream();
@@ -1610,18 +1610,15 @@ void TVPAutoMountSiblingXP3Archives() {
 void TVPBoostAutoMountPaths() {
     if(TVPAutoMountedPaths.empty()) return;
 
-    extern std::vector<ttstr> TVPAutoPathList;
-    extern bool AutoPathTableInit;
-
+    // move to the end of the list; TVPRemoveAutoPath and TVPAddAutoPath
+    // also invalidate the auto path table and cache
     for(const auto &p : TVPAutoMountedPaths) {
-        auto it = std::find(TVPAutoPathList.begin(), TVPAutoPathList.end(), p);
-        if(it != TVPAutoPathList.end())
-            TVPAutoPathList.erase(it);
-        TVPAutoPathList.push_back(p);
+        TVPRemoveAutoPath(p);
+        TVPAddAutoPath(p);
     }
+    size_t count = TVPAutoMountedPaths.size();
     TVPAutoMountedPaths.clear();
 
-    AutoPathTableInit = false;
     spdlog::info("TVPBoostAutoMountPaths: re-ordered {} patch paths to end of auto path list",
-                 TVPAutoPathList.size());
+                 count);
 }
@@ -20,8 +20,11 @@
 #include "Exception.h"
 #include "StorageIntf.h"
 #include "StorageImpl.h"
+#include "XP3Archive.h"
+#include "XP3IndexCache.h"
 #include "MsgIntf.h"
 #include "GraphicsLoaderIntf.h"
+#include "GraphicDiskCache.h"
 #include "SystemControl.h"
 #include "DebugIntf.h"
 #include "tjsLex.h"
@@ -118,6 +121,24 @@ static void TVPInitRandomGenerator() {
 }
 //---------------------------------------------------------------------------
 
+extern "C" int TVPGL_SIMD_SetTarget(const char *name);
+extern "C" const char *TVPGL_SIMD_GetTargetName();
+
+//---------------------------------------------------------------------------
+static void TVPApplySIMDTargetOption() {
+    // -simdtarget pins the SIMD target of the pixel routines. this is a
+    // debugging and benchmarking override only; by default the best target
+    // supported by the CPU is used.
+    tTJSVariant v;
+    if(TVPGetCommandLine(TJS_W("-simdtarget"), &v)) {
+        ttstr target(v);
+        if(!TVPGL_SIMD_SetTarget(target.AsStdString().c_str()))
+            TVPAddImportantLog(TJS_W("(info) SIMD target ") + target +
+                               TJS_W(" is not available; using the best "
+                                     "supported target"));
+    }
+}
+
 //---------------------------------------------------------------------------
 // TVPInitializeBaseSystems
 //---------------------------------------------------------------------------
@@ -127,6 +148,34 @@ void TVPInitializeBaseSystems() {
     if(TVPGetCommandLine(TJS_W("-arcdelim"), &v))
         TVPArchiveDelimiter = ttstr(v)[0];
 
+    // must be set before TVPInitTVPGL()
+    TVPApplySIMDTargetOption();
+
+    // check XP3 archive options before any archive is opened
+    if(TVPGetCommandLine(TJS_W("-xp3mmap"), &v)) {
+        ttstr str(v);
+        if(str == TJS_W("no") || str == TJS_W("false"))
+            TVPXP3ArchiveUseMmap = false;
+        else
+            TVPXP3ArchiveUseMmap = true;
+    }
+    if(TVPGetCommandLine(TJS_W("-xp3idxcache"), &v)) {
+        ttstr str(v);
+        if(str == TJS_W("no") || str == TJS_W("false"))
+            TVPXP3IndexCacheEnabled = false;
+        else
+            TVPXP3IndexCacheEnabled = true;
+    }
+    if(TVPGetCommandLine(TJS_W("-xp3readahead"), &v)) {
+        tjs_int depth = (tjs_int)v.AsInteger();
+        TVPXP3SegmentReadAhead = depth < 0 ? 0 : depth;
+    }
+    if(TVPGetCommandLine(TJS_W("-xp3blobcache"), &v)) {
+        // in MB; 0 disables
+        tjs_int mb = (tjs_int)v.AsInteger();
+        TVPXP3BlobCacheLimit = mb <= 0 ? 0 : (tjs_uint)mb * 1024 * 1024;
+    }
+
     // set default current directory
     {
         TVPSetCurrentDirectory(
@@ -158,6 +207,9 @@ void TVPBeforeSystemInit() {
     if(TVPGetCommandLine(TJS_W("-arcdelim"), &v))
         TVPArchiveDelimiter = ttstr(v)[0];
 
+    // must be set before TVPInitTVPGL()
+    TVPApplySIMDTargetOption();
+
     if(TVPIsExistentStorageNoSearchNoNormalize(TVPProjectDir)) {
         TVPProjectDir += TVPArchiveDelimiter;
     } else {
@@ -234,6 +286,8 @@ static uint32_t TVPTimeBeginPeriodRes = 0;
 void TVPAfterSystemInit() {
     // check CPU type
     TVPDetectCPU();
+    TVPAddImportantLog(TJS_W("(info) SIMD target : ") +
+                       ttstr(TVPGL_SIMD_GetTargetName()));
 
     TVPAllocGraphicCacheOnHeap = false; // always false since beta 20
 
@@ -277,6 +331,25 @@ void TVPAfterSystemInit() {
     if(TVPGraphicCacheSystemLimit >= 256 * 1024 * 1024)
         TVPGraphicCacheSystemLimit = 256 * 1024 * 1024;
 
+    // decoded graphic disk cache
+    if(TVPGetCommandLine(TJS_W("-gdcache"), &opt)) {
+        ttstr str(opt);
+        if(str == TJS_W("yes") || str == TJS_W("true"))
+            TVPGraphicDiskCacheEnabled = true;
+        else
+            TVPGraphicDiskCacheEnabled = false;
+    }
+    if(TVPGetCommandLine(TJS_W("-gdcachetime"), &opt)) {
+        // in ms; images decoded faster than this are not stored
+        tjs_int ms = (tjs_int)opt.AsInteger();
+        TVPGraphicDiskCacheMinDecodeTime = ms < 0 ? 0 : ms;
+    }
+    if(TVPGetCommandLine(TJS_W("-gdcachesize"), &opt)) {
+        // in MB; 0 for no limit
+        tjs_int64 mb = opt.AsInteger();
+        TVPGraphicDiskCacheLimit = mb < 0 ? 0 : (tjs_uint64)mb * 1024 * 1024;
+    }
+
     if(TVPTotalPhysMemory <= 64 * 1024 * 1024)
         TVPSetFontCacheForLowMem();
 
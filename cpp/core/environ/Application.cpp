@@ -360,9 +360,6 @@ bool tTVPApplication::StartApplication(ttstr path) {
         // Check digitizer
         CheckDigitizer();
 
-        // start image load thread
-        image_load_thread_->Resume();
-
         TVPAutoMountSiblingXP3Archives();
 
         spdlog::debug("StartApplication: TVPInitializeStartupScript...");
@@ -840,9 +837,15 @@ void tTVPApplication::ModalFinished() {
 #endif
 void tTVPApplication::LoadImageRequest(class iTJSDispatch2 *owner,
                                        class tTJSNI_Bitmap *bmp,
-                                       const ttstr &name) {
+                                       const ttstr &name, tjs_int priority) {
+    if(image_load_thread_) {
+        image_load_thread_->LoadRequest(owner, bmp, name, priority);
+    }
+}
+
+void tTVPApplication::CancelImageLoadRequest(class tTJSNI_Bitmap *bmp) {
     if(image_load_thread_) {
-        image_load_thread_->LoadRequest(owner, bmp, name);
+        image_load_thread_->CancelRequest(bmp);
     }
 }
 
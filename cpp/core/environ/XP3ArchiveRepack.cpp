@@ -13,12 +13,15 @@ extern "C" {
 #include "XP3Archive.h"
 #include <cassert>
 #include <thread>
+#include <atomic>
 #include <fcntl.h>
 #include "GraphicsLoaderIntf.h"
 #include <unordered_map>
 #include "LayerIntf.h"
 #include "MsgIntf.h"
 #include "DetectCPU.h"
+#include "ThreadPool.h"
+#include <deque>
 #include <set>
 
 #ifdef _WIN32
@@ -170,6 +173,48 @@ public:
     }
 };
 
+// progress sink for coders running on the worker pool; only polls the stop
+// request, progress is reported by the writer
+class StopCheckFor7z : public ICompressProgressInfo {
+    const std::atomic<bool> &StopRequired;
+
+public:
+    StopCheckFor7z(const std::atomic<bool> &stop) : StopRequired(stop) {}
+
+    HRESULT STDMETHODCALLTYPE
+    SetRatioInfo(const UInt64 *inSize, const UInt64 *outSize) noexcept override {
+        return StopRequired ? S_INTERRUPT : S_OK;
+    }
+    HRESULT STDMETHODCALLTYPE
+    QueryInterface(REFIID riid, void **ppvObject) noexcept override {
+        return E_NOTIMPL;
+    }
+    ULONG STDMETHODCALLTYPE AddRef() noexcept override { return 0; }
+    ULONG STDMETHODCALLTYPE Release() noexcept override { return 0; }
+};
+
+// one unit of the repack pipeline: a plain file or an image with its mask.
+// entries are read in order, converted and compressed on the worker pool,
+// and written to the archive in the order they were queued.
+struct XP3RepackEntry {
+    struct Output {
+        ttstr Name;
+        tjs_uint Index = 0; // item to stream from the archive if !Data
+        std::unique_ptr<tTJSBinaryStream> Data;
+        std::unique_ptr<OutStreamMemory> Packed; // LZMA compressed Data
+    };
+
+    tjs_uint Index = 0; // item index reported to OnNewFile
+    uint64_t Size = 0; // source bytes, for progress
+    bool MergeMask = false; // Outputs hold the image and its mask
+    std::vector<Output> Outputs;
+    HRESULT Result = S_OK;
+    // set by whichever thread converts the entry: a worker, or the repack
+    // thread when the pool dropped or has not started the task
+    std::atomic<bool> Claimed{ false };
+    bool Done = false; // guarded by XP3ArchiveRepackAsyncImpl::PipeMutex
+};
+
 class XP3ArchiveRepackAsyncImpl : ICompressProgressInfo {
 public:
     XP3ArchiveRepackAsyncImpl();
@@ -201,7 +246,10 @@ public:
     bool OptionMergeMaskImg = true;
 
 private:
-    HRESULT AddTo7zArchive(tTJSBinaryStream *s, const ttstr &_naem);
+    HRESULT AddTo7zArchive(tTJSBinaryStream *s, OutStreamMemory *packed,
+                           const ttstr &_name);
+    void ConvertEntry(XP3RepackEntry *entry);
+    void MergeImageWithMask(XP3RepackEntry *entry);
 
     // ICompressProgressInfo
     HRESULT STDMETHODCALLTYPE
@@ -216,15 +264,19 @@ private:
 
     std::vector<std::pair<tTVPXP3ArchiveEx *, std::string>> ConvFileList;
     std::thread *Thread = nullptr;
-    CCreatedCoder CoderCompress, CoderCopy;
+    CCreatedCoder CoderCopy;
     static constexpr int nCodecMethod = 0x30101, // LZMA
         nCodecMethodCopy = 0;
     CArchiveDatabaseOut newDatabase;
     OutStreamFor7z *strout;
     CByteBuffer props;
-    bool bStopRequired = false;
+    std::atomic<bool> bStopRequired{ false };
     uint64_t nTotalSize = 0, nArcSize = 0;
 
+    // completion of entries converted on the worker pool
+    std::mutex PipeMutex;
+    std::condition_variable PipeCond;
+
     std::function<void(int, uint64_t, const std::string &)> OnNewFile;
     std::function<void(int, uint64_t, const std::string &)> OnNewArchive;
     std::function<void(uint64_t, uint64_t, uint64_t)> OnProgress;
@@ -265,18 +317,17 @@ void XP3ArchiveRepackAsync::SetOption(const std::string &name, bool v) {
     _impl->SetOption(name, v);
 }
 
-XP3ArchiveRepackAsyncImpl::XP3ArchiveRepackAsyncImpl() {
-    if(!g_CrcTable[1])
-        CrcGenerateTable();
-    CreateCoder_Id(nCodecMethod, true, CoderCompress);
-    CreateCoder_Id(nCodecMethodCopy, true, CoderCopy);
+// creates the LZMA encoder used for compressable items; props receives
+// the coder properties stored in the archive header if given
+static void CreateCompressCoder(CCreatedCoder &coder, CByteBuffer *props) {
+    CreateCoder_Id(0x30101, true, coder); // LZMA
 
     CMyComPtr<ICompressWriteCoderProperties> writeCoderProperties;
     CMyComPtr<ICompressSetCoderProperties> setCoderProperties;
-    CoderCompress.Coder->QueryInterface(
+    coder.Coder->QueryInterface(
         IID_ICompressWriteCoderProperties,
         reinterpret_cast<void **>(&writeCoderProperties));
-    CoderCompress.Coder->QueryInterface(
+    coder.Coder->QueryInterface(
         IID_ICompressSetCoderProperties,
         reinterpret_cast<void **>(&setCoderProperties));
 
@@ -290,15 +341,24 @@ XP3ArchiveRepackAsyncImpl::XP3ArchiveRepackAsyncImpl() {
         propvars[0].ulVal = 4 * 1024 * 1024;
         setCoderProperties->SetCoderProperties(props, propvars, nProp);
     }
-    if(writeCoderProperties) {
+    if(props && writeCoderProperties) {
         CDynBufSeqOutStream *outStreamSpec = new CDynBufSeqOutStream;
         CMyComPtr<ISequentialOutStream> dynOutStream(outStreamSpec);
         outStreamSpec->Init();
         writeCoderProperties->WriteCoderProperties(dynOutStream);
-        outStreamSpec->CopyToBuffer(props);
+        outStreamSpec->CopyToBuffer(*props);
     }
 }
 
+XP3ArchiveRepackAsyncImpl::XP3ArchiveRepackAsyncImpl() {
+    if(!g_CrcTable[1])
+        CrcGenerateTable();
+    CreateCoder_Id(nCodecMethodCopy, true, CoderCopy);
+
+    CCreatedCoder coder;
+    CreateCompressCoder(coder, &props);
+}
+
 XP3ArchiveRepackAsyncImpl::~XP3ArchiveRepackAsyncImpl() {
     std::thread *t = Thread;
     if(t && t->joinable()) {
@@ -385,80 +445,112 @@ static bool CheckIsImage(tTJSBinaryStream *s) {
     return false;
 }
 
+// quick check whether LZMA compression of the item is worth a try
+static bool CheckIsCompressable(tTJSBinaryStream *s) {
+    tjs_uint64 origSize = s->GetSize();
+    if(origSize <= 64 || origSize >= COMPRESS_THRESHOLD)
+        return false;
+    bool compressable = true;
+    tjs_uint8 header[16];
+    s->Read(header, 16);
+    if(!memcmp(header, static_cast<const void *>("\x89PNG"), 4)) {
+        compressable = false;
+    } else if(!memcmp(header, "OggS\x00", 5)) {
+        compressable = false;
+    } else if(!memcmp(header, "\xFF\xD8\xFF", 3)) { // JPEG
+        compressable = false;
+    } else if(!memcmp(header, "TLG", 3)) {
+        compressable = false;
+    } else if(!memcmp(header, "0&\xB2\x75\x8E\x66\xCF\x11", 8)) { // wmv/wma
+        compressable = false;
+    } else if(!memcmp(header, "AJPM", 4)) { // AMV
+        compressable = false;
+    } else if(!memcmp(header, "\x49\x49\xbc\x01", 4)) { // JXR
+        compressable = false;
+    } else if(!memcmp(header, "BPG", 3)) {
+        compressable = false;
+    } else if(!memcmp(header, "RIFF", 4)) {
+        if(!memcmp(header + 8, "WEBPVP8", 7)) {
+            compressable = false;
+        }
+    }
+    s->SetPosition(0);
+    return compressable;
+}
+
+// compresses a whole stream into memory on the calling thread. packed is
+// left empty when compression does not save at least a fifth of the size.
+static HRESULT CompressToMemory(tTJSBinaryStream *s,
+                                std::unique_ptr<OutStreamMemory> &packed,
+                                ICompressProgressInfo *progress) {
+    CCreatedCoder coder;
+    CreateCompressCoder(coder, nullptr);
+    SequentialInStreamFor7z str(s);
+    UInt64 origSize = s->GetSize();
+    UInt64 inSizeForReduce = origSize;
+    UInt64 newSize = origSize;
+    std::unique_ptr<OutStreamMemory> tmp(new OutStreamMemory);
+    HRESULT ret = coder.Coder->Code(&str, tmp.get(), &inSizeForReduce,
+                                    &newSize, progress);
+    s->SetPosition(0);
+    if(ret != S_OK)
+        return ret;
+    UInt64 expectedSize = origSize * 4 / 5;
+    if(tmp->GetSize() < expectedSize)
+        packed = std::move(tmp);
+    return S_OK;
+}
+
+// reads an archive item into memory, so that the workers never touch the
+// archive (and the xp3 filter script) themselves
+static tTJSBinaryStream *ReadItemToMemory(tTVPXP3Archive *arc, tjs_uint idx) {
+    std::unique_ptr<tTJSBinaryStream> src(arc->CreateStreamByIndex(idx));
+    tjs_uint size = (tjs_uint)src->GetSize();
+    std::unique_ptr<tTVPMemoryStream> mem(new tTVPMemoryStream());
+    mem->SetSize(size);
+    src->ReadBuffer(mem->GetInternalBuffer(), size);
+    return mem.release();
+}
+
 HRESULT
 XP3ArchiveRepackAsyncImpl::AddTo7zArchive(tTJSBinaryStream *s,
+                                          OutStreamMemory *packed,
                                           const ttstr &_name) {
     CFileItem file;
     CFileItem2 file2;
-    SequentialInStreamFor7z str(s);
     tjs_uint64 origSize = s->GetSize();
     file.Size = origSize;
     UString name{ _name.toWString().c_str() };
-    UInt64 inSizeForReduce = origSize;
-    UInt64 newSize = origSize;
-    bool compressable = origSize > 64 && origSize < 4 * 1024 * 1024;
-    if(compressable) {
-        // compressable quick check
-        tjs_uint8 header[16];
-        s->Read(header, 16);
-        if(!memcmp(header, static_cast<const void *>("\x89PNG"), 4)) {
-            compressable = false;
-        } else if(!memcmp(header, "OggS\x00", 5)) {
-            compressable = false;
-        } else if(!memcmp(header, "\xFF\xD8\xFF", 3)) { // JPEG
-            compressable = false;
-        } else if(!memcmp(header, "TLG", 3)) {
-            compressable = false;
-        } else if(!memcmp(header, "0&\xB2\x75\x8E\x66\xCF\x11",
-                          8)) { // wmv/wma
-            compressable = false;
-        } else if(!memcmp(header, "AJPM", 4)) { // AMV
-            compressable = false;
-        } else if(!memcmp(header, "\x49\x49\xbc\x01", 4)) { // JXR
-            compressable = false;
-        } else if(!memcmp(header, "BPG", 3)) {
-            compressable = false;
-        } else if(!memcmp(header, "RIFF", 4)) {
-            if(!memcmp(header + 8, "WEBPVP8", 7)) {
-                compressable = false;
-            }
-        }
-        s->SetPosition(0);
-    }
     HRESULT ret;
-    if(compressable) {
-        UInt64 expectedSize = origSize * 4 / 5;
-        OutStreamMemory tmp;
-        if((ret = CoderCompress.Coder->Code(&str, &tmp, &inSizeForReduce,
-                                            &newSize, this)) != S_OK)
+    if(packed) {
+        // compressed by a worker
+        UInt32 writed;
+        UInt32 packedSize = (UInt32)packed->GetSize();
+        if((ret = strout->Write(packed->GetInternalBuffer(), packedSize,
+                                &writed)) != S_OK) {
             return ret;
-        if(tmp.GetSize() < expectedSize) {
-            UInt32 writed;
-            if((ret = strout->Write(tmp.GetInternalBuffer(), tmp.GetSize(),
-                                    &writed)) != S_OK) {
-                return ret;
-            }
-            if(writed != tmp.GetSize())
-                return E_FAIL;
-            newDatabase.PackSizes.Add(tmp.GetSize());
-            newDatabase.CoderUnpackSizes.Add(origSize);
-            newDatabase.NumUnpackStreamsVector.Add(1);
-            CFolder &folder = newDatabase.Folders.AddNew();
-            folder.Bonds.SetSize(0);
-            folder.Coders.SetSize(1);
-            CCoderInfo &cod = folder.Coders[0];
-            cod.MethodID = nCodecMethod;
-            cod.NumStreams = 1;
-            cod.Props = props;
-            folder.PackStreams.SetSize(1);
-            folder.PackStreams[0] = 0; // only 1 stream
-            newDatabase.AddFile(file, file2, name);
-            return S_OK;
         }
-        s->SetPosition(0);
+        if(writed != packedSize)
+            return E_FAIL;
+        newDatabase.PackSizes.Add(packedSize);
+        newDatabase.CoderUnpackSizes.Add(origSize);
+        newDatabase.NumUnpackStreamsVector.Add(1);
+        CFolder &folder = newDatabase.Folders.AddNew();
+        folder.Bonds.SetSize(0);
+        folder.Coders.SetSize(1);
+        CCoderInfo &cod = folder.Coders[0];
+        cod.MethodID = nCodecMethod;
+        cod.NumStreams = 1;
+        cod.Props = props;
+        folder.PackStreams.SetSize(1);
+        folder.PackStreams[0] = 0; // only 1 stream
+        newDatabase.AddFile(file, file2, name);
+        return S_OK;
     }
     // direct copy
-    newSize = origSize;
+    SequentialInStreamFor7z str(s);
+    UInt64 inSizeForReduce = origSize;
+    UInt64 newSize = origSize;
     if((ret = CoderCopy.Coder->Code(&str, strout, &inSizeForReduce, &newSize,
                                     this)) != S_OK) {
         return ret;
@@ -487,8 +579,163 @@ XP3ArchiveRepackAsyncImpl::SetRatioInfo(const UInt64 *inSize,
     return bStopRequired ? S_INTERRUPT : S_OK;
 }
 
+void XP3ArchiveRepackAsyncImpl::MergeImageWithMask(XP3RepackEntry *entry) {
+    // actual TVPLoadGraphicRouter
+    static tTVPGraphicHandlerType *handler =
+        TVPGetGraphicLoadHandler(TJS_W(".png"));
+    tTJSBinaryStream *strImg = entry->Outputs[0].Data.get();
+    tTJSBinaryStream *strMask = entry->Outputs[1].Data.get();
+    try {
+        bool isImage = CheckIsImage(strImg) && CheckIsImage(strMask);
+        if(isImage) {
+            // skip 8-bit image
+            iTJSDispatch2 *dic = nullptr;
+            handler->Header(strImg, &dic);
+            strImg->SetPosition(0);
+            if(dic) {
+                tTJSVariant val;
+                dic->PropGet(0, TJS_W("bpp"), nullptr, &val, dic);
+                dic->Release();
+                int bpp = val.AsInteger();
+                isImage = bpp == 24 || bpp == 32;
+            } else {
+                isImage = false; // unknown error, skip
+            }
+        }
+        if(!isImage)
+            return; // store both files as they are
+
+        struct BmpInfoWithMask {
+            tTVPBitmap *bmp = nullptr;
+            tTVPBitmap *bmpForMask = nullptr;
+            std::unordered_map<ttstr, ttstr, ttstr_hasher> metainfo;
+            ~BmpInfoWithMask() {
+                if(bmp)
+                    delete bmp;
+                if(bmpForMask)
+                    delete bmpForMask;
+            }
+        } data;
+
+        // main part
+        handler->Load(
+            handler->FormatData, &data,
+            [](void *callbackdata, tjs_uint w, tjs_uint h,
+               tTVPGraphicPixelFormat fmt) -> int {
+                BmpInfoWithMask *data = (BmpInfoWithMask *)callbackdata;
+                if(!data->bmp) {
+                    data->bmp = new tTVPBitmap(w, h, 32);
+                }
+                return data->bmp->GetPitch();
+            },
+            [](void *callbackdata, tjs_int y) -> void * {
+                BmpInfoWithMask *data =
+                    static_cast<BmpInfoWithMask *>(callbackdata);
+                if(y >= 0) {
+                    return data->bmp->GetScanLine(y);
+                }
+                return nullptr;
+            },
+            [](void *callbackdata, const ttstr &name, const ttstr &value) {
+                BmpInfoWithMask *data = (BmpInfoWithMask *)callbackdata;
+                data->metainfo.emplace(name, value);
+            },
+            strImg, TVP_clNone, glmNormal);
+
+        // mask part
+        handler->Load(
+            handler->FormatData, &data,
+            [](void *callbackdata, tjs_uint w, tjs_uint h,
+               tTVPGraphicPixelFormat fmt) -> int {
+                BmpInfoWithMask *data = (BmpInfoWithMask *)callbackdata;
+                if(data->bmp->GetWidth() != w || data->bmp->GetHeight() != h)
+                    TVPThrowExceptionMessage(TVPMaskSizeMismatch);
+                if(!data->bmpForMask) {
+                    data->bmpForMask = new tTVPBitmap(w, h, 8);
+                }
+                return data->bmpForMask->GetPitch();
+            },
+            [](void *callbackdata, tjs_int y) -> void * {
+                BmpInfoWithMask *data = (BmpInfoWithMask *)callbackdata;
+                if(y >= 0) {
+                    return data->bmpForMask->GetScanLine(y);
+                }
+                return nullptr;
+            },
+            [](void *callbackdata, const ttstr &name, const ttstr &value) {
+                // no metainfo for mask
+            },
+            strMask, TVP_clNone, glmGrayscale);
+
+        for(tjs_uint y = 0; y < data.bmp->GetHeight(); ++y) {
+            TVPBindMaskToMain((tjs_uint32 *)data.bmp->GetScanLine(y),
+                              (tjs_uint8 *)data.bmpForMask->GetScanLine(y),
+                              data.bmp->GetWidth());
+        }
+        delete data.bmpForMask;
+        data.bmpForMask = nullptr;
+        std::unique_ptr<iTJSDispatch2> meta{ TJSCreateDictionaryObject() };
+        for(const auto &[k, v] : data.metainfo) {
+            tTJSVariant var{ v };
+            meta->PropSet(TJS_MEMBERENSURE, k.c_str(), nullptr, &var,
+                          meta.get());
+        }
+        std::unique_ptr<tTVPMemoryStream> memstr(new tTVPMemoryStream());
+        std::unique_ptr<tTVPBaseBitmap> bmp(
+            new tTVPBaseBitmap(data.bmp->GetWidth(), data.bmp->GetHeight()));
+        bmp->AssignBitmap(data.bmp);
+
+        if(OptionUsingETC2) {
+            TVPSavePVRv3(nullptr, memstr.get(), bmp.get(), TJS_W("ETC2_RGBA"),
+                         meta.get());
+        } else {
+            // convert to tlg5 for better performance
+            TVPSaveAsTLG(nullptr, memstr.get(), bmp.get(), TJS_W("tlg5"),
+                         meta.get());
+        }
+        memstr->SetPosition(0);
+
+        // the merged image replaces both the image and the mask
+        XP3RepackEntry::Output merged;
+        merged.Name = entry->Outputs[0].Name;
+        merged.Index = entry->Outputs[0].Index;
+        merged.Data = std::move(memstr);
+        entry->Outputs.clear();
+        entry->Outputs.emplace_back(std::move(merged));
+    } catch(...) {
+        // broken image or mask; store both files as they are
+        strImg->SetPosition(0);
+        strMask->SetPosition(0);
+    }
+}
+
+void XP3ArchiveRepackAsyncImpl::ConvertEntry(XP3RepackEntry *entry) {
+    // runs on the worker pool, or on the repack thread; see Claimed
+    if(entry->MergeMask && !bStopRequired)
+        MergeImageWithMask(entry);
+    StopCheckFor7z progress(bStopRequired);
+    for(XP3RepackEntry::Output &out : entry->Outputs) {
+        if(!out.Data || !CheckIsCompressable(out.Data.get()))
+            continue;
+        HRESULT ret = CompressToMemory(out.Data.get(), out.Packed, &progress);
+        if(ret != S_OK) {
+            entry->Result = ret;
+            break;
+        }
+    }
+    // notify under the lock; DoConv (and this object) may end as soon as
+    // the last entry is done
+    std::lock_guard<std::mutex> lock(PipeMutex);
+    entry->Done = true;
+    PipeCond.notify_all();
+}
+
 void XP3ArchiveRepackAsyncImpl::DoConv() {
     nTotalSize = 0;
+    tTVPThreadPool &pool = TVPGetWorkerThreadPool();
+    // entries held by the pipeline at once; bounds the memory used for
+    // items waiting to be converted or written
+    const size_t maxPending = std::max<tjs_int>(pool.GetThreadCount(), 1) * 2;
     for(unsigned int arcidx = 0; arcidx < ConvFileList.size(); ++arcidx) {
         auto &it = ConvFileList[arcidx];
         if(bStopRequired)
@@ -577,225 +824,104 @@ void XP3ArchiveRepackAsyncImpl::DoConv() {
             }
         }
 
-        // merge image with mask
-        // actual TVPLoadGraphicRouter
-        static tTVPGraphicHandlerType *handler =
-            TVPGetGraphicLoadHandler(TJS_W(".png"));
-        for(const auto &it : imglist) {
+        // <idx, mask_idx> in output order; images with masks first
+        std::vector<std::pair<tjs_uint, tjs_int>> joblist;
+        for(const auto &it : imglist)
+            joblist.emplace_back(it.first, it.second);
+        for(tjs_uint idx : filelist)
+            joblist.emplace_back(idx, -1);
+
+        // pipeline: this thread reads the items in order and queues them,
+        // the worker pool merges masks, converts images and compresses,
+        // and this thread writes the finished entries in queue order.
+        std::deque<std::shared_ptr<XP3RepackEntry>> pending;
+        auto writeFront = [&]() {
+            std::shared_ptr<XP3RepackEntry> entry = pending.front();
+            pending.pop_front();
+            // the pool drops queued tasks when it stops; convert the entry
+            // here if no worker has taken it yet
+            if(!entry->Claimed.exchange(true))
+                ConvertEntry(entry.get());
+            {
+                std::unique_lock<std::mutex> lock(PipeMutex);
+                PipeCond.wait(lock, [&] { return entry->Done; });
+            }
             if(bStopRequired)
-                break;
-            const tTVPXP3Archive::tArchiveItem &imgItem =
-                xp3arc->ItemVector[it.first];
-            const tTVPXP3Archive::tArchiveItem &maskItem =
-                xp3arc->ItemVector[it.second];
-            std::unique_ptr<tTJSBinaryStream> strImg(
-                xp3arc->CreateStreamByIndex(&imgItem -
-                                            &xp3arc->ItemVector.front()));
-            std::unique_ptr<tTJSBinaryStream> strMask(
-                xp3arc->CreateStreamByIndex(&maskItem -
-                                            &xp3arc->ItemVector.front()));
-            bool isImage =
-                CheckIsImage(strImg.get()) && CheckIsImage(strMask.get());
-            if(isImage) {
-                // skip 8-bit image
-                iTJSDispatch2 *dic = nullptr;
-                handler->Header(strImg.get(), &dic);
-                strImg->SetPosition(0);
-                if(dic) {
-                    tTJSVariant val;
-                    dic->PropGet(0, TJS_W("bpp"), nullptr, &val, dic);
-                    dic->Release();
-                    int bpp = val.AsInteger();
-                    isImage = bpp == 24 || bpp == 32;
+                return; // only drain the workers
+            HRESULT ret = entry->Result;
+            for(XP3RepackEntry::Output &out : entry->Outputs) {
+                if(ret != S_OK)
+                    break;
+                if(out.Data) {
+                    ret = AddTo7zArchive(out.Data.get(), out.Packed.get(),
+                                         out.Name);
                 } else {
-                    isImage = false; // unknown error, skip
-                }
-            }
-            if(!isImage) {
-                filelist.push_back(it.first);
-                filelist.push_back(it.second);
-                continue;
-            }
-            struct BmpInfoWithMask {
-                tTVPBitmap *bmp = nullptr;
-                tTVPBitmap *bmpForMask = nullptr;
-                std::unordered_map<ttstr, ttstr, ttstr_hasher> metainfo;
-                ~BmpInfoWithMask() {
-                    if(bmp)
-                        delete bmp;
-                    if(bmpForMask)
-                        delete bmpForMask;
+                    std::unique_ptr<tTJSBinaryStream> s(
+                        xp3arc->CreateStreamByIndex(out.Index));
+                    ret = AddTo7zArchive(s.get(), nullptr, out.Name);
                 }
-            } data;
-
-            if(OnNewFile) {
-                OnNewFile(it.first, imgItem.OrgSize,
-                          imgItem.Name.AsStdString());
-            }
-
-            // main part
-            handler->Load(
-                handler->FormatData, &data,
-                [](void *callbackdata, tjs_uint w, tjs_uint h,
-                   tTVPGraphicPixelFormat fmt) -> int {
-                    BmpInfoWithMask *data = (BmpInfoWithMask *)callbackdata;
-                    if(!data->bmp) {
-                        data->bmp = new tTVPBitmap(w, h, 32);
-                    }
-                    return data->bmp->GetPitch();
-                },
-                [](void *callbackdata, tjs_int y) -> void * {
-                    BmpInfoWithMask *data =
-                        static_cast<BmpInfoWithMask *>(callbackdata);
-                    if(y >= 0) {
-                        return data->bmp->GetScanLine(y);
-                    }
-                    return nullptr;
-                },
-                [](void *callbackdata, const ttstr &name, const ttstr &value) {
-                    BmpInfoWithMask *data = (BmpInfoWithMask *)callbackdata;
-                    data->metainfo.emplace(name, value);
-                },
-                strImg.get(), TVP_clNone, glmNormal);
-
-            // mask part
-            handler->Load(
-                handler->FormatData, &data,
-                [](void *callbackdata, tjs_uint w, tjs_uint h,
-                   tTVPGraphicPixelFormat fmt) -> int {
-                    BmpInfoWithMask *data = (BmpInfoWithMask *)callbackdata;
-                    if(data->bmp->GetWidth() != w ||
-                       data->bmp->GetHeight() != h)
-                        TVPThrowExceptionMessage(TVPMaskSizeMismatch);
-                    if(!data->bmpForMask) {
-                        data->bmpForMask = new tTVPBitmap(w, h, 8);
-                    }
-                    return data->bmpForMask->GetPitch();
-                },
-                [](void *callbackdata, tjs_int y) -> void * {
-                    BmpInfoWithMask *data = (BmpInfoWithMask *)callbackdata;
-                    if(y >= 0) {
-                        return data->bmpForMask->GetScanLine(y);
-                    }
-                    return nullptr;
-                },
-                [](void *callbackdata, const ttstr &name, const ttstr &value) {
-                    // no metainfo for mask
-                },
-                strMask.get(), TVP_clNone, glmGrayscale);
-
-            for(tjs_uint y = 0; y < data.bmp->GetHeight(); ++y) {
-                TVPBindMaskToMain((tjs_uint32 *)data.bmp->GetScanLine(y),
-                                  (tjs_uint8 *)data.bmpForMask->GetScanLine(y),
-                                  data.bmp->GetWidth());
-            }
-            delete data.bmpForMask;
-            data.bmpForMask = nullptr;
-            std::unique_ptr<iTJSDispatch2> meta{ TJSCreateDictionaryObject() };
-            for(const auto &[k, v] : data.metainfo) {
-                tTJSVariant var{ v };
-                meta->PropSet(TJS_MEMBERENSURE, k.c_str(), nullptr, &var,
-                              meta.get());
-            }
-            tTVPMemoryStream memstr;
-            auto *bmp =
-                new tTVPBaseBitmap(data.bmp->GetWidth(), data.bmp->GetHeight());
-            bmp->AssignBitmap(data.bmp);
-
-            if(OptionUsingETC2) {
-                TVPSavePVRv3(nullptr, &memstr, bmp, TJS_W("ETC2_RGBA"),
-                             meta.get());
-            } else {
-                // convert to tlg5 for better performance
-                TVPSaveAsTLG(nullptr, &memstr, bmp, TJS_W("tlg5"), meta.get());
-            }
-            delete bmp;
-            memstr.SetPosition(0);
-            HRESULT ret = AddTo7zArchive(&memstr, imgItem.Name);
-            if(OnProgress) {
-                uint64_t size = imgItem.OrgSize + maskItem.OrgSize;
-                nArcSize += size;
-                nTotalSize += size;
-                OnProgress(nTotalSize, nArcSize, size);
             }
+            nArcSize += entry->Size;
+            nTotalSize += entry->Size;
+            if(OnProgress)
+                OnProgress(nTotalSize, nArcSize, entry->Size);
             if(ret != S_OK) {
                 if(ret != S_INTERRUPT && OnError) {
                     OnError(ret, "Write to file fail.");
                 }
                 bStopRequired = true;
-                break;
             }
-        }
-        for(tjs_uint idx : filelist) {
-            const tTVPXP3Archive::tArchiveItem &item = xp3arc->ItemVector[idx];
+        };
 
+        for(const auto &[idx, maskidx] : joblist) {
+            while(!bStopRequired && pending.size() >= maxPending)
+                writeFront();
             if(bStopRequired)
                 break;
-            std::unique_ptr<tTJSBinaryStream> s(
-                xp3arc->CreateStreamByIndex(idx));
 
-            if(OnNewFile)
-                OnNewFile(&item - &xp3arc->ItemVector.front(), item.OrgSize,
-                          item.Name.AsStdString());
-
-            if(OptionUsingETC2 && item.OrgSize > 8192) {
-                // convert image > 8k
-                bool isImage = CheckIsImage(s.get());
-
-                struct BmpInfo {
-                    tTVPBitmap *bmp = nullptr;
-                    std::unordered_map<ttstr, ttstr, ttstr_hasher> metainfo;
-                    tTVPGraphicPixelFormat fmt = gpfLuminance;
-                    ~BmpInfo() {
-                        if(bmp)
-                            delete bmp;
-                    }
-                } data;
-
-                if(isImage) {
-                    // main part
-                    handler->Load(
-                        handler->FormatData, &data,
-                        [](void *callbackdata, tjs_uint w, tjs_uint h,
-                           tTVPGraphicPixelFormat fmt) -> int {
-                            BmpInfo *data = (BmpInfo *)callbackdata;
-                            if(!data->bmp) {
-                                data->bmp = new tTVPBitmap(w, h, 32);
-                                data->fmt = fmt;
-                            }
-                            return data->bmp->GetPitch();
-                        },
-                        [](void *callbackdata, tjs_int y) -> void * {
-                            BmpInfo *data = (BmpInfo *)callbackdata;
-                            if(y >= 0) {
-                                return data->bmp->GetScanLine(y);
-                            }
-                            return nullptr;
-                        },
-                        [](void *callbackdata, const ttstr &name,
-                           const ttstr &value) {
-                            BmpInfo *data = (BmpInfo *)callbackdata;
-                            data->metainfo.emplace(name, value);
-                        },
-                        s.get(), TVP_clNone, glmNormal);
-
-                    // skip 8-bit image
-                    if(data.fmt != gpfRGB || data.fmt != gpfRGBA) {
-                        isImage = false;
-                    }
-                }
+            const tTVPXP3Archive::tArchiveItem &item = xp3arc->ItemVector[idx];
+            auto entry = std::make_shared<XP3RepackEntry>();
+            entry->Index = idx;
+            entry->Size = item.OrgSize;
+            entry->Outputs.emplace_back();
+            entry->Outputs.back().Name = item.Name;
+            entry->Outputs.back().Index = idx;
+            if(maskidx >= 0) {
+                const tTVPXP3Archive::tArchiveItem &maskItem =
+                    xp3arc->ItemVector[maskidx];
+                entry->Size += maskItem.OrgSize;
+                entry->MergeMask = true;
+                entry->Outputs.emplace_back();
+                entry->Outputs.back().Name = maskItem.Name;
+                entry->Outputs.back().Index = maskidx;
             }
-            HRESULT ret = AddTo7zArchive(s.get(), item.Name);
-            nArcSize += item.OrgSize;
-            nTotalSize += item.OrgSize;
-            if(ret != S_OK) {
-                if(ret != S_INTERRUPT && OnError) {
-                    OnError(ret, "Write to file fail.");
-                }
-                bStopRequired = true;
-                break;
+
+            if(OnNewFile)
+                OnNewFile(idx, item.OrgSize, item.Name.AsStdString());
+
+            if(entry->MergeMask ||
+               (item.OrgSize > 64 && item.OrgSize < COMPRESS_THRESHOLD)) {
+                for(XP3RepackEntry::Output &out : entry->Outputs)
+                    out.Data.reset(ReadItemToMemory(xp3arc, out.Index));
+                pending.push_back(entry);
+                auto task = [this, entry] {
+                    if(!entry->Claimed.exchange(true))
+                        ConvertEntry(entry.get());
+                };
+                if(!pool.Post(task))
+                    task(); // the pool has been stopped
+            } else {
+                // nothing to convert; the writer copies it from the archive
+                entry->Claimed = true;
+                entry->Done = true;
+                pending.push_back(entry);
             }
         }
+        // flush the pipeline; after a stop request this only waits for the
+        // workers still holding entries
+        while(!pending.empty())
+            writeFront();
+
         if(bStopRequired)
             break;
         CCompressionMethodMode mode;
@@ -198,6 +198,15 @@ void tTVPSystemControl::RunMemoryGovernor(uint32_t tick) {
         archive_limit = 12;
     TVPSetArchiveCacheCount(archive_limit);
 
+    tjs_uint64 solid_limit_mb = MemoryProfile ? 16 : 32;
+    if(pressure == 1)
+        solid_limit_mb /= 2;
+    else if(pressure == 2)
+        solid_limit_mb /= 4;
+    else if(pressure >= 3)
+        solid_limit_mb = 0;
+    TVPSet7zFolderCacheLimit(solid_limit_mb * 1024 * 1024);
+
     tjs_uint auto_path_limit = 256;
     if(pressure == 1)
         auto_path_limit = 192;
@@ -291,6 +300,12 @@ void tTVPSystemControl::RunMemoryGovernor(uint32_t tick) {
             TVPGetGraphicCacheLimit() / (1024ULL * 1024ULL));
         const tjs_int xp3_seg_mb = static_cast<tjs_int>(
             TVPGetXP3SegmentCacheTotalBytes() / (1024ULL * 1024ULL));
+        tTVPXP3BlobCacheStats blob_stats{};
+        TVPGetXP3BlobCacheStats(blob_stats);
+        const tjs_int xp3_blob_mb =
+            static_cast<tjs_int>(blob_stats.Bytes / (1024ULL * 1024ULL));
+        const tjs_int solid_mb = static_cast<tjs_int>(
+            TVPGet7zFolderCacheTotalBytes() / (1024ULL * 1024ULL));
 
         tjs_int psb_used_mb = 0, psb_limit_mb = 0;
         if(g_GetPSBCacheInfo) {
@@ -316,7 +331,8 @@ void tTVPSystemControl::RunMemoryGovernor(uint32_t tick) {
         const tjs_int tjs_net_mb = static_cast<tjs_int>(tjsNetBytes / (1024LL * 1024LL));
 
         const tjs_int tracked_mb = graphic_used_mb + psb_used_mb + vmem_mb +
-                                    xp3_seg_mb + layermem_mb;
+                                    xp3_seg_mb + xp3_blob_mb + solid_mb +
+                                    layermem_mb;
         const tjs_int untracked_mb = self_used_mb - tracked_mb;
 
         const tjs_int obj_count = static_cast<tjs_int>(TJS_GetCustomObjectCount());
@@ -357,6 +373,8 @@ void tTVPSystemControl::RunMemoryGovernor(uint32_t tick) {
                   ttstr(psb_used_mb) + TJS_W("/") + ttstr(psb_limit_mb) +
                   TJS_W("MB vmem=") + ttstr(vmem_mb) +
                   TJS_W("MB xp3seg=") + ttstr(xp3_seg_mb) +
+                  TJS_W("MB xp3blob=") + ttstr(xp3_blob_mb) +
+                  TJS_W("MB 7z=") + ttstr(solid_mb) +
                   TJS_W("MB layers=") + ttstr(layer_count) +
                   TJS_W("/") + ttstr(layermem_mb) +
                   TJS_W("MB heap=") + ttstr(heap_in_use_mb) + TJS_W("/") +
@@ -433,7 +433,7 @@ namespace TJS {
             return ret;
         }
 
-        tjs_uint GetCount() { return Count; }
+        tjs_uint GetCount() const { return Count; }
 
     private:
         void InternalClear() {
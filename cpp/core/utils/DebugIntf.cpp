@@ -13,6 +13,7 @@
 #include <deque>
 #include <algorithm>
 #include <ctime>
+#include <mutex>
 #include "DebugIntf.h"
 #include "MsgIntf.h"
 #include "StorageIntf.h"
@@ -340,7 +341,9 @@ void tTVPLogStreamHolder::Log(const ttstr &text) {
 void TVPAddLog(const ttstr &line, bool appendtoimportant) {
     // add a line to the log.
     // exceeded lines over TVPLogMaxLines are eliminated.
-    // this function is not thread-safe ...
+    // storage lookups also log from loader threads, so this is serialized.
+    static std::recursive_mutex mutex;
+    std::lock_guard<std::recursive_mutex> lock(mutex);
 
     TVPEnsureLogObjects();
     if(!TVPLogDeque)
@@ -0,0 +1,102 @@
+//---------------------------------------------------------------------------
+// Worker thread pool
+//---------------------------------------------------------------------------
+#include "tjsCommHead.h"
+
+#include <algorithm>
+#include "ThreadPool.h"
+#include "ThreadIntf.h"
+#include "SysInitIntf.h"
+
+//---------------------------------------------------------------------------
+// tTVPThreadPool
+//---------------------------------------------------------------------------
+tTVPThreadPool::tTVPThreadPool(tjs_int threads) :
+    ThreadCount(std::max<tjs_int>(1, threads)) {}
+
+//---------------------------------------------------------------------------
+tTVPThreadPool::~tTVPThreadPool() { Stop(); }
+
+//---------------------------------------------------------------------------
+void tTVPThreadPool::Worker() {
+    while(true) {
+        tTask task;
+        {
+            std::unique_lock<std::mutex> lk(Mutex);
+            Cond.wait(lk, [this] { return Shutdown || !Queue.empty(); });
+            if(Shutdown)
+                return;
+            task = std::move(const_cast<tEntry &>(Queue.top()).Task);
+            Queue.pop();
+        }
+        task();
+    }
+}
+
+//---------------------------------------------------------------------------
+bool tTVPThreadPool::Post(tTask task, tjs_int priority) {
+    {
+        std::lock_guard<std::mutex> lk(Mutex);
+        if(Shutdown)
+            return false;
+        if(Threads.empty()) {
+            // create workers lazily
+            for(tjs_int i = 0; i < ThreadCount; i++)
+                Threads.emplace_back(&tTVPThreadPool::Worker, this);
+        }
+        Queue.push(tEntry{ priority, Sequence++, std::move(task) });
+    }
+    Cond.notify_one();
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void tTVPThreadPool::Clear() {
+    std::lock_guard<std::mutex> lk(Mutex);
+    while(!Queue.empty())
+        Queue.pop();
+}
+
+//---------------------------------------------------------------------------
+void tTVPThreadPool::Stop() {
+    {
+        std::lock_guard<std::mutex> lk(Mutex);
+        if(Shutdown)
+            return;
+        Shutdown = true;
+        while(!Queue.empty())
+            Queue.pop();
+    }
+    Cond.notify_all();
+    for(auto &t : Threads) {
+        if(t.joinable())
+            t.join();
+    }
+    Threads.clear();
+}
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+// TVPGetWorkerThreadPool
+//---------------------------------------------------------------------------
+static tTVPThreadPool *TVPWorkerThreadPool = nullptr;
+static std::once_flag TVPWorkerThreadPoolOnce;
+
+tTVPThreadPool &TVPGetWorkerThreadPool() {
+    std::call_once(TVPWorkerThreadPoolOnce, [] {
+        TVPWorkerThreadPool =
+            new tTVPThreadPool(std::max<tjs_int>(1, TVPGetProcessorNum() - 1));
+    });
+    return *TVPWorkerThreadPool;
+}
+
+//---------------------------------------------------------------------------
+static void TVPStopWorkerThreadPool() {
+    // workers must be gone before the modules their tasks use shut down
+    if(TVPWorkerThreadPool)
+        TVPWorkerThreadPool->Stop();
+}
+
+static tTVPAtExit TVPStopWorkerThreadPoolAtExit(TVP_ATEXIT_PRI_PREPARE,
+                                                TVPStopWorkerThreadPool);
+//---------------------------------------------------------------------------
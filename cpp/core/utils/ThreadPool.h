@@ -0,0 +1,98 @@
+//---------------------------------------------------------------------------
+// Worker thread pool
+//---------------------------------------------------------------------------
+#ifndef ThreadPoolH
+#define ThreadPoolH
+
+#include "tjsTypes.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+//---------------------------------------------------------------------------
+// tTVPThreadPool
+//---------------------------------------------------------------------------
+/*
+        a fixed-size pool of worker threads running posted tasks.
+        tasks with higher priority run first; tasks with the same priority
+        run in the order they were posted. worker threads are created on
+        the first post. tasks must not throw.
+*/
+class tTVPThreadPool {
+public:
+    typedef std::function<void()> tTask;
+
+private:
+    struct tEntry {
+        tjs_int Priority;
+        tjs_uint64 Sequence;
+        tTask Task;
+
+        bool operator<(const tEntry &rhs) const {
+            // std::priority_queue pops the largest element first
+            if(Priority != rhs.Priority)
+                return Priority < rhs.Priority;
+            return Sequence > rhs.Sequence;
+        }
+    };
+
+    std::mutex Mutex;
+    std::condition_variable Cond;
+    std::priority_queue<tEntry> Queue;
+    std::vector<std::thread> Threads;
+    tjs_int ThreadCount;
+    tjs_uint64 Sequence = 0;
+    bool Shutdown = false;
+
+    void Worker();
+
+public:
+    explicit tTVPThreadPool(tjs_int threads);
+
+    ~tTVPThreadPool();
+
+    // returns false when the pool has been stopped; the task is dropped
+    bool Post(tTask task, tjs_int priority = 0);
+
+    // drop all tasks which have not started yet
+    void Clear();
+
+    // stop accepting tasks, drop queued tasks and join the workers
+    void Stop();
+
+    [[nodiscard]] tjs_int GetThreadCount() const { return ThreadCount; }
+};
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+// tTVPCancelToken
+//---------------------------------------------------------------------------
+/*
+        shared cancellation flag; the requester keeps one reference and
+        the task checks IsCancelled() at convenient points.
+*/
+class tTVPCancelToken {
+    std::shared_ptr<std::atomic<bool>> Flag;
+
+public:
+    tTVPCancelToken() : Flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void Cancel() { Flag->store(true, std::memory_order_release); }
+
+    [[nodiscard]] bool IsCancelled() const {
+        return Flag->load(std::memory_order_acquire);
+    }
+};
+//---------------------------------------------------------------------------
+
+// shared pool for CPU bound background work (decompression, decoding);
+// sized to the processor count, leaving one core for the main thread.
+tTVPThreadPool &TVPGetWorkerThreadPool();
+//---------------------------------------------------------------------------
+
+#endif
@@ -44,6 +44,8 @@ tjs_error tTJSNI_Bitmap::Construct(tjs_int numparams, tTJSVariant **param,
 }
 //----------------------------------------------------------------------
 void tTJSNI_Bitmap::Invalidate() {
+    if(Loading && Application)
+        Application->CancelImageLoadRequest(this);
     if(Bitmap)
         delete Bitmap, Bitmap = nullptr;
 }
@@ -95,22 +97,24 @@ void tTJSNI_Bitmap::Independ(bool copy) {
     }
 }
 //----------------------------------------------------------------------
-iTJSDispatch2 *tTJSNI_Bitmap::Load(const ttstr &name, tjs_uint32 colorkey) {
+iTJSDispatch2 *tTJSNI_Bitmap::Load(const ttstr &name, tjs_uint32 colorkey,
+                                   tjs_uint maxw, tjs_uint maxh) {
     if(Loading)
         TVPThrowExceptionMessage(TVPCurrentlyAsyncLoadBitmap);
     if(!Bitmap)
         Bitmap = new tTVPBaseBitmap(TVPGetInitialBitmap());
 
     iTJSDispatch2 *metainfo = nullptr;
-    TVPLoadGraphic(Bitmap, name, colorkey, 0, 0, glmNormal, nullptr, &metainfo);
+    TVPLoadGraphic(Bitmap, name, colorkey, 0, 0, glmNormal, nullptr, &metainfo,
+                   maxw, maxh);
     return metainfo;
 }
 //----------------------------------------------------------------------
-void tTJSNI_Bitmap::LoadAsync(const ttstr &name) {
+void tTJSNI_Bitmap::LoadAsync(const ttstr &name, tjs_int priority) {
     if(Loading)
         TVPThrowExceptionMessage(TVPCurrentlyAsyncLoadBitmap);
     Loading = true;
-    Application->LoadImageRequest(Owner, this, name);
+    Application->LoadImageRequest(Owner, this, name, priority);
 }
 //----------------------------------------------------------------------
 void tTJSNI_Bitmap::Save(const ttstr &name, const ttstr &type,
@@ -364,13 +368,47 @@ tTJSNC_Bitmap::tTJSNC_Bitmap() : inherited(TJS_W("Bitmap")) {
     }
     TJS_END_NATIVE_METHOD_DECL(/*func. name*/ load)
     //----------------------------------------------------------------------
+    TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/ loadScaled) {
+        // loadScaled(storage, width, height, key) : decodes the image at a
+        // reduced scale when the format supports it. the result is no
+        // smaller than width x height (aspect ratio kept) but may be larger.
+        TJS_GET_NATIVE_INSTANCE(/*var. name*/ _this,
+                                /*var. type*/ tTJSNI_Bitmap);
+        if(numparams < 3)
+            return TJS_E_BADPARAMCOUNT;
+        ttstr name(*param[0]);
+        tjs_int maxw = *param[1];
+        tjs_int maxh = *param[2];
+        if(maxw < 0 || maxh < 0)
+            TVPThrowExceptionMessage(TVPInvalidParam);
+        tjs_uint32 key = clNone;
+        if(numparams >= 4 && param[3]->Type() != tvtVoid)
+            key = (tjs_uint32)param[3]->AsInteger();
+        iTJSDispatch2 *metainfo = _this->Load(name, key, maxw, maxh);
+        try {
+            if(result)
+                *result = metainfo;
+        } catch(...) {
+            if(metainfo)
+                metainfo->Release();
+            throw;
+        }
+        if(metainfo)
+            metainfo->Release();
+        return TJS_S_OK;
+    }
+    TJS_END_NATIVE_METHOD_DECL(/*func. name*/ loadScaled)
+    //----------------------------------------------------------------------
     TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/ loadAsync) {
         TJS_GET_NATIVE_INSTANCE(/*var. name*/ _this,
                                 /*var. type*/ tTJSNI_Bitmap);
         if(numparams < 1)
             return TJS_E_BADPARAMCOUNT;
         ttstr name(*param[0]);
-        _this->LoadAsync(name);
+        tjs_int priority = 0;
+        if(numparams >= 2 && param[1]->Type() != tvtVoid)
+            priority = *param[1];
+        _this->LoadAsync(name, priority);
         return TJS_S_OK;
     }
     TJS_END_NATIVE_METHOD_DECL(/*func. name*/ loadAsync)
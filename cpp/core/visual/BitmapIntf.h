@@ -33,8 +33,9 @@ public:
 
     void Independ(bool copy = true);
 
-    iTJSDispatch2 *Load(const ttstr &name, tjs_uint32 colorkey);
-    void LoadAsync(const ttstr &name);
+    iTJSDispatch2 *Load(const ttstr &name, tjs_uint32 colorkey,
+                        tjs_uint maxw = 0, tjs_uint maxh = 0);
+    void LoadAsync(const ttstr &name, tjs_int priority = 0);
     void Save(const ttstr &name, const ttstr &type,
               iTJSDispatch2 *meta = nullptr);
 
@@ -0,0 +1,549 @@
+//---------------------------------------------------------------------------
+// decoded graphic disk cache
+//---------------------------------------------------------------------------
+#include "tjsCommHead.h"
+
+#include "GraphicDiskCache.h"
+#include "LayerBitmapIntf.h"
+#include "StorageIntf.h"
+#include "SysInitImpl.h"
+#include "tjsHashSearch.h"
+#include "TVPMmapAlloc.h"
+
+#include <lz4.h>
+#include <zlib.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+bool TVPGraphicDiskCacheEnabled = false;
+tjs_uint TVPGraphicDiskCacheMinDecodeTime = 20;
+tjs_uint64 TVPGraphicDiskCacheLimit = 512 * 1024 * 1024;
+
+//---------------------------------------------------------------------------
+// on-disk layout
+//---------------------------------------------------------------------------
+/*
+        header | meta table | string table | (padding) | pixels
+
+        all integers are host endian; the cache is never shared between
+        machines. the string table holds the storage name first, followed
+        by the meta information names and values, without terminators.
+        pixels start at a page boundary so that a raw image can be copied
+        straight out of the mapping; rows are tightly packed, top-down,
+        and optionally LZ4 compressed as a single block.
+*/
+#define TVP_GRAPHIC_DISK_CACHE_VERSION 1
+#define TVP_GRAPHIC_DISK_CACHE_LZ4 1
+#define TVP_GRAPHIC_DISK_CACHE_OPAQUE 2
+#define TVP_GRAPHIC_DISK_CACHE_PAGE_SIZE 4096
+
+namespace {
+const char TVPGraphicDiskCacheMagic[8] = { 'K', 'R', 'G', 'F', 'X', 'B', 'M', 'C' };
+
+struct tTVPGraphicDiskCacheHeader {
+    char Magic[8];
+    tjs_uint32 Version;
+    tjs_uint32 CharSize; // sizeof(tjs_char)
+    tjs_uint64 SourceSize;
+    tjs_int64 SourceMTime;
+    tjs_uint32 KeyIdx;
+    tjs_uint32 DesW;
+    tjs_uint32 DesH;
+    tjs_uint32 MaxW;
+    tjs_uint32 MaxH;
+    tjs_uint32 Width;
+    tjs_uint32 Height;
+    tjs_uint32 Flags; // TVP_GRAPHIC_DISK_CACHE_*
+    tjs_uint32 NameLength; // in characters
+    tjs_uint32 MetaInfoCount;
+    tjs_uint32 Checksum; // adler32 of the meta and string tables
+    tjs_uint32 Reserved;
+    tjs_uint64 MetaTableOffset;
+    tjs_uint64 StringTableOffset;
+    tjs_uint64 PixelOffset;
+    tjs_uint64 PixelSize; // stored (possibly compressed) size
+    tjs_uint64 TotalSize;
+};
+
+struct tTVPGraphicDiskCacheMetaInfo {
+    tjs_uint32 NameOffset; // in characters, from the string table
+    tjs_uint32 NameLength;
+    tjs_uint32 ValueOffset;
+    tjs_uint32 ValueLength;
+};
+
+static_assert(sizeof(tTVPGraphicDiskCacheHeader) % 8 == 0, "");
+static_assert(sizeof(tTVPGraphicDiskCacheMetaInfo) % 8 == 0, "");
+
+//---------------------------------------------------------------------------
+// storage name -> cache key
+//---------------------------------------------------------------------------
+struct tTVPGraphicDiskCacheKey {
+    ttstr Name; // placed storage name; stored in the cache file
+    std::filesystem::path CachePath;
+    tjs_uint64 SourceSize = 0;
+    tjs_int64 SourceMTime = 0;
+};
+
+bool TVPGetGraphicDiskCacheKey(const ttstr &name,
+                               const tTVPGraphicDiskCacheParams &params,
+                               tTVPGraphicDiskCacheKey &key) {
+    if(!TVPGraphicDiskCacheEnabled || TVPNativeDataPath.IsEmpty())
+        return false;
+
+    // the loaders get auto path names, which do not exist on disk. the
+    // image is stamped with the outermost local file actually providing
+    // it; for an in-archive storage that is the archive itself, so an
+    // overriding patch archive gets entries of its own.
+    key.Name = TVPGetPlacedPath(name);
+    if(key.Name.IsEmpty())
+        return false;
+    ttstr source = key.Name;
+    tjs_int delim = source.IndexOf(TVPArchiveDelimiter);
+    if(delim > 0)
+        source = source.SubString(0, delim);
+    ttstr localname = TVPGetLocallyAccessibleName(source);
+    if(localname.IsEmpty())
+        return false;
+
+    std::error_code ec;
+    std::filesystem::path srcpath =
+        std::filesystem::u8path(localname.AsStdString());
+    key.SourceSize = std::filesystem::file_size(srcpath, ec);
+    if(ec)
+        return false;
+    auto mtime = std::filesystem::last_write_time(srcpath, ec);
+    if(ec)
+        return false;
+    key.SourceMTime = (tjs_int64)mtime.time_since_epoch().count();
+
+    tjs_uint32 paramhash = params.KeyIdx;
+    paramhash = paramhash * 31 + params.DesW;
+    paramhash = paramhash * 31 + params.DesH;
+    paramhash = paramhash * 31 + params.MaxW;
+    paramhash = paramhash * 31 + params.MaxH;
+
+    char filename[32];
+    std::snprintf(filename, sizeof(filename), "%08x%08x.bmc",
+                  (unsigned)tTJSHashFunc<ttstr>::Make(key.Name),
+                  (unsigned)(paramhash ^ (tjs_uint32)key.Name.GetLen()));
+    key.CachePath = std::filesystem::u8path(TVPNativeDataPath.AsStdString()) /
+        "gfxcache" / filename;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// size limit
+//---------------------------------------------------------------------------
+/*
+        the total size of the cache directory is counted on the first store
+        and kept up to date by later stores. when it exceeds
+        TVPGraphicDiskCacheLimit, the least recently used files are removed
+        until it is down to 3/4 of the limit. loads refresh the modification
+        time of the files they hit, which serves as the last use time.
+*/
+std::mutex TVPGraphicDiskCacheSizeMutex;
+bool TVPGraphicDiskCacheSizeKnown = false;
+tjs_uint64 TVPGraphicDiskCacheTotalSize = 0;
+
+struct tTVPGraphicDiskCacheEntry {
+    std::filesystem::path Path;
+    std::filesystem::file_time_type LastUse;
+    tjs_uint64 Size;
+};
+
+std::vector<tTVPGraphicDiskCacheEntry>
+TVPListGraphicDiskCache(const std::filesystem::path &dir) {
+    std::vector<tTVPGraphicDiskCacheEntry> list;
+    std::error_code ec;
+    for(std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end;
+        it.increment(ec)) {
+        if(it->path().extension() != ".bmc")
+            continue;
+        std::error_code ec2;
+        tjs_uint64 size = it->file_size(ec2);
+        if(ec2)
+            continue;
+        auto time = it->last_write_time(ec2);
+        if(ec2)
+            continue;
+        list.push_back({ it->path(), time, size });
+    }
+    return list;
+}
+
+void TVPUpdateGraphicDiskCacheSize(const std::filesystem::path &dir,
+                                   tjs_uint64 added, tjs_uint64 removed) {
+    if(!TVPGraphicDiskCacheLimit)
+        return; // unlimited
+
+    std::lock_guard<std::mutex> lk(TVPGraphicDiskCacheSizeMutex);
+    if(!TVPGraphicDiskCacheSizeKnown) {
+        // the new file is already in place and counted by the scan
+        TVPGraphicDiskCacheSizeKnown = true;
+        TVPGraphicDiskCacheTotalSize = 0;
+        for(const auto &entry : TVPListGraphicDiskCache(dir))
+            TVPGraphicDiskCacheTotalSize += entry.Size;
+    } else {
+        TVPGraphicDiskCacheTotalSize += added;
+        TVPGraphicDiskCacheTotalSize -=
+            std::min(removed, TVPGraphicDiskCacheTotalSize);
+    }
+    if(TVPGraphicDiskCacheTotalSize <= TVPGraphicDiskCacheLimit)
+        return;
+
+    // evict the least recently used files
+    std::vector<tTVPGraphicDiskCacheEntry> list = TVPListGraphicDiskCache(dir);
+    std::sort(list.begin(), list.end(),
+              [](const tTVPGraphicDiskCacheEntry &a,
+                 const tTVPGraphicDiskCacheEntry &b) {
+                  return a.LastUse < b.LastUse;
+              });
+    tjs_uint64 total = 0;
+    for(const auto &entry : list)
+        total += entry.Size;
+    tjs_uint64 target = TVPGraphicDiskCacheLimit / 4 * 3;
+    for(const auto &entry : list) {
+        if(total <= target)
+            break;
+        std::error_code ec;
+        if(std::filesystem::remove(entry.Path, ec))
+            total -= entry.Size;
+    }
+    TVPGraphicDiskCacheTotalSize = total;
+}
+
+tjs_uint64 TVPAlignGraphicDiskCache(tjs_uint64 v, tjs_uint64 align) {
+    return (v + align - 1) & ~(align - 1);
+}
+
+//---------------------------------------------------------------------------
+// read-only view of a cache file
+//---------------------------------------------------------------------------
+class tTVPGraphicDiskCacheFile {
+    const tjs_uint8 *Data = nullptr;
+    tjs_uint64 Size = 0;
+#ifdef TVP_USE_MMAP_FILE
+    bool Mapped = false;
+#endif
+    std::vector<tjs_uint8> Buffer;
+
+public:
+    explicit tTVPGraphicDiskCacheFile(const std::filesystem::path &path) {
+#ifdef TVP_USE_MMAP_FILE
+        Data = (const tjs_uint8 *)TVPMmapFileReadOnly(path.u8string().c_str(),
+                                                      Size);
+        if(Data) {
+            Mapped = true;
+            return;
+        }
+#endif
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if(!in)
+            return;
+        std::streamoff len = in.tellg();
+        if(len <= 0)
+            return;
+        Buffer.resize((size_t)len);
+        in.seekg(0);
+        if(!in.read((char *)Buffer.data(), len))
+            return;
+        Data = Buffer.data();
+        Size = (tjs_uint64)len;
+    }
+
+    ~tTVPGraphicDiskCacheFile() {
+#ifdef TVP_USE_MMAP_FILE
+        if(Mapped)
+            TVPMunmapFile(Data, Size);
+#endif
+    }
+
+    [[nodiscard]] const tjs_uint8 *GetData() const { return Data; }
+
+    [[nodiscard]] tjs_uint64 GetSize() const { return Size; }
+};
+} // namespace
+
+//---------------------------------------------------------------------------
+// TVPLoadGraphicDiskCache
+//---------------------------------------------------------------------------
+tTVPBitmap *
+TVPLoadGraphicDiskCache(const ttstr &name,
+                        const tTVPGraphicDiskCacheParams &params,
+                        std::vector<tTVPGraphicMetaInfoPair> **metainfo) {
+    tTVPGraphicDiskCacheKey key;
+    if(!TVPGetGraphicDiskCacheKey(name, params, key))
+        return nullptr;
+
+    std::error_code ec;
+    if(!std::filesystem::exists(key.CachePath, ec))
+        return nullptr;
+
+    tTVPGraphicDiskCacheFile file(key.CachePath);
+    const tjs_uint8 *data = file.GetData();
+    tjs_uint64 size = file.GetSize();
+    if(!data || size < sizeof(tTVPGraphicDiskCacheHeader))
+        return nullptr;
+
+    // validate the header against the current source file and parameters
+    const auto *hdr = (const tTVPGraphicDiskCacheHeader *)data;
+    if(memcmp(hdr->Magic, TVPGraphicDiskCacheMagic, sizeof(hdr->Magic)) ||
+       hdr->Version != TVP_GRAPHIC_DISK_CACHE_VERSION ||
+       hdr->CharSize != sizeof(tjs_char) || hdr->TotalSize != size ||
+       hdr->SourceSize != key.SourceSize ||
+       hdr->SourceMTime != key.SourceMTime || hdr->KeyIdx != params.KeyIdx ||
+       hdr->DesW != params.DesW || hdr->DesH != params.DesH ||
+       hdr->MaxW != params.MaxW || hdr->MaxH != params.MaxH ||
+       hdr->Width == 0 || hdr->Height == 0)
+        return nullptr;
+
+    tjs_uint64 rawsize = (tjs_uint64)hdr->Width * hdr->Height * 4;
+    tjs_uint64 metatablesize =
+        (tjs_uint64)hdr->MetaInfoCount * sizeof(tTVPGraphicDiskCacheMetaInfo);
+    if(hdr->MetaTableOffset != sizeof(tTVPGraphicDiskCacheHeader) ||
+       hdr->StringTableOffset < hdr->MetaTableOffset + metatablesize ||
+       hdr->PixelOffset < hdr->StringTableOffset ||
+       hdr->PixelOffset > size || hdr->PixelSize > size - hdr->PixelOffset)
+        return nullptr;
+    bool compressed = (hdr->Flags & TVP_GRAPHIC_DISK_CACHE_LZ4) != 0;
+    if(compressed ? (rawsize > 0x7fffffff || hdr->PixelSize > 0x7fffffff)
+                  : hdr->PixelSize != rawsize)
+        return nullptr;
+
+    uLong checksum = adler32(0L, Z_NULL, 0);
+    checksum = adler32(checksum, data + hdr->MetaTableOffset,
+                       (uInt)(hdr->PixelOffset - hdr->MetaTableOffset));
+    if((tjs_uint32)checksum != hdr->Checksum)
+        return nullptr;
+
+    tjs_uint64 stringcount =
+        (hdr->PixelOffset - hdr->StringTableOffset) / sizeof(tjs_char);
+    if(hdr->NameLength > stringcount)
+        return nullptr;
+    const auto *strings = (const tjs_char *)(data + hdr->StringTableOffset);
+    if(ttstr(strings, hdr->NameLength) != key.Name)
+        return nullptr; // hash collision in the cache file name
+
+    std::vector<tTVPGraphicMetaInfoPair> *mi = nullptr;
+    tTVPBitmap *bmp = nullptr;
+    try {
+        const auto *metatable =
+            (const tTVPGraphicDiskCacheMetaInfo *)(data + hdr->MetaTableOffset);
+        for(tjs_uint32 i = 0; i < hdr->MetaInfoCount; i++) {
+            const tTVPGraphicDiskCacheMetaInfo &rec = metatable[i];
+            if((tjs_uint64)rec.NameOffset + rec.NameLength > stringcount ||
+               (tjs_uint64)rec.ValueOffset + rec.ValueLength > stringcount) {
+                delete mi;
+                return nullptr;
+            }
+            if(!mi)
+                mi = new std::vector<tTVPGraphicMetaInfoPair>();
+            mi->emplace_back(ttstr(strings + rec.NameOffset, rec.NameLength),
+                             ttstr(strings + rec.ValueOffset, rec.ValueLength));
+        }
+
+        bmp = new tTVPBitmap(hdr->Width, hdr->Height, 32);
+        bmp->IsOpaque = (hdr->Flags & TVP_GRAPHIC_DISK_CACHE_OPAQUE) != 0;
+        const tjs_uint8 *pixels = data + hdr->PixelOffset;
+        tjs_uint rowbytes = hdr->Width * 4;
+        std::vector<tjs_uint8> unpacked;
+        if(compressed) {
+            // decompress straight into the bitmap when its rows are
+            // contiguous and top-down
+            tjs_uint8 *dest = nullptr;
+            if(bmp->GetPitch() == (tjs_int)rowbytes)
+                dest = (tjs_uint8 *)bmp->GetScanLine(0);
+            else {
+                unpacked.resize((size_t)rawsize);
+                dest = unpacked.data();
+            }
+            int ret = LZ4_decompress_safe((const char *)pixels, (char *)dest,
+                                          (int)hdr->PixelSize, (int)rawsize);
+            if(ret != (int)rawsize) {
+                bmp->Release();
+                delete mi;
+                return nullptr;
+            }
+            if(unpacked.empty())
+                pixels = nullptr;
+            else
+                pixels = unpacked.data();
+        }
+        if(pixels) {
+            for(tjs_uint y = 0; y < hdr->Height; y++)
+                memcpy(bmp->GetScanLine(y), pixels + (size_t)y * rowbytes,
+                       rowbytes);
+        }
+    } catch(...) {
+        // bad allocation and the like; fall back to decoding
+        if(bmp)
+            bmp->Release();
+        delete mi;
+        return nullptr;
+    }
+
+    // mark the entry as recently used for the eviction
+    std::filesystem::last_write_time(
+        key.CachePath, std::filesystem::file_time_type::clock::now(), ec);
+
+    *metainfo = mi;
+    return bmp;
+}
+
+//---------------------------------------------------------------------------
+// TVPSaveGraphicDiskCache
+//---------------------------------------------------------------------------
+void TVPSaveGraphicDiskCache(
+    const ttstr &name, const tTVPGraphicDiskCacheParams &params,
+    const tTVPBitmap *bmp,
+    const std::vector<tTVPGraphicMetaInfoPair> *metainfo) {
+    if(!bmp || !bmp->Is32bit())
+        return;
+
+    tTVPGraphicDiskCacheKey key;
+    if(!TVPGetGraphicDiskCacheKey(name, params, key))
+        return;
+
+    try {
+        tjs_uint width = bmp->GetWidth();
+        tjs_uint height = bmp->GetHeight();
+        tjs_uint64 rawsize = (tjs_uint64)width * height * 4;
+        if(!width || !height || rawsize > 0x7fffffff)
+            return;
+
+        tjs_uint64 metacount = metainfo ? metainfo->size() : 0;
+        tjs_uint64 stringcount = key.Name.GetLen();
+        if(metainfo) {
+            for(const auto &pair : *metainfo)
+                stringcount += pair.Name.GetLen() + pair.Value.GetLen();
+        }
+        if(stringcount > 0xffffffffu)
+            return;
+
+        tTVPGraphicDiskCacheHeader hdr{};
+        memcpy(hdr.Magic, TVPGraphicDiskCacheMagic, sizeof(hdr.Magic));
+        hdr.Version = TVP_GRAPHIC_DISK_CACHE_VERSION;
+        hdr.CharSize = sizeof(tjs_char);
+        hdr.SourceSize = key.SourceSize;
+        hdr.SourceMTime = key.SourceMTime;
+        hdr.KeyIdx = params.KeyIdx;
+        hdr.DesW = params.DesW;
+        hdr.DesH = params.DesH;
+        hdr.MaxW = params.MaxW;
+        hdr.MaxH = params.MaxH;
+        hdr.Width = width;
+        hdr.Height = height;
+        if(bmp->IsOpaque)
+            hdr.Flags |= TVP_GRAPHIC_DISK_CACHE_OPAQUE;
+        hdr.NameLength = key.Name.GetLen();
+        hdr.MetaInfoCount = (tjs_uint32)metacount;
+        hdr.MetaTableOffset = sizeof(hdr);
+        hdr.StringTableOffset = TVPAlignGraphicDiskCache(
+            hdr.MetaTableOffset +
+                metacount * sizeof(tTVPGraphicDiskCacheMetaInfo),
+            8);
+        hdr.PixelOffset = TVPAlignGraphicDiskCache(
+            hdr.StringTableOffset + stringcount * sizeof(tjs_char),
+            TVP_GRAPHIC_DISK_CACHE_PAGE_SIZE);
+
+        // gather the pixels top-down and tightly packed
+        tjs_uint rowbytes = width * 4;
+        std::vector<tjs_uint8> pixels((size_t)rawsize);
+        for(tjs_uint y = 0; y < height; y++)
+            memcpy(pixels.data() + (size_t)y * rowbytes, bmp->GetScanLine(y),
+                   rowbytes);
+
+        // keep the LZ4 block only when it saves a worthwhile amount; raw
+        // pixels are copied out of the mapping without any decoding
+        std::vector<tjs_uint8> packed(
+            (size_t)LZ4_compressBound((int)rawsize));
+        int packedsize =
+            LZ4_compress_default((const char *)pixels.data(),
+                                 (char *)packed.data(), (int)rawsize,
+                                 (int)packed.size());
+        const std::vector<tjs_uint8> *body = &pixels;
+        hdr.PixelSize = rawsize;
+        if(packedsize > 0 && (tjs_uint64)packedsize <= rawsize / 4 * 3) {
+            body = &packed;
+            hdr.PixelSize = (tjs_uint64)packedsize;
+            hdr.Flags |= TVP_GRAPHIC_DISK_CACHE_LZ4;
+        }
+        hdr.TotalSize = hdr.PixelOffset + hdr.PixelSize;
+
+        std::vector<tjs_uint8> image((size_t)hdr.PixelOffset, 0);
+        auto *metatable = (tTVPGraphicDiskCacheMetaInfo *)(image.data() +
+                                                           hdr.MetaTableOffset);
+        auto *strings = (tjs_char *)(image.data() + hdr.StringTableOffset);
+
+        tjs_uint32 strofs = 0;
+        memcpy(strings, key.Name.c_str(), key.Name.GetLen() * sizeof(tjs_char));
+        strofs += key.Name.GetLen();
+        for(tjs_uint64 i = 0; i < metacount; i++) {
+            const tTVPGraphicMetaInfoPair &pair = (*metainfo)[(size_t)i];
+            tTVPGraphicDiskCacheMetaInfo &rec = metatable[i];
+            rec.NameOffset = strofs;
+            rec.NameLength = pair.Name.GetLen();
+            if(rec.NameLength)
+                memcpy(strings + strofs, pair.Name.c_str(),
+                       rec.NameLength * sizeof(tjs_char));
+            strofs += rec.NameLength;
+            rec.ValueOffset = strofs;
+            rec.ValueLength = pair.Value.GetLen();
+            if(rec.ValueLength)
+                memcpy(strings + strofs, pair.Value.c_str(),
+                       rec.ValueLength * sizeof(tjs_char));
+            strofs += rec.ValueLength;
+        }
+
+        uLong checksum = adler32(0L, Z_NULL, 0);
+        checksum = adler32(checksum, image.data() + hdr.MetaTableOffset,
+                           (uInt)(hdr.PixelOffset - hdr.MetaTableOffset));
+        hdr.Checksum = (tjs_uint32)checksum;
+        memcpy(image.data(), &hdr, sizeof(hdr));
+
+        // write to a temporary file and rename it over, so that a reader
+        // never sees a partially written cache. decode workers may store
+        // the same image at once, hence the per-thread temporary name.
+        std::error_code ec;
+        std::filesystem::create_directories(key.CachePath.parent_path(), ec);
+        char suffix[32];
+        std::snprintf(
+            suffix, sizeof(suffix), ".%zx.tmp",
+            (size_t)std::hash<std::thread::id>()(std::this_thread::get_id()));
+        std::filesystem::path tmppath = key.CachePath;
+        tmppath += suffix;
+        {
+            std::ofstream out(tmppath, std::ios::binary | std::ios::trunc);
+            if(!out)
+                return;
+            out.write((const char *)image.data(), (std::streamsize)image.size());
+            out.write((const char *)body->data(),
+                      (std::streamsize)hdr.PixelSize);
+            if(!out) {
+                out.close();
+                std::filesystem::remove(tmppath, ec);
+                return;
+            }
+        }
+        tjs_uint64 replaced = std::filesystem::file_size(key.CachePath, ec);
+        if(ec)
+            replaced = 0;
+        std::filesystem::rename(tmppath, key.CachePath, ec);
+        if(ec) {
+            std::filesystem::remove(tmppath, ec);
+            return;
+        }
+        TVPUpdateGraphicDiskCacheSize(key.CachePath.parent_path(),
+                                      hdr.TotalSize, replaced);
+    } catch(...) {
+        // the cache is an optimization only
+    }
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,58 @@
+//---------------------------------------------------------------------------
+// decoded graphic disk cache
+//---------------------------------------------------------------------------
+/*
+        persistent on-disk cache of decoded bitmaps.
+
+        images which are slow to decode (BPG, JXR, large TLG6 backgrounds)
+        are written once as raw or LZ4 compressed 32bpp pixels, keyed by
+        the placed storage name, the load parameters and the size and
+        modification time of the local file (or the archive) holding the
+        image. later loads map the cache file and copy the pixels into a
+        new bitmap instead of running the decoder. the cache directory is
+        kept under a size limit by removing the least recently used files.
+*/
+//---------------------------------------------------------------------------
+#ifndef GraphicDiskCacheH
+#define GraphicDiskCacheH
+
+#include "GraphicsLoaderIntf.h"
+#include <vector>
+
+class tTVPBitmap;
+
+//---------------------------------------------------------------------------
+extern bool TVPGraphicDiskCacheEnabled; // use decoded graphic disk cache
+// decode time in ms an image must take before it is written to the cache
+extern tjs_uint TVPGraphicDiskCacheMinDecodeTime;
+// total size in bytes of the cache files; least recently used files are
+// removed beyond it. 0 means no limit.
+extern tjs_uint64 TVPGraphicDiskCacheLimit;
+//---------------------------------------------------------------------------
+
+// load parameters which affect the decoded pixels
+struct tTVPGraphicDiskCacheParams {
+    tjs_uint32 KeyIdx = 0;
+    tjs_uint DesW = 0;
+    tjs_uint DesH = 0;
+    tjs_uint MaxW = 0;
+    tjs_uint MaxH = 0;
+};
+
+// loads the cached 32bpp image for 'name' (normalized storage name).
+// returns nullptr when there is no valid entry. metainfo receives a new
+// vector when the cached image carries meta information.
+tTVPBitmap *
+TVPLoadGraphicDiskCache(const ttstr &name,
+                        const tTVPGraphicDiskCacheParams &params,
+                        std::vector<tTVPGraphicMetaInfoPair> **metainfo);
+
+// stores 'bmp' for 'name'. only 32bpp images are stored; failures are
+// silently ignored.
+void TVPSaveGraphicDiskCache(
+    const ttstr &name, const tTVPGraphicDiskCacheParams &params,
+    const tTVPBitmap *bmp,
+    const std::vector<tTVPGraphicMetaInfoPair> *metainfo);
+//---------------------------------------------------------------------------
+
+#endif
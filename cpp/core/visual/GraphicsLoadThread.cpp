@@ -14,6 +14,9 @@
 #include "BitmapBitsAlloc.h"
 #include "LayerIntf.h"
 #include "TVPDecodeArena.h"
+#include "ThreadPool.h"
+#include "GraphicDiskCache.h"
+#include "TickCount.h"
 
 tTVPTmpBitmapImage::tTVPTmpBitmapImage() : MetaInfo(nullptr) {}
 tTVPTmpBitmapImage::~tTVPTmpBitmapImage() {
@@ -27,7 +30,8 @@ tTVPTmpBitmapImage::~tTVPTmpBitmapImage() {
     }
 }
 tTVPImageLoadCommand::tTVPImageLoadCommand() :
-    owner_(nullptr), bmp_(nullptr), dest_(nullptr) {}
+    owner_(nullptr), bmp_(nullptr), dest_(nullptr), sequence_(0),
+    cancelled_(false) {}
 tTVPImageLoadCommand::~tTVPImageLoadCommand() {
     if(owner_) {
         owner_->Release();
@@ -88,34 +92,37 @@ static void TVPLoadGraphicAsync_MetaInfoPushCallback(void *callbackdata,
 //---------------------------------------------------------------------------
 
 tTVPAsyncImageLoader::tTVPAsyncImageLoader() :
-    EventQueue(this, &tTVPAsyncImageLoader::Proc), tTVPThread(true) {
+    EventQueue(this, &tTVPAsyncImageLoader::Proc),
+    Link(std::make_shared<tLink>()) {
+    Link->Loader = this;
     EventQueue.Allocate();
 }
 tTVPAsyncImageLoader::~tTVPAsyncImageLoader() {
     ExitRequest();
-    WaitFor();
-    EventQueue.Deallocate();
-    while(!CommandQueue.empty()) {
-        tTVPImageLoadCommand *cmd = CommandQueue.front();
-        CommandQueue.pop();
-        delete cmd;
-    }
-    while(!LoadedQueue.empty()) {
-        tTVPImageLoadCommand *cmd = LoadedQueue.front();
-        LoadedQueue.pop();
-        delete cmd;
+    {
+        // デコード中のタスクはこれ以降結果を捨てる
+        std::lock_guard<std::mutex> lk(Link->Mutex);
+        Link->Loader = nullptr;
     }
+    EventQueue.Deallocate();
+    for(auto &i : LoadedQueue)
+        delete i.second;
+    LoadedQueue.clear();
 }
 void tTVPAsyncImageLoader::ExitRequest() {
-    Terminate();
-    PushCommandQueueEvent.Set();
+    for(auto &i : Pending)
+        i.second->cancelled_ = true;
 }
-void tTVPAsyncImageLoader::Execute() {
-    // プライオリティは最低にする
-    SetPriority(ttpIdle);
-    LoadingThread();
+void tTVPAsyncImageLoader::CancelRequest(tTJSNI_Bitmap *bmp) {
+    auto it = Pending.find(bmp);
+    if(it != Pending.end())
+        it->second->cancelled_ = true;
 }
-void tTVPAsyncImageLoader::SendToLoadFinish() {
+void tTVPAsyncImageLoader::PushLoadedQueue(tTVPImageLoadCommand *cmd) {
+    {
+        tTJSCriticalSectionHolder cs(ImageQueueCS);
+        LoadedQueue[cmd->sequence_] = cmd;
+    }
     NativeEvent ev(TVP_EV_IMAGE_LOAD_THREAD);
     EventQueue.PostEvent(ev);
 }
@@ -132,16 +139,24 @@ void tTVPAsyncImageLoader::HandleLoadedImage() {
         loading = false;
         tTVPImageLoadCommand *cmd = nullptr;
         {
+            // 並列にデコードされるので、要求順に揃えて通知する
             tTJSCriticalSectionHolder cs(ImageQueueCS);
-            if(!LoadedQueue.empty()) {
-                cmd = LoadedQueue.front();
-                LoadedQueue.pop();
+            auto it = LoadedQueue.begin();
+            if(it != LoadedQueue.end() && it->first == NextDeliver) {
+                cmd = it->second;
+                LoadedQueue.erase(it);
+                NextDeliver++;
                 loading = true;
             }
         }
         if(cmd != nullptr) {
+            auto pending = Pending.find(cmd->bmp_);
+            if(pending != Pending.end() && pending->second == cmd)
+                Pending.erase(pending);
             cmd->bmp_->SetLoading(false);
-            if(cmd->result_.length() > 0) {
+            if(cmd->cancelled_) {
+                // 無効化された Bitmap へは格納も通知もしない
+            } else if(cmd->result_.length() > 0) {
                 // error
                 tTJSVariant param[4];
                 param[0] = tTJSVariant((iTJSDispatch2 *)nullptr,
@@ -166,16 +181,9 @@ void tTVPAsyncImageLoader::HandleLoadedImage() {
                     TVPMetaInfoPairsToDictionary(cmd->dest_->MetaInfo);
 
                 cmd->bmp_->SetSizeAndImageBuffer(cmd->dest_->bmp);
-                // 読込み完了時にもキャッシュチェック(非同期なので完了前に読み込まれている可能性あり)
-                if(TVPHasImageCache(cmd->path_, glmNormal, 0, 0, TVP_clNone) ==
-                   false) {
-                    TVPPushGraphicCache(cmd->path_, cmd->dest_->bmp,
-                                        cmd->dest_->MetaInfo);
-                    cmd->dest_->MetaInfo = nullptr;
-                } else {
-                    delete cmd->dest_->MetaInfo;
-                    cmd->dest_->MetaInfo = nullptr;
-                }
+                // キャッシュへの格納はワーカースレッドで済んでいる
+                delete cmd->dest_->MetaInfo;
+                cmd->dest_->MetaInfo = nullptr;
                 cmd->dest_->bmp->Release();
                 cmd->dest_->bmp = nullptr;
 
@@ -203,7 +211,7 @@ void tTVPAsyncImageLoader::HandleLoadedImage() {
 // onLoaded( dic, is_async, is_error, error_mes ); エラーは
 // sync ( main thead )
 void tTVPAsyncImageLoader::LoadRequest(iTJSDispatch2 *owner, tTJSNI_Bitmap *bmp,
-                                       const ttstr &name) {
+                                       const ttstr &name, tjs_int priority) {
     // tTVPBaseBitmap* dest = new tTVPBaseBitmap( 32, 32, 32 );
     tTVPBaseBitmap dest(TVPGetInitialBitmap());
     iTJSDispatch2 *metainfo = nullptr;
@@ -237,16 +245,15 @@ void tTVPAsyncImageLoader::LoadRequest(iTJSDispatch2 *owner, tTJSNI_Bitmap *bmp,
                                  name);
     }
 
-    PushLoadQueue(owner, bmp, nname);
+    PushLoadQueue(owner, bmp, nname, priority);
 }
 
-// tTJSCriticalSectionHolder cs_holder(TVPCreateStreamCS);
-//	tTJSBinaryStream* stream = TVPCreateStream(nname, TJS_BS_READ);
-// TVPCreateStream はロックされているので、非同期で実行可能
+// TVPCreateStream はスレッドセーフなので、ワーカースレッドで実行可能
 
 void tTVPAsyncImageLoader::PushLoadQueue(iTJSDispatch2 *owner,
                                          tTJSNI_Bitmap *bmp,
-                                         const ttstr &nname) {
+                                         const ttstr &nname,
+                                         tjs_int priority) {
     auto *cmd = new tTVPImageLoadCommand();
     cmd->owner_ = owner;
     if(owner)
@@ -255,44 +262,21 @@ void tTVPAsyncImageLoader::PushLoadQueue(iTJSDispatch2 *owner,
     cmd->path_ = nname;
     cmd->dest_ = new tTVPTmpBitmapImage();
     cmd->result_.Clear();
-    {
-        // キューをロックしてプッシュ
-        tTJSCriticalSectionHolder cs(CommandQueueCS);
-        CommandQueue.push(cmd);
-    }
-    // 追加したことをイベントで通知
-    PushCommandQueueEvent.Set();
-}
-void tTVPAsyncImageLoader::LoadingThread() {
-    while(!GetTerminated()) {
-        // キュー追加イベント待ち
-        PushCommandQueueEvent.WaitFor(0);
-        if(GetTerminated())
-            break;
-        bool loading;
-        do {
-            loading = false;
-            tTVPImageLoadCommand *cmd = nullptr;
+    cmd->sequence_ = NextSequence++;
+    Pending[bmp] = cmd;
 
-            { // Lock
-                tTJSCriticalSectionHolder cs(CommandQueueCS);
-                if(!CommandQueue.empty()) {
-                    cmd = CommandQueue.front();
-                    CommandQueue.pop();
-                }
-            }
-            if(cmd) {
-                loading = true;
-                LoadImageFromCommand(cmd);
-                { // Lock
-                    tTJSCriticalSectionHolder cs(ImageQueueCS);
-                    LoadedQueue.push(cmd);
-                }
-                // Send to message
-                SendToLoadFinish();
-            }
-        } while(loading && !GetTerminated());
-    }
+    // コア数に応じたワーカースレッドプールで並列にデコードする
+    std::shared_ptr<tLink> link = Link;
+    auto task = [link, cmd]() {
+        if(!cmd->cancelled_)
+            LoadImageFromCommand(cmd);
+        std::lock_guard<std::mutex> lk(link->Mutex);
+        if(link->Loader) // 終了処理中なら cmd は破棄しない
+            link->Loader->PushLoadedQueue(cmd);
+    };
+    // プールが停止済みならここでデコードする (後続の通知を止めないため)
+    if(!TVPGetWorkerThreadPool().Post(task, priority))
+        task();
 }
 tTVPGraphicHandlerType *TVPGuessGraphicLoadHandler(ttstr &name);
 void tTVPAsyncImageLoader::LoadImageFromCommand(tTVPImageLoadCommand *cmd) {
@@ -308,18 +292,48 @@ void tTVPAsyncImageLoader::LoadImageFromCommand(tTVPImageLoadCommand *cmd) {
     }
     if(handler) {
         try {
-            tTVPStreamHolder holder(name);
+            // デコード済み画像のディスクキャッシュがあればそれを使う
+            tTVPGraphicDiskCacheParams diskcacheparams;
+            diskcacheparams.KeyIdx = TVP_clNone;
+            tTVPBitmap *cached = nullptr;
+            if(TVPGraphicDiskCacheEnabled)
+                cached = TVPLoadGraphicDiskCache(name, diskcacheparams,
+                                                 &cmd->dest_->MetaInfo);
+            if(cached) {
+                if(cmd->dest_->bmp)
+                    cmd->dest_->bmp->Release();
+                cmd->dest_->bmp = cached;
+            } else {
+                tjs_uint64 starttime = TVPGetTickCount();
+                tTVPStreamHolder holder(name);
 #if defined(__APPLE__) || defined(__linux__) || defined(__ANDROID__)
-            TVPDecodeArena::Instance().Begin();
+                TVPDecodeArena::Instance().Begin();
 #endif
-            handler->Load(handler->FormatData, (void *)cmd->dest_,
-                          TVPLoadGraphicAsync_SizeCallback,
-                          TVPLoadGraphicAsync_ScanLineCallback,
-                          TVPLoadGraphicAsync_MetaInfoPushCallback,
-                          holder.Get(), -1, glmNormal);
+                handler->Load(handler->FormatData, (void *)cmd->dest_,
+                              TVPLoadGraphicAsync_SizeCallback,
+                              TVPLoadGraphicAsync_ScanLineCallback,
+                              TVPLoadGraphicAsync_MetaInfoPushCallback,
+                              holder.Get(), -1, glmNormal);
 #if defined(__APPLE__) || defined(__linux__) || defined(__ANDROID__)
-            TVPDecodeArena::Instance().End();
+                TVPDecodeArena::Instance().End();
 #endif
+                if(TVPGraphicDiskCacheEnabled &&
+                   TVPGetTickCount() - starttime >=
+                       TVPGraphicDiskCacheMinDecodeTime)
+                    TVPSaveGraphicDiskCache(name, diskcacheparams,
+                                            cmd->dest_->bmp,
+                                            cmd->dest_->MetaInfo);
+            }
+            // デコード完了時点でキャッシュへ直接格納する
+            // (非同期なので完了前に読み込まれている可能性あり)
+            if(cmd->dest_->bmp &&
+               !TVPHasImageCache(cmd->path_, glmNormal, 0, 0, TVP_clNone)) {
+                std::vector<tTVPGraphicMetaInfoPair> *meta = nullptr;
+                if(cmd->dest_->MetaInfo)
+                    meta = new std::vector<tTVPGraphicMetaInfoPair>(
+                        *cmd->dest_->MetaInfo);
+                TVPPushGraphicCache(cmd->path_, cmd->dest_->bmp, meta);
+            }
         } catch(...) {
 #if defined(__APPLE__) || defined(__linux__) || defined(__ANDROID__)
             TVPDecodeArena::Instance().End();
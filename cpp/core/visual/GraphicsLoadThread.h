@@ -2,7 +2,10 @@
 #ifndef __GRAPHICS_LOAD_THREAD_H__
 #define __GRAPHICS_LOAD_THREAD_H__
 
-#include <queue>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include "ThreadIntf.h"
 #include "NativeEventQueue.h"
@@ -24,31 +27,44 @@ struct tTVPImageLoadCommand {
     ttstr path_;
     tTVPTmpBitmapImage *dest_;
     ttstr result_;
+    tjs_uint64 sequence_; // request order; results are delivered in this order
+    std::atomic<bool> cancelled_; // the bitmap was invalidated
     tTVPImageLoadCommand();
     ~tTVPImageLoadCommand();
 };
 
-class tTVPAsyncImageLoader : public tTVPThread {
-    /** 読込み要求コマンドのキュー用CS */
-    tTJSCriticalSection CommandQueueCS;
+class tTVPAsyncImageLoader {
     /** 読込み済み画像キュー用CS */
     tTJSCriticalSection ImageQueueCS;
 
     /** ロード完了後メインスレッドで処理するためのメッセージキュー */
     NativeEventQueue<tTVPAsyncImageLoader> EventQueue;
-    /**  読込みスレッドへ読込み要求があったことを伝えるイベント */
-    tTVPThreadEvent PushCommandQueueEvent;
 
-    /** 読込み要求コマンドキュー */
-    std::queue<tTVPImageLoadCommand *> CommandQueue;
-    /** 読込み完了画像キュー */
-    std::queue<tTVPImageLoadCommand *> LoadedQueue;
+    /**
+     * デコードタスクからローダーへの参照
+     * ローダー破棄後に完了したタスクは結果を捨てる
+     */
+    struct tLink {
+        std::mutex Mutex;
+        tTVPAsyncImageLoader *Loader;
+    };
+    std::shared_ptr<tLink> Link;
+
+    /** 読込み完了画像キュー (要求順) */
+    std::map<tjs_uint64, tTVPImageLoadCommand *> LoadedQueue;
+    /** 次に通知する要求番号 (メインスレッドのみ) */
+    tjs_uint64 NextDeliver = 0;
+    /** 次に発行する要求番号 (メインスレッドのみ) */
+    tjs_uint64 NextSequence = 0;
+    /** 読込み中の要求 (メインスレッドのみ) */
+    std::map<tTJSNI_Bitmap *, tTVPImageLoadCommand *> Pending;
 
 private:
     /**
-     * 読込みスレッドからメインスレッドへ読込みが完了したことを通知する
+     * 読込み完了した画像をキューへ入れて、メインスレッドへ通知する
+     * (ワーカースレッド)
      */
-    void SendToLoadFinish();
+    void PushLoadedQueue(tTVPImageLoadCommand *cmd);
     /**
      * 読込み完了した画像をメインスレッドでBitmapへ格納して、イベント通知する
      */
@@ -56,27 +72,15 @@ private:
 
 public:
     /**
-     * 読込みを読込みスレッドに要求する(キューへ入れる)
+     * 読込みをワーカースレッドプールに要求する
      */
     void PushLoadQueue(iTJSDispatch2 *owner, tTJSNI_Bitmap *bmp,
-                       const ttstr &nname);
-
-    /**
-     * 読込みスレッド実体
-     * キューにコマンドが入るのを待ち、イベントが来たらキューからコマンドを取り出して読込み処理を実行
-     * 読込みが完了したら読込み済み画像キューに入れてメインスレッドへ完了を通知する
-     */
-    void LoadingThread();
+                       const ttstr &nname, tjs_int priority = 0);
 
     /**
-     * 画像読込み処理
+     * 画像読込み処理 (ワーカースレッド)
      */
-    void LoadImageFromCommand(tTVPImageLoadCommand *cmd);
-
-    /**
-     * 読込みスレッドメイン
-     */
-    void Execute() override;
+    static void LoadImageFromCommand(tTVPImageLoadCommand *cmd);
 
     /**
      * メインスレッドハンドラ
@@ -86,21 +90,28 @@ public:
 
 public:
     tTVPAsyncImageLoader();
-    ~tTVPAsyncImageLoader() override;
+    ~tTVPAsyncImageLoader();
 
     /**
-     読込みスレッドの終了を要求する(終了は待たない)
+     読込み中の要求をすべて取り消す(終了は待たない)
      */
     void ExitRequest();
 
     /**
      * 読込み要求
-     * メインスレッドから読込みスレッドへ読込みを要求する。
+     * メインスレッドからワーカースレッドプールへ読込みを要求する。
      * 読込み前にエラーが発生した場合やキャッシュ上に画像があった場合は要求は行われず
      * 即座に終了し、onLoaded イベントを発生させる。
+     * priority の高い要求から先にデコードされるが、onLoaded は要求順に通知される。
      */
     void LoadRequest(iTJSDispatch2 *owner, tTJSNI_Bitmap *bmp,
-                     const ttstr &name);
+                     const ttstr &name, tjs_int priority = 0);
+
+    /**
+     * 読込み要求の取り消し
+     * bmp が無効化された時に呼ばれる。未着手ならデコードせず、onLoaded も通知しない。
+     */
+    void CancelRequest(tTJSNI_Bitmap *bmp);
 };
 
 #endif // __GRAPHICS_LOAD_THREAD_H__
@@ -29,12 +29,17 @@
 #include "ScriptMgnIntf.h"
 #include "RenderManager.h"
 #include "ConfigManager/LocaleConfigManager.h"
+#include <atomic>
+#include <exception>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <condition_variable>
 #include "Application.h"
 #include "BitmapIntf.h"
 #include "GraphicsLoadThread.h"
+#include "GraphicDiskCache.h"
+#include "ThreadPool.h"
 #include <complex>
 #include <list>
 #include <spdlog/spdlog.h>
@@ -976,17 +981,42 @@ void TVPLoadHeaderBMP(void *formatdata, tTJSBinaryStream *src,
 //---------------------------------------------------------------------------
 // TVPLoadGraphic related
 //---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// scaled decoding hint
+//---------------------------------------------------------------------------
+static thread_local tTVPGraphicScaleHint TVPGraphicScaleHint;
+//---------------------------------------------------------------------------
+tTVPGraphicScaleHint TVPGetGraphicScaleHint() { return TVPGraphicScaleHint; }
+//---------------------------------------------------------------------------
+void TVPSetGraphicScaleHint(const tTVPGraphicScaleHint &hint) {
+    TVPGraphicScaleHint = hint;
+}
+//---------------------------------------------------------------------------
+tjs_uint TVPGetGraphicScaleDenom(tjs_uint w, tjs_uint h, tjs_uint maxdenom) {
+    const tTVPGraphicScaleHint &hint = TVPGraphicScaleHint;
+    if(!hint.MaxW && !hint.MaxH)
+        return 1;
+    tjs_uint denom = 1;
+    while(denom * 2 <= maxdenom) {
+        tjs_uint next = denom * 2;
+        // reduced sizes are rounded up, as libjpeg does
+        if((w + next - 1) / next < hint.MaxW || (h + next - 1) / next < hint.MaxH)
+            break;
+        denom = next;
+    }
+    return denom;
+}
+//---------------------------------------------------------------------------
 enum tTVPLoadGraphicType {
     lgtFullColor, // full 32bit color
-    lgtPalGray, // palettized or grayscale
-    lgtMask // mask
+    lgtPalGray // palettized or grayscale
 };
+class tTVPLoadGraphicMask;
 struct tTVPLoadGraphicData {
     ttstr Name;
     tTVPBitmap *Dest;
     tTVPLoadGraphicType Type;
     tjs_int ColorKey;
-    tjs_uint8 *Buffer;
     tjs_uint ScanLineNum;
     tjs_uint DesW;
     tjs_uint DesH;
@@ -996,6 +1026,63 @@ struct tTVPLoadGraphicData {
     tjs_uint BufH;
     bool NeedMetaInfo;
     std::vector<tTVPGraphicMetaInfoPair> *MetaInfo;
+    // separate mask bound to each full color line as it is written
+    tTVPLoadGraphicMask *Mask = nullptr;
+};
+//---------------------------------------------------------------------------
+// tTVPLoadGraphicMask
+//---------------------------------------------------------------------------
+/*
+        decodes a separate mask file ( _m ) on a worker thread while the
+        main image is decoded by the caller. each main line is bound to the
+        mask as soon as both lines are available, so the main image is
+        written once; lines whose mask was not ready yet are bound by
+        Finish(). when no worker has picked up the mask by the time the
+        main image is done, the caller decodes it itself.
+*/
+class tTVPLoadGraphicMask {
+    struct tState {
+        tTVPGraphicHandlerType *Handler = nullptr;
+        ttstr Name; // opened on the decoding thread when Stream is null
+        tTJSBinaryStream *Stream = nullptr;
+        tTVPLoadGraphicData Data;
+        std::atomic<tTVPBitmap *> Dest{ nullptr }; // published mask bitmap
+        std::unique_ptr<std::atomic<bool>[]> Ready; // per mask line
+        std::atomic<bool> Claimed{ false };
+        std::mutex Mutex;
+        std::condition_variable Cond;
+        bool Done = false;
+        std::exception_ptr Error;
+
+        ~tState() {
+            if(Data.Dest)
+                Data.Dest->Release();
+        }
+
+        void Run();
+    };
+
+    std::shared_ptr<tState> State;
+    std::vector<bool> Bound; // main lines already bound; caller only
+
+    static int SizeCallback(void *callbackdata, tjs_uint w, tjs_uint h,
+                            tTVPGraphicPixelFormat fmt);
+    static void *ScanLineCallback(void *callbackdata, tjs_int y);
+
+    void Wait(bool run);
+
+public:
+    tTVPLoadGraphicMask(tTVPGraphicHandlerType *handler, const ttstr &name,
+                        tTJSBinaryStream *stream, tjs_uint desw,
+                        tjs_uint desh);
+    ~tTVPLoadGraphicMask();
+
+    // main line y is about to be (re)written
+    void Unbind(tjs_uint y);
+    // main line y and its vertical tiles ( every orgh lines ) are written
+    void Bind(tTVPBitmap *dest, tjs_uint y, tjs_uint orgh);
+    // waits for the mask and binds the remaining lines
+    void Finish(tTVPBitmap *dest);
 };
 //---------------------------------------------------------------------------
 static int TVPLoadGraphic_SizeCallback(void *callbackdata, tjs_uint w,
@@ -1013,42 +1100,26 @@ static int TVPLoadGraphic_SizeCallback(void *callbackdata, tjs_uint w,
     data->BufH = h;
 
     // create buffer
-    if(data->Type == lgtMask) {
-        // mask ( _m ) load
-
-        // check the image previously loaded
-        if(data->Dest->GetWidth() != w || data->Dest->GetHeight() != h)
-            TVPThrowExceptionMessage(TVPMaskSizeMismatch);
-
-        // allocate line buffer
-        data->Buffer = new tjs_uint8[w];
-        data->Dest->IsOpaque = false;
-        return w;
-    } else {
-        // normal load or province load
-        if(!data->Dest) {
-            data->Dest =
-                new tTVPBitmap(w, h, data->Type == lgtFullColor ? 32 : 8);
-        } else if(data->Dest->GetWidth() != w || data->Dest->GetHeight() != h) {
-            data->Dest->Release();
-            data->Dest =
-                new tTVPBitmap(w, h, data->Type == lgtFullColor ? 32 : 8);
-        }
-        switch(fmt) {
-            case gpfLuminance:
-            case gpfRGB:
-                data->Dest->IsOpaque = true;
-                break;
-            case gpfPalette:
-            case gpfRGBA:
-                data->Dest->IsOpaque = false;
-                break;
-        }
+    if(!data->Dest) {
+        data->Dest = new tTVPBitmap(w, h, data->Type == lgtFullColor ? 32 : 8);
+    } else if(data->Dest->GetWidth() != w || data->Dest->GetHeight() != h) {
+        data->Dest->Release();
+        data->Dest = new tTVPBitmap(w, h, data->Type == lgtFullColor ? 32 : 8);
+    }
+    switch(fmt) {
+        case gpfLuminance:
+        case gpfRGB:
+            data->Dest->IsOpaque = true;
+            break;
+        case gpfPalette:
+        case gpfRGBA:
+            data->Dest->IsOpaque = false;
+            break;
+    }
 #if 0
-		data->Dest->Recreate(w, h, data->Type!=lgtFullColor?8:32);
+	data->Dest->Recreate(w, h, data->Type!=lgtFullColor?8:32);
 #endif
-        return data->Dest->GetPitch();
-    }
+    return data->Dest->GetPitch();
 }
 //---------------------------------------------------------------------------
 static void *TVPLoadGraphic_ScanLineCallback(void *callbackdata, tjs_int y) {
@@ -1058,35 +1129,14 @@ static void *TVPLoadGraphic_ScanLineCallback(void *callbackdata, tjs_int y) {
         // query of line buffer
 
         data->ScanLineNum = y;
-        if(data->Type == lgtMask) {
-            // mask
-            return data->Buffer;
-        } else {
-            // return the scanline for writing
-            return data->Dest->GetScanLine(y);
-        }
+        if(data->Mask)
+            data->Mask->Unbind(y);
+        // return the scanline for writing
+        return data->Dest->GetScanLine(y);
     } else {
         // y==-1 indicates the buffer previously returned was written
 
-        if(data->Type == lgtMask) {
-            // mask
-
-            // tile for horizontal direction
-            tjs_uint i;
-            for(i = data->OrgW; i < data->BufW; i += data->OrgW) {
-                tjs_uint w = data->BufW - i;
-                w = w > data->OrgW ? data->OrgW : w;
-                memcpy(data->Buffer + i, data->Buffer, w);
-            }
-
-            // bind mask buffer to main image buffer ( and tile for
-            // vertical )
-            for(i = data->ScanLineNum; i < data->BufH; i += data->OrgH) {
-                TVPBindMaskToMain((tjs_uint32 *)data->Dest->GetScanLine(i),
-                                  data->Buffer, data->BufW);
-            }
-            return nullptr;
-        } else if(data->Type == lgtFullColor) {
+        if(data->Type == lgtFullColor) {
             tjs_uint32 *sl =
                 (tjs_uint32 *)data->Dest->GetScanLine(data->ScanLineNum);
             if((data->ColorKey & 0xff000000) == 0x00000000) {
@@ -1109,6 +1159,10 @@ static void *TVPLoadGraphic_ScanLineCallback(void *callbackdata, tjs_int y) {
                        data->BufW * sizeof(tjs_uint32));
             }
 
+            // bind the mask while the line is still hot
+            if(data->Mask)
+                data->Mask->Bind(data->Dest, data->ScanLineNum, data->OrgH);
+
             return nullptr;
         } else if(data->Type == lgtPalGray) {
             // nothing to do
@@ -1150,6 +1204,145 @@ static void TVPLoadGraphic_MetaInfoPushCallback(void *callbackdata,
     }
 }
 //---------------------------------------------------------------------------
+// tTVPLoadGraphicMask
+//---------------------------------------------------------------------------
+tTVPLoadGraphicMask::tTVPLoadGraphicMask(tTVPGraphicHandlerType *handler,
+                                         const ttstr &name,
+                                         tTJSBinaryStream *stream,
+                                         tjs_uint desw, tjs_uint desh) :
+    State(std::make_shared<tState>()) {
+    State->Handler = handler;
+    State->Name = name;
+    State->Stream = stream;
+
+    tTVPLoadGraphicData &data = State->Data;
+    data.Dest = nullptr;
+    data.ColorKey = -1;
+    data.Type = lgtPalGray;
+    data.Name = name;
+    data.DesW = desw;
+    data.DesH = desh;
+    data.NeedMetaInfo = false;
+    data.MetaInfo = nullptr;
+
+    std::shared_ptr<tState> state = State;
+    TVPGetWorkerThreadPool().Post([state]() {
+        if(!state->Claimed.exchange(true))
+            state->Run();
+    });
+}
+//---------------------------------------------------------------------------
+tTVPLoadGraphicMask::~tTVPLoadGraphicMask() {
+    // the main image failed; a mask nobody started is not needed anymore
+    Wait(false);
+}
+//---------------------------------------------------------------------------
+void tTVPLoadGraphicMask::tState::Run() {
+    try {
+        if(Stream) {
+            Handler->Load(Handler->FormatData, (void *)this, SizeCallback,
+                          ScanLineCallback, nullptr, Stream, -1,
+                          glmGrayscale);
+        } else {
+            tTVPStreamHolder holder(Name);
+            Handler->Load(Handler->FormatData, (void *)this, SizeCallback,
+                          ScanLineCallback, nullptr, holder.Get(), -1,
+                          glmGrayscale);
+        }
+    } catch(...) {
+        Error = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lk(Mutex);
+    Done = true;
+    Cond.notify_all();
+}
+//---------------------------------------------------------------------------
+int tTVPLoadGraphicMask::SizeCallback(void *callbackdata, tjs_uint w,
+                                      tjs_uint h, tTVPGraphicPixelFormat fmt) {
+    auto *state = (tState *)callbackdata;
+
+    // the bitmap may already be read by the main thread; never recreate it
+    if(state->Data.Dest)
+        TVPThrowExceptionMessage(TVPMaskSizeMismatch);
+
+    int pitch = TVPLoadGraphic_SizeCallback(&state->Data, w, h, fmt);
+    tjs_uint height = state->Data.BufH;
+    state->Ready.reset(new std::atomic<bool>[height]);
+    for(tjs_uint i = 0; i < height; i++)
+        state->Ready[i].store(false, std::memory_order_relaxed);
+    state->Dest.store(state->Data.Dest, std::memory_order_release);
+    return pitch;
+}
+//---------------------------------------------------------------------------
+void *tTVPLoadGraphicMask::ScanLineCallback(void *callbackdata, tjs_int y) {
+    auto *state = (tState *)callbackdata;
+    tTVPLoadGraphicData &data = state->Data;
+
+    void *ret = TVPLoadGraphic_ScanLineCallback(&data, y);
+    if(y < 0) {
+        // the line and its vertical tiles are complete
+        for(tjs_uint i = data.ScanLineNum; i < data.BufH; i += data.OrgH)
+            state->Ready[i].store(true, std::memory_order_release);
+    }
+    return ret;
+}
+//---------------------------------------------------------------------------
+void tTVPLoadGraphicMask::Wait(bool run) {
+    if(!State->Claimed.exchange(true)) {
+        if(run)
+            State->Run();
+        return;
+    }
+    std::unique_lock<std::mutex> lk(State->Mutex);
+    State->Cond.wait(lk, [this]() { return State->Done; });
+}
+//---------------------------------------------------------------------------
+void tTVPLoadGraphicMask::Unbind(tjs_uint y) {
+    if(y < Bound.size())
+        Bound[y] = false;
+}
+//---------------------------------------------------------------------------
+void tTVPLoadGraphicMask::Bind(tTVPBitmap *dest, tjs_uint y, tjs_uint orgh) {
+    tTVPBitmap *mask = State->Dest.load(std::memory_order_acquire);
+    tjs_uint w = dest->GetWidth(), h = dest->GetHeight();
+    if(!mask || mask->GetWidth() != w || mask->GetHeight() != h)
+        return; // not ready yet, or mismatched ( reported by Finish )
+    if(Bound.size() != h)
+        Bound.assign(h, false);
+
+    for(tjs_uint i = y; i < h; i += orgh) {
+        if(State->Ready[i].load(std::memory_order_acquire)) {
+            TVPBindMaskToMain((tjs_uint32 *)dest->GetScanLine(i),
+                              (const tjs_uint8 *)mask->GetScanLine(i), w);
+            Bound[i] = true;
+        } else {
+            Bound[i] = false;
+        }
+    }
+}
+//---------------------------------------------------------------------------
+void tTVPLoadGraphicMask::Finish(tTVPBitmap *dest) {
+    Wait(true);
+    if(State->Error)
+        std::rethrow_exception(State->Error);
+
+    tTVPBitmap *mask = State->Data.Dest;
+    if(!mask)
+        return;
+    tjs_uint w = dest->GetWidth(), h = dest->GetHeight();
+    if(mask->GetWidth() != w || mask->GetHeight() != h)
+        TVPThrowExceptionMessage(TVPMaskSizeMismatch);
+    if(Bound.size() != h)
+        Bound.assign(h, false);
+
+    for(tjs_uint i = 0; i < h; i++) {
+        if(!Bound[i])
+            TVPBindMaskToMain((tjs_uint32 *)dest->GetScanLine(i),
+                              (const tjs_uint8 *)mask->GetScanLine(i), w);
+    }
+    dest->IsOpaque = false;
+}
+//---------------------------------------------------------------------------
 // static int _USERENTRY TVPColorCompareFunc(const void *_a, const
 // void *_b)
 static int TVPColorCompareFunc(const void *_a, const void *_b) {
@@ -1281,10 +1474,13 @@ struct tTVPGraphicsSearchData {
     tTVPGraphicLoadMode Mode; // image mode
     tjs_uint DesW; // desired width ( 0 for original size )
     tjs_uint DesH; // desired height ( 0 for original size )
+    tjs_uint MaxW = 0; // scaled decode width ( 0 for original size )
+    tjs_uint MaxH = 0; // scaled decode height ( 0 for original size )
 
     bool operator==(const tTVPGraphicsSearchData &rhs) const {
         return KeyIdx == rhs.KeyIdx && Mode == rhs.Mode && Name == rhs.Name &&
-            DesW == rhs.DesW && DesH == rhs.DesH;
+            DesW == rhs.DesW && DesH == rhs.DesH && MaxW == rhs.MaxW &&
+            MaxH == rhs.MaxH;
     }
 };
 //---------------------------------------------------------------------------
@@ -1297,6 +1493,7 @@ public:
         v ^= (val.Mode << 30);
         v ^= val.DesW + (val.DesW >> 8);
         v ^= val.DesH + (val.DesH >> 8);
+        v ^= (val.MaxW << 16) ^ val.MaxH;
         return v;
     }
 };
@@ -1315,8 +1512,11 @@ public:
 
     std::vector<tTVPGraphicMetaInfoPair> *MetaInfo;
 
+    // last access stamp of the cache entry; guarded by the shard lock
+    tjs_uint64 LastUse = 0;
+
 private:
-    tjs_int RefCount;
+    std::atomic<tjs_int> RefCount;
     tjs_uint Size;
 
 public:
@@ -1437,47 +1637,169 @@ public:
 
     void AddRef() { RefCount++; }
     void Release() {
-        if(RefCount == 1) {
+        if(--RefCount == 0)
             delete this;
-        } else {
-            RefCount--;
-        }
     }
 };
 //---------------------------------------------------------------------------
 typedef tTJSRefHolder<tTVPGraphicImageData> tTVPGraphicImageHolder;
 
-typedef tTJSHashTable<tTVPGraphicsSearchData, tTVPGraphicImageHolder,
-                      tTVPGraphicsSearchHashFunc>
-    tTVPGraphicCache;
-tTVPGraphicCache TVPGraphicCache;
-static bool TVPGraphicCacheEnabled = false;
-static tjs_uint64 TVPGraphicCacheLimit = 0;
-static tjs_uint64 TVPGraphicCacheTotalBytes = 0;
-tjs_uint64 TVPGraphicCacheSystemLimit =
-    0; // maximum possible value of  TVPGraphicCacheLimit
 //---------------------------------------------------------------------------
-tjs_uint64 TVPGetGraphicCacheTotalBytes() { return TVPGraphicCacheTotalBytes; }
+// tTVPGraphicImageRef : a reference returned by tTVPGraphicCache::Find
 //---------------------------------------------------------------------------
-static void TVPCheckGraphicCacheLimit() {
-    while(TVPGraphicCacheTotalBytes > TVPGraphicCacheLimit) {
-        // chop last graphics
-        tTVPGraphicCache::tIterator i;
-        i = TVPGraphicCache.GetLast();
-        if(!i.IsNull()) {
+class tTVPGraphicImageRef {
+    tTVPGraphicImageData *Data;
+
+public:
+    explicit tTVPGraphicImageRef(tTVPGraphicImageData *data) : Data(data) {}
+    tTVPGraphicImageRef(tTVPGraphicImageRef &&ref) noexcept : Data(ref.Data) {
+        ref.Data = nullptr;
+    }
+    tTVPGraphicImageRef(const tTVPGraphicImageRef &) = delete;
+    ~tTVPGraphicImageRef() {
+        if(Data)
+            Data->Release();
+    }
+
+    tTVPGraphicImageData *operator->() const { return Data; }
+    explicit operator bool() const { return Data != nullptr; }
+};
+
+//---------------------------------------------------------------------------
+// tTVPGraphicCache : decoded images
+//---------------------------------------------------------------------------
+/*
+        the cache is used by the main thread and by the decode workers,
+        which publish their results directly. it is split into shards by
+        the key hash; each shard has its own lock, LRU order and byte count,
+        and a lookup holds one shard lock only for the hash search.
+        eviction takes the shard tail with the oldest access stamp, which
+        keeps the order close to a global LRU.
+*/
+class tTVPGraphicCache {
+    typedef tTJSHashTable<tTVPGraphicsSearchData, tTVPGraphicImageHolder,
+                          tTVPGraphicsSearchHashFunc>
+        tTable;
+
+    static const tjs_uint ShardCount = 16;
+
+    struct tShard {
+        std::mutex Mutex;
+        tTable Table;
+        tjs_uint64 Bytes = 0;
+    } Shards[ShardCount];
+
+    std::atomic<tjs_uint64> TotalBytes{ 0 };
+    std::atomic<tjs_uint64> Clock{ 0 };
+
+    tShard &GetShard(tjs_uint32 hash) {
+        return Shards[(hash >> 8) % ShardCount];
+    }
+
+public:
+    static tjs_uint32 MakeHash(const tTVPGraphicsSearchData &key) {
+        return tTable::MakeHash(key);
+    }
+
+    // returns the cached image and makes it most recently used
+    tTVPGraphicImageRef Find(const tTVPGraphicsSearchData &key,
+                             tjs_uint32 hash) {
+        tShard &shard = GetShard(hash);
+        std::lock_guard<std::mutex> lk(shard.Mutex);
+        tTVPGraphicImageHolder *ptr =
+            shard.Table.FindAndTouchWithHash(key, hash);
+        if(!ptr)
+            return tTVPGraphicImageRef(nullptr);
+        ptr->GetObjectNoAddRef()->LastUse = ++Clock;
+        return tTVPGraphicImageRef(ptr->GetObject());
+    }
+
+    // same as Find but does not take a reference
+    bool Touch(const tTVPGraphicsSearchData &key, tjs_uint32 hash) {
+        tShard &shard = GetShard(hash);
+        std::lock_guard<std::mutex> lk(shard.Mutex);
+        tTVPGraphicImageHolder *ptr =
+            shard.Table.FindAndTouchWithHash(key, hash);
+        if(!ptr)
+            return false;
+        ptr->GetObjectNoAddRef()->LastUse = ++Clock;
+        return true;
+    }
+
+    void Add(const tTVPGraphicsSearchData &key, tjs_uint32 hash,
+             tTVPGraphicImageData *data) {
+        tShard &shard = GetShard(hash);
+        std::lock_guard<std::mutex> lk(shard.Mutex);
+        tTVPGraphicImageHolder *ptr = shard.Table.FindWithHash(key, hash);
+        if(ptr) {
+            // replaced; another thread loaded the same image meanwhile
+            tjs_uint old = ptr->GetObjectNoAddRef()->GetSize();
+            shard.Bytes -= old;
+            TotalBytes -= old;
+        }
+        data->LastUse = ++Clock;
+        shard.Table.AddWithHash(key, hash, tTVPGraphicImageHolder(data));
+        shard.Bytes += data->GetSize();
+        TotalBytes += data->GetSize();
+    }
+
+    // evicts least recently used images until the total fits in 'limit'
+    void Trim(tjs_uint64 limit) {
+        while(TotalBytes > limit) {
+            // find the shard whose tail is the oldest
+            tShard *victim = nullptr;
+            tjs_uint64 oldest = 0;
+            for(tShard &shard : Shards) {
+                std::lock_guard<std::mutex> lk(shard.Mutex);
+                tTable::tIterator i = shard.Table.GetLast();
+                if(i.IsNull())
+                    continue;
+                tjs_uint64 stamp = i.GetValue().GetObjectNoAddRef()->LastUse;
+                if(!victim || stamp < oldest) {
+                    victim = &shard;
+                    oldest = stamp;
+                }
+            }
+            if(!victim)
+                break;
+
+            std::lock_guard<std::mutex> lk(victim->Mutex);
+            tTable::tIterator i = victim->Table.GetLast();
+            if(i.IsNull())
+                continue; // emptied meanwhile
             tjs_uint size = i.GetValue().GetObjectNoAddRef()->GetSize();
-            TVPGraphicCacheTotalBytes -= size;
-            TVPGraphicCache.ChopLast(1);
-        } else {
-            break;
+            victim->Bytes -= size;
+            TotalBytes -= size;
+            victim->Table.ChopLast(1);
+        }
+    }
+
+    void Clear() {
+        for(tShard &shard : Shards) {
+            std::lock_guard<std::mutex> lk(shard.Mutex);
+            shard.Table.Clear();
+            TotalBytes -= shard.Bytes;
+            shard.Bytes = 0;
         }
     }
+
+    [[nodiscard]] tjs_uint64 GetTotalBytes() const { return TotalBytes; }
+};
+static tTVPGraphicCache TVPGraphicCache;
+static std::atomic<bool> TVPGraphicCacheEnabled{ false };
+static std::atomic<tjs_uint64> TVPGraphicCacheLimit{ 0 };
+tjs_uint64 TVPGraphicCacheSystemLimit =
+    0; // maximum possible value of  TVPGraphicCacheLimit
+//---------------------------------------------------------------------------
+tjs_uint64 TVPGetGraphicCacheTotalBytes() {
+    return TVPGraphicCache.GetTotalBytes();
 }
 //---------------------------------------------------------------------------
-void TVPClearGraphicCache() {
-    TVPGraphicCache.Clear();
-    TVPGraphicCacheTotalBytes = 0;
+static void TVPCheckGraphicCacheLimit() {
+    TVPGraphicCache.Trim(TVPGraphicCacheLimit);
 }
+//---------------------------------------------------------------------------
+void TVPClearGraphicCache() { TVPGraphicCache.Clear(); }
 static tTVPAtExit TVPUninitMessageLoad(TVP_ATEXIT_PRI_RELEASE,
                                        TVPClearGraphicCache);
 //---------------------------------------------------------------------------
@@ -1488,17 +1810,19 @@ struct tTVPClearGraphicCacheCallback : public tTVPCompactEventCallbackIntf {
         }
     }
 } static TVPClearGraphicCacheCallback;
-static bool TVPClearGraphicCacheCallbackInit = false;
+static std::once_flag TVPClearGraphicCacheCallbackInit;
+static void TVPInitClearGraphicCacheCallback() {
+    // graphic compact initialization; decode workers reach this too
+    std::call_once(TVPClearGraphicCacheCallbackInit, [] {
+        TVPAddCompactEventHook(&TVPClearGraphicCacheCallback);
+    });
+}
 //---------------------------------------------------------------------------
+// may be called from decode worker threads. the compact hook is registered
+// by TVPSetGraphicCacheLimit, which is the only way to enable the cache.
 void TVPPushGraphicCache(const ttstr &nname, tTVPBitmap *bmp,
                          std::vector<tTVPGraphicMetaInfoPair> *meta) {
     if(TVPGraphicCacheEnabled) {
-        // graphic compact initialization
-        if(!TVPClearGraphicCacheCallbackInit) {
-            TVPAddCompactEventHook(&TVPClearGraphicCacheCallback);
-            TVPClearGraphicCacheCallbackInit = true;
-        }
-
         tTVPGraphicImageData *data = nullptr;
         try {
             tjs_uint32 hash;
@@ -1519,10 +1843,7 @@ void TVPPushGraphicCache(const ttstr &nname, tTVPBitmap *bmp,
             meta = nullptr;
 
             // push into hash table
-            tjs_uint datasize = data->GetSize();
-            TVPGraphicCacheTotalBytes += datasize;
-            tTVPGraphicImageHolder holder(data);
-            TVPGraphicCache.AddWithHash(searchdata, hash, holder);
+            TVPGraphicCache.Add(searchdata, hash, data);
 
             // check size limit after adding new entry
             TVPCheckGraphicCacheLimit();
@@ -1555,14 +1876,12 @@ bool TVPCheckImageCache(const ttstr &nname, tTVPBaseBitmap *dest,
 
         hash = tTVPGraphicCache::MakeHash(searchdata);
 
-        tTVPGraphicImageHolder *ptr =
-            TVPGraphicCache.FindAndTouchWithHash(searchdata, hash);
+        tTVPGraphicImageRef ptr = TVPGraphicCache.Find(searchdata, hash);
         if(ptr) {
             // found in cache
-            ptr->GetObjectNoAddRef()->AssignToBitmap(dest);
+            ptr->AssignToBitmap(dest);
             if(metainfo)
-                *metainfo = TVPMetaInfoPairsToDictionary(
-                    ptr->GetObjectNoAddRef()->MetaInfo);
+                *metainfo = TVPMetaInfoPairsToDictionary(ptr->MetaInfo);
             return true;
         }
     }
@@ -1583,9 +1902,7 @@ bool TVPHasImageCache(const ttstr &nname, tTVPGraphicLoadMode mode, tjs_uint dw,
 
         hash = tTVPGraphicCache::MakeHash(searchdata);
 
-        tTVPGraphicImageHolder *ptr =
-            TVPGraphicCache.FindAndTouchWithHash(searchdata, hash);
-        if(ptr) {
+        if(TVPGraphicCache.Touch(searchdata, hash)) {
             return true;
         }
     }
@@ -1595,10 +1912,7 @@ bool TVPHasImageCache(const ttstr &nname, tTVPGraphicLoadMode mode, tjs_uint dw,
 tTVPGraphicHandlerType *TVPFindGraphicLoadHandler(ttstr &_name, ttstr *maskname,
                                                   ttstr *provincename) {
     // graphic compact initialization
-    if(!TVPClearGraphicCacheCallbackInit) {
-        TVPAddCompactEventHook(&TVPClearGraphicCacheCallback);
-        TVPClearGraphicCacheCallbackInit = true;
-    }
+    TVPInitClearGraphicCacheCallback();
 
     // search according with its extension
     tjs_int namelen = _name.GetLen();
@@ -1720,6 +2034,34 @@ TVPInternalLoadBitmap(const ttstr &_name, tjs_uint32 keyidx, tjs_uint desw,
     ttstr name(_name), maskname;
     tTVPGraphicHandlerType *handler = TVPFindGraphicLoadHandler(
         name, &maskname, mode == glmNormal ? provincename : nullptr);
+
+    // a separate mask must match the main image size, which is not
+    // guaranteed when the two formats scale differently. color keys are
+    // applied to the decoded pixels, which a reduced decode has blended.
+    tTVPGraphicScaleHint hint = TVPGetGraphicScaleHint();
+    if(mode != glmNormal || !maskname.IsEmpty() ||
+       (keyidx != TVP_clNone && !TVP_Is_clAlphaMat(keyidx)))
+        hint = tTVPGraphicScaleHint();
+    tTVPGraphicScaleHintHolder hintholder(hint.MaxW, hint.MaxH);
+
+    // try the decoded graphic disk cache; images combined with a separate
+    // mask file are not cached since the mask is not part of the key
+    bool diskcache = TVPGraphicDiskCacheEnabled && mode == glmNormal &&
+        maskname.IsEmpty();
+    tTVPGraphicDiskCacheParams diskcacheparams;
+    if(diskcache) {
+        diskcacheparams.KeyIdx = keyidx;
+        diskcacheparams.DesW = desw;
+        diskcacheparams.DesH = desh;
+        diskcacheparams.MaxW = hint.MaxW;
+        diskcacheparams.MaxH = hint.MaxH;
+        tTVPBitmap *cached =
+            TVPLoadGraphicDiskCache(name, diskcacheparams, MetaInfo);
+        if(cached)
+            return cached;
+    }
+    tjs_uint64 starttime = diskcache ? TVPGetTickCount() : 0;
+
     tTVPStreamHolder holder(name); // open a storage named "name"
 
     // load the image
@@ -1737,6 +2079,20 @@ TVPInternalLoadBitmap(const ttstr &_name, tjs_uint32 keyidx, tjs_uint desw,
     bool doalphacolormat = TVP_Is_clAlphaMat(keyidx);
     tjs_uint32 alphamatcolor = TVP_get_clAlphaMat(keyidx);
 
+    // decode the mask concurrently with the main image. the adaptive
+    // color key must see the main image before the mask is bound.
+    std::unique_ptr<tTVPLoadGraphicMask> mask;
+    if(mode == glmNormal && !maskname.IsEmpty()) {
+        tTVPGraphicHandlerType *maskhandler =
+            TVPFindGraphicLoadHandler(maskname, nullptr, nullptr);
+        if(maskhandler) {
+            mask = std::make_unique<tTVPLoadGraphicMask>(
+                maskhandler, maskname, nullptr, desw, desh);
+            if(!keyadapt)
+                data.Mask = mask.get();
+        }
+    }
+
     if(TVP_Is_clPalIdx(keyidx)) {
         // pass the palette index number to the handler.
         // ( since only Graphic Loading Handler can process the
@@ -1762,35 +2118,14 @@ TVPInternalLoadBitmap(const ttstr &_name, tjs_uint32 keyidx, tjs_uint desw,
     if(mode != glmNormal)
         return data.Dest;
 
-    if(!maskname.IsEmpty() &&
-       (handler = TVPFindGraphicLoadHandler(maskname, nullptr, nullptr))) {
-        // open the mask file
-        holder.Open(maskname);
-
-        // fill "data"'s member
-        data.Type = lgtMask;
-        //	    data.Name = name;
-        data.Buffer = nullptr;
-        data.DesW = desw;
-        data.DesH = desh;
-        data.NeedMetaInfo = false;
-
+    if(mask) {
         try {
-            // load image via handler
-            handler->Load(handler->FormatData, (void *)&data,
-                          TVPLoadGraphic_SizeCallback,
-                          TVPLoadGraphic_ScanLineCallback, nullptr,
-                          holder.Get(), -1, glmGrayscale);
+            mask->Finish(data.Dest);
         } catch(...) {
-            if(data.Buffer)
-                delete[] data.Buffer;
             if(data.Dest)
                 data.Dest->Release();
             throw;
         }
-
-        if(data.Buffer)
-            delete[] data.Buffer;
     }
 
     // do color matting
@@ -1799,6 +2134,10 @@ TVPInternalLoadBitmap(const ttstr &_name, tjs_uint32 keyidx, tjs_uint desw,
         TVPDoAlphaColorMat(data.Dest, alphamatcolor);
     }
 
+    if(diskcache &&
+       TVPGetTickCount() - starttime >= TVPGraphicDiskCacheMinDecodeTime)
+        TVPSaveGraphicDiskCache(name, diskcacheparams, data.Dest, *MetaInfo);
+
     return data.Dest;
 }
 //---------------------------------------------------------------------------
@@ -1839,11 +2178,10 @@ void TVPLoadGraphicProvince(tTVPBaseBitmap *dest, const ttstr &name,
 
         hash = tTVPGraphicCache::MakeHash(searchdata);
 
-        tTVPGraphicImageHolder *ptr =
-            TVPGraphicCache.FindAndTouchWithHash(searchdata, hash);
+        tTVPGraphicImageRef ptr = TVPGraphicCache.Find(searchdata, hash);
         if(ptr) {
             // found in cache
-            ptr->GetObjectNoAddRef()->AssignToBitmap(dest);
+            ptr->AssignToBitmap(dest);
             return;
         }
     }
@@ -1869,13 +2207,7 @@ void TVPLoadGraphicProvince(tTVPBaseBitmap *dest, const ttstr &name,
             TVPCheckGraphicCacheLimit();
 
             // push into hash table
-            tjs_uint datasize = data->GetSize();
-            //			if(datasize < TVPGraphicCacheLimit)
-            //			{
-            TVPGraphicCacheTotalBytes += datasize;
-            tTVPGraphicImageHolder holder(data);
-            TVPGraphicCache.AddWithHash(searchdata, hash, holder);
-            //			}
+            TVPGraphicCache.Add(searchdata, hash, data);
         }
         bmp->Release();
     } catch(...) {
@@ -1897,7 +2229,8 @@ void TVPLoadGraphicProvince(tTVPBaseBitmap *dest, const ttstr &name,
 //---------------------------------------------------------------------------
 int TVPLoadGraphic(iTVPBaseBitmap *dest, const ttstr &name, tjs_int32 keyidx,
                    tjs_uint desw, tjs_uint desh, tTVPGraphicLoadMode mode,
-                   ttstr *provincename, iTJSDispatch2 **metainfo) {
+                   ttstr *provincename, iTJSDispatch2 **metainfo,
+                   tjs_uint maxw, tjs_uint maxh) {
     // loading with cache management
     ttstr nname = TVPNormalizeStorageName(name);
     tjs_uint32 hash;
@@ -1909,21 +2242,21 @@ int TVPLoadGraphic(iTVPBaseBitmap *dest, const ttstr &name, tjs_int32 keyidx,
         searchdata.Mode = mode;
         searchdata.DesW = desw;
         searchdata.DesH = desh;
+        searchdata.MaxW = maxw;
+        searchdata.MaxH = maxh;
 
         hash = tTVPGraphicCache::MakeHash(searchdata);
 
-        tTVPGraphicImageHolder *ptr =
-            TVPGraphicCache.FindAndTouchWithHash(searchdata, hash);
+        tTVPGraphicImageRef ptr = TVPGraphicCache.Find(searchdata, hash);
         if(ptr) {
             // found in cache
             if(dest)
-                ptr->GetObjectNoAddRef()->AssignToTexture(dest);
+                ptr->AssignToTexture(dest);
             if(provincename)
-                *provincename = ptr->GetObjectNoAddRef()->ProvinceName;
+                *provincename = ptr->ProvinceName;
             if(metainfo)
-                *metainfo = TVPMetaInfoPairsToDictionary(
-                    ptr->GetObjectNoAddRef()->MetaInfo);
-            return ptr->GetObjectNoAddRef()->GetSize();
+                *metainfo = TVPMetaInfoPairsToDictionary(ptr->MetaInfo);
+            return ptr->GetSize();
         }
     }
 
@@ -1957,10 +2290,12 @@ int TVPLoadGraphic(iTVPBaseBitmap *dest, const ttstr &name, tjs_int32 keyidx,
 #if defined(__APPLE__) || defined(__linux__) || defined(__ANDROID__)
             TVPDecodeArena::Instance().Begin();
 #endif
-            if(mode == glmNormal && keyidx == TVP_clNone && !desw && !desh) {
+            if(mode == glmNormal && keyidx == TVP_clNone && !desw && !desh &&
+               !maxw && !maxh) {
                 texture = TVPInternalLoadTexture(nname, &mi, &pn);
             }
             if(!texture) {
+                tTVPGraphicScaleHintHolder hint(maxw, maxh);
                 bmp = TVPInternalLoadBitmap(nname, keyidx, desw, desh, &mi,
                                             mode, &pn);
             }
@@ -1992,13 +2327,7 @@ int TVPLoadGraphic(iTVPBaseBitmap *dest, const ttstr &name, tjs_int32 keyidx,
             TVPCheckGraphicCacheLimit();
 
             // push into hash table
-            tjs_uint datasize = data->GetSize();
-            //			if(datasize < TVPGraphicCacheLimit)
-            //			{
-            TVPGraphicCacheTotalBytes += datasize;
-            tTVPGraphicImageHolder holder(data);
-            TVPGraphicCache.AddWithHash(searchdata, hash, holder);
-            //			}
+            TVPGraphicCache.Add(searchdata, hash, data);
         } else if(dest) {
             tTVPGraphicImageData data;
             if(texture) {
@@ -2128,12 +2457,10 @@ private:
     }
 
     unsigned int loadOneGraph(const tItem &item) {
-        // TODO move cache operation to main thread
         tjs_uint32 hash = tTVPGraphicCache::MakeHash(item.searchdata);
-        tTVPGraphicImageHolder *ptr =
-            TVPGraphicCache.FindAndTouchWithHash(item.searchdata, hash);
+        tTVPGraphicImageRef ptr = TVPGraphicCache.Find(item.searchdata, hash);
         if(ptr) {
-            return ptr->GetObjectNoAddRef()->GetSize(); // already in cache
+            return ptr->GetSize(); // already in cache
         }
 #ifdef _DEBUG
         TVPAddLog(TJS_W("Touching Image: ") + item.main.filename);
@@ -2162,32 +2489,34 @@ private:
                 data.NeedMetaInfo = true;
                 data.MetaInfo = nullptr;
 
-                (item.main.handler->Load)(
-                    item.main.handler->FormatData, (void *)&data,
-                    TVPLoadGraphic_SizeCallback,
-                    TVPLoadGraphic_ScanLineCallback,
-                    TVPLoadGraphic_MetaInfoPushCallback, item.main.Stream.get(),
-                    -1, glmNormal);
-
-                mi = data.MetaInfo;
-
+                // decode the mask concurrently with the main image
+                std::unique_ptr<tTVPLoadGraphicMask> mask;
                 if(item.mask.handler && item.mask.Stream) {
-                    // open the mask file
-                    // holder.Open(item.maskfile);
-
-                    // fill "data"'s member
-                    data.Type = lgtMask;
-                    data.Name = item.mask.filename;
-                    data.Buffer = nullptr;
-                    data.DesW = 0;
-                    data.DesH = 0;
-                    data.NeedMetaInfo = false;
-
-                    (item.mask.handler->Load)(
-                        item.mask.handler->FormatData, (void *)&data,
+                    mask = std::make_unique<tTVPLoadGraphicMask>(
+                        item.mask.handler, item.mask.filename,
+                        item.mask.Stream.get(), 0, 0);
+                    data.Mask = mask.get();
+                }
+
+                try {
+                    (item.main.handler->Load)(
+                        item.main.handler->FormatData, (void *)&data,
                         TVPLoadGraphic_SizeCallback,
-                        TVPLoadGraphic_ScanLineCallback, nullptr,
-                        item.mask.Stream.get(), -1, glmGrayscale);
+                        TVPLoadGraphic_ScanLineCallback,
+                        TVPLoadGraphic_MetaInfoPushCallback,
+                        item.main.Stream.get(), -1, glmNormal);
+
+                    mi = data.MetaInfo;
+                    data.MetaInfo = nullptr;
+
+                    if(mask)
+                        mask->Finish(data.Dest);
+                } catch(...) {
+                    if(data.MetaInfo)
+                        delete data.MetaInfo;
+                    if(data.Dest)
+                        data.Dest->Release();
+                    throw;
                 }
 
                 bmp = data.Dest;
@@ -2203,10 +2532,7 @@ private:
             TVPCheckGraphicCacheLimit();
 
             // push into hash table
-            tjs_uint datasize = data->GetSize();
-            TVPGraphicCacheTotalBytes += datasize;
-            tTVPGraphicImageHolder holder(data);
-            TVPGraphicCache.AddWithHash(item.searchdata, hash, holder);
+            TVPGraphicCache.Add(item.searchdata, hash, data);
             ret = bmp->GetWidth() * bmp->GetHeight() * bmp->GetBPP() / 8;
             bmp->Release();
         } catch(...) {
@@ -2285,9 +2611,7 @@ void TVPTouchImages(const std::vector<ttstr> &storages, tjs_int64 limit,
 
                 hash = tTVPGraphicCache::MakeHash(searchdata);
 
-                tTVPGraphicImageHolder *ptr =
-                    TVPGraphicCache.FindAndTouchWithHash(searchdata, hash);
-                if(ptr) {
+                if(TVPGraphicCache.Touch(searchdata, hash)) {
                     // found in cache
                     continue;
                 }
@@ -2446,7 +2770,7 @@ void TVPTouchImages(const std::vector<ttstr> &storages, tjs_int64 limit,
 
         tjs_uint32 hash = tTVPGraphicCache::MakeHash(searchdata);
 
-        TVPGraphicCache.FindAndTouchWithHash(searchdata, hash);
+        TVPGraphicCache.Touch(searchdata, hash);
     }
 
     statusstr += TJS_W(" (elapsed ");
@@ -2478,6 +2802,9 @@ void TVPSetGraphicCacheLimit(tjs_uint64 limit) {
     if(TVPGraphicCacheLimit > 256 * 1024 * 1024)
         TVPGraphicCacheLimit = 256 * 1024 * 1024;
 
+    if(TVPGraphicCacheEnabled)
+        TVPInitClearGraphicCacheCallback();
+
     TVPCheckGraphicCacheLimit();
 }
 //---------------------------------------------------------------------------
@@ -306,8 +306,45 @@ extern int TVPLoadGraphic(iTVPBaseBitmap *dest, const ttstr &name,
                           tjs_int keyidx, tjs_uint desw, tjs_uint desh,
                           tTVPGraphicLoadMode mode,
                           ttstr *provincename = nullptr,
-                          iTJSDispatch2 **metainfo = nullptr);
-// throws exception when this function can not handle the file
+                          iTJSDispatch2 **metainfo = nullptr,
+                          tjs_uint maxw = 0, tjs_uint maxh = 0);
+// throws exception when this function can not handle the file.
+// maxw/maxh request a scaled decode (see tTVPGraphicScaleHint); the loaded
+// image may still be larger than that and should be stretched by the caller.
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+// scaled decoding
+//---------------------------------------------------------------------------
+// the size wanted for the image being loaded on the current thread. loaders
+// which can decode at a reduced scale natively (JPEG DCT scaling, WebP
+// scaling, PNG box filter) deliver an image no smaller than this.
+// 0 means the original size.
+struct tTVPGraphicScaleHint {
+    tjs_uint MaxW = 0;
+    tjs_uint MaxH = 0;
+};
+extern tTVPGraphicScaleHint TVPGetGraphicScaleHint();
+extern void TVPSetGraphicScaleHint(const tTVPGraphicScaleHint &hint);
+
+// returns the largest power of two up to maxdenom by which a w x h image
+// can be reduced while staying no smaller than the current hint.
+extern tjs_uint TVPGetGraphicScaleDenom(tjs_uint w, tjs_uint h,
+                                        tjs_uint maxdenom);
+
+class tTVPGraphicScaleHintHolder {
+    tTVPGraphicScaleHint Prev;
+
+public:
+    tTVPGraphicScaleHintHolder(tjs_uint maxw, tjs_uint maxh) :
+        Prev(TVPGetGraphicScaleHint()) {
+        tTVPGraphicScaleHint hint;
+        hint.MaxW = maxw;
+        hint.MaxH = maxh;
+        TVPSetGraphicScaleHint(hint);
+    }
+    ~tTVPGraphicScaleHintHolder() { TVPSetGraphicScaleHint(Prev); }
+};
 //---------------------------------------------------------------------------
 
 extern void TVPLoadGraphicProvince(tTVPBaseBitmap *dest, const ttstr &name,
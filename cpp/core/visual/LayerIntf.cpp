@@ -22,6 +22,7 @@
 
 #include "tjsArray.h"
 #include "LayerIntf.h"
+#include "ProvinceSpans.h"
 #include "MsgIntf.h"
 #include "LayerBitmapIntf.h"
 #include "LayerTreeOwner.h"
@@ -1486,7 +1487,9 @@ void tTJSNI_BaseLayer::DumpStructure(int level) {
                   ttstr(TJS_W(" ")) +
                   ttstr(GetVisible() ? TJS_W("visible") : TJS_W("invisible")) +
                   TJS_W(" index=") + ttstr(GetAbsoluteOrderIndex()) +
-                  ttstr(ProvinceImage ? TJS_W(" p") : TJS_W("")) + TJS_W(" ") +
+                  ttstr(ProvinceImage || ProvinceSpans ? TJS_W(" p")
+                                                       : TJS_W("")) +
+                  TJS_W(" ") +
                   ttstr(GetTypeNameString()));
     } catch(...) {
         delete[] indent;
@@ -2308,6 +2311,7 @@ void tTJSNI_BaseLayer::ChangeImageSize(tjs_uint width, tjs_uint height) {
         MainImage->SetSizeWithFill(width, height, NeutralColor);
     TVPLayerBitmapTotalBytes.fetch_add(TVPCalcMainImageBytes(MainImage) - oldBytes,
                                        std::memory_order_relaxed);
+    EnsureProvinceImage();
     if(ProvinceImage)
         ProvinceImage->SetSizeWithFill(width, height, 0);
 
@@ -2335,6 +2339,7 @@ void tTJSNI_BaseLayer::AllocateImage() {
     if(MainImage)
         ResetClip(); // cliprect is reset
 
+    EnsureProvinceImage();
     if(ProvinceImage) {
         ProvinceImage->SetSizeWithFill(MainImage->GetWidth(),
                                        MainImage->GetHeight(), 0);
@@ -2354,6 +2359,8 @@ void tTJSNI_BaseLayer::DeallocateImage() {
     }
     if(ProvinceImage)
         delete ProvinceImage, ProvinceImage = nullptr;
+    if(ProvinceSpans)
+        delete ProvinceSpans, ProvinceSpans = nullptr;
 
     ImageModified = true;
 }
@@ -2371,6 +2378,8 @@ void tTJSNI_BaseLayer::EnsureBitmap() {
 
 //---------------------------------------------------------------------------
 void tTJSNI_BaseLayer::AllocateProvinceImage() {
+    EnsureProvinceImage();
+
     tjs_uint neww = MainImage ? MainImage->GetWidth() : Rect.get_width();
     tjs_uint newh = MainImage ? MainImage->GetHeight() : Rect.get_height();
 
@@ -2388,9 +2397,40 @@ void tTJSNI_BaseLayer::AllocateProvinceImage() {
 void tTJSNI_BaseLayer::DeallocateProvinceImage() {
     if(ProvinceImage)
         delete ProvinceImage, ProvinceImage = nullptr;
+    if(ProvinceSpans)
+        delete ProvinceSpans, ProvinceSpans = nullptr;
     ImageModified = true;
 }
 
+//---------------------------------------------------------------------------
+void tTJSNI_BaseLayer::EnsureProvinceImage() {
+    if(!ProvinceSpans)
+        return;
+    tjs_uint w = ProvinceSpans->GetWidth(), h = ProvinceSpans->GetHeight();
+    auto *bmp = new tTVPBaseBitmap(w, h, 8);
+    try {
+        ProvinceSpans->Expand(bmp);
+    } catch(...) {
+        delete bmp;
+        throw;
+    }
+    delete ProvinceSpans, ProvinceSpans = nullptr;
+    ProvinceImage = bmp;
+}
+
+//---------------------------------------------------------------------------
+void tTJSNI_BaseLayer::CompactProvinceImage() {
+    // the bitmap may be shared with the graphic cache; dropping it here
+    // lets the cache evict it
+    if(!ProvinceImage)
+        return;
+    tTVPProvinceSpans *spans = tTVPProvinceSpans::Create(ProvinceImage);
+    if(!spans)
+        return;
+    delete ProvinceImage, ProvinceImage = nullptr;
+    ProvinceSpans = spans;
+}
+
 //---------------------------------------------------------------------------
 void tTJSNI_BaseLayer::AllocateDefaultImage() {
     int64_t oldBytes = TVPCalcMainImageBytes(MainImage);
@@ -2425,7 +2465,11 @@ void tTJSNI_BaseLayer::AssignImages(tTJSNI_BaseLayer *src) {
         DeallocateImage();
     }
 
-    if(src->ProvinceImage) {
+    if(src->ProvinceSpans) {
+        DeallocateProvinceImage();
+        ProvinceSpans = new tTVPProvinceSpans(*src->ProvinceSpans);
+    } else if(src->ProvinceImage) {
+        EnsureProvinceImage();
         if(ProvinceImage)
             ProvinceImage->Assign(*src->ProvinceImage);
         else
@@ -2721,6 +2765,7 @@ void tTJSNI_BaseLayer::IndependMainImage(bool copy) {
 
 //---------------------------------------------------------------------------
 void tTJSNI_BaseLayer::IndependProvinceImage(bool copy) {
+    // the compact form is never shared
     if(ProvinceImage) {
         if(copy)
             ProvinceImage->Independ();
@@ -2916,6 +2961,8 @@ iTJSDispatch2 *tTJSNI_BaseLayer::LoadImages(const ttstr &name,
                    ProvinceImage->GetHeight() != MainImage->GetHeight())
                     TVPThrowExceptionMessage(TVPProvinceSizeMismatch,
                                              provincename);
+
+                CompactProvinceImage();
             } catch(...) {
                 DeallocateProvinceImage();
                 throw;
@@ -2955,6 +3002,8 @@ void tTJSNI_BaseLayer::LoadProvinceImage(const ttstr &name) {
         if(ProvinceImage->GetWidth() != MainImage->GetWidth() ||
            ProvinceImage->GetHeight() != MainImage->GetHeight())
             TVPThrowExceptionMessage(TVPProvinceSizeMismatch, name);
+
+        CompactProvinceImage();
     } catch(...) {
         DeallocateProvinceImage();
         throw;
@@ -3025,6 +3074,13 @@ void tTJSNI_BaseLayer::SetMaskPixel(tjs_int x, tjs_int y, tjs_int mask) {
 
 //---------------------------------------------------------------------------
 tjs_int tTJSNI_BaseLayer::GetProvincePixel(tjs_int x, tjs_int y) const {
+    if(ProvinceSpans) {
+        if(x < 0 || y < 0 || x >= (tjs_int)ProvinceSpans->GetWidth() ||
+           y >= (tjs_int)ProvinceSpans->GetHeight())
+            return 0;
+        return ProvinceSpans->GetPoint(x, y);
+    }
+
     if(!ProvinceImage)
         return 0;
 
@@ -3079,6 +3135,8 @@ tjs_int tTJSNI_BaseLayer::GetMainImagePixelBufferPitch() const {
 
 //---------------------------------------------------------------------------
 const void *tTJSNI_BaseLayer::GetProvinceImagePixelBuffer() const {
+    // the caller reads the bitmap directly
+    const_cast<tTJSNI_BaseLayer *>(this)->EnsureProvinceImage();
     if(!ProvinceImage)
         return nullptr;
     return ProvinceImage->GetScanLine(0);
@@ -3094,6 +3152,7 @@ void *tTJSNI_BaseLayer::GetProvinceImagePixelBufferForWrite() {
 
 //---------------------------------------------------------------------------
 tjs_int tTJSNI_BaseLayer::GetProvinceImagePixelBufferPitch() const {
+    const_cast<tTJSNI_BaseLayer *>(this)->EnsureProvinceImage();
     if(!ProvinceImage)
         return 0;
     return ProvinceImage->GetPitchBytes();
@@ -3316,7 +3375,14 @@ bool tTJSNI_BaseLayer::_HitTestNoVisibleCheck(tjs_int x, tjs_int y) {
     } else if(HitType == htProvince) {
         // use province
 
-        if(ProvinceImage) {
+        if(ProvinceSpans) {
+            tjs_int px = x - ImageLeft, py = y - ImageTop;
+            if(px >= 0 && py >= 0 &&
+               px < (tjs_int)ProvinceSpans->GetWidth() &&
+               py < (tjs_int)ProvinceSpans->GetHeight())
+                return ProvinceSpans->GetPoint(px, py) != 0;
+            return false;
+        } else if(ProvinceImage) {
             tjs_int px = x - ImageLeft, py = y - ImageTop;
             if(px >= 0 && py >= 0 && px < (tjs_int)ProvinceImage->GetWidth() &&
                py < (tjs_int)ProvinceImage->GetHeight()) {
@@ -4355,6 +4421,7 @@ void tTJSNI_BaseLayer::FillRect(const tTVPRect &rect, tjs_uint32 color) {
     } else if(DrawFace == dfProvince) {
         // province
         color = color & 0xff;
+        EnsureProvinceImage();
         if(color) {
             if(!ProvinceImage)
                 AllocateProvinceImage();
@@ -4445,6 +4512,7 @@ void tTJSNI_BaseLayer::ColorRect(const tTVPRect &rect, tjs_uint32 color,
 
         case dfProvince: // province ( opacity will be ignored )
             color = color & 0xff;
+            EnsureProvinceImage();
             if(color) {
                 if(!ProvinceImage)
                     AllocateProvinceImage();
@@ -4674,6 +4742,7 @@ void tTJSNI_BaseLayer::CopyRect(tjs_int dx, tjs_int dy, iTVPBaseBitmap *src,
             break;
 
         case dfProvince:
+            EnsureProvinceImage();
             if(!provincesrc) {
                 // source province image is nullptr;
                 // fill destination with zero
@@ -5668,6 +5737,7 @@ void tTJSNI_BaseLayer::LRFlip() {
 
     tTVPRect r(0, 0, MainImage->GetWidth(), MainImage->GetHeight());
     MainImage->LRFlip(r);
+    EnsureProvinceImage();
     if(ProvinceImage)
         ProvinceImage->LRFlip(r);
 
@@ -5683,6 +5753,7 @@ void tTJSNI_BaseLayer::UDFlip() {
 
     tTVPRect r(0, 0, MainImage->GetWidth(), MainImage->GetHeight());
     MainImage->UDFlip(r);
+    EnsureProvinceImage();
     if(ProvinceImage)
         ProvinceImage->UDFlip(r);
 
@@ -425,6 +425,9 @@ protected:
     void EnsureBitmap();
     bool CanHaveImage; // whether the layer can have image
     tTVPBaseBitmap *ProvinceImage;
+    // run-length form of a loaded province image, used for hit tests and
+    // getProvincePixel instead of ProvinceImage until the image is edited
+    class tTVPProvinceSpans *ProvinceSpans = nullptr;
     tjs_uint32 NeutralColor; // Neutral Color (which can be set by the user)
     tjs_uint32 TransparentColor; // transparent color (which cannot be set by
                                  // the user, decided by layer type)
@@ -438,6 +441,8 @@ protected:
     void DeallocateImage();
     void AllocateProvinceImage();
     void DeallocateProvinceImage();
+    void EnsureProvinceImage(); // expand ProvinceSpans into ProvinceImage
+    void CompactProvinceImage(); // replace ProvinceImage by ProvinceSpans
     void AllocateDefaultImage();
 
 public:
@@ -486,6 +491,7 @@ public:
     }
     tTVPBaseBitmap *GetProvinceImage() {
         ApplyFont();
+        EnsureProvinceImage();
         return ProvinceImage;
     }
     // exporting of these two members is a bit dangerous
@@ -280,6 +280,11 @@ void TVPLoadJPEG(void *formatdata, void *callbackdata,
         cinfo.out_color_space = JCS_EXT_RGBA;
     }
 
+    // let the IDCT produce a reduced image when a smaller one is wanted
+    cinfo.scale_num = 1;
+    cinfo.scale_denom =
+        TVPGetGraphicScaleDenom(cinfo.image_width, cinfo.image_height, 8);
+
     jpeg_start_decompress(&cinfo);
 
     try {
@@ -18,6 +18,9 @@
 
 #include "TVPMmapAlloc.h"
 
+#include <algorithm>
+#include <vector>
+
 bool TVPAcceptSaveAsPNG(void *formatdata, const ttstr &type,
                         class iTJSDispatch2 **dic) {
     bool result = false;
@@ -162,6 +165,60 @@ static int PNG_read_chunk_callback(png_structp png_ptr,
     return 0; // did not recognize
 }
 //---------------------------------------------------------------------------
+// reads a non-interlaced 32bpp image and averages each denom x denom block
+// into one pixel as the rows arrive. "image" is a one row work buffer.
+// colors are weighted by alpha, so that the colors of transparent pixels
+// do not bleed into the edges of opaque ones.
+static void PNG_read_rows_box_filtered(
+    png_structp png_ptr, png_uint_32 width, png_uint_32 height,
+    tjs_uint denom, tjs_uint8 *image, void *callbackdata,
+    tTVPGraphicScanLineCallback scanlinecallback) {
+    tjs_uint outw = (width + denom - 1) / denom;
+    tjs_uint outh = (height + denom - 1) / denom;
+    // per output pixel: plain sums of r, g, b, a and alpha weighted sums
+    // of r, g, b. at most 64 pixels of 255 * 255 are added up.
+    std::vector<tjs_uint32> sums(outw * 8);
+    for(tjs_uint oy = 0; oy < outh; oy++) {
+        tjs_uint rows = std::min<tjs_uint>(denom, height - oy * denom);
+        std::fill(sums.begin(), sums.end(), 0);
+        for(tjs_uint r = 0; r < rows; r++) {
+            png_read_row(png_ptr, (png_bytep)image, nullptr);
+            const tjs_uint8 *in = image;
+            for(tjs_uint x = 0; x < width; x++, in += 4) {
+                tjs_uint32 *sum = &sums[(x / denom) * 8];
+                tjs_uint32 a = in[3];
+                sum[0] += in[0];
+                sum[1] += in[1];
+                sum[2] += in[2];
+                sum[3] += a;
+                sum[4] += in[0] * a;
+                sum[5] += in[1] * a;
+                sum[6] += in[2] * a;
+            }
+        }
+        tjs_uint8 *scanline = (tjs_uint8 *)scanlinecallback(callbackdata, oy);
+        if(!scanline)
+            break;
+        for(tjs_uint ox = 0; ox < outw; ox++) {
+            tjs_uint cols = std::min<tjs_uint>(denom, width - ox * denom);
+            tjs_uint32 n = cols * rows;
+            const tjs_uint32 *sum = &sums[ox * 8];
+            tjs_uint8 *out = scanline + ox * 4;
+            tjs_uint32 asum = sum[3];
+            if(asum) {
+                for(int c = 0; c < 3; c++)
+                    out[c] = (tjs_uint8)((sum[4 + c] + asum / 2) / asum);
+            } else {
+                // fully transparent; keep the plain average
+                for(int c = 0; c < 3; c++)
+                    out[c] = (tjs_uint8)((sum[c] + n / 2) / n);
+            }
+            out[3] = (tjs_uint8)((asum + n / 2) / n);
+        }
+        scanlinecallback(callbackdata, -1);
+    }
+}
+//---------------------------------------------------------------------------
 void TVPLoadPNG(void *formatdata, void *callbackdata,
                 tTVPGraphicSizeCallback sizecallback,
                 tTVPGraphicScanLineCallback scanlinecallback,
@@ -380,12 +437,28 @@ void TVPLoadPNG(void *formatdata, void *callbackdata,
         // call png_read_update_info
         png_read_update_info(png_ptr, info_ptr);
 
+        // box filter rows while decoding when a smaller image is wanted.
+        // not with a color key; the key color would be blended into its
+        // neighbors and no longer match.
+        tjs_uint denom = 1;
+        if(mode == glmNormal && keyidx == -1 &&
+           png_get_interlace_type(png_ptr, info_ptr) == PNG_INTERLACE_NONE)
+            denom = TVPGetGraphicScaleDenom(width, height, 8);
+
         // set size
-        sizecallback(callbackdata, width, height,
+        sizecallback(callbackdata, (width + denom - 1) / denom,
+                     (height + denom - 1) / denom,
                      color_type == PNG_COLOR_TYPE_RGB_ALPHA ? gpfRGBA : gpfRGB);
 
         // load image
-        if(png_get_interlace_type(png_ptr, info_ptr) == PNG_INTERLACE_NONE) {
+        if(denom > 1) {
+            image = new tjs_uint8[png_get_rowbytes(png_ptr, info_ptr)];
+            PNG_read_rows_box_filtered(png_ptr, width, height, denom, image,
+                                       callbackdata, scanlinecallback);
+            // finish loading
+            png_read_end(png_ptr, info_ptr);
+        } else if(png_get_interlace_type(png_ptr, info_ptr) ==
+                  PNG_INTERLACE_NONE) {
             // non-interlace
             if(do_convert_rgb_gray) {
                 png_size_t rowbytes = png_get_rowbytes(png_ptr, info_ptr);
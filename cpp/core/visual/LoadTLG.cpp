@@ -16,8 +16,14 @@
 #include "tvpgl.h"
 #include "tjsDictionary.h"
 #include "TVPDecodeArena.h"
+#include "ThreadPool.h"
 
 #include <stdlib.h>
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 static inline void *TLGArenaAlloc(size_t size, int align) {
     if(TVPDecodeArenaActive()) {
@@ -49,6 +55,208 @@ static inline void TLGArenaDealloc(void *ptr) {
                 (in Japanese).
 */
 
+//---------------------------------------------------------------------------
+// TLG block pipeline
+//---------------------------------------------------------------------------
+/*
+        TLG5 and TLG6 both store the image as a sequence of horizontal
+        blocks whose entropy coded data can be expanded ahead of the final
+        per-line pass (color composition for TLG5, MED/average filters for
+        TLG6), which depends on the previous line and runs on the calling
+        thread in block order.
+
+        the coded data of the whole image is read up front and blocks are
+        expanded on the worker pool into a small ring of slots. TLG6 blocks
+        are independent and expand concurrently; TLG5 shares one LZSS
+        dictionary across the image, so its blocks expand one at a time
+        (Serial) but still overlap with the composition of earlier blocks.
+
+        the calling thread also expands blocks by itself whenever the next
+        block is not ready; the async image loader runs on the same pool,
+        so waiting for pool tasks alone could stall.
+
+        the state is shared with the pool tasks, so an exception on the
+        calling thread (or a task which starts late) never touches freed
+        memory.
+*/
+#define TVP_TLG_PARALLEL_MIN_PIXELS (256 * 256)
+#define TVP_TLG_MAX_HELPERS 7
+struct tTVPTLGBlockPipeline {
+    tjs_int BlockCount;
+    tjs_int SlotCount; // slot ring size
+    tjs_int MaxHelpers;
+    bool Serial; // blocks must be expanded one at a time, in order
+
+    std::mutex Mutex;
+    std::condition_variable Cond;
+    std::vector<tjs_uint8> Ready; // per block
+    tjs_int NextClaim = 0; // next block to expand
+    tjs_int Released = 0; // blocks whose slot may be reused
+    tjs_int Helpers = 0; // posted pool tasks which have not exited
+    bool Busy = false; // a serial block is being expanded
+    bool Stopping = false;
+
+    tTVPTLGBlockPipeline(tjs_int blockcount, tjs_int width, tjs_int height,
+                         bool serial) :
+        BlockCount(blockcount), Serial(serial) {
+        MaxHelpers = 0;
+        if((tjs_int64)width * height >= TVP_TLG_PARALLEL_MIN_PIXELS) {
+            MaxHelpers = serial
+                ? 1
+                : std::min<tjs_int>(TVPGetWorkerThreadPool().GetThreadCount(),
+                                    TVP_TLG_MAX_HELPERS);
+            MaxHelpers = std::min<tjs_int>(MaxHelpers, blockcount - 1);
+        }
+        SlotCount = std::min<tjs_int>(blockcount, MaxHelpers * 2 + 2);
+        Ready.resize(blockcount, 0);
+    }
+
+    virtual ~tTVPTLGBlockPipeline() = default;
+
+    // expands the coded data of the block into its slot
+    virtual void Expand(tjs_int block) = 0;
+
+    // must be called with Mutex held
+    bool Claim(tjs_int &block) {
+        if(Stopping || (Serial && Busy) || NextClaim >= BlockCount ||
+           NextClaim >= Released + SlotCount)
+            return false;
+        block = NextClaim++;
+        Busy = true;
+        return true;
+    }
+
+    void Run(tjs_int block) {
+        Expand(block);
+        std::lock_guard<std::mutex> lk(Mutex);
+        Ready[block] = 1;
+        Busy = false;
+        Cond.notify_all();
+    }
+
+    static void Help(const std::shared_ptr<tTVPTLGBlockPipeline> &self) {
+        while(true) {
+            tjs_int block;
+            {
+                std::lock_guard<std::mutex> lk(self->Mutex);
+                if(!self->Claim(block)) {
+                    self->Helpers--;
+                    return;
+                }
+            }
+            self->Run(block);
+        }
+    }
+
+    // must be called with Mutex held
+    static void PostHelpers(const std::shared_ptr<tTVPTLGBlockPipeline> &self) {
+        tjs_int claimable =
+            std::min(self->BlockCount, self->Released + self->SlotCount) -
+            self->NextClaim;
+        while(self->Helpers < self->MaxHelpers && self->Helpers < claimable) {
+            self->Helpers++;
+            std::shared_ptr<tTVPTLGBlockPipeline> ref = self;
+            TVPGetWorkerThreadPool().Post([ref]() { Help(ref); });
+        }
+    }
+
+    // waits until the block is expanded; called in block order
+    static void Acquire(const std::shared_ptr<tTVPTLGBlockPipeline> &self,
+                        tjs_int block) {
+        std::unique_lock<std::mutex> lk(self->Mutex);
+        PostHelpers(self);
+        while(!self->Ready[block]) {
+            tjs_int other;
+            if(self->Claim(other)) {
+                lk.unlock();
+                self->Run(other);
+                lk.lock();
+                continue;
+            }
+            self->Cond.wait(lk);
+        }
+    }
+
+    // the slot of the block may be reused
+    void Release(tjs_int block) {
+        std::lock_guard<std::mutex> lk(Mutex);
+        Released = block + 1;
+    }
+
+    void Stop() {
+        std::lock_guard<std::mutex> lk(Mutex);
+        Stopping = true;
+    }
+};
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+// TLG5 block decoder
+//---------------------------------------------------------------------------
+struct tTVPTLG5BlockDecoder : public tTVPTLGBlockPipeline {
+    tjs_int Colors;
+    tjs_int SlotStride; // one color component of one block
+
+    std::vector<tjs_uint8> Pool; // coded data of all blocks
+    std::vector<size_t> Offsets; // [block * Colors + c] into Pool
+    std::vector<tjs_int> Sizes;
+    std::vector<tjs_uint8> Methods; // 0: modified LZSS, otherwise raw
+    std::vector<tjs_uint8> Slots;
+    tjs_uint8 Text[4096 + 32];
+    tjs_int R = 0; // LZSS dictionary position
+
+    tTVPTLG5BlockDecoder(tjs_int colors, tjs_int width, tjs_int height,
+                         tjs_int blockheight) :
+        tTVPTLGBlockPipeline((height - 1) / blockheight + 1, width, height,
+                             true),
+        Colors(colors) {
+        SlotStride = blockheight * width + 10 + 16;
+        Offsets.resize(BlockCount * colors);
+        Sizes.resize(BlockCount * colors);
+        Methods.resize(BlockCount * colors);
+        memset(Text, 0, sizeof(Text));
+    }
+
+    // reads the coded data of all blocks
+    void Read(tTJSBinaryStream *src) {
+        for(tjs_int i = 0; i < BlockCount * Colors; i++) {
+            tjs_uint8 mark;
+            src->ReadBuffer(&mark, 1);
+            tjs_int size = src->ReadI32LE();
+            if(size < 0 || (mark != 0 && size > SlotStride))
+                TVPThrowExceptionMessage(
+                    TVPTLGLoadError, (const tjs_char *)TVPTlgInvalidBlockSize);
+            size_t ofs = Pool.size();
+            Methods[i] = mark;
+            Sizes[i] = size;
+            Offsets[i] = ofs;
+            Pool.resize(ofs + size);
+            if(size)
+                src->ReadBuffer(&Pool[ofs], size);
+        }
+        // LZSS decompressor may look ahead a few bytes
+        Pool.resize(Pool.size() + 16, 0);
+        Slots.resize((size_t)SlotCount * Colors * SlotStride);
+    }
+
+    tjs_uint8 *GetSlot(tjs_int block, tjs_int c) {
+        return &Slots[((size_t)(block % SlotCount) * Colors + c) * SlotStride];
+    }
+
+    void Expand(tjs_int block) override {
+        for(tjs_int c = 0; c < Colors; c++) {
+            tjs_int i = block * Colors + c;
+            const tjs_uint8 *in = &Pool[Offsets[i]];
+            if(Methods[i] == 0)
+                R = TVPTLG5DecompressSlide(GetSlot(block, c), in, Sizes[i],
+                                           Text, R);
+            else if(Sizes[i])
+                memcpy(GetSlot(block, c), in, Sizes[i]);
+        }
+    }
+};
+//---------------------------------------------------------------------------
+
 //---------------------------------------------------------------------------
 // TLG5 loading handler
 //---------------------------------------------------------------------------
@@ -83,38 +291,25 @@ void TVPLoadTLG5(void *formatdata, void *callbackdata,
     // decomperss
     sizecallback(callbackdata, width, height, colors == 3 ? gpfRGB : gpfRGBA);
 
-    tjs_uint8 *inbuf = nullptr;
-    tjs_uint8 *outbuf[4];
-    tjs_uint8 *text = nullptr;
-    tjs_int r = 0;
-    for(int i = 0; i < colors; i++)
-        outbuf[i] = nullptr;
+    // the first line is composed against a virtual zero line
+    tjs_uint8 *zeroline = nullptr;
+    std::shared_ptr<tTVPTLG5BlockDecoder> decoder;
 
     try {
-        text = (tjs_uint8 *)TLGArenaAlloc(4096 + 32, 4) + 16;
-        memset(text, 0, 4096);
+        zeroline = (tjs_uint8 *)TLGArenaAlloc(width * sizeof(tjs_uint32), 4);
+        memset(zeroline, 0, width * sizeof(tjs_uint32));
 
-        inbuf = (tjs_uint8 *)TLGArenaAlloc(blockheight * width + 10 + 16, 4);
-        for(tjs_int i = 0; i < colors; i++)
-            outbuf[i] =
-                (tjs_uint8 *)TLGArenaAlloc(blockheight * width + 10 + 16, 4);
+        // read coded data of all blocks
+        decoder = std::make_shared<tTVPTLG5BlockDecoder>(colors, width, height,
+                                                         blockheight);
+        decoder->Read(src);
+        std::shared_ptr<tTVPTLGBlockPipeline> pipeline = decoder;
 
-        tjs_uint8 *prevline = nullptr;
+        tjs_uint8 *prevline = zeroline;
         for(tjs_int y_blk = 0; y_blk < height; y_blk += blockheight) {
-            // read file and decompress
-            for(tjs_int c = 0; c < colors; c++) {
-                src->ReadBuffer(mark, 1);
-                tjs_int size;
-                size = src->ReadI32LE();
-                if(mark[0] == 0) {
-                    // modified LZSS compressed data
-                    src->ReadBuffer(inbuf, size);
-                    r = TVPTLG5DecompressSlide(outbuf[c], inbuf, size, text, r);
-                } else {
-                    // raw data
-                    src->ReadBuffer(outbuf[c], size);
-                }
-            }
+            // wait for decompressed block
+            tjs_int block = y_blk / blockheight;
+            tTVPTLGBlockPipeline::Acquire(pipeline, block);
 
             // compose colors and store
             tjs_int y_lim = y_blk + blockheight;
@@ -122,96 +317,130 @@ void TVPLoadTLG5(void *formatdata, void *callbackdata,
                 y_lim = height;
             tjs_uint8 *outbufp[4];
             for(tjs_int c = 0; c < colors; c++)
-                outbufp[c] = outbuf[c];
+                outbufp[c] = decoder->GetSlot(block, c);
             for(tjs_int y = y_blk; y < y_lim; y++) {
                 tjs_uint8 *current =
                     (tjs_uint8 *)scanlinecallback(callbackdata, y);
-                tjs_uint8 *current_org = current;
-                if(prevline) {
-                    // not first line
-                    switch(colors) {
-                        case 3:
-                            TVPTLG5ComposeColors3To4(current, prevline, outbufp,
-                                                     width);
-                            outbufp[0] += width;
-                            outbufp[1] += width;
-                            outbufp[2] += width;
-                            break;
-                        case 4:
-                            TVPTLG5ComposeColors4To4(current, prevline, outbufp,
-                                                     width);
-                            outbufp[0] += width;
-                            outbufp[1] += width;
-                            outbufp[2] += width;
-                            outbufp[3] += width;
-                            break;
-                    }
-                } else {
-                    // first line
-                    switch(colors) {
-                        case 3:
-                            for(tjs_int pr = 0, pg = 0, pb = 0, x = 0;
-                                x < width; x++) {
-                                tjs_int r = outbufp[0][x];
-                                tjs_int g = outbufp[1][x];
-                                tjs_int b = outbufp[2][x];
-                                b += g;
-                                r += g;
-                                0 [current++] = pb += b;
-                                0 [current++] = pg += g;
-                                0 [current++] = pr += r;
-                                0 [current++] = 0xff;
-                            }
-                            outbufp[0] += width;
-                            outbufp[1] += width;
-                            outbufp[2] += width;
-                            break;
-                        case 4:
-                            for(tjs_int pr = 0, pg = 0, pb = 0, pa = 0, x = 0;
-                                x < width; x++) {
-                                tjs_int r = outbufp[0][x];
-                                tjs_int g = outbufp[1][x];
-                                tjs_int b = outbufp[2][x];
-                                tjs_int a = outbufp[3][x];
-                                b += g;
-                                r += g;
-                                0 [current++] = pb += b;
-                                0 [current++] = pg += g;
-                                0 [current++] = pr += r;
-                                0 [current++] = pa += a;
-                            }
-                            outbufp[0] += width;
-                            outbufp[1] += width;
-                            outbufp[2] += width;
-                            outbufp[3] += width;
-                            break;
-                    }
+                switch(colors) {
+                    case 3:
+                        TVPTLG5ComposeColors3To4(current, prevline, outbufp,
+                                                 width);
+                        break;
+                    case 4:
+                        TVPTLG5ComposeColors4To4(current, prevline, outbufp,
+                                                 width);
+                        break;
                 }
+                for(tjs_int c = 0; c < colors; c++)
+                    outbufp[c] += width;
                 scanlinecallback(callbackdata, -1);
 
-                prevline = current_org;
+                prevline = current;
             }
+
+            decoder->Release(block);
         }
     } catch(...) {
-        if(inbuf)
-            TLGArenaDealloc(inbuf);
-        if(text)
-            TLGArenaDealloc(text - 16);
-        for(tjs_int i = 0; i < colors; i++)
-            if(outbuf[i])
-                TLGArenaDealloc(outbuf[i]);
+        if(decoder)
+            decoder->Stop();
+        if(zeroline)
+            TLGArenaDealloc(zeroline);
         throw;
     }
-    if(inbuf)
-        TLGArenaDealloc(inbuf);
-    if(text)
-        TLGArenaDealloc(text - 16);
-    for(tjs_int i = 0; i < colors; i++)
-        if(outbuf[i])
-            TLGArenaDealloc(outbuf[i]);
+    decoder->Stop();
+    if(zeroline)
+        TLGArenaDealloc(zeroline);
 }
 //---------------------------------------------------------------------------
 
+//---------------------------------------------------------------------------
+// TLG6 block row decoder
+//---------------------------------------------------------------------------
+/*
+        golomb decoding of each 8-line block row (all color components) is
+        independent of the other block rows, so block rows expand
+        concurrently.
+*/
+struct tTVPTLG6BlockRowDecoder : public tTVPTLGBlockPipeline {
+    tjs_int Colors;
+    tjs_int Width;
+    tjs_int Height;
+    tjs_int SlotStride; // pixel buffer size in tjs_uint32 units
+
+    std::vector<tjs_uint8> Pool; // entropy coded data of all block rows
+    std::vector<size_t> Offsets; // [row * Colors + c] into Pool
+    std::vector<tjs_uint32> Slots;
+
+    tTVPTLG6BlockRowDecoder(tjs_int colors, tjs_int width, tjs_int height) :
+        tTVPTLGBlockPipeline((height - 1) / TVP_TLG6_H_BLOCK_SIZE + 1, width,
+                             height, false),
+        Colors(colors), Width(width), Height(height) {
+        SlotStride = width * TVP_TLG6_H_BLOCK_SIZE + 1;
+        Offsets.resize(BlockCount * colors);
+    }
+
+    // reads the entropy coded data of all block rows
+    void Read(tTJSBinaryStream *src) {
+        for(tjs_int row = 0; row < BlockCount; row++) {
+            for(tjs_int c = 0; c < Colors; c++) {
+                // read bit length
+                tjs_int bit_length = src->ReadI32LE();
+
+                // get compress method
+                // two most significant bits of bitlength are
+                // entropy coding method;
+                // 00 means Golomb method,
+                // 01 means Gamma method (not yet suppoted),
+                // 10 means modified LZSS method (not yet supported),
+                // 11 means raw (uncompressed) data (not yet
+                // supported).
+                int method = (bit_length >> 30) & 3;
+                bit_length &= 0x3fffffff;
+                if(method != 0)
+                    TVPThrowExceptionMessage(
+                        TVPTLGLoadError,
+                        (const tjs_char *)TVPUnsupportedEntropyCodingMethod);
+
+                // compute byte length
+                tjs_int byte_length = bit_length / 8;
+                if(bit_length % 8)
+                    byte_length++;
+
+                // read source from input
+                size_t ofs = Pool.size();
+                Offsets[row * Colors + c] = ofs;
+                Pool.resize(ofs + byte_length);
+                if(byte_length)
+                    src->ReadBuffer(&Pool[ofs], byte_length);
+            }
+        }
+        // the golomb decoder fetches 32bits at a time
+        Pool.resize(Pool.size() + 8, 0);
+        Slots.resize((size_t)SlotCount * SlotStride);
+    }
+
+    tjs_uint32 *GetPixelBuf(tjs_int row) {
+        return &Slots[(size_t)(row % SlotCount) * SlotStride];
+    }
+
+    void Expand(tjs_int row) override {
+        tjs_int y = row * TVP_TLG6_H_BLOCK_SIZE;
+        tjs_int ylim = std::min<tjs_int>(y + TVP_TLG6_H_BLOCK_SIZE, Height);
+        tjs_int pixel_count = (ylim - y) * Width;
+        tjs_uint32 *pixelbuf = GetPixelBuf(row);
+        for(tjs_int c = 0; c < Colors; c++) {
+            tjs_uint8 *bit_pool = &Pool[Offsets[row * Colors + c]];
+            if(c == 0 && Colors != 1)
+                TVPTLG6DecodeGolombValuesForFirst((tjs_int8 *)pixelbuf,
+                                                  pixel_count, bit_pool);
+            else
+                TVPTLG6DecodeGolombValues((tjs_int8 *)pixelbuf + c,
+                                          pixel_count, bit_pool);
+        }
+    }
+};
+//---------------------------------------------------------------------------
+
 //---------------------------------------------------------------------------
 // TLG6 loading handler
 //---------------------------------------------------------------------------
@@ -257,6 +486,7 @@ void TVPLoadTLG6(void *formatdata, void *callbackdata,
     tjs_int max_bit_length;
 
     max_bit_length = src->ReadI32LE();
+    (void)max_bit_length; // block rows are read into one pool
 
     // set destination size
     sizecallback(callbackdata, width, height, colors == 3 ? gpfRGB : gpfRGBA);
@@ -268,19 +498,15 @@ void TVPLoadTLG6(void *formatdata, void *callbackdata,
     tjs_int fraction = width - main_count * TVP_TLG6_W_BLOCK_SIZE;
 
     // prepare memory pointers
-    tjs_uint8 *bit_pool = nullptr;
-    tjs_uint32 *pixelbuf = nullptr; // pixel buffer
     tjs_uint8 *filter_types = nullptr;
     tjs_uint8 *LZSS_text = nullptr;
     tjs_uint32 *zeroline = nullptr;
 
     tjs_uint32 *tmpline[2] = { nullptr, nullptr };
     tjs_uint8 *grayline;
+    std::shared_ptr<tTVPTLG6BlockRowDecoder> decoder;
     try {
         // allocate memories
-        bit_pool = (tjs_uint8 *)TLGArenaAlloc(max_bit_length / 8 + 5, 4);
-        pixelbuf = (tjs_uint32 *)TLGArenaAlloc(
-            sizeof(tjs_uint32) * width * TVP_TLG6_H_BLOCK_SIZE + 1, 4);
         filter_types =
             (tjs_uint8 *)TLGArenaAlloc(x_block_count * y_block_count + 16, 4);
         zeroline = (tjs_uint32 *)TLGArenaAlloc(width * sizeof(tjs_uint32), 4);
@@ -316,6 +542,12 @@ void TVPLoadTLG6(void *formatdata, void *callbackdata,
             TLGArenaDealloc(inbuf);
         }
 
+        // read entropy coded values of all block rows
+        decoder =
+            std::make_shared<tTVPTLG6BlockRowDecoder>(colors, width, height);
+        decoder->Read(src);
+        std::shared_ptr<tTVPTLGBlockPipeline> pipeline = decoder;
+
         // for each horizontal block group ...
         tjs_uint32 *prevline = zeroline;
         for(tjs_int y = 0; y < height; y += TVP_TLG6_H_BLOCK_SIZE) {
@@ -323,54 +555,13 @@ void TVPLoadTLG6(void *formatdata, void *callbackdata,
             if(ylim >= height)
                 ylim = height;
 
-            tjs_int pixel_count = (ylim - y) * width;
-
-            // decode values
-            for(tjs_int c = 0; c < colors; c++) {
-                // read bit length
-                tjs_int bit_length = src->ReadI32LE();
-
-                // get compress method
-                int method = (bit_length >> 30) & 3;
-                bit_length &= 0x3fffffff;
-
-                // compute byte length
-                tjs_int byte_length = bit_length / 8;
-                if(bit_length % 8)
-                    byte_length++;
-
-                // read source from input
-                src->ReadBuffer(bit_pool, byte_length);
-
-                // decode values
-                // two most significant bits of bitlength are
-                // entropy coding method;
-                // 00 means Golomb method,
-                // 01 means Gamma method (not yet suppoted),
-                // 10 means modified LZSS method (not yet supported),
-                // 11 means raw (uncompressed) data (not yet
-                // supported).
-
-                switch(method) {
-                    case 0:
-                        if(c == 0 && colors != 1)
-                            TVPTLG6DecodeGolombValuesForFirst(
-                                (tjs_int8 *)pixelbuf, pixel_count, bit_pool);
-                        else
-                            TVPTLG6DecodeGolombValues((tjs_int8 *)pixelbuf + c,
-                                                      pixel_count, bit_pool);
-                        break;
-                    default:
-                        TVPThrowExceptionMessage(
-                            TVPTLGLoadError,
-                            (const tjs_char *)
-                                TVPUnsupportedEntropyCodingMethod);
-                }
-            }
+            // wait for golomb decoded values
+            tjs_int row = y / TVP_TLG6_H_BLOCK_SIZE;
+            tTVPTLGBlockPipeline::Acquire(pipeline, row);
+            tjs_uint32 *pixelbuf = decoder->GetPixelBuf(row);
 
             // for each line
-            unsigned char *ft =
-                filter_types + (y / TVP_TLG6_H_BLOCK_SIZE) * x_block_count;
+            unsigned char *ft = filter_types + row * x_block_count;
             int skipbytes = (ylim - y) * TVP_TLG6_W_BLOCK_SIZE;
 
             for(int yy = y; yy < ylim; yy++) {
@@ -420,12 +611,12 @@ void TVPLoadTLG6(void *formatdata, void *callbackdata,
                 }
                 scanlinecallback(callbackdata, -1);
             }
+
+            decoder->Release(row);
         }
     } catch(...) {
-        if(bit_pool)
-            TLGArenaDealloc(bit_pool);
-        if(pixelbuf)
-            TLGArenaDealloc(pixelbuf);
+        if(decoder)
+            decoder->Stop();
         if(filter_types)
             TLGArenaDealloc(filter_types);
         if(zeroline)
@@ -438,10 +629,7 @@ void TVPLoadTLG6(void *formatdata, void *callbackdata,
         }
         throw;
     }
-    if(bit_pool)
-        TLGArenaDealloc(bit_pool);
-    if(pixelbuf)
-        TLGArenaDealloc(pixelbuf);
+    decoder->Stop();
     if(filter_types)
         TLGArenaDealloc(filter_types);
     if(zeroline)
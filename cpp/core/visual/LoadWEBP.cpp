@@ -3,6 +3,8 @@
 #include "GraphicsLoaderIntf.h"
 #include "MsgIntf.h"
 #include "tjsDictionary.h"
+#include <algorithm>
+#include <cmath>
 #include <memory>
 
 void TVPLoadWEBP(void *formatdata, void *callbackdata,
@@ -23,8 +25,23 @@ void TVPLoadWEBP(void *formatdata, void *callbackdata,
         TVPThrowExceptionMessage(TJS_W("Invalid WebP image"));
     }
 
+    // let the decoder scale the image down when a smaller one is wanted
+    int width = config.input.width, height = config.input.height;
+    tTVPGraphicScaleHint hint = TVPGetGraphicScaleHint();
+    if(glmNormal == mode && (hint.MaxW || hint.MaxH)) {
+        double scale = std::max((double)hint.MaxW / config.input.width,
+                                (double)hint.MaxH / config.input.height);
+        if(scale < 1.0) {
+            width = std::max(1, (int)std::ceil(config.input.width * scale));
+            height = std::max(1, (int)std::ceil(config.input.height * scale));
+            config.options.use_scaling = 1;
+            config.options.scaled_width = width;
+            config.options.scaled_height = height;
+        }
+    }
+
     unsigned int stride =
-        sizecallback(callbackdata, config.input.width, config.input.height,
+        sizecallback(callbackdata, width, height,
                      config.input.has_alpha ? gpfRGBA : gpfRGB);
 #if 0
 	WebPData webp_data = { data, datasize };
@@ -42,7 +59,7 @@ void TVPLoadWEBP(void *formatdata, void *callbackdata,
         config.output.colorspace = MODE_RGBA;
         config.output.u.RGBA.rgba = scanline;
         config.output.u.RGBA.stride = stride;
-        config.output.u.RGBA.size = config.input.height * stride;
+        config.output.u.RGBA.size = height * stride;
         config.output.is_external_memory = 1;
         if(WebPDecode(data.get(), datasize, &config) != VP8_STATUS_OK) {
             TVPThrowExceptionMessage(TJS_W("Invalid WebP image(RGBA mode)"));
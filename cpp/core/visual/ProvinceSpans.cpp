@@ -0,0 +1,76 @@
+//---------------------------------------------------------------------------
+// compact province image
+//---------------------------------------------------------------------------
+#include "tjsCommHead.h"
+
+#include "ProvinceSpans.h"
+#include "LayerBitmapIntf.h"
+
+#include <algorithm>
+#include <cstring>
+
+//---------------------------------------------------------------------------
+// tTVPProvinceSpans
+//---------------------------------------------------------------------------
+tTVPProvinceSpans *tTVPProvinceSpans::Create(const tTVPBaseBitmap *bmp) {
+    if(!bmp->Is8BPP())
+        return nullptr;
+    tjs_uint w = bmp->GetWidth(), h = bmp->GetHeight();
+    if(!w || !h || w > 0x10000)
+        return nullptr;
+
+    // give up as soon as the spans would exceed a quarter of the bitmap
+    tjs_uint64 limit = (tjs_uint64)w * h / 4;
+
+    auto *spans = new tTVPProvinceSpans();
+    try {
+        spans->Width = w;
+        spans->Height = h;
+        spans->RowStart.resize(h + 1);
+        for(tjs_uint y = 0; y < h; y++) {
+            spans->RowStart[y] = (tjs_uint32)spans->SpanX.size();
+            const auto *line = (const tjs_uint8 *)bmp->GetScanLine(y);
+            tjs_uint x = 0;
+            while(x < w) {
+                tjs_uint8 v = line[x];
+                spans->SpanX.push_back((tjs_uint16)x);
+                spans->SpanValue.push_back(v);
+                x++;
+                while(x < w && line[x] == v)
+                    x++;
+            }
+            if(spans->GetBytes() > limit) {
+                delete spans;
+                return nullptr;
+            }
+        }
+        spans->RowStart[h] = (tjs_uint32)spans->SpanX.size();
+        spans->SpanX.shrink_to_fit();
+        spans->SpanValue.shrink_to_fit();
+    } catch(...) {
+        delete spans;
+        throw;
+    }
+    return spans;
+}
+//---------------------------------------------------------------------------
+tjs_uint8 tTVPProvinceSpans::GetPoint(tjs_uint x, tjs_uint y) const {
+    // the span containing x is the last one starting at or before x; every
+    // row has a span starting at 0
+    const tjs_uint16 *first = SpanX.data() + RowStart[y];
+    const tjs_uint16 *last = SpanX.data() + RowStart[y + 1];
+    const tjs_uint16 *it = std::upper_bound(first, last, (tjs_uint16)x) - 1;
+    return SpanValue[it - SpanX.data()];
+}
+//---------------------------------------------------------------------------
+void tTVPProvinceSpans::Expand(tTVPBaseBitmap *dest) const {
+    for(tjs_uint y = 0; y < Height; y++) {
+        auto *line = (tjs_uint8 *)dest->GetScanLineForWrite(y);
+        tjs_uint32 end = RowStart[y + 1];
+        for(tjs_uint32 i = RowStart[y]; i < end; i++) {
+            tjs_uint next = i + 1 < end ? SpanX[i + 1] : Width;
+            memset(line + SpanX[i], SpanValue[i], next - SpanX[i]);
+        }
+    }
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,55 @@
+//---------------------------------------------------------------------------
+// compact province image
+//---------------------------------------------------------------------------
+/*
+        read-only run-length form of an 8bpp province image.
+
+        each row is a sorted list of spans ( start x, province number );
+        a span lasts until the next one starts. a pixel lookup is a binary
+        search in its row. province maps consist of a few large flat
+        regions, so this takes a small fraction of the full bitmap.
+*/
+//---------------------------------------------------------------------------
+#ifndef ProvinceSpansH
+#define ProvinceSpansH
+
+#include "tjsTypes.h"
+#include <vector>
+
+class tTVPBaseBitmap;
+
+//---------------------------------------------------------------------------
+// tTVPProvinceSpans
+//---------------------------------------------------------------------------
+class tTVPProvinceSpans {
+    tjs_uint Width = 0;
+    tjs_uint Height = 0;
+    std::vector<tjs_uint32> RowStart; // first span of each row; Height + 1
+    std::vector<tjs_uint16> SpanX; // start x of each span
+    std::vector<tjs_uint8> SpanValue; // province number of each span
+
+    tTVPProvinceSpans() = default;
+
+public:
+    // returns nullptr when the image is not 8bpp, is too wide, or the
+    // compact form would not be much smaller than the bitmap
+    static tTVPProvinceSpans *Create(const tTVPBaseBitmap *bmp);
+
+    [[nodiscard]] tjs_uint GetWidth() const { return Width; }
+    [[nodiscard]] tjs_uint GetHeight() const { return Height; }
+
+    // x and y must be in range
+    [[nodiscard]] tjs_uint8 GetPoint(tjs_uint x, tjs_uint y) const;
+
+    // writes the image into an 8bpp bitmap of the same size
+    void Expand(tTVPBaseBitmap *dest) const;
+
+    [[nodiscard]] tjs_uint64 GetBytes() const {
+        return RowStart.size() * sizeof(tjs_uint32) +
+            SpanX.size() * sizeof(tjs_uint16) +
+            SpanValue.size() * sizeof(tjs_uint8);
+    }
+};
+//---------------------------------------------------------------------------
+
+#endif
@@ -15,6 +15,9 @@
 #include <float.h>
 #include <math.h>
 #include <cmath>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 // #include "tvpgl_ia32_intf.h"
@@ -24,23 +27,8 @@
 #include "WeightFunctor.h"
 #include "ThreadIntf.h"
 
-#include "aligned_allocator.h"
 #include "ResampleImageInternal.h"
 
-extern void TVPResampleImageAVX2(const tTVPResampleClipping &clip,
-                                 const tTVPImageCopyFuncBase *blendfunc,
-                                 iTVPBaseBitmap *dest, const tTVPRect &destrect,
-                                 const iTVPBaseBitmap *src,
-                                 const tTVPRect &srcrect,
-                                 tTVPBBStretchType type, tjs_real typeopt);
-
-extern void TVPResampleImageSSE2(const tTVPResampleClipping &clip,
-                                 const tTVPImageCopyFuncBase *blendfunc,
-                                 iTVPBaseBitmap *dest, const tTVPRect &destrect,
-                                 const iTVPBaseBitmap *src,
-                                 const tTVPRect &srcrect,
-                                 tTVPBBStretchType type, tjs_real typeopt);
-
 void tTVPBlendParameter::setFunctionFromParam() {
 #define TVP_BLEND_4(basename) /* blend for 4 types (normal, opacity,           \
                                  HDA, HDA opacity) */                          \
@@ -219,22 +207,12 @@ void tTVPResampleClipping::setClipping(const tTVPRect &cliprect,
 /**
  * 各軸でのウェイトをあらかじめ計算しておく
  */
-template <typename TWeight = float, int NAlign = 4>
 struct AxisParam {
-    typedef TWeight weight_t;
-    typedef std::vector<weight_t, aligned_allocator<weight_t, NAlign>>
-        weight_vector_t;
-    static const int ALIGN_DIV = (NAlign / 4);
-    static const int ALIGN_OFFSET = ALIGN_DIV - 1;
+    typedef float weight_t;
 
     std::vector<int> start_; // 開始インデックス
     std::vector<int> length_; // 各要素長さ
-    std::vector<int> min_length_;
-    weight_vector_t weight_;
-
-    static int toAlign(int &length) {
-        length = ((length + ALIGN_OFFSET) / ALIGN_DIV) * ALIGN_DIV;
-    }
+    std::vector<weight_t> weight_;
 };
 
 static inline void AxisParamCalculateWeight(float *weight, float *&output,
@@ -305,11 +283,7 @@ static void AxisParamCalculateAxis(TParam &param, int srcstart, int srcend,
         std::vector<float> work(maxrange, 0.0f);
         float *weight = &work[0];
         int length = (dstlength * maxrange + dstlength);
-#ifdef _DEBUG
         param.weight_.resize(length);
-#else
-        param.weight_.reserve(length);
-#endif
         typename TParam::weight_t *output = &param.weight_[0];
         for(int x = 0; x < dstlength; x++) {
             float cx =
@@ -344,11 +318,7 @@ static void AxisParamCalculateAxis(TParam &param, int srcstart, int srcend,
         std::vector<float> work(maxrange, 0.0f);
         float *weight = &work[0];
         int length = (srclength * maxrange + srclength);
-#ifdef _DEBUG
         param.weight_.resize(length);
-#else
-        param.weight_.reserve(length);
-#endif
         typename TParam::weight_t *output = &param.weight_[0];
         const float delta =
             (float)dstlength / (float)srclength; // 転送先座標での位置増分
@@ -394,394 +364,305 @@ static void AxisParamCalculateAxisAreaAvg(TParam &param, int srcstart,
         TVPCalculateAxisAreaAvg(srcstart, srcend, srclength, dstlength,
                                 param.start_, param.length_, param.weight_);
         TVPNormalizeAxisAreaAvg(param.length_, param.weight_);
+        // 開始インデックスは 0 起点で計算されるので、ソース位置に合わせる
+        for(int &start : param.start_) {
+            start += srcstart;
+        }
     }
 }
 
-void TJS_USERENTRY ResamplerFunc(void *p);
-
-class Resampler {
-    AxisParam<> paramx_;
-    AxisParam<> paramy_;
+/**
+ * 各軸の固定小数点ウェイトテーブル
+ * TVPResampleRowH/TVPResampleRowV にそのまま渡せる形式
+ */
+struct tTVPResampleAxis {
+    std::vector<int> start_; // 開始インデックス
+    std::vector<int> length_; // 各要素長さ
+    std::vector<int> offset_; // 各要素のウェイト開始位置
+    std::vector<tjs_int> weight_; // TVP_RESAMPLE_WEIGHT_BITS の固定小数点
+};
 
-public:
-    /** マルチスレッド化用 */
-    struct ThreadParameter {
-        Resampler *sampler_;
-        int start_;
-        int end_;
-        int width_;
-
-        const float *wstarty_;
-        const iTVPBaseBitmap *src_;
-        const tTVPRect *srcrect_;
-        iTVPBaseBitmap *dest_;
-        const tTVPRect *destrect_;
-
-        const tTVPResampleClipping *clip_;
-        const tTVPImageCopyFuncBase *blendfunc_;
-    };
-
-    /** 縦方向の拡大縮小処理 */
-    inline void samplingVertical(int y, tjs_uint32 *dstbits, int dstheight,
-                                 int srcwidth, const iTVPBaseBitmap *src,
-                                 const tTVPRect &srcrect,
-                                 const float *&wstarty) {
-        const int top = paramy_.start_[y];
-        const int len = paramy_.length_[y];
-        const int bottom = top + len;
-        const float *weighty = wstarty;
-        const tjs_uint32 *srctop =
-            (const tjs_uint32 *)src->GetScanLine(top) + srcrect.left;
-        tjs_int stride = src->GetPitchBytes() / (int)sizeof(tjs_uint32);
-        for(int x = 0; x < srcwidth; x++) {
-            weighty = wstarty;
-            float color_element[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-            const tjs_uint32 *src = &srctop[x];
-            for(int sy = top; sy < bottom; sy++) {
-                const float weight = *weighty;
-                tjs_uint32 color = *src;
-                color_element[0] += (color & 0xff) * weight;
-                color_element[1] += ((color >> 8) & 0xff) * weight;
-                color_element[2] += ((color >> 16) & 0xff) * weight;
-                color_element[3] += ((color >> 24) & 0xff) * weight;
-                weighty++;
-                src += stride;
-            }
-            tjs_uint32 color =
-                (tjs_uint32)((color_element[0] > 255)     ? 255
-                                 : (color_element[0] < 0) ? 0
-                                                          : color_element[0]);
-            color +=
-                (tjs_uint32)((color_element[1] > 255)     ? 255
-                                 : (color_element[1] < 0) ? 0
-                                                          : color_element[1])
-                << 8;
-            color +=
-                (tjs_uint32)((color_element[2] > 255)     ? 255
-                                 : (color_element[2] < 0) ? 0
-                                                          : color_element[2])
-                << 16;
-            color +=
-                (tjs_uint32)((color_element[3] > 255)     ? 255
-                                 : (color_element[3] < 0) ? 0
-                                                          : color_element[3])
-                << 24;
-            *dstbits = color;
-            dstbits++;
+/**
+ * 浮動小数点のウェイトを固定小数点に変換する
+ * 丸め誤差は絶対値最大のウェイトに寄せ、合計をちょうど 1.0 にする
+ */
+static void AxisParamToFixed(const AxisParam &param,
+                             tTVPResampleAxis &axis) {
+    const tjs_int one = 1 << TVP_RESAMPLE_WEIGHT_BITS;
+    const int count = (int)param.length_.size();
+    axis.start_ = param.start_;
+    axis.length_ = param.length_;
+    axis.offset_.resize(count);
+    int total = 0;
+    for(int i = 0; i < count; i++) {
+        axis.offset_[i] = total;
+        total += param.length_[i];
+    }
+    axis.weight_.resize(total);
+    const float *w = param.weight_.data();
+    tjs_int *output = axis.weight_.data();
+    for(int i = 0; i < count; i++) {
+        const int len = param.length_[i];
+        float fsum = 0.0f;
+        tjs_int sum = 0;
+        int peak = 0;
+        for(int j = 0; j < len; j++) {
+            fsum += w[j];
+            output[j] = (tjs_int)std::lround(w[j] * (float)one);
+            sum += output[j];
+            if(std::abs(w[j]) > std::abs(w[peak]))
+                peak = j;
         }
-        wstarty = weighty;
+        // 合計が 0 の場合 (正規化できなかった場合) はそのまま
+        if(len > 0 && fsum > 0.5f)
+            output[peak] += one - sum;
+        w += len;
+        output += len;
     }
+}
 
-    /** 横方向の拡大縮小処理 */
-    inline void samplingHorizontal(tjs_uint32 *dstbits, const int offsetx,
-                                   const int dstwidth,
-                                   const tjs_uint32 *srcbits) {
-        const float *weightx = &paramx_.weight_[0];
-        // まずoffset分をスキップ
-        for(int x = 0; x < offsetx; x++) {
-            weightx += paramx_.length_[x];
-        }
-        const tjs_uint32 *src = srcbits;
-        for(int x = offsetx; x < dstwidth; x++) {
-            const int left = paramx_.start_[x];
-            int right = left + paramx_.length_[x];
-            float color_element[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-            for(int sx = left; sx < right; sx++) {
-                const float weight = *weightx;
-                tjs_uint32 color = srcbits[sx];
-                color_element[0] += (color & 0xff) * weight;
-                color_element[1] += ((color >> 8) & 0xff) * weight;
-                color_element[2] += ((color >> 16) & 0xff) * weight;
-                color_element[3] += ((color >> 24) & 0xff) * weight;
-                weightx++;
+/**
+ * ウェイトテーブルのキャッシュ
+ * サムネイルや UI の拡大縮小は同じ (転送元, 転送先, フィルタ) で繰り返し
+ * 呼ばれるので、計算済みのテーブルを使い回す
+ */
+struct tTVPResampleAxisKey {
+    int srcstart_;
+    int srcend_;
+    int srclength_;
+    int dstlength_;
+    tTVPBBStretchType type_;
+    float typeopt_;
+
+    bool operator==(const tTVPResampleAxisKey &rhs) const {
+        return srcstart_ == rhs.srcstart_ && srcend_ == rhs.srcend_ &&
+            srclength_ == rhs.srclength_ && dstlength_ == rhs.dstlength_ &&
+            type_ == rhs.type_ && typeopt_ == rhs.typeopt_;
+    }
+};
+
+class tTVPResampleAxisCache {
+    static const size_t MAX_ENTRIES = 16;
+
+    std::mutex mutex_;
+    // 先頭ほど最近使われたもの
+    std::list<std::pair<tTVPResampleAxisKey,
+                        std::shared_ptr<const tTVPResampleAxis>>>
+        entries_;
+
+public:
+    template <typename TBuild>
+    std::shared_ptr<const tTVPResampleAxis>
+    get(const tTVPResampleAxisKey &key, TBuild build) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for(auto i = entries_.begin(); i != entries_.end(); ++i) {
+                if(i->first == key) {
+                    entries_.splice(entries_.begin(), entries_, i);
+                    return i->second;
+                }
             }
-            tjs_uint32 color =
-                (tjs_uint32)((color_element[0] > 255)     ? 255
-                                 : (color_element[0] < 0) ? 0
-                                                          : color_element[0]);
-            color +=
-                (tjs_uint32)((color_element[1] > 255)     ? 255
-                                 : (color_element[1] < 0) ? 0
-                                                          : color_element[1])
-                << 8;
-            color +=
-                (tjs_uint32)((color_element[2] > 255)     ? 255
-                                 : (color_element[2] < 0) ? 0
-                                                          : color_element[2])
-                << 16;
-            color +=
-                (tjs_uint32)((color_element[3] > 255)     ? 255
-                                 : (color_element[3] < 0) ? 0
-                                                          : color_element[3])
-                << 24;
-            *dstbits = color;
-            dstbits++;
         }
+        // テーブル作成はロックの外で行う
+        auto axis = std::make_shared<tTVPResampleAxis>();
+        {
+            AxisParam param;
+            build(param);
+            AxisParamToFixed(param, *axis);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.emplace_front(key, axis);
+        if(entries_.size() > MAX_ENTRIES)
+            entries_.pop_back();
+        return axis;
     }
+};
+
+static tTVPResampleAxisCache TVPResampleAxisCache;
+
+template <typename TWeightFunc>
+static std::shared_ptr<const tTVPResampleAxis>
+TVPGetResampleAxis(int srcstart, int srcend, int srclength, int dstlength,
+                   tTVPBBStretchType type, float typeopt, float tap,
+                   TWeightFunc &func) {
+    tTVPResampleAxisKey key = { srcstart,  srcend, srclength,
+                                dstlength, type,   typeopt };
+    return TVPResampleAxisCache.get(key, [&](AxisParam &param) {
+        AxisParamCalculateAxis(param, srcstart, srcend, srclength, dstlength,
+                               tap, func);
+    });
+}
+
+static std::shared_ptr<const tTVPResampleAxis>
+TVPGetResampleAxisAreaAvg(int srcstart, int srcend, int srclength,
+                          int dstlength, tTVPBBStretchType type) {
+    tTVPResampleAxisKey key = { srcstart,  srcend, srclength,
+                                dstlength, type,   0.0f };
+    return TVPResampleAxisCache.get(key, [&](AxisParam &param) {
+        AxisParamCalculateAxisAreaAvg(param, srcstart, srcend, srclength,
+                                      dstlength);
+    });
+}
 
-    void ResampleImage(const tTVPResampleClipping &clip,
+/**
+ * 固定小数点の分離型拡大縮小
+ * 横方向を先に処理し、縦方向のタップ数分の行だけをリングバッファに保持する。
+ * 作業領域は (最大タップ数 x 転送先幅) に収まり、キャッシュに乗ったまま
+ * 縦方向の処理に渡される
+ */
+class Resampler {
+    std::shared_ptr<const tTVPResampleAxis> axisx_;
+    std::shared_ptr<const tTVPResampleAxis> axisy_;
+
+public:
+    Resampler(std::shared_ptr<const tTVPResampleAxis> axisx,
+              std::shared_ptr<const tTVPResampleAxis> axisy) :
+        axisx_(std::move(axisx)), axisy_(std::move(axisy)) {}
+
+    /** 転送先の [top, bottom) 行を処理する */
+    void ResampleLines(const tTVPResampleClipping &clip,
                        const tTVPImageCopyFuncBase *blendfunc,
-                       iTVPBaseBitmap *dest, const tTVPRect &destrect,
-                       const iTVPBaseBitmap *src, const tTVPRect &srcrect) {
-        const int srcwidth = srcrect.get_width();
-        const int dstheight = destrect.get_height();
-#ifdef _DEBUG
-        std::vector<tjs_uint32> work(srcwidth);
-#else
-        std::vector<tjs_uint32> work;
-        work.reserve(srcwidth);
-#endif
-        const float *wstarty = &paramy_.weight_[0];
+                       iTVPBaseBitmap *dest, const iTVPBaseBitmap *src,
+                       const tTVPRect &srcrect, int top, int bottom) const {
+        const tTVPResampleAxis &ax = *axisx_;
+        const tTVPResampleAxis &ay = *axisy_;
+        const int width = clip.getDestWidth();
         // クリッピング部分スキップ
-        for(int y = 0; y < clip.offsety_; y++) {
-            wstarty += paramy_.length_[y];
+        const int *startx = &ax.start_[clip.offsetx_];
+        const int *lengthx = &ax.length_[clip.offsetx_];
+        const tjs_int *weightx = &ax.weight_[ax.offset_[clip.offsetx_]];
+
+        int ringsize = 1;
+        for(int y = top; y < bottom; y++) {
+            if(ay.length_[y] > ringsize)
+                ringsize = ay.length_[y];
         }
-        tjs_uint32 *workbits = &work[0];
+        // 横方向処理済みの行 (ソース行 % ringsize の位置に置く)
+        std::vector<tjs_uint32> ring((size_t)ringsize * width);
+        std::vector<const tjs_uint32 *> lines(ringsize);
+        std::vector<tjs_uint32> midwork; // 途中処理用バッファ
+        if(blendfunc)
+            midwork.resize(width);
+
         tjs_int dststride = dest->GetPitchBytes() / (int)sizeof(tjs_uint32);
-        tjs_uint32 *dstbits =
-            (tjs_uint32 *)dest->GetScanLineForWrite(clip.dst_top_) +
+        tjs_uint32 *dstbits = (tjs_uint32 *)dest->GetScanLineForWrite(
+                                  clip.dst_top_ + top - clip.offsety_) +
             clip.dst_left_;
-        if(blendfunc == nullptr) {
-            for(int y = clip.offsety_; y < clip.height_; y++) {
-                samplingVertical(y, workbits, dstheight, srcwidth, src, srcrect,
-                                 wstarty);
-                samplingHorizontal(dstbits, clip.offsetx_, clip.width_,
-                                   workbits);
-                dstbits += dststride;
+        int next = 0; // 次に横方向処理するソース行
+        for(int y = top; y < bottom; y++) {
+            const int srctop = ay.start_[y];
+            const int len = ay.length_[y];
+            if(next < srctop)
+                next = srctop;
+            for(; next < srctop + len; next++) {
+                const tjs_uint32 *srcbits =
+                    (const tjs_uint32 *)src->GetScanLine(next) + srcrect.left;
+                TVPResampleRowH(&ring[(size_t)(next % ringsize) * width],
+                                srcbits, startx, lengthx, weightx, width);
             }
-        } else { // 単純コピー以外は、一度テンポラリに書き出してから合成する
-#ifdef _DEBUG
-            std::vector<tjs_uint32> dstwork(clip.getDestWidth());
-#else
-            std::vector<tjs_uint32> dstwork;
-            dstwork.reserve(clip.getDestWidth());
-#endif
-            tjs_uint32 *midbits = &dstwork[0]; // 途中処理用バッファ
-            for(int y = clip.offsety_; y < clip.height_; y++) {
-                samplingVertical(y, workbits, dstheight, srcwidth, src, srcrect,
-                                 wstarty);
-                samplingHorizontal(midbits, clip.offsetx_, clip.width_,
-                                   workbits); // 一時バッファにまずコピー,
-                                              // 範囲外は処理しない
-                (*blendfunc)(dstbits, midbits, clip.getDestWidth());
-                dstbits += dststride;
+            for(int i = 0; i < len; i++) {
+                lines[i] = &ring[(size_t)((srctop + i) % ringsize) * width];
             }
-        }
-    }
-    void ResampleImageMT(const tTVPResampleClipping &clip,
-                         const tTVPImageCopyFuncBase *blendfunc,
-                         iTVPBaseBitmap *dest, const tTVPRect &destrect,
-                         const iTVPBaseBitmap *src, const tTVPRect &srcrect,
-                         tjs_int threadNum) {
-        const int srcwidth = srcrect.get_width();
-        const float *wstarty = &paramy_.weight_[0];
-        // クリッピング部分スキップ
-        for(int y = 0; y < clip.offsety_; y++) {
-            wstarty += paramy_.length_[y];
-        }
-        int offset = clip.offsety_;
-        const int height = clip.getDestHeight();
-
-        //		TVPBeginThreadTask(threadNum);
-        std::vector<ThreadParameter> params(threadNum);
-        for(int i = 0; i < threadNum; i++) {
-            ThreadParameter *param = &params[i];
-            param->sampler_ = this;
-            param->start_ = height * i / threadNum + offset;
-            param->end_ = height * (i + 1) / threadNum + offset;
-            param->width_ = srcwidth;
-            param->wstarty_ = wstarty;
-            param->src_ = src;
-            param->srcrect_ = &srcrect;
-            param->dest_ = dest;
-            param->destrect_ = &destrect;
-            param->clip_ = &clip;
-            param->blendfunc_ = blendfunc;
-            int top = param->start_;
-            int bottom = param->end_;
-            //	TVPExecThreadTask(&ResamplerFunc,
-            // TVP_THREAD_PARAM(param));
-            if(i < (threadNum - 1)) {
-                for(int y = top; y < bottom; y++) {
-                    int len = paramy_.length_[y];
-                    wstarty += len;
-                }
+            const tjs_int *weighty = &ay.weight_[ay.offset_[y]];
+            if(blendfunc == nullptr) {
+                TVPResampleRowV(dstbits, lines.data(), weighty, len, width);
+            } else { // 単純コピー以外は、一度テンポラリに書き出してから合成する
+                TVPResampleRowV(midwork.data(), lines.data(), weighty, len,
+                                width);
+                (*blendfunc)(dstbits, midwork.data(), width);
             }
+            dstbits += dststride;
         }
-        //		TVPEndThreadTask();
-        TVPExecThreadTask(threadNum, [&](int i) { ResamplerFunc(&params[i]); });
     }
 
-public:
-    /** シングルスレッド */
-    template <typename TWeightFunc>
     void Resample(const tTVPResampleClipping &clip,
                   const tTVPImageCopyFuncBase *blendfunc, iTVPBaseBitmap *dest,
-                  const tTVPRect &destrect, const iTVPBaseBitmap *src,
-                  const tTVPRect &srcrect, float tap, TWeightFunc &func) {
-        const int srcwidth = srcrect.get_width();
-        const int srcheight = srcrect.get_height();
-        const int dstwidth = destrect.get_width();
-        const int dstheight = destrect.get_height();
-        AxisParamCalculateAxis(paramx_, 0, srcwidth, srcwidth, dstwidth, tap,
-                               func);
-        AxisParamCalculateAxis(paramy_, srcrect.top, srcrect.bottom, srcheight,
-                               dstheight, tap, func);
-        ResampleImage(clip, blendfunc, dest, destrect, src, srcrect);
-    }
-    template <typename TWeightFunc>
-    void ResampleMT(const tTVPResampleClipping &clip,
-                    const tTVPImageCopyFuncBase *blendfunc,
-                    iTVPBaseBitmap *dest, const tTVPRect &destrect,
-                    const iTVPBaseBitmap *src, const tTVPRect &srcrect,
-                    float tap, TWeightFunc &func) {
-        const int srcwidth = srcrect.get_width();
-        const int srcheight = srcrect.get_height();
-        const int dstwidth = destrect.get_width();
-        const int dstheight = destrect.get_height();
-        int maxwidth = srcwidth > dstwidth ? srcwidth : dstwidth;
-        int maxheight = srcheight > dstheight ? srcheight : dstheight;
-        int threadNum = 1;
-        int pixelNum =
-            maxwidth * (int)tap * maxheight + maxheight * (int)tap * maxwidth;
-        if(pixelNum >= 50 * 500) {
-            threadNum = TVPGetThreadNum();
-        }
-        if(threadNum == 1) { // 面積が少なくスレッドが1の時はそのまま実行
-            Resample(clip, blendfunc, dest, destrect, src, srcrect, tap, func);
-            return;
-        }
-        AxisParamCalculateAxis(paramx_, 0, srcwidth, srcwidth, dstwidth, tap,
-                               func);
-        AxisParamCalculateAxis(paramy_, srcrect.top, srcrect.bottom, srcheight,
-                               dstheight, tap, func);
-        ResampleImageMT(clip, blendfunc, dest, destrect, src, srcrect,
-                        threadNum);
-    }
-    void ResampleAreaAvg(const tTVPResampleClipping &clip,
-                         const tTVPImageCopyFuncBase *blendfunc,
-                         iTVPBaseBitmap *dest, const tTVPRect &destrect,
-                         const iTVPBaseBitmap *src, const tTVPRect &srcrect) {
-        const int srcwidth = srcrect.get_width();
-        const int srcheight = srcrect.get_height();
-        const int dstwidth = destrect.get_width();
-        const int dstheight = destrect.get_height();
-        if(dstwidth > srcwidth || dstheight > srcheight)
-            return;
-        AxisParamCalculateAxisAreaAvg(paramx_, 0, srcwidth, srcwidth, dstwidth);
-        AxisParamCalculateAxisAreaAvg(paramy_, srcrect.top, srcrect.bottom,
-                                      srcheight, dstheight);
-        ResampleImage(clip, blendfunc, dest, destrect, src, srcrect);
-    }
-    void ResampleAreaAvgMT(const tTVPResampleClipping &clip,
-                           const tTVPImageCopyFuncBase *blendfunc,
-                           iTVPBaseBitmap *dest, const tTVPRect &destrect,
-                           const iTVPBaseBitmap *src, const tTVPRect &srcrect) {
-        const int srcwidth = srcrect.get_width();
-        const int srcheight = srcrect.get_height();
-        const int dstwidth = destrect.get_width();
-        const int dstheight = destrect.get_height();
-        if(dstwidth > srcwidth || dstheight > srcheight)
-            return;
-        int maxwidth = srcwidth > dstwidth ? srcwidth : dstwidth;
-        int maxheight = srcheight > dstheight ? srcheight : dstheight;
-        int threadNum = 1;
-        int pixelNum = maxwidth * maxheight;
-        if(pixelNum >= 50 * 500) {
-            threadNum = TVPGetThreadNum();
-        }
-        if(threadNum == 1) { // 面積が少なくスレッドが1の時はそのまま実行
-            ResampleAreaAvg(clip, blendfunc, dest, destrect, src, srcrect);
+                  const iTVPBaseBitmap *src, const tTVPRect &srcrect,
+                  tjs_int threadNum) const {
+        const int offset = clip.offsety_;
+        const int height = clip.getDestHeight();
+        if(threadNum > height)
+            threadNum = height;
+        if(threadNum <= 1) { // 面積が少なくスレッドが1の時はそのまま実行
+            ResampleLines(clip, blendfunc, dest, src, srcrect, offset,
+                          clip.height_);
             return;
         }
-        AxisParamCalculateAxisAreaAvg(paramx_, 0, srcwidth, srcwidth, dstwidth);
-        AxisParamCalculateAxisAreaAvg(paramy_, srcrect.top, srcrect.bottom,
-                                      srcheight, dstheight);
-        ResampleImageMT(clip, blendfunc, dest, destrect, src, srcrect,
-                        threadNum);
+        TVPExecThreadTask(threadNum, [&](int i) {
+            ResampleLines(clip, blendfunc, dest, src, srcrect,
+                          height * i / threadNum + offset,
+                          height * (i + 1) / threadNum + offset);
+        });
     }
 };
 
-void TJS_USERENTRY ResamplerFunc(void *p) {
-    Resampler::ThreadParameter *param = (Resampler::ThreadParameter *)p;
-    const int width = param->width_;
-#ifdef _DEBUG
-    std::vector<tjs_uint32> work(width);
-#else
-    std::vector<tjs_uint32> work;
-    work.reserve(width);
-#endif
-
-    iTVPBaseBitmap *dest = param->dest_;
-    const tTVPRect &destrect = *param->destrect_;
-    const iTVPBaseBitmap *src = param->src_;
-    const tTVPRect &srcrect = *param->srcrect_;
+/** 処理量からスレッド数を決める */
+static tjs_int TVPGetResampleThreadNum(int pixelNum) {
+    return pixelNum >= 50 * 500 ? TVPGetThreadNum() : 1;
+}
 
+template <typename TWeightFunc>
+static void TVPFilterResample(tTVPBBStretchType type,
+                              const tTVPResampleClipping &clip,
+                              const tTVPImageCopyFuncBase *blendfunc,
+                              iTVPBaseBitmap *dest, const tTVPRect &destrect,
+                              const iTVPBaseBitmap *src,
+                              const tTVPRect &srcrect, float typeopt,
+                              float tap, TWeightFunc &func) {
     const int srcwidth = srcrect.get_width();
+    const int srcheight = srcrect.get_height();
     const int dstwidth = destrect.get_width();
     const int dstheight = destrect.get_height();
-    const float *wstarty = param->wstarty_;
-    tjs_uint32 *workbits = &work[0];
-    tjs_int dststride = dest->GetPitchBytes() / (int)sizeof(tjs_uint32);
-    tjs_uint32 *dstbits =
-        (tjs_uint32 *)dest->GetScanLineForWrite(param->start_ + destrect.top) +
-        param->clip_->dst_left_;
-    if(param->blendfunc_ == nullptr) {
-        for(int y = param->start_; y < param->end_; y++) {
-            param->sampler_->samplingVertical(y, workbits, dstheight, srcwidth,
-                                              src, srcrect, wstarty);
-            param->sampler_->samplingHorizontal(dstbits, param->clip_->offsetx_,
-                                                param->clip_->width_, workbits);
-            dstbits += dststride;
-        }
-    } else { // 単純コピー以外
-#ifdef _DEBUG
-        std::vector<tjs_uint32> dstwork(param->clip_->getDestWidth());
-#else
-        std::vector<tjs_uint32> dstwork;
-        dstwork.reserve(param->clip_->getDestWidth());
-#endif
-        tjs_uint32 *midbits = &dstwork[0]; // 途中処理用バッファ
-        for(int y = param->start_; y < param->end_; y++) {
-            param->sampler_->samplingVertical(y, workbits, dstheight, srcwidth,
-                                              src, srcrect, wstarty);
-            param->sampler_->samplingHorizontal(
-                midbits, param->clip_->offsetx_, param->clip_->width_,
-                workbits); // 一時バッファにまずコピー,
-                           // 範囲外は処理しない
-            (*param->blendfunc_)(dstbits, midbits,
-                                 param->clip_->getDestWidth());
-            dstbits += dststride;
-        }
-    }
+    int maxwidth = srcwidth > dstwidth ? srcwidth : dstwidth;
+    int maxheight = srcheight > dstheight ? srcheight : dstheight;
+    int pixelNum =
+        maxwidth * (int)tap * maxheight + maxheight * (int)tap * maxwidth;
+    Resampler sampler(
+        TVPGetResampleAxis(0, srcwidth, srcwidth, dstwidth, type, typeopt, tap,
+                           func),
+        TVPGetResampleAxis(srcrect.top, srcrect.bottom, srcheight, dstheight,
+                           type, typeopt, tap, func));
+    sampler.Resample(clip, blendfunc, dest, src, srcrect,
+                     TVPGetResampleThreadNum(pixelNum));
 }
 
-void TVPBicubicResample(const tTVPResampleClipping &clip,
+void TVPBicubicResample(tTVPBBStretchType type,
+                        const tTVPResampleClipping &clip,
                         const tTVPImageCopyFuncBase *blendfunc,
                         iTVPBaseBitmap *dest, const tTVPRect &destrect,
                         const iTVPBaseBitmap *src, const tTVPRect &srcrect,
                         float sharpness) {
     BicubicWeight weightfunc(sharpness);
-    Resampler sampler;
-    sampler.ResampleMT(clip, blendfunc, dest, destrect, src, srcrect,
-                       BicubicWeight::RANGE, weightfunc);
+    TVPFilterResample(type, clip, blendfunc, dest, destrect, src, srcrect,
+                      sharpness, BicubicWeight::RANGE, weightfunc);
 }
-void TVPAreaAvgResample(const tTVPResampleClipping &clip,
+void TVPAreaAvgResample(tTVPBBStretchType type,
+                        const tTVPResampleClipping &clip,
                         const tTVPImageCopyFuncBase *blendfunc,
                         iTVPBaseBitmap *dest, const tTVPRect &destrect,
                         const iTVPBaseBitmap *src, const tTVPRect &srcrect) {
-    Resampler sampler;
-    sampler.ResampleAreaAvgMT(clip, blendfunc, dest, destrect, src, srcrect);
+    const int srcwidth = srcrect.get_width();
+    const int srcheight = srcrect.get_height();
+    const int dstwidth = destrect.get_width();
+    const int dstheight = destrect.get_height();
+    if(dstwidth > srcwidth || dstheight > srcheight)
+        return;
+    Resampler sampler(
+        TVPGetResampleAxisAreaAvg(0, srcwidth, srcwidth, dstwidth, type),
+        TVPGetResampleAxisAreaAvg(srcrect.top, srcrect.bottom, srcheight,
+                                  dstheight, type));
+    sampler.Resample(clip, blendfunc, dest, src, srcrect,
+                     TVPGetResampleThreadNum(srcwidth * srcheight));
 }
 template <typename TWeightFunc>
-void TVPWeightResample(const tTVPResampleClipping &clip,
+void TVPWeightResample(tTVPBBStretchType type,
+                       const tTVPResampleClipping &clip,
                        const tTVPImageCopyFuncBase *blendfunc,
                        iTVPBaseBitmap *dest, const tTVPRect &destrect,
                        const iTVPBaseBitmap *src, const tTVPRect &srcrect) {
     TWeightFunc weightfunc;
-    Resampler sampler;
-    sampler.ResampleMT(clip, blendfunc, dest, destrect, src, srcrect,
-                       TWeightFunc::RANGE, weightfunc);
+    TVPFilterResample(type, clip, blendfunc, dest, destrect, src, srcrect,
+                      0.0f, TWeightFunc::RANGE, weightfunc);
 }
 
 /**
@@ -821,93 +702,83 @@ void TVPResampleImage(const tTVPRect &cliprect, iTVPBaseBitmap *dest,
     }
 
     try {
-#if 0
-		tjs_uint32 CpuFeature = TVPGetCPUType();
-		if( (CpuFeature & TVP_CPU_HAS_AVX2) ) {
-			TVPResampleImageAVX2( clip, func, dest, destrect, src, srcrect, type, typeopt );
-		} else if( (CpuFeature & TVP_CPU_HAS_SSE2) ) {
-			TVPResampleImageSSE2( clip, func, dest, destrect, src, srcrect, type, typeopt );
-		} else
-#endif
-        {
-            // Cバージョンは固定小数点版なし。遅くなる。
-            switch(type) {
-                case stLinear:
-                    TVPWeightResample<BilinearWeight>(clip, func, dest,
-                                                      destrect, src, srcrect);
-                    break;
-                case stCubic:
-                    TVPBicubicResample(clip, func, dest, destrect, src, srcrect,
-                                       (float)typeopt);
-                    break;
-                case stLanczos2:
-                    TVPWeightResample<LanczosWeight<2>>(clip, func, dest,
-                                                        destrect, src, srcrect);
-                    break;
-                case stLanczos3:
-                    TVPWeightResample<LanczosWeight<3>>(clip, func, dest,
-                                                        destrect, src, srcrect);
-                    break;
-                case stSpline16:
-                    TVPWeightResample<Spline16Weight>(clip, func, dest,
-                                                      destrect, src, srcrect);
-                    break;
-                case stSpline36:
-                    TVPWeightResample<Spline36Weight>(clip, func, dest,
-                                                      destrect, src, srcrect);
-                    break;
-                case stAreaAvg:
-                    TVPAreaAvgResample(clip, func, dest, destrect, src,
-                                       srcrect);
-                    break;
-                case stGaussian:
-                    TVPWeightResample<GaussianWeight>(clip, func, dest,
-                                                      destrect, src, srcrect);
-                    break;
-                case stBlackmanSinc:
-                    TVPWeightResample<BlackmanSincWeight>(
-                        clip, func, dest, destrect, src, srcrect);
-                    break;
-                case stSemiFastLinear:
-                    TVPWeightResample<BilinearWeight>(clip, func, dest,
-                                                      destrect, src, srcrect);
-                    break;
-                case stFastCubic:
-                    TVPBicubicResample(clip, func, dest, destrect, src, srcrect,
-                                       (float)typeopt);
-                    break;
-                case stFastLanczos2:
-                    TVPWeightResample<LanczosWeight<2>>(clip, func, dest,
-                                                        destrect, src, srcrect);
-                    break;
-                case stFastSpline16:
-                    TVPWeightResample<Spline16Weight>(clip, func, dest,
-                                                      destrect, src, srcrect);
-                    break;
-                case stFastLanczos3:
-                    TVPWeightResample<LanczosWeight<3>>(clip, func, dest,
-                                                        destrect, src, srcrect);
-                    break;
-                case stFastSpline36:
-                    TVPWeightResample<Spline36Weight>(clip, func, dest,
-                                                      destrect, src, srcrect);
-                    break;
-                case stFastAreaAvg:
-                    TVPAreaAvgResample(clip, func, dest, destrect, src,
-                                       srcrect);
-                    break;
-                case stFastGaussian:
-                    TVPWeightResample<GaussianWeight>(clip, func, dest,
-                                                      destrect, src, srcrect);
-                    break;
-                case stFastBlackmanSinc:
-                    TVPWeightResample<BlackmanSincWeight>(
-                        clip, func, dest, destrect, src, srcrect);
-                    break;
-                default:
-                    throw L"Not supported yet.";
-                    break;
-            }
+        // 行の処理は TVPResampleRowH/TVPResampleRowV (SIMD 版あり) で行う
+        switch(type) {
+            case stLinear:
+                TVPWeightResample<BilinearWeight>(type, clip, func, dest,
+                                                  destrect, src, srcrect);
+                break;
+            case stCubic:
+                TVPBicubicResample(type, clip, func, dest, destrect, src,
+                                   srcrect, (float)typeopt);
+                break;
+            case stLanczos2:
+                TVPWeightResample<LanczosWeight<2>>(type, clip, func, dest,
+                                                    destrect, src, srcrect);
+                break;
+            case stLanczos3:
+                TVPWeightResample<LanczosWeight<3>>(type, clip, func, dest,
+                                                    destrect, src, srcrect);
+                break;
+            case stSpline16:
+                TVPWeightResample<Spline16Weight>(type, clip, func, dest,
+                                                  destrect, src, srcrect);
+                break;
+            case stSpline36:
+                TVPWeightResample<Spline36Weight>(type, clip, func, dest,
+                                                  destrect, src, srcrect);
+                break;
+            case stAreaAvg:
+                TVPAreaAvgResample(type, clip, func, dest, destrect, src,
+                                   srcrect);
+                break;
+            case stGaussian:
+                TVPWeightResample<GaussianWeight>(type, clip, func, dest,
+                                                  destrect, src, srcrect);
+                break;
+            case stBlackmanSinc:
+                TVPWeightResample<BlackmanSincWeight>(
+                    type, clip, func, dest, destrect, src, srcrect);
+                break;
+            case stSemiFastLinear:
+                TVPWeightResample<BilinearWeight>(type, clip, func, dest,
+                                                  destrect, src, srcrect);
+                break;
+            case stFastCubic:
+                TVPBicubicResample(type, clip, func, dest, destrect, src,
+                                   srcrect, (float)typeopt);
+                break;
+            case stFastLanczos2:
+                TVPWeightResample<LanczosWeight<2>>(type, clip, func, dest,
+                                                    destrect, src, srcrect);
+                break;
+            case stFastSpline16:
+                TVPWeightResample<Spline16Weight>(type, clip, func, dest,
+                                                  destrect, src, srcrect);
+                break;
+            case stFastLanczos3:
+                TVPWeightResample<LanczosWeight<3>>(type, clip, func, dest,
+                                                    destrect, src, srcrect);
+                break;
+            case stFastSpline36:
+                TVPWeightResample<Spline36Weight>(type, clip, func, dest,
+                                                  destrect, src, srcrect);
+                break;
+            case stFastAreaAvg:
+                TVPAreaAvgResample(type, clip, func, dest, destrect, src,
+                                   srcrect);
+                break;
+            case stFastGaussian:
+                TVPWeightResample<GaussianWeight>(type, clip, func, dest,
+                                                  destrect, src, srcrect);
+                break;
+            case stFastBlackmanSinc:
+                TVPWeightResample<BlackmanSincWeight>(
+                    type, clip, func, dest, destrect, src, srcrect);
+                break;
+            default:
+                throw L"Not supported yet.";
+                break;
         }
     } catch(...) {
         if(func)
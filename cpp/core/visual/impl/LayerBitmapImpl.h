@@ -15,6 +15,7 @@
 #include "ComplexRect.h"
 
 #include "BitmapInfomation.h"
+#include <atomic>
 
 //---------------------------------------------------------------------------
 extern void TVPSetFontCacheForLowMem();
@@ -28,7 +29,8 @@ public:
     static const tjs_int DEFAULT_PALETTE_COUNT = 256;
 
 private:
-    tjs_int RefCount;
+    // bitmaps are shared between decode workers and the graphic cache
+    std::atomic<tjs_int> RefCount;
 
     void *Bits; // pointer to bitmap bits
     BitmapInfomation *BitmapInfo; // DIB information
@@ -57,10 +59,8 @@ public:
     void AddRef() { RefCount++; }
 
     void Release() {
-        if(RefCount == 1)
+        if(--RefCount == 0)
             delete this;
-        else
-            RefCount--;
     }
 
     [[nodiscard]] tjs_uint GetWidth() const { return Width; }
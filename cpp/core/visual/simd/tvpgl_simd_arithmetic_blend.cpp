@@ -6,6 +6,8 @@
  *   TVPSubBlend - Subtraction blend
  *   TVPMulBlend - Multiplication blend
  *   TVPScreenBlend - Screen blend
+ *   TVPDarkenBlend - Per-channel minimum
+ *   TVPLightenBlend - Per-channel maximum
  *
  * Each with 4 variants: base, HDA, _o (opacity), HDA_o
  */
@@ -624,6 +626,140 @@ void ScreenBlend_HDA_o_HWY(tjs_uint32 *dest, const tjs_uint32 *src,
     }
 }
 
+// =========================================================================
+// DarkenBlend / LightenBlend: min / max of dest and src per channel
+// The C functors pick per byte with a carry trick, alpha byte included,
+// which is exactly Min / Max on u8 lanes. The opacity versions fade from
+// dest towards the result on the packed 0x00ff00ff / 0x0000ff00 channels
+// (alpha byte zero), done here on u32 lanes with the same arithmetic.
+// =========================================================================
+
+template <bool Lighten>
+static HWY_INLINE hn::Vec<hn::ScalableTag<uint8_t>> MinMaxBytes(
+    hn::Vec<hn::ScalableTag<uint8_t>> vd, hn::Vec<hn::ScalableTag<uint8_t>> vs) {
+    if constexpr(Lighten)
+        return hn::Max(vd, vs);
+    else
+        return hn::Min(vd, vs);
+}
+
+template <bool Lighten>
+static HWY_INLINE tjs_uint32 MinMaxPixel(tjs_uint32 d, tjs_uint32 s) {
+    tjs_uint32 r = 0;
+    for(int sh = 0; sh < 32; sh += 8) {
+        tjs_uint32 dc = (d >> sh) & 0xff, sc = (s >> sh) & 0xff;
+        r |= (Lighten ? (dc > sc ? dc : sc) : (dc < sc ? dc : sc)) << sh;
+    }
+    return r;
+}
+
+// darken_blend_func / lighten_blend_func
+template <bool Lighten>
+static HWY_INLINE tjs_uint32 MinMaxPixel_o(tjs_uint32 d, tjs_uint32 s,
+                                           tjs_uint32 a) {
+    tjs_uint32 tmp = MinMaxPixel<Lighten>(d, s);
+    tjs_uint32 d1 = d & 0xff00ff;
+    d1 = (d1 + (((tmp & 0xff00ff) - d1) * a >> 8)) & 0xff00ff;
+    tjs_uint32 d2 = d & 0xff00;
+    tmp &= 0xff00;
+    return d1 + ((d2 + ((tmp - d2) * a >> 8)) & 0xff00);
+}
+
+template <bool Lighten, bool HDA>
+static void MinMaxBlend(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len) {
+    const hn::ScalableTag<uint8_t> d8;
+    const size_t N_PIXELS = hn::Lanes(d8) / 4;
+    const auto alpha_mask = hn::Dup128VecFromValues(
+        d8,
+        0, 0, 0, 0xFF,  0, 0, 0, 0xFF,
+        0, 0, 0, 0xFF,  0, 0, 0, 0xFF
+    );
+
+    tjs_int i = 0;
+    for (; i + static_cast<tjs_int>(N_PIXELS) <= len; i += N_PIXELS) {
+        auto vs = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(src + i));
+        auto vd = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(dest + i));
+        auto result = MinMaxBytes<Lighten>(vd, vs);
+        if constexpr(HDA)
+            result = hn::Or(hn::AndNot(alpha_mask, result),
+                            hn::And(alpha_mask, vd));
+        hn::StoreU(result, d8, reinterpret_cast<uint8_t*>(dest + i));
+    }
+
+    for (; i < len; i++) {
+        tjs_uint32 d = dest[i];
+        tjs_uint32 r = MinMaxPixel<Lighten>(d, src[i]);
+        dest[i] = HDA ? (r & 0x00ffffff) | (d & 0xff000000) : r;
+    }
+}
+
+template <bool Lighten, bool HDA>
+static void MinMaxBlend_o(tjs_uint32 *dest, const tjs_uint32 *src,
+                          tjs_int len, tjs_int opa) {
+    const hn::ScalableTag<uint32_t> du;
+    const hn::Repartition<uint8_t, decltype(du)> d8;
+    const tjs_int N = static_cast<tjs_int>(hn::Lanes(du));
+    const auto va = hn::Set(du, static_cast<uint32_t>(opa));
+    const auto rbmask = hn::Set(du, 0x00ff00ffu);
+    const auto gmask = hn::Set(du, 0x0000ff00u);
+
+    tjs_int i = 0;
+    for (; i + N <= len; i += N) {
+        auto vs = hn::LoadU(du, src + i);
+        auto vd = hn::LoadU(du, dest + i);
+        auto tmp = hn::BitCast(
+            du, MinMaxBytes<Lighten>(hn::BitCast(d8, vd), hn::BitCast(d8, vs)));
+        auto d1 = hn::And(vd, rbmask);
+        d1 = hn::And(hn::Add(d1, hn::ShiftRight<8>(hn::Mul(
+                                     hn::Sub(hn::And(tmp, rbmask), d1), va))),
+                     rbmask);
+        auto d2 = hn::And(vd, gmask);
+        auto g = hn::And(hn::Add(d2, hn::ShiftRight<8>(hn::Mul(
+                                         hn::Sub(hn::And(tmp, gmask), d2), va))),
+                         gmask);
+        auto result = hn::Add(d1, g);
+        if constexpr(HDA)
+            result = hn::Or(result, hn::And(vd, hn::Set(du, 0xff000000u)));
+        hn::StoreU(result, du, dest + i);
+    }
+
+    for (; i < len; i++) {
+        tjs_uint32 d = dest[i];
+        tjs_uint32 r = MinMaxPixel_o<Lighten>(d, src[i], opa);
+        dest[i] = HDA ? (r & 0x00ffffff) | (d & 0xff000000) : r;
+    }
+}
+
+void DarkenBlend_HWY(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len) {
+    MinMaxBlend<false, false>(dest, src, len);
+}
+void DarkenBlend_HDA_HWY(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len) {
+    MinMaxBlend<false, true>(dest, src, len);
+}
+void DarkenBlend_o_HWY(tjs_uint32 *dest, const tjs_uint32 *src,
+                       tjs_int len, tjs_int opa) {
+    MinMaxBlend_o<false, false>(dest, src, len, opa);
+}
+void DarkenBlend_HDA_o_HWY(tjs_uint32 *dest, const tjs_uint32 *src,
+                           tjs_int len, tjs_int opa) {
+    MinMaxBlend_o<false, true>(dest, src, len, opa);
+}
+
+void LightenBlend_HWY(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len) {
+    MinMaxBlend<true, false>(dest, src, len);
+}
+void LightenBlend_HDA_HWY(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len) {
+    MinMaxBlend<true, true>(dest, src, len);
+}
+void LightenBlend_o_HWY(tjs_uint32 *dest, const tjs_uint32 *src,
+                        tjs_int len, tjs_int opa) {
+    MinMaxBlend_o<true, false>(dest, src, len, opa);
+}
+void LightenBlend_HDA_o_HWY(tjs_uint32 *dest, const tjs_uint32 *src,
+                            tjs_int len, tjs_int opa) {
+    MinMaxBlend_o<true, true>(dest, src, len, opa);
+}
+
 }  // namespace HWY_NAMESPACE
 }  // namespace krkr2
 HWY_AFTER_NAMESPACE();
@@ -647,6 +783,14 @@ HWY_EXPORT(ScreenBlend_HWY);
 HWY_EXPORT(ScreenBlend_HDA_HWY);
 HWY_EXPORT(ScreenBlend_o_HWY);
 HWY_EXPORT(ScreenBlend_HDA_o_HWY);
+HWY_EXPORT(DarkenBlend_HWY);
+HWY_EXPORT(DarkenBlend_HDA_HWY);
+HWY_EXPORT(DarkenBlend_o_HWY);
+HWY_EXPORT(DarkenBlend_HDA_o_HWY);
+HWY_EXPORT(LightenBlend_HWY);
+HWY_EXPORT(LightenBlend_HDA_HWY);
+HWY_EXPORT(LightenBlend_o_HWY);
+HWY_EXPORT(LightenBlend_HDA_o_HWY);
 }  // namespace krkr2
 
 extern "C" {
@@ -711,5 +855,35 @@ void TVPScreenBlend_HDA_o_hwy(tjs_uint32 *dest, const tjs_uint32 *src,
     krkr2::HWY_DYNAMIC_DISPATCH(ScreenBlend_HDA_o_HWY)(dest, src, len, opa);
 }
 
+void TVPDarkenBlend_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len) {
+    krkr2::HWY_DYNAMIC_DISPATCH(DarkenBlend_HWY)(dest, src, len);
+}
+void TVPDarkenBlend_HDA_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len) {
+    krkr2::HWY_DYNAMIC_DISPATCH(DarkenBlend_HDA_HWY)(dest, src, len);
+}
+void TVPDarkenBlend_o_hwy(tjs_uint32 *dest, const tjs_uint32 *src,
+                        tjs_int len, tjs_int opa) {
+    krkr2::HWY_DYNAMIC_DISPATCH(DarkenBlend_o_HWY)(dest, src, len, opa);
+}
+void TVPDarkenBlend_HDA_o_hwy(tjs_uint32 *dest, const tjs_uint32 *src,
+                            tjs_int len, tjs_int opa) {
+    krkr2::HWY_DYNAMIC_DISPATCH(DarkenBlend_HDA_o_HWY)(dest, src, len, opa);
+}
+
+void TVPLightenBlend_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len) {
+    krkr2::HWY_DYNAMIC_DISPATCH(LightenBlend_HWY)(dest, src, len);
+}
+void TVPLightenBlend_HDA_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len) {
+    krkr2::HWY_DYNAMIC_DISPATCH(LightenBlend_HDA_HWY)(dest, src, len);
+}
+void TVPLightenBlend_o_hwy(tjs_uint32 *dest, const tjs_uint32 *src,
+                         tjs_int len, tjs_int opa) {
+    krkr2::HWY_DYNAMIC_DISPATCH(LightenBlend_o_HWY)(dest, src, len, opa);
+}
+void TVPLightenBlend_HDA_o_hwy(tjs_uint32 *dest, const tjs_uint32 *src,
+                             tjs_int len, tjs_int opa) {
+    krkr2::HWY_DYNAMIC_DISPATCH(LightenBlend_HDA_o_HWY)(dest, src, len, opa);
+}
+
 }  // extern "C"
 #endif
@@ -5,15 +5,17 @@
  * using Google Highway's portable SIMD abstraction.
  */
 
-#ifndef __TVPGL_SIMD_COMMON_H__
+// Per-target include guard: the including .cpp is compiled once per
+// Highway target by foreach_target.h and must see these helpers each time.
+// Include this after <hwy/highway.h>.
+#if defined(__TVPGL_SIMD_COMMON_H__) == defined(HWY_TARGET_TOGGLE)
+#ifdef __TVPGL_SIMD_COMMON_H__
+#undef __TVPGL_SIMD_COMMON_H__
+#else
 #define __TVPGL_SIMD_COMMON_H__
+#endif
 
 #include "tjsTypes.h"
-
-#undef HWY_TARGET_INCLUDE
-#define HWY_TARGET_INCLUDE "tvpgl_simd_common.h"
-
-#include <hwy/foreach_target.h>
 #include <hwy/highway.h>
 
 HWY_BEFORE_NAMESPACE();
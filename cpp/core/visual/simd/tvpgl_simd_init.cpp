@@ -9,6 +9,9 @@
 #include "tjsTypes.h"
 #include "tvpgl.h"
 
+#include <cctype>
+#include <hwy/targets.h>
+
 // Forward declarations of Highway SIMD implementations
 extern "C" {
 
@@ -46,6 +49,18 @@ void TVPScreenBlend_HDA_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len
 void TVPScreenBlend_o_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len, tjs_int opa);
 void TVPScreenBlend_HDA_o_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len, tjs_int opa);
 
+// Phase 2: Darken Blend (4 variants)
+void TVPDarkenBlend_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len);
+void TVPDarkenBlend_HDA_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len);
+void TVPDarkenBlend_o_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len, tjs_int opa);
+void TVPDarkenBlend_HDA_o_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len, tjs_int opa);
+
+// Phase 2: Lighten Blend (4 variants)
+void TVPLightenBlend_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len);
+void TVPLightenBlend_HDA_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len);
+void TVPLightenBlend_o_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len, tjs_int opa);
+void TVPLightenBlend_HDA_o_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len, tjs_int opa);
+
 // Phase 2: Const Alpha Blend (4 variants)
 void TVPConstAlphaBlend_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len, tjs_int opa);
 void TVPConstAlphaBlend_HDA_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len, tjs_int opa);
@@ -64,7 +79,7 @@ void TVPAdditiveAlphaBlend_ao_hwy(tjs_uint32 *dest, const tjs_uint32 *src, tjs_i
 void TVPAlphaColorMat_hwy(tjs_uint32 *dest, const tjs_uint32 color, tjs_int len);
 
 // Phase 3: Photoshop blend modes (16 types × 4 variants = 64 functions)
-// Part 1: Fully SIMD-able (8 modes × 4 variants = 32)
+// Part 1: Packed arithmetic (8 modes × 4 variants = 32)
 #define DECLARE_PS_BLEND_4V(Name)                                             \
     void TVPPs##Name##Blend_hwy(tjs_uint32 *dest, const tjs_uint32 *src,      \
                                 tjs_int len);                                  \
@@ -84,7 +99,7 @@ DECLARE_PS_BLEND_4V(Lighten)
 DECLARE_PS_BLEND_4V(Darken)
 DECLARE_PS_BLEND_4V(Diff)
 
-// Part 2: Special handling (8 modes × 4 variants = 32)
+// Part 2: Table driven in C (8 modes × 4 variants = 32)
 DECLARE_PS_BLEND_4V(Overlay)
 DECLARE_PS_BLEND_4V(HardLight)
 DECLARE_PS_BLEND_4V(Exclusion)
@@ -132,9 +147,120 @@ void TVPChBlurAddMulCopy65_hwy(tjs_uint8 *dest, const tjs_uint8 *src, tjs_int le
 void TVPChBlurMulCopy_hwy(tjs_uint8 *dest, const tjs_uint8 *src, tjs_int len, tjs_int level);
 void TVPChBlurAddMulCopy_hwy(tjs_uint8 *dest, const tjs_uint8 *src, tjs_int len, tjs_int level);
 
+// TLG decoder
+void TVPTLG5ComposeColors3To4_hwy(tjs_uint8 *outp, const tjs_uint8 *upper, tjs_uint8 *const *buf, tjs_int width);
+void TVPTLG5ComposeColors4To4_hwy(tjs_uint8 *outp, const tjs_uint8 *upper, tjs_uint8 *const *buf, tjs_int width);
+void TVPTLG6DecodeLineGeneric_hwy(tjs_uint32 *prevline, tjs_uint32 *curline, tjs_int width, tjs_int start_block, tjs_int block_limit, tjs_uint8 *filtertypes, tjs_int skipblockbytes, tjs_uint32 *in, tjs_uint32 initialp, tjs_int oddskip, tjs_int dir);
+void TVPTLG6DecodeLine_hwy(tjs_uint32 *prevline, tjs_uint32 *curline, tjs_int width, tjs_int block_count, tjs_uint8 *filtertypes, tjs_int skipblockbytes, tjs_uint32 *in, tjs_uint32 initialp, tjs_int oddskip, tjs_int dir);
+
+// Stretch / affine: nearest and bilinear sampling + existing blends
+#define DECLARE_STRETCH(Name)                                                 \
+    void TVPStretch##Name##_hwy(tjs_uint32 *dest, tjs_int len,                \
+                                const tjs_uint32 *src, tjs_int srcstart,      \
+                                tjs_int srcstep);                             \
+    void TVPLinTrans##Name##_hwy(tjs_uint32 *dest, tjs_int len,               \
+                                 const tjs_uint32 *src, tjs_int sx,           \
+                                 tjs_int sy, tjs_int stepx, tjs_int stepy,    \
+                                 tjs_int srcpitch);
+#define DECLARE_STRETCH_O(Name)                                               \
+    void TVPStretch##Name##_hwy(tjs_uint32 *dest, tjs_int len,                \
+                                const tjs_uint32 *src, tjs_int srcstart,      \
+                                tjs_int srcstep, tjs_int opa);                \
+    void TVPLinTrans##Name##_hwy(tjs_uint32 *dest, tjs_int len,               \
+                                 const tjs_uint32 *src, tjs_int sx,           \
+                                 tjs_int sy, tjs_int stepx, tjs_int stepy,    \
+                                 tjs_int srcpitch, tjs_int opa);
+DECLARE_STRETCH(Copy)
+DECLARE_STRETCH(ColorCopy)
+DECLARE_STRETCH(CopyOpaqueImage)
+DECLARE_STRETCH(AlphaBlend)
+DECLARE_STRETCH(AlphaBlend_HDA)
+DECLARE_STRETCH(AlphaBlend_d)
+DECLARE_STRETCH(AlphaBlend_a)
+DECLARE_STRETCH_O(AlphaBlend_o)
+DECLARE_STRETCH_O(AlphaBlend_HDA_o)
+DECLARE_STRETCH_O(AlphaBlend_do)
+DECLARE_STRETCH_O(AlphaBlend_ao)
+DECLARE_STRETCH(AdditiveAlphaBlend)
+DECLARE_STRETCH(AdditiveAlphaBlend_HDA)
+DECLARE_STRETCH(AdditiveAlphaBlend_a)
+DECLARE_STRETCH_O(AdditiveAlphaBlend_o)
+DECLARE_STRETCH_O(AdditiveAlphaBlend_HDA_o)
+DECLARE_STRETCH_O(AdditiveAlphaBlend_ao)
+DECLARE_STRETCH_O(ConstAlphaBlend)
+DECLARE_STRETCH_O(ConstAlphaBlend_HDA)
+DECLARE_STRETCH_O(ConstAlphaBlend_a)
+#undef DECLARE_STRETCH
+#undef DECLARE_STRETCH_O
+void TVPLinTransConstAlphaBlend_d_hwy(tjs_uint32 *dest, tjs_int len, const tjs_uint32 *src, tjs_int sx, tjs_int sy, tjs_int stepx, tjs_int stepy, tjs_int srcpitch, tjs_int opa);
+void TVPInterpStretchCopy_hwy(tjs_uint32 *dest, tjs_int len, const tjs_uint32 *src1, const tjs_uint32 *src2, tjs_int blend_y, tjs_int srcstart, tjs_int srcstep);
+void TVPInterpStretchAdditiveAlphaBlend_hwy(tjs_uint32 *dest, tjs_int len, const tjs_uint32 *src1, const tjs_uint32 *src2, tjs_int blend_y, tjs_int srcstart, tjs_int srcstep);
+void TVPInterpStretchAdditiveAlphaBlend_o_hwy(tjs_uint32 *dest, tjs_int len, const tjs_uint32 *src1, const tjs_uint32 *src2, tjs_int blend_y, tjs_int srcstart, tjs_int srcstep, tjs_int opa);
+void TVPInterpStretchConstAlphaBlend_hwy(tjs_uint32 *dest, tjs_int len, const tjs_uint32 *src1, const tjs_uint32 *src2, tjs_int blend_y, tjs_int srcstart, tjs_int srcstep, tjs_int opa);
+void TVPInterpLinTransCopy_hwy(tjs_uint32 *dest, tjs_int len, const tjs_uint32 *src, tjs_int sx, tjs_int sy, tjs_int stepx, tjs_int stepy, tjs_int srcpitch);
+void TVPInterpLinTransAdditiveAlphaBlend_hwy(tjs_uint32 *dest, tjs_int len, const tjs_uint32 *src, tjs_int sx, tjs_int sy, tjs_int stepx, tjs_int stepy, tjs_int srcpitch);
+void TVPInterpLinTransAdditiveAlphaBlend_o_hwy(tjs_uint32 *dest, tjs_int len, const tjs_uint32 *src, tjs_int sx, tjs_int sy, tjs_int stepx, tjs_int stepy, tjs_int srcpitch, tjs_int opa);
+void TVPInterpLinTransConstAlphaBlend_hwy(tjs_uint32 *dest, tjs_int len, const tjs_uint32 *src, tjs_int sx, tjs_int sy, tjs_int stepx, tjs_int stepy, tjs_int srcpitch, tjs_int opa);
+
+// Universal transition
+#define DECLARE_UNIVTRANS(Suffix)                                             \
+    void TVPUnivTransBlend##Suffix##_hwy(                                     \
+        tjs_uint32 *dest, const tjs_uint32 *src1, const tjs_uint32 *src2,     \
+        const tjs_uint8 *rule, const tjs_uint32 *table, tjs_int len);         \
+    void TVPUnivTransBlend_switch##Suffix##_hwy(                              \
+        tjs_uint32 *dest, const tjs_uint32 *src1, const tjs_uint32 *src2,     \
+        const tjs_uint8 *rule, const tjs_uint32 *table, tjs_int len,          \
+        tjs_int src1lv, tjs_int src2lv);
+DECLARE_UNIVTRANS()
+DECLARE_UNIVTRANS(_d)
+DECLARE_UNIVTRANS(_a)
+#undef DECLARE_UNIVTRANS
+
+// Resampler rows (tvpgl_simd_resample.cpp)
+void TVPResampleRowH_hwy(tjs_uint32 *dest, const tjs_uint32 *src, const tjs_int *start, const tjs_int *length, const tjs_int *weight, tjs_int len);
+void TVPResampleRowV_hwy(tjs_uint32 *dest, const tjs_uint32 *const *lines, const tjs_int *weight, tjs_int taps, tjs_int len);
 }  // extern "C"
 
+static bool TVPGLSIMDTargetNameEquals(const char *a, const char *b) {
+    for(; *a && *b; a++, b++) {
+        if(std::tolower((unsigned char)*a) != std::tolower((unsigned char)*b))
+            return false;
+    }
+    return *a == *b;
+}
+
+int TVPGL_SIMD_SetTarget(const char *name) {
+    // debug-only override. Highway offers no production API to restrict
+    // the dispatch targets, so this is the only place which uses its test
+    // hook; 0 restores the targets supported by the CPU.
+    hwy::SetSupportedTargetsForTest(0);
+    if(!name || !*name || TVPGLSIMDTargetNameEquals(name, "auto"))
+        return 1;
+    for(int64_t target : hwy::SupportedAndGeneratedTargets()) {
+        if(TVPGLSIMDTargetNameEquals(hwy::TargetName(target), name)) {
+            hwy::SetSupportedTargetsForTest(target);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char *TVPGL_SIMD_GetTargetName() {
+    // same choice as ChosenTarget::Update(): the best (lowest bit)
+    // target which is both compiled in and supported
+    int64_t targets = hwy::SupportedTargets() & HWY_TARGETS;
+    return hwy::TargetName(targets & -targets);
+}
+
 void TVPGL_SIMD_Init() {
+    // =====================================================================
+    // Target selection: the kernels are compiled for every attainable
+    // target; choose one now so that HWY_DYNAMIC_DISPATCH in the _hwy
+    // wrappers goes straight to it instead of through the first-call
+    // trampoline.
+    // =====================================================================
+    hwy::GetChosenTarget().Update(hwy::SupportedTargets());
+
     // =====================================================================
     // Phase 1: Copy/Fill operations
     // =====================================================================
@@ -171,6 +297,16 @@ void TVPGL_SIMD_Init() {
     TVPScreenBlend_o     = TVPScreenBlend_o_hwy;
     TVPScreenBlend_HDA_o = TVPScreenBlend_HDA_o_hwy;
 
+    TVPDarkenBlend       = TVPDarkenBlend_hwy;
+    TVPDarkenBlend_HDA   = TVPDarkenBlend_HDA_hwy;
+    TVPDarkenBlend_o     = TVPDarkenBlend_o_hwy;
+    TVPDarkenBlend_HDA_o = TVPDarkenBlend_HDA_o_hwy;
+
+    TVPLightenBlend       = TVPLightenBlend_hwy;
+    TVPLightenBlend_HDA   = TVPLightenBlend_HDA_hwy;
+    TVPLightenBlend_o     = TVPLightenBlend_o_hwy;
+    TVPLightenBlend_HDA_o = TVPLightenBlend_HDA_o_hwy;
+
     // Phase 2: Const Alpha Blend (only truly SIMD variants)
     TVPConstAlphaBlend     = TVPConstAlphaBlend_hwy;
     TVPConstAlphaBlend_HDA = TVPConstAlphaBlend_HDA_hwy;
@@ -192,10 +328,7 @@ void TVPGL_SIMD_Init() {
     TVPAlphaColorMat = TVPAlphaColorMat_hwy;
 
     // =====================================================================
-    // Phase 3: Photoshop blend modes
-    // Only register modes that have true SIMD blend cores.
-    // Table-based modes (SoftLight, ColorDodge, ColorBurn, ColorDodge5, Diff5)
-    // are pure scalar - keep original C for better performance.
+    // Phase 3: Photoshop blend modes (all 16, bit-exact with the C versions)
     // =====================================================================
 #define REGISTER_PS_BLEND_4V(Name)                                            \
     TVPPs##Name##Blend       = TVPPs##Name##Blend_hwy;                        \
@@ -214,12 +347,11 @@ void TVPGL_SIMD_Init() {
     REGISTER_PS_BLEND_4V(Overlay)
     REGISTER_PS_BLEND_4V(HardLight)
     REGISTER_PS_BLEND_4V(Exclusion)
-    // Table-based modes: keep original C (pure scalar, no SIMD benefit)
-    // REGISTER_PS_BLEND_4V(SoftLight)
-    // REGISTER_PS_BLEND_4V(ColorDodge)
-    // REGISTER_PS_BLEND_4V(ColorBurn)
-    // REGISTER_PS_BLEND_4V(ColorDodge5)
-    // REGISTER_PS_BLEND_4V(Diff5)
+    REGISTER_PS_BLEND_4V(SoftLight)
+    REGISTER_PS_BLEND_4V(ColorDodge)
+    REGISTER_PS_BLEND_4V(ColorBurn)
+    REGISTER_PS_BLEND_4V(ColorDodge5)
+    REGISTER_PS_BLEND_4V(Diff5)
 
 #undef REGISTER_PS_BLEND_4V
 
@@ -272,4 +404,68 @@ void TVPGL_SIMD_Init() {
     // TVPChBlurAddMulCopy65  = TVPChBlurAddMulCopy65_hwy;
     // TVPChBlurMulCopy       = TVPChBlurMulCopy_hwy;
     // TVPChBlurAddMulCopy    = TVPChBlurAddMulCopy_hwy;
+
+    // =====================================================================
+    // TLG decoder: per-line passes only. LZSS and Golomb decoding are
+    // serial - keep original C (the loader runs them on worker threads)
+    // =====================================================================
+    TVPTLG5ComposeColors3To4 = TVPTLG5ComposeColors3To4_hwy;
+    TVPTLG5ComposeColors4To4 = TVPTLG5ComposeColors4To4_hwy;
+    TVPTLG6DecodeLineGeneric = TVPTLG6DecodeLineGeneric_hwy;
+    TVPTLG6DecodeLine        = TVPTLG6DecodeLine_hwy;
+
+    // =====================================================================
+    // Stretch / affine: the sampling is vectorized, the blend stage uses
+    // the function pointers assigned above. TVPStretchConstAlphaBlend_d
+    // differs from TVPConstAlphaBlend_d and keeps the C version.
+    // =====================================================================
+#define ASSIGN_STRETCH(Name)                                                  \
+    TVPStretch##Name  = TVPStretch##Name##_hwy;                               \
+    TVPLinTrans##Name = TVPLinTrans##Name##_hwy;
+    ASSIGN_STRETCH(Copy)
+    ASSIGN_STRETCH(ColorCopy)
+    ASSIGN_STRETCH(CopyOpaqueImage)
+    ASSIGN_STRETCH(AlphaBlend)
+    ASSIGN_STRETCH(AlphaBlend_HDA)
+    ASSIGN_STRETCH(AlphaBlend_d)
+    ASSIGN_STRETCH(AlphaBlend_a)
+    ASSIGN_STRETCH(AlphaBlend_o)
+    ASSIGN_STRETCH(AlphaBlend_HDA_o)
+    ASSIGN_STRETCH(AlphaBlend_do)
+    ASSIGN_STRETCH(AlphaBlend_ao)
+    ASSIGN_STRETCH(AdditiveAlphaBlend)
+    ASSIGN_STRETCH(AdditiveAlphaBlend_HDA)
+    ASSIGN_STRETCH(AdditiveAlphaBlend_a)
+    ASSIGN_STRETCH(AdditiveAlphaBlend_o)
+    ASSIGN_STRETCH(AdditiveAlphaBlend_HDA_o)
+    ASSIGN_STRETCH(AdditiveAlphaBlend_ao)
+    ASSIGN_STRETCH(ConstAlphaBlend)
+    ASSIGN_STRETCH(ConstAlphaBlend_HDA)
+    ASSIGN_STRETCH(ConstAlphaBlend_a)
+#undef ASSIGN_STRETCH
+    TVPLinTransConstAlphaBlend_d = TVPLinTransConstAlphaBlend_d_hwy;
+    TVPInterpStretchCopy                 = TVPInterpStretchCopy_hwy;
+    TVPInterpStretchAdditiveAlphaBlend   = TVPInterpStretchAdditiveAlphaBlend_hwy;
+    TVPInterpStretchAdditiveAlphaBlend_o = TVPInterpStretchAdditiveAlphaBlend_o_hwy;
+    TVPInterpStretchConstAlphaBlend      = TVPInterpStretchConstAlphaBlend_hwy;
+    TVPInterpLinTransCopy                 = TVPInterpLinTransCopy_hwy;
+    TVPInterpLinTransAdditiveAlphaBlend   = TVPInterpLinTransAdditiveAlphaBlend_hwy;
+    TVPInterpLinTransAdditiveAlphaBlend_o = TVPInterpLinTransAdditiveAlphaBlend_o_hwy;
+    TVPInterpLinTransConstAlphaBlend      = TVPInterpLinTransConstAlphaBlend_hwy;
+
+    // =====================================================================
+    // Universal transition: the per phase table is still built in C
+    // =====================================================================
+    TVPUnivTransBlend          = TVPUnivTransBlend_hwy;
+    TVPUnivTransBlend_switch   = TVPUnivTransBlend_switch_hwy;
+    TVPUnivTransBlend_d        = TVPUnivTransBlend_d_hwy;
+    TVPUnivTransBlend_switch_d = TVPUnivTransBlend_switch_d_hwy;
+    TVPUnivTransBlend_a        = TVPUnivTransBlend_a_hwy;
+    TVPUnivTransBlend_switch_a = TVPUnivTransBlend_switch_a_hwy;
+
+    // =====================================================================
+    // Fixed-point separable resampler (gl/ResampleImage.cpp)
+    // =====================================================================
+    TVPResampleRowH = TVPResampleRowH_hwy;
+    TVPResampleRowV = TVPResampleRowV_hwy;
 }
@@ -17,6 +17,19 @@ extern "C" {
 /// implementations with SIMD-optimized versions.
 void TVPGL_SIMD_Init();
 
+/// Pin the Highway target used by TVPGL_SIMD_Init() (e.g. "AVX2", "SSE4",
+/// "NEON", "EMU128"; case-insensitive). "auto" or an empty name selects the
+/// best target supported by the CPU. Fails if the target was not
+/// compiled in or is not supported (zero is returned and the best target
+/// is used then).
+/// Debugging and benchmarking override only (-simdtarget); it relies on
+/// Highway's test hook hwy::SetSupportedTargetsForTest.
+/// Call this before TVPGL_SIMD_Init().
+int TVPGL_SIMD_SetTarget(const char *name);
+
+/// Name of the Highway target selected by TVPGL_SIMD_Init().
+const char *TVPGL_SIMD_GetTargetName();
+
 #ifdef __cplusplus
 }
 #endif
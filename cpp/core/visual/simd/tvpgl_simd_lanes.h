@@ -0,0 +1,55 @@
+/*
+ * KrKr2 Engine - Highway SIMD Pixel Lane Helpers
+ *
+ * Helpers for kernels which hold one 32bpp pixel per u32 lane and use the
+ * packed 0x00ff00ff arithmetic of the C versions in tvpgl.cpp.
+ */
+
+// Per-target include guard: the including .cpp is compiled once per
+// Highway target by foreach_target.h and must see these helpers each time.
+// Include this after <hwy/highway.h>.
+#if defined(__TVPGL_SIMD_LANES_H__) == defined(HWY_TARGET_TOGGLE)
+#ifdef __TVPGL_SIMD_LANES_H__
+#undef __TVPGL_SIMD_LANES_H__
+#else
+#define __TVPGL_SIMD_LANES_H__
+#endif
+
+#include <hwy/highway.h>
+
+HWY_BEFORE_NAMESPACE();
+namespace krkr2 {
+namespace HWY_NAMESPACE {
+
+namespace hn = hwy::HWY_NAMESPACE;
+
+// Gathers are only faster than scalar loads where the hardware has them
+constexpr bool kUseGather = HWY_ARCH_X86 && HWY_TARGET <= HWY_AVX2;
+
+/*
+ * TVPBlendARGB on u32 lanes: a * ratio + b * (1 - ratio), ratio in 0..256.
+ * Uses the same packed 0x00ff00ff arithmetic as the C version.
+ */
+template <class D>
+static HWY_INLINE hn::Vec<D> BlendARGBLanes(D d, hn::Vec<D> b, hn::Vec<D> a,
+                                            hn::Vec<D> ratio) {
+    const auto mask = hn::Set(d, 0x00ff00ffu);
+    auto b2 = hn::And(b, mask);
+    auto t = hn::And(
+        hn::Add(b2, hn::ShiftRight<8>(
+                        hn::Mul(hn::Sub(hn::And(a, mask), b2), ratio))),
+        mask);
+    b2 = hn::And(hn::ShiftRight<8>(b), mask);
+    auto u = hn::And(
+        hn::Add(b2, hn::ShiftRight<8>(hn::Mul(
+                        hn::Sub(hn::And(hn::ShiftRight<8>(a), mask), b2),
+                        ratio))),
+        mask);
+    return hn::Add(t, hn::ShiftLeft<8>(u));
+}
+
+}  // namespace HWY_NAMESPACE
+}  // namespace krkr2
+HWY_AFTER_NAMESPACE();
+
+#endif  // __TVPGL_SIMD_LANES_H__
@@ -1,7 +1,7 @@
 /*
  * KrKr2 Engine - Highway SIMD Photoshop Blend Modes (Part 1)
  *
- * Implements fully SIMD-able PS blend modes:
+ * Implements the PS blend modes that are plain packed arithmetic:
  *   PsAlphaBlend, PsAddBlend, PsSubBlend, PsMulBlend,
  *   PsScreenBlend, PsLightenBlend, PsDarkenBlend, PsDiffBlend
  *
@@ -12,7 +12,10 @@
  *   1. Compute blended color 's' per-channel
  *   2. Apply ps_alpha_blend: result_ch = d_ch + (s_ch - d_ch) * alpha >> 8
  *
- * Phase 3 implementation.
+ * The kernels hold one pixel per u32 lane and run the packed arithmetic of
+ * the C functors (gl/blend_functor_c.h) on it, borrows between channels and
+ * the zero alpha byte of ps_alpha_blend included, so the results are
+ * bit-exact with the C versions.
  */
 
 #include "tjsTypes.h"
@@ -29,116 +32,64 @@ namespace HWY_NAMESPACE {
 
 namespace hn = hwy::HWY_NAMESPACE;
 
+using DU32 = hn::ScalableTag<uint32_t>;
+using VU32 = hn::Vec<DU32>;
+
 // =========================================================================
-// Common helper: ps_alpha_blend step
-// Applies: result = d + (s - d) * a >> 8  (per channel, preserving alpha)
-// All inputs are u8 vectors. alpha must be broadcast per-pixel.
+// Common helper: ps_alpha_blend step on u32 lanes
+// result = ((s - d) * a >> 8) + d on the 0x00ff00ff and 0x0000ff00 channels;
+// the alpha byte of the result is zero
 // =========================================================================
-static HWY_INLINE hn::Vec<hn::ScalableTag<uint8_t>> PsApplyAlpha(
-    hn::ScalableTag<uint8_t> d8,
-    hn::Vec<hn::ScalableTag<uint8_t>> vd,
-    hn::Vec<hn::ScalableTag<uint8_t>> vs_blended,
-    hn::Vec<hn::ScalableTag<uint8_t>> va) {
-
-    const hn::Repartition<uint16_t, decltype(d8)> d16;
-    const auto half = hn::Half<decltype(d8)>();
-    const auto v255 = hn::Set(d16, static_cast<uint16_t>(255));
-
-    auto s_lo = hn::PromoteTo(d16, hn::LowerHalf(half, vs_blended));
-    auto d_lo = hn::PromoteTo(d16, hn::LowerHalf(half, vd));
-    auto a_lo = hn::PromoteTo(d16, hn::LowerHalf(half, va));
-
-    auto s_hi = hn::PromoteUpperTo(d16, vs_blended);
-    auto d_hi = hn::PromoteUpperTo(d16, vd);
-    auto a_hi = hn::PromoteUpperTo(d16, va);
-
-    // result = (s * a >> 8) + (d * (255 - a) >> 8), split to avoid u16 overflow
-    auto inv_a_lo = hn::Sub(v255, a_lo);
-    auto inv_a_hi = hn::Sub(v255, a_hi);
-    auto r_lo = hn::Add(hn::ShiftRight<8>(hn::Mul(s_lo, a_lo)),
-                        hn::ShiftRight<8>(hn::Mul(d_lo, inv_a_lo)));
-    auto r_hi = hn::Add(hn::ShiftRight<8>(hn::Mul(s_hi, a_hi)),
-                        hn::ShiftRight<8>(hn::Mul(d_hi, inv_a_hi)));
-
-    return hn::OrderedDemote2To(d8, r_lo, r_hi);
-}
-
-// Helper: Extract alpha from src and broadcast to all channels
-static HWY_INLINE hn::Vec<hn::ScalableTag<uint8_t>> ExtractAlpha(
-    hn::ScalableTag<uint8_t> d8,
-    hn::Vec<hn::ScalableTag<uint8_t>> vs) {
-    const auto alpha_shuffle = hn::Dup128VecFromValues(
-        d8,
-        3, 3, 3, 3,    7, 7, 7, 7,
-        11, 11, 11, 11, 15, 15, 15, 15
-    );
-    return hn::TableLookupBytes(vs, alpha_shuffle);
-}
-
-// Helper: Scale alpha by opacity
-static HWY_INLINE hn::Vec<hn::ScalableTag<uint8_t>> ScaleAlpha(
-    hn::ScalableTag<uint8_t> d8,
-    hn::Vec<hn::ScalableTag<uint8_t>> va,
-    hn::Vec<hn::ScalableTag<uint16_t>> vopa16) {
-    const hn::Repartition<uint16_t, decltype(d8)> d16;
-    const auto half = hn::Half<decltype(d8)>();
-    auto a_lo = hn::ShiftRight<8>(hn::Mul(hn::PromoteTo(d16, hn::LowerHalf(half, va)), vopa16));
-    auto a_hi = hn::ShiftRight<8>(hn::Mul(hn::PromoteUpperTo(d16, va), vopa16));
-    return hn::OrderedDemote2To(d8, a_lo, a_hi);
-}
-
-// Helper: Per-channel multiply (d * s) >> 8 in u16
-static HWY_INLINE hn::Vec<hn::ScalableTag<uint8_t>> MulChannels(
-    hn::ScalableTag<uint8_t> d8,
-    hn::Vec<hn::ScalableTag<uint8_t>> va,
-    hn::Vec<hn::ScalableTag<uint8_t>> vb) {
-    const hn::Repartition<uint16_t, decltype(d8)> d16;
-    const auto half = hn::Half<decltype(d8)>();
-    auto a_lo = hn::PromoteTo(d16, hn::LowerHalf(half, va));
-    auto b_lo = hn::PromoteTo(d16, hn::LowerHalf(half, vb));
-    auto a_hi = hn::PromoteUpperTo(d16, va);
-    auto b_hi = hn::PromoteUpperTo(d16, vb);
-    auto r_lo = hn::ShiftRight<8>(hn::Mul(a_lo, b_lo));
-    auto r_hi = hn::ShiftRight<8>(hn::Mul(a_hi, b_hi));
-    return hn::OrderedDemote2To(d8, r_lo, r_hi);
+static HWY_INLINE VU32 PsAlphaBlendLanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    const auto rbmask = hn::Set(du, 0x00ff00ffu);
+    const auto gmask = hn::Set(du, 0x0000ff00u);
+    auto d1 = hn::And(d, rbmask);
+    auto d2 = hn::And(d, gmask);
+    auto rb = hn::And(
+        hn::Add(hn::ShiftRight<8>(hn::Mul(hn::Sub(hn::And(s, rbmask), d1), a)),
+                d1),
+        rbmask);
+    auto g = hn::And(
+        hn::Add(hn::ShiftRight<8>(hn::Mul(hn::Sub(hn::And(s, gmask), d2), a)),
+                d2),
+        gmask);
+    return hn::Or(rb, g);
 }
 
-// Helper: alpha_mask constant
-static HWY_INLINE hn::Vec<hn::ScalableTag<uint8_t>> GetAlphaMask(
-    hn::ScalableTag<uint8_t> d8) {
-    return hn::Dup128VecFromValues(d8,
-        0, 0, 0, 0xFF,  0, 0, 0, 0xFF,
-        0, 0, 0, 0xFF,  0, 0, 0, 0xFF);
+// Per-channel mask of the low three bytes: 0xff where x + y carries out of
+// the byte
+static HWY_INLINE VU32 PsCarryMask(DU32 du, VU32 x, VU32 y) {
+    auto n = hn::And(hn::Add(hn::ShiftLeft<1>(hn::And(x, y)),
+                             hn::And(hn::Xor(x, y), hn::Set(du, 0x00fefefeu))),
+                     hn::Set(du, 0x01010100u));
+    const auto v7f = hn::Set(du, 0x007f7f7fu);
+    return hn::Xor(hn::Add(hn::ShiftRight<8>(n), v7f), v7f);
 }
 
-// Helper: Apply HDA
-static HWY_INLINE hn::Vec<hn::ScalableTag<uint8_t>> ApplyHDA(
-    hn::ScalableTag<uint8_t> d8,
-    hn::Vec<hn::ScalableTag<uint8_t>> result,
-    hn::Vec<hn::ScalableTag<uint8_t>> vd) {
-    auto mask = GetAlphaMask(d8);
-    return hn::Or(hn::AndNot(mask, result), hn::And(mask, vd));
+// Helper: Apply HDA (keep the destination alpha byte)
+static HWY_INLINE VU32 ApplyHDA(DU32 du, VU32 result, VU32 d) {
+    return hn::Or(hn::And(result, hn::Set(du, 0x00ffffffu)),
+                  hn::And(d, hn::Set(du, 0xff000000u)));
 }
 
 // =========================================================================
 // Macro for generating 4 variants of each PS blend mode
-// BLEND_CORE(d8, vs, vd) must produce the blended color before alpha application
+// Ps##Name##Lanes(du, d, s, a) is the vector form of ps_*_blend_func and
+// TVPPsAlphaBlend_##Name##_scalar its scalar form for the tail
 // =========================================================================
 
-#define DEFINE_PS_BLEND_4VARIANTS(Name, blend_core_body)                      \
+#define DEFINE_PS_BLEND_4VARIANTS(Name)                                       \
                                                                                \
 void Ps##Name##Blend_HWY(tjs_uint32 *dest, const tjs_uint32 *src,            \
                           tjs_int len) {                                       \
-    const hn::ScalableTag<uint8_t> d8;                                        \
-    const size_t N_PIXELS = hn::Lanes(d8) / 4;                               \
+    const DU32 du;                                                            \
+    const tjs_int N = static_cast<tjs_int>(hn::Lanes(du));                   \
     tjs_int i = 0;                                                            \
-    for (; i + static_cast<tjs_int>(N_PIXELS) <= len; i += N_PIXELS) {        \
-        auto vs = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(src + i));   \
-        auto vd = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(dest + i)); \
-        auto va = ExtractAlpha(d8, vs);                                       \
-        auto vs_blended = [&]() { blend_core_body }();                        \
-        auto result = PsApplyAlpha(d8, vd, vs_blended, va);                   \
-        hn::StoreU(result, d8, reinterpret_cast<uint8_t*>(dest + i));         \
+    for (; i + N <= len; i += N) {                                            \
+        auto vs = hn::LoadU(du, src + i);                                     \
+        auto vd = hn::LoadU(du, dest + i);                                    \
+        auto va = hn::ShiftRight<24>(vs);                                     \
+        hn::StoreU(Ps##Name##Lanes(du, vd, vs, va), du, dest + i);           \
     }                                                                          \
     for (; i < len; i++) {                                                    \
         tjs_uint32 s = src[i], d = dest[i];                                   \
@@ -149,18 +100,15 @@ void Ps##Name##Blend_HWY(tjs_uint32 *dest, const tjs_uint32 *src,            \
                                                                                \
 void Ps##Name##Blend_o_HWY(tjs_uint32 *dest, const tjs_uint32 *src,          \
                             tjs_int len, tjs_int opa) {                       \
-    const hn::ScalableTag<uint8_t> d8;                                        \
-    const hn::Repartition<uint16_t, decltype(d8)> d16;                        \
-    const size_t N_PIXELS = hn::Lanes(d8) / 4;                               \
-    const auto vopa16 = hn::Set(d16, static_cast<uint16_t>(opa));             \
+    const DU32 du;                                                            \
+    const tjs_int N = static_cast<tjs_int>(hn::Lanes(du));                   \
+    const auto vopa = hn::Set(du, static_cast<uint32_t>(opa));               \
     tjs_int i = 0;                                                            \
-    for (; i + static_cast<tjs_int>(N_PIXELS) <= len; i += N_PIXELS) {        \
-        auto vs = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(src + i));   \
-        auto vd = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(dest + i)); \
-        auto va = ScaleAlpha(d8, ExtractAlpha(d8, vs), vopa16);               \
-        auto vs_blended = [&]() { blend_core_body }();                        \
-        auto result = PsApplyAlpha(d8, vd, vs_blended, va);                   \
-        hn::StoreU(result, d8, reinterpret_cast<uint8_t*>(dest + i));         \
+    for (; i + N <= len; i += N) {                                            \
+        auto vs = hn::LoadU(du, src + i);                                     \
+        auto vd = hn::LoadU(du, dest + i);                                    \
+        auto va = hn::ShiftRight<8>(hn::Mul(hn::ShiftRight<24>(vs), vopa));   \
+        hn::StoreU(Ps##Name##Lanes(du, vd, vs, va), du, dest + i);           \
     }                                                                          \
     for (; i < len; i++) {                                                    \
         tjs_uint32 s = src[i], d = dest[i];                                   \
@@ -171,16 +119,15 @@ void Ps##Name##Blend_o_HWY(tjs_uint32 *dest, const tjs_uint32 *src,          \
                                                                                \
 void Ps##Name##Blend_HDA_HWY(tjs_uint32 *dest, const tjs_uint32 *src,        \
                               tjs_int len) {                                   \
-    const hn::ScalableTag<uint8_t> d8;                                        \
-    const size_t N_PIXELS = hn::Lanes(d8) / 4;                               \
+    const DU32 du;                                                            \
+    const tjs_int N = static_cast<tjs_int>(hn::Lanes(du));                   \
     tjs_int i = 0;                                                            \
-    for (; i + static_cast<tjs_int>(N_PIXELS) <= len; i += N_PIXELS) {        \
-        auto vs = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(src + i));   \
-        auto vd = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(dest + i)); \
-        auto va = ExtractAlpha(d8, vs);                                       \
-        auto vs_blended = [&]() { blend_core_body }();                        \
-        auto result = ApplyHDA(d8, PsApplyAlpha(d8, vd, vs_blended, va), vd); \
-        hn::StoreU(result, d8, reinterpret_cast<uint8_t*>(dest + i));         \
+    for (; i + N <= len; i += N) {                                            \
+        auto vs = hn::LoadU(du, src + i);                                     \
+        auto vd = hn::LoadU(du, dest + i);                                    \
+        auto va = hn::ShiftRight<24>(vs);                                     \
+        auto result = ApplyHDA(du, Ps##Name##Lanes(du, vd, vs, va), vd);      \
+        hn::StoreU(result, du, dest + i);                                     \
     }                                                                          \
     for (; i < len; i++) {                                                    \
         tjs_uint32 s = src[i], d = dest[i];                                   \
@@ -192,18 +139,16 @@ void Ps##Name##Blend_HDA_HWY(tjs_uint32 *dest, const tjs_uint32 *src,        \
                                                                                \
 void Ps##Name##Blend_HDA_o_HWY(tjs_uint32 *dest, const tjs_uint32 *src,      \
                                 tjs_int len, tjs_int opa) {                   \
-    const hn::ScalableTag<uint8_t> d8;                                        \
-    const hn::Repartition<uint16_t, decltype(d8)> d16;                        \
-    const size_t N_PIXELS = hn::Lanes(d8) / 4;                               \
-    const auto vopa16 = hn::Set(d16, static_cast<uint16_t>(opa));             \
+    const DU32 du;                                                            \
+    const tjs_int N = static_cast<tjs_int>(hn::Lanes(du));                   \
+    const auto vopa = hn::Set(du, static_cast<uint32_t>(opa));               \
     tjs_int i = 0;                                                            \
-    for (; i + static_cast<tjs_int>(N_PIXELS) <= len; i += N_PIXELS) {        \
-        auto vs = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(src + i));   \
-        auto vd = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(dest + i)); \
-        auto va = ScaleAlpha(d8, ExtractAlpha(d8, vs), vopa16);               \
-        auto vs_blended = [&]() { blend_core_body }();                        \
-        auto result = ApplyHDA(d8, PsApplyAlpha(d8, vd, vs_blended, va), vd); \
-        hn::StoreU(result, d8, reinterpret_cast<uint8_t*>(dest + i));         \
+    for (; i + N <= len; i += N) {                                            \
+        auto vs = hn::LoadU(du, src + i);                                     \
+        auto vd = hn::LoadU(du, dest + i);                                    \
+        auto va = hn::ShiftRight<8>(hn::Mul(hn::ShiftRight<24>(vs), vopa));   \
+        auto result = ApplyHDA(du, Ps##Name##Lanes(du, vd, vs, va), vd);      \
+        hn::StoreU(result, du, dest + i);                                     \
     }                                                                          \
     for (; i < len; i++) {                                                    \
         tjs_uint32 s = src[i], d = dest[i];                                   \
@@ -292,229 +237,95 @@ static HWY_INLINE void TVPPsAlphaBlend_Diff_scalar(
 }
 
 // =========================================================================
-// 1. PsAlphaBlend: blended = src (identity, just alpha blend)
+// Vector cores, one per mode; each mirrors the scalar helper above
 // =========================================================================
-DEFINE_PS_BLEND_4VARIANTS(Alpha,
-    return vs;
-)
 
-// =========================================================================
-// 2. PsAddBlend: blended = SaturatedAdd(d, s)
-// =========================================================================
-DEFINE_PS_BLEND_4VARIANTS(Add,
-    return hn::SaturatedAdd(vd, vs);
-)
-
-// =========================================================================
-// 3. PsSubBlend: Linear Burn = d - ~s (clamped)
-//    Original: n = carry; s = (d | n) - (~s | n)
-//    Simplified SIMD: SaturatedSub(d, ~s) then the result goes through alpha
-//    Actually from the scalar: s_new = (d|n) - (~s|n) which is clamp(d - ~s, 0)
-// =========================================================================
-DEFINE_PS_BLEND_4VARIANTS(Sub,
-    auto si = hn::Not(vs);
-    return hn::SaturatedSub(vd, si);
-)
+// 1. PsAlphaBlend: blended = src
+static HWY_INLINE VU32 PsAlphaLanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    return PsAlphaBlendLanes(du, d, s, a);
+}
 
-// =========================================================================
-// 4. PsMulBlend: blended = (d * s) >> 8 per channel
-// =========================================================================
-DEFINE_PS_BLEND_4VARIANTS(Mul,
-    return MulChannels(d8, vd, vs);
-)
+// 2. PsAddBlend: saturated add
+static HWY_INLINE VU32 PsAddLanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    auto n = PsCarryMask(du, d, s);
+    return PsAlphaBlendLanes(du, d, hn::Or(hn::Sub(hn::Add(d, s), n), n), a);
+}
 
-// =========================================================================
-// 5. PsScreenBlend: result_ch = d + (s - s*d/255) * a / 256
-//    The screen blend color is s - s*d/255, but for PsScreen the final
-//    formula is: result = d + (s - s*d/255) * a >> 8
-//    Which is different from standard screen blend.
-// =========================================================================
-void PsScreenBlend_HWY(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len) {
-    const hn::ScalableTag<uint8_t> d8;
-    const hn::Repartition<uint16_t, decltype(d8)> d16;
-    const size_t N_PIXELS = hn::Lanes(d8) / 4;
-
-    tjs_int i = 0;
-    for (; i + static_cast<tjs_int>(N_PIXELS) <= len; i += N_PIXELS) {
-        auto vs = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(src + i));
-        auto vd = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(dest + i));
-        auto va = ExtractAlpha(d8, vs);
-
-        // Compute s*d/255 per channel
-        auto sd = MulChannels(d8, vs, vd);
-        // Blend: s_effective = s - s*d/255
-        // Final: result = d + (s - sd - d) * a >> 8 = d + ((s - sd) - d) * a >> 8
-        // But PsScreen formula is: result_ch = d + (s - sd) * a >> 8 - d * a >> 8 + d
-        // Actually: result = ((s - sd - d) * a >> 8) + d
-        // Which is just: PsApplyAlpha(d, s - sd, a)
-        auto s_minus_sd = hn::SaturatedSub(vs, sd);
-
-        // ps_alpha_blend: result = d + (s_eff - d) * a >> 8
-        // where s_eff = s - s*d/255
-        // We need to compute this differently because s_eff is not simply s
-        // Actually the correct formula from scalar:
-        //   result = (((s - sd) * a >> 8) + d) for each channel
-        // This is equivalent to PsApplyAlpha with s_effective = s - sd
-        // But s - sd can exceed 255, but since both are u8, saturated sub handles it
-
-        const auto half = hn::Half<decltype(d8)>();
-        auto se_lo = hn::PromoteTo(d16, hn::LowerHalf(half, s_minus_sd));
-        auto se_hi = hn::PromoteUpperTo(d16, s_minus_sd);
-        auto d_lo = hn::PromoteTo(d16, hn::LowerHalf(half, vd));
-        auto d_hi = hn::PromoteUpperTo(d16, vd);
-        auto a_lo = hn::PromoteTo(d16, hn::LowerHalf(half, va));
-        auto a_hi = hn::PromoteUpperTo(d16, va);
-
-        // result = d + (s_eff * a >> 8) where s_eff = s - sd
-        auto r_lo = hn::Add(d_lo, hn::ShiftRight<8>(hn::Mul(se_lo, a_lo)));
-        auto r_hi = hn::Add(d_hi, hn::ShiftRight<8>(hn::Mul(se_hi, a_hi)));
-
-        auto result = hn::OrderedDemote2To(d8, r_lo, r_hi);
-        hn::StoreU(result, d8, reinterpret_cast<uint8_t*>(dest + i));
-    }
-
-    for (; i < len; i++) {
-        tjs_uint32 s = src[i], d = dest[i];
-        tjs_uint32 a = s >> 24;
-        TVPPsAlphaBlend_Screen_scalar(dest + i, d, s, a);
-    }
+// 3. PsSubBlend: linear burn, (d | n) - (~s | n)
+static HWY_INLINE VU32 PsSubLanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    auto si = hn::Not(s);
+    auto n = PsCarryMask(du, hn::Not(d), si);
+    return PsAlphaBlendLanes(du, d, hn::Sub(hn::Or(d, n), hn::Or(si, n)), a);
 }
 
-void PsScreenBlend_o_HWY(tjs_uint32 *dest, const tjs_uint32 *src,
-                          tjs_int len, tjs_int opa) {
-    const hn::ScalableTag<uint8_t> d8;
-    const hn::Repartition<uint16_t, decltype(d8)> d16;
-    const size_t N_PIXELS = hn::Lanes(d8) / 4;
-    const auto vopa16 = hn::Set(d16, static_cast<uint16_t>(opa));
-
-    tjs_int i = 0;
-    for (; i + static_cast<tjs_int>(N_PIXELS) <= len; i += N_PIXELS) {
-        auto vs = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(src + i));
-        auto vd = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(dest + i));
-        auto va = ScaleAlpha(d8, ExtractAlpha(d8, vs), vopa16);
-        auto sd = MulChannels(d8, vs, vd);
-        auto s_minus_sd = hn::SaturatedSub(vs, sd);
-
-        const auto half = hn::Half<decltype(d8)>();
-        auto se_lo = hn::PromoteTo(d16, hn::LowerHalf(half, s_minus_sd));
-        auto se_hi = hn::PromoteUpperTo(d16, s_minus_sd);
-        auto d_lo = hn::PromoteTo(d16, hn::LowerHalf(half, vd));
-        auto d_hi = hn::PromoteUpperTo(d16, vd);
-        auto a_lo = hn::PromoteTo(d16, hn::LowerHalf(half, va));
-        auto a_hi = hn::PromoteUpperTo(d16, va);
-
-        auto r_lo = hn::Add(d_lo, hn::ShiftRight<8>(hn::Mul(se_lo, a_lo)));
-        auto r_hi = hn::Add(d_hi, hn::ShiftRight<8>(hn::Mul(se_hi, a_hi)));
-
-        auto result = hn::OrderedDemote2To(d8, r_lo, r_hi);
-        hn::StoreU(result, d8, reinterpret_cast<uint8_t*>(dest + i));
-    }
-
-    for (; i < len; i++) {
-        tjs_uint32 s = src[i], d = dest[i];
-        tjs_uint32 a = ((s >> 24) * opa) >> 8;
-        TVPPsAlphaBlend_Screen_scalar(dest + i, d, s, a);
-    }
+// 4. PsMulBlend: d * s >> 8 per channel
+static HWY_INLINE VU32 PsMulLanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    const auto ff = hn::Set(du, 0xffu);
+    auto r = hn::And(hn::Mul(hn::And(hn::ShiftRight<16>(d), ff),
+                             hn::And(s, hn::Set(du, 0x00ff0000u))),
+                     hn::Set(du, 0xff000000u));
+    r = hn::Or(r, hn::And(hn::Mul(hn::And(hn::ShiftRight<8>(d), ff),
+                                  hn::And(s, hn::Set(du, 0x0000ff00u))),
+                          hn::Set(du, 0x00ff0000u)));
+    r = hn::Or(r, hn::Mul(hn::And(d, ff), hn::And(s, ff)));
+    return PsAlphaBlendLanes(du, d, hn::ShiftRight<8>(r), a);
 }
 
-void PsScreenBlend_HDA_HWY(tjs_uint32 *dest, const tjs_uint32 *src,
-                            tjs_int len) {
-    const hn::ScalableTag<uint8_t> d8;
-    const hn::Repartition<uint16_t, decltype(d8)> d16;
-    const size_t N_PIXELS = hn::Lanes(d8) / 4;
-
-    tjs_int i = 0;
-    for (; i + static_cast<tjs_int>(N_PIXELS) <= len; i += N_PIXELS) {
-        auto vs = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(src + i));
-        auto vd = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(dest + i));
-        auto va = ExtractAlpha(d8, vs);
-        auto sd = MulChannels(d8, vs, vd);
-        auto s_minus_sd = hn::SaturatedSub(vs, sd);
-
-        const auto half = hn::Half<decltype(d8)>();
-        auto se_lo = hn::PromoteTo(d16, hn::LowerHalf(half, s_minus_sd));
-        auto se_hi = hn::PromoteUpperTo(d16, s_minus_sd);
-        auto d_lo = hn::PromoteTo(d16, hn::LowerHalf(half, vd));
-        auto d_hi = hn::PromoteUpperTo(d16, vd);
-        auto a_lo = hn::PromoteTo(d16, hn::LowerHalf(half, va));
-        auto a_hi = hn::PromoteUpperTo(d16, va);
-
-        auto r_lo = hn::Add(d_lo, hn::ShiftRight<8>(hn::Mul(se_lo, a_lo)));
-        auto r_hi = hn::Add(d_hi, hn::ShiftRight<8>(hn::Mul(se_hi, a_hi)));
-
-        auto result = ApplyHDA(d8, hn::OrderedDemote2To(d8, r_lo, r_hi), vd);
-        hn::StoreU(result, d8, reinterpret_cast<uint8_t*>(dest + i));
-    }
-
-    for (; i < len; i++) {
-        tjs_uint32 s = src[i], d = dest[i];
-        tjs_uint32 a = s >> 24;
-        TVPPsAlphaBlend_Screen_scalar(dest + i, d, s, a);
-        dest[i] = (dest[i] & 0x00ffffff) | (d & 0xff000000);
-    }
+// 5. PsScreenBlend: result = ((s - s * d >> 8) * a >> 8) + d
+static HWY_INLINE VU32 PsScreenLanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    const auto ff = hn::Set(du, 0xffu);
+    const auto rbmask = hn::Set(du, 0x00ff00ffu);
+    const auto gmask = hn::Set(du, 0x0000ff00u);
+    auto sd1 = hn::Or(
+        hn::And(hn::Mul(hn::And(hn::ShiftRight<16>(d), ff),
+                        hn::And(s, hn::Set(du, 0x00ff0000u))),
+                hn::Set(du, 0xff000000u)),
+        hn::Mul(hn::And(d, ff), hn::And(s, ff)));
+    sd1 = hn::ShiftRight<8>(sd1);
+    auto sd2 = hn::ShiftRight<8>(
+        hn::And(hn::Mul(hn::And(hn::ShiftRight<8>(d), ff), hn::And(s, gmask)),
+                hn::Set(du, 0x00ff0000u)));
+    auto rb = hn::And(
+        hn::Add(hn::ShiftRight<8>(hn::Mul(hn::Sub(hn::And(s, rbmask), sd1), a)),
+                hn::And(d, rbmask)),
+        rbmask);
+    auto g = hn::And(
+        hn::Add(hn::ShiftRight<8>(hn::Mul(hn::Sub(hn::And(s, gmask), sd2), a)),
+                hn::And(d, gmask)),
+        gmask);
+    return hn::Or(rb, g);
 }
 
-void PsScreenBlend_HDA_o_HWY(tjs_uint32 *dest, const tjs_uint32 *src,
-                              tjs_int len, tjs_int opa) {
-    const hn::ScalableTag<uint8_t> d8;
-    const hn::Repartition<uint16_t, decltype(d8)> d16;
-    const size_t N_PIXELS = hn::Lanes(d8) / 4;
-    const auto vopa16 = hn::Set(d16, static_cast<uint16_t>(opa));
-
-    tjs_int i = 0;
-    for (; i + static_cast<tjs_int>(N_PIXELS) <= len; i += N_PIXELS) {
-        auto vs = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(src + i));
-        auto vd = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(dest + i));
-        auto va = ScaleAlpha(d8, ExtractAlpha(d8, vs), vopa16);
-        auto sd = MulChannels(d8, vs, vd);
-        auto s_minus_sd = hn::SaturatedSub(vs, sd);
-
-        const auto half = hn::Half<decltype(d8)>();
-        auto se_lo = hn::PromoteTo(d16, hn::LowerHalf(half, s_minus_sd));
-        auto se_hi = hn::PromoteUpperTo(d16, s_minus_sd);
-        auto d_lo = hn::PromoteTo(d16, hn::LowerHalf(half, vd));
-        auto d_hi = hn::PromoteUpperTo(d16, vd);
-        auto a_lo = hn::PromoteTo(d16, hn::LowerHalf(half, va));
-        auto a_hi = hn::PromoteUpperTo(d16, va);
-
-        auto r_lo = hn::Add(d_lo, hn::ShiftRight<8>(hn::Mul(se_lo, a_lo)));
-        auto r_hi = hn::Add(d_hi, hn::ShiftRight<8>(hn::Mul(se_hi, a_hi)));
-
-        auto result = ApplyHDA(d8, hn::OrderedDemote2To(d8, r_lo, r_hi), vd);
-        hn::StoreU(result, d8, reinterpret_cast<uint8_t*>(dest + i));
-    }
-
-    for (; i < len; i++) {
-        tjs_uint32 s = src[i], d = dest[i];
-        tjs_uint32 a = ((s >> 24) * opa) >> 8;
-        TVPPsAlphaBlend_Screen_scalar(dest + i, d, s, a);
-        dest[i] = (dest[i] & 0x00ffffff) | (d & 0xff000000);
-    }
+// 6. PsLightenBlend: max(d, s) per channel
+static HWY_INLINE VU32 PsLightenLanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    auto n = PsCarryMask(du, hn::Not(d), s); // d < s: 0xff
+    return PsAlphaBlendLanes(du, d, hn::Or(hn::And(s, n), hn::AndNot(n, d)),
+                             a);
 }
 
-// =========================================================================
-// 6. PsLightenBlend: blended = max(d, s) per channel
-// =========================================================================
-DEFINE_PS_BLEND_4VARIANTS(Lighten,
-    return hn::Max(vd, vs);
-)
+// 7. PsDarkenBlend: min(d, s) per channel
+static HWY_INLINE VU32 PsDarkenLanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    auto n = PsCarryMask(du, hn::Not(d), s); // d < s: 0xff
+    return PsAlphaBlendLanes(du, d, hn::Or(hn::And(d, n), hn::AndNot(n, s)),
+                             a);
+}
 
-// =========================================================================
-// 7. PsDarkenBlend: blended = min(d, s) per channel
-// =========================================================================
-DEFINE_PS_BLEND_4VARIANTS(Darken,
-    return hn::Min(vd, vs);
-)
+// 8. PsDiffBlend: |d - s| per channel
+static HWY_INLINE VU32 PsDiffLanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    auto n = PsCarryMask(du, hn::Not(d), s); // d < s: 0xff
+    auto diff = hn::Or(hn::Sub(hn::And(s, n), hn::And(d, n)),
+                       hn::Sub(hn::AndNot(n, d), hn::AndNot(n, s)));
+    return PsAlphaBlendLanes(du, d, diff, a);
+}
 
-// =========================================================================
-// 8. PsDiffBlend: blended = |d - s| per channel
-// =========================================================================
-DEFINE_PS_BLEND_4VARIANTS(Diff,
-    // |d - s| = max(d,s) - min(d,s) for unsigned
-    auto mx = hn::Max(vd, vs);
-    auto mn = hn::Min(vd, vs);
-    return hn::Sub(mx, mn);
-)
+DEFINE_PS_BLEND_4VARIANTS(Alpha)
+DEFINE_PS_BLEND_4VARIANTS(Add)
+DEFINE_PS_BLEND_4VARIANTS(Sub)
+DEFINE_PS_BLEND_4VARIANTS(Mul)
+DEFINE_PS_BLEND_4VARIANTS(Screen)
+DEFINE_PS_BLEND_4VARIANTS(Lighten)
+DEFINE_PS_BLEND_4VARIANTS(Darken)
+DEFINE_PS_BLEND_4VARIANTS(Diff)
 
 }  // namespace HWY_NAMESPACE
 }  // namespace krkr2
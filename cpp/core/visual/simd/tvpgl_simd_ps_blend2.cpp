@@ -1,37 +1,42 @@
 /*
  * KrKr2 Engine - Highway SIMD Photoshop Blend Modes (Part 2)
  *
- * Implements PS blend modes that require special handling:
+ * Implements the PS blend modes that are table driven in the C version:
  *   PsOverlayBlend - Overlay (conditional per-channel)
  *   PsHardLightBlend - Hard Light (overlay with swapped s/d)
  *   PsExclusionBlend - Exclusion (s - 2*s*d/255)
  *   PsDiff5Blend - Diff5 (fade src first, then |d-s|)
- *   PsSoftLightBlend - Uses lookup table (scalar fallback in SIMD loop)
- *   PsColorDodgeBlend - Uses lookup table (scalar fallback)
- *   PsColorBurnBlend - Uses lookup table (scalar fallback)
- *   PsColorDodge5Blend - Uses lookup table (scalar fallback)
+ *   PsSoftLightBlend - Soft Light (lookup table)
+ *   PsColorDodgeBlend - Color Dodge (d*255/(255-s))
+ *   PsColorBurnBlend - Color Burn (255-(255-d)*255/s)
+ *   PsColorDodge5Blend - Color Dodge, faded src (Photoshop 5.x)
  *
  * Each with 4 variants: base, _o, _HDA, _HDA_o
  * Total: 32 function entries
  *
- * Phase 3 implementation.
+ * One pixel per u32 lane, as in Part 1. Overlay, hard light, color dodge
+ * and color burn evaluate the formulas TVPPsInitTable fills the tables
+ * with, per channel in int32 lanes; the divisions go through float and are
+ * truncated, which is exact for these 16-bit operands. Soft light uses pow
+ * and keeps its table, looked up per lane. Everything else is the packed
+ * arithmetic of the C functors, so all modes are bit-exact with C.
  */
 
 #include "tjsTypes.h"
 #include "tvpgl.h"
 
-// Access the PS lookup tables
-extern unsigned char ps_soft_light_table_TABLE[256][256];
-extern unsigned char ps_color_dodge_table_TABLE[256][256];
-extern unsigned char ps_color_burn_table_TABLE[256][256];
+// Declared once: foreach_target.h re-includes this file for every target
+#ifndef TVPGL_SIMD_PS_BLEND2_DECLS
+#define TVPGL_SIMD_PS_BLEND2_DECLS
 
-// Forward declare the tables defined in blend_function.cpp
-// They are actually struct static members; we access via extern
+// The PS lookup tables, struct static members defined in blend_function.cpp
 struct ps_soft_light_table { static unsigned char TABLE[256][256]; };
 struct ps_color_dodge_table { static unsigned char TABLE[256][256]; };
 struct ps_color_burn_table { static unsigned char TABLE[256][256]; };
 struct ps_overlay_table { static unsigned char TABLE[256][256]; };
 
+#endif  // TVPGL_SIMD_PS_BLEND2_DECLS
+
 #undef HWY_TARGET_INCLUDE
 #define HWY_TARGET_INCLUDE "tvpgl_simd_ps_blend2.cpp"
 #include <hwy/foreach_target.h>
@@ -43,6 +48,12 @@ namespace HWY_NAMESPACE {
 
 namespace hn = hwy::HWY_NAMESPACE;
 
+using DU32 = hn::ScalableTag<uint32_t>;
+using VU32 = hn::Vec<DU32>;
+using DI32 = hn::RebindToSigned<DU32>;
+using VI32 = hn::Vec<DI32>;
+using DF32 = hn::Rebind<float, DU32>;
+
 // Common scalar ps_alpha_blend step
 static HWY_INLINE tjs_uint32 PsAlphaBlendScalar(tjs_uint32 d, tjs_uint32 s,
                                                   tjs_uint32 a) {
@@ -53,266 +64,88 @@ static HWY_INLINE tjs_uint32 PsAlphaBlendScalar(tjs_uint32 d, tjs_uint32 s,
 }
 
 // =========================================================================
-// Helper for SIMD ps_alpha_blend
+// Helpers for the u32 lane kernels
 // =========================================================================
-static HWY_INLINE hn::Vec<hn::ScalableTag<uint8_t>> PsApplyAlpha(
-    hn::ScalableTag<uint8_t> d8,
-    hn::Vec<hn::ScalableTag<uint8_t>> vd,
-    hn::Vec<hn::ScalableTag<uint8_t>> vs_blended,
-    hn::Vec<hn::ScalableTag<uint8_t>> va) {
-    const hn::Repartition<uint16_t, decltype(d8)> d16;
-    const auto half = hn::Half<decltype(d8)>();
-    const auto v255 = hn::Set(d16, static_cast<uint16_t>(255));
-    auto s_lo = hn::PromoteTo(d16, hn::LowerHalf(half, vs_blended));
-    auto d_lo = hn::PromoteTo(d16, hn::LowerHalf(half, vd));
-    auto a_lo = hn::PromoteTo(d16, hn::LowerHalf(half, va));
-    auto s_hi = hn::PromoteUpperTo(d16, vs_blended);
-    auto d_hi = hn::PromoteUpperTo(d16, vd);
-    auto a_hi = hn::PromoteUpperTo(d16, va);
-    // result = (s * a >> 8) + (d * (255 - a) >> 8), split to avoid u16 overflow
-    auto inv_a_lo = hn::Sub(v255, a_lo);
-    auto inv_a_hi = hn::Sub(v255, a_hi);
-    auto r_lo = hn::Add(hn::ShiftRight<8>(hn::Mul(s_lo, a_lo)),
-                        hn::ShiftRight<8>(hn::Mul(d_lo, inv_a_lo)));
-    auto r_hi = hn::Add(hn::ShiftRight<8>(hn::Mul(s_hi, a_hi)),
-                        hn::ShiftRight<8>(hn::Mul(d_hi, inv_a_hi)));
-    return hn::OrderedDemote2To(d8, r_lo, r_hi);
-}
 
-static HWY_INLINE hn::Vec<hn::ScalableTag<uint8_t>> ExtractAlpha(
-    hn::ScalableTag<uint8_t> d8,
-    hn::Vec<hn::ScalableTag<uint8_t>> vs) {
-    const auto alpha_shuffle = hn::Dup128VecFromValues(d8,
-        3, 3, 3, 3,    7, 7, 7, 7,
-        11, 11, 11, 11, 15, 15, 15, 15);
-    return hn::TableLookupBytes(vs, alpha_shuffle);
+// ps_alpha_blend on u32 lanes; the alpha byte of the result is zero
+static HWY_INLINE VU32 PsAlphaBlendLanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    const auto rbmask = hn::Set(du, 0x00ff00ffu);
+    const auto gmask = hn::Set(du, 0x0000ff00u);
+    auto d1 = hn::And(d, rbmask);
+    auto d2 = hn::And(d, gmask);
+    auto rb = hn::And(
+        hn::Add(hn::ShiftRight<8>(hn::Mul(hn::Sub(hn::And(s, rbmask), d1), a)),
+                d1),
+        rbmask);
+    auto g = hn::And(
+        hn::Add(hn::ShiftRight<8>(hn::Mul(hn::Sub(hn::And(s, gmask), d2), a)),
+                d2),
+        gmask);
+    return hn::Or(rb, g);
 }
 
-static HWY_INLINE hn::Vec<hn::ScalableTag<uint8_t>> ScaleAlpha(
-    hn::ScalableTag<uint8_t> d8,
-    hn::Vec<hn::ScalableTag<uint8_t>> va,
-    hn::Vec<hn::ScalableTag<uint16_t>> vopa16) {
-    const hn::Repartition<uint16_t, decltype(d8)> d16;
-    const auto half = hn::Half<decltype(d8)>();
-    auto a_lo = hn::ShiftRight<8>(hn::Mul(hn::PromoteTo(d16, hn::LowerHalf(half, va)), vopa16));
-    auto a_hi = hn::ShiftRight<8>(hn::Mul(hn::PromoteUpperTo(d16, va), vopa16));
-    return hn::OrderedDemote2To(d8, a_lo, a_hi);
+// src faded by a, alpha byte cleared (Diff5 / ColorDodge5)
+static HWY_INLINE VU32 PsFadeLanes(DU32 du, VU32 s, VU32 a) {
+    const auto rbmask = hn::Set(du, 0x00ff00ffu);
+    const auto gmask = hn::Set(du, 0x0000ff00u);
+    return hn::Or(
+        hn::And(hn::ShiftRight<8>(hn::Mul(hn::And(s, rbmask), a)), rbmask),
+        hn::And(hn::ShiftRight<8>(hn::Mul(hn::And(s, gmask), a)), gmask));
 }
 
-static HWY_INLINE hn::Vec<hn::ScalableTag<uint8_t>> MulChannels(
-    hn::ScalableTag<uint8_t> d8,
-    hn::Vec<hn::ScalableTag<uint8_t>> va,
-    hn::Vec<hn::ScalableTag<uint8_t>> vb) {
-    const hn::Repartition<uint16_t, decltype(d8)> d16;
-    const auto half = hn::Half<decltype(d8)>();
-    auto a_lo = hn::PromoteTo(d16, hn::LowerHalf(half, va));
-    auto b_lo = hn::PromoteTo(d16, hn::LowerHalf(half, vb));
-    auto a_hi = hn::PromoteUpperTo(d16, va);
-    auto b_hi = hn::PromoteUpperTo(d16, vb);
-    auto r_lo = hn::ShiftRight<8>(hn::Mul(a_lo, b_lo));
-    auto r_hi = hn::ShiftRight<8>(hn::Mul(a_hi, b_hi));
-    return hn::OrderedDemote2To(d8, r_lo, r_hi);
+static HWY_INLINE VU32 ApplyHDA(DU32 du, VU32 result, VU32 d) {
+    return hn::Or(hn::And(result, hn::Set(du, 0x00ffffffu)),
+                  hn::And(d, hn::Set(du, 0xff000000u)));
 }
 
-static HWY_INLINE hn::Vec<hn::ScalableTag<uint8_t>> ApplyHDA(
-    hn::ScalableTag<uint8_t> d8,
-    hn::Vec<hn::ScalableTag<uint8_t>> result,
-    hn::Vec<hn::ScalableTag<uint8_t>> vd) {
-    auto mask = hn::Dup128VecFromValues(d8,
-        0, 0, 0, 0xFF,  0, 0, 0, 0xFF,
-        0, 0, 0, 0xFF,  0, 0, 0, 0xFF);
-    return hn::Or(hn::AndNot(mask, result), hn::And(mask, vd));
+// trunc(num / den) for 0 <= num < 2^17 and 1 <= den; the +0.5 keeps the
+// quotient away from the integers, so an approximate division can not
+// round it across one
+static HWY_INLINE VI32 DivTrunc(DI32 di, VI32 num, VI32 den) {
+    const DF32 df;
+    auto q = hn::Div(hn::Add(hn::ConvertTo(df, num), hn::Set(df, 0.5f)),
+                     hn::ConvertTo(df, den));
+    return hn::ConvertTo(di, q);
 }
 
-// =========================================================================
-// Overlay core: per channel, if d < 128: 2*d*s/255, else: 2*(d+s) - 2*d*s/255 - 255
-// SIMD: use comparison mask
-// =========================================================================
-static HWY_INLINE hn::Vec<hn::ScalableTag<uint8_t>> OverlayCore(
-    hn::ScalableTag<uint8_t> d8,
-    hn::Vec<hn::ScalableTag<uint8_t>> vd,
-    hn::Vec<hn::ScalableTag<uint8_t>> vs) {
-
-    const hn::Repartition<uint16_t, decltype(d8)> d16;
-    const auto half = hn::Half<decltype(d8)>();
-    const auto v128 = hn::Set(d8, 128);
-    const auto v255_16 = hn::Set(d16, 255);
-
-    // mask: d < 128 → true
-    auto mask = hn::Lt(vd, v128);
-
-    // Compute both paths in u16
-    auto d_lo = hn::PromoteTo(d16, hn::LowerHalf(half, vd));
-    auto s_lo = hn::PromoteTo(d16, hn::LowerHalf(half, vs));
-    auto d_hi = hn::PromoteUpperTo(d16, vd);
-    auto s_hi = hn::PromoteUpperTo(d16, vs);
-
-    // Path 1 (d < 128): 2*d*s/255 ≈ (d*s) >> 7
-    // d*s max=65025 fits u16, >>7 max=507, saturates to 255 on demote
-    auto p1_lo = hn::ShiftRight<7>(hn::Mul(d_lo, s_lo));
-    auto p1_hi = hn::ShiftRight<7>(hn::Mul(d_hi, s_hi));
-    auto path1 = hn::OrderedDemote2To(d8, p1_lo, p1_hi);
-
-    // Path 2 (d >= 128): 2*(d+s) - 2*d*s/255 - 255
-    // = 2*(d+s) - 2*(d*s>>8) - 255
-    auto ds_lo = hn::Add(d_lo, s_lo);  // d+s, max 510
-    auto ds_hi = hn::Add(d_hi, s_hi);
-    auto mul_lo = hn::ShiftRight<7>(hn::Mul(d_lo, s_lo));  // 2*d*s/256
-    auto mul_hi = hn::ShiftRight<7>(hn::Mul(d_hi, s_hi));
-    // 2*(d+s) - 2*d*s/256 - 255
-    auto p2_lo = hn::Sub(hn::Sub(hn::ShiftLeft<1>(ds_lo), mul_lo), v255_16);
-    auto p2_hi = hn::Sub(hn::Sub(hn::ShiftLeft<1>(ds_hi), mul_hi), v255_16);
-    auto path2 = hn::OrderedDemote2To(d8, p2_lo, p2_hi);
-
-    return hn::IfThenElse(mask, path1, path2);
+// ps_overlay_table[s][d] for one channel in each lane
+static HWY_INLINE VI32 OverlayChannel(DI32 di, VI32 s, VI32 d) {
+    const auto v255 = hn::Set(di, 255);
+    auto sd = DivTrunc(di, hn::ShiftLeft<1>(hn::Mul(s, d)), v255);
+    auto hi = hn::Sub(hn::Sub(hn::ShiftLeft<1>(hn::Add(s, d)), sd), v255);
+    return hn::IfThenElse(hn::Lt(d, hn::Set(di, 128)), sd, hi);
 }
 
-// HardLight core: same as overlay but s and d swapped in the condition
-static HWY_INLINE hn::Vec<hn::ScalableTag<uint8_t>> HardLightCore(
-    hn::ScalableTag<uint8_t> d8,
-    hn::Vec<hn::ScalableTag<uint8_t>> vd,
-    hn::Vec<hn::ScalableTag<uint8_t>> vs) {
-
-    const hn::Repartition<uint16_t, decltype(d8)> d16;
-    const auto half = hn::Half<decltype(d8)>();
-    const auto v128 = hn::Set(d8, 128);
-    const auto v255_16 = hn::Set(d16, 255);
-
-    // HardLight: condition on s (not d)
-    auto mask = hn::Lt(vs, v128);
-
-    auto d_lo = hn::PromoteTo(d16, hn::LowerHalf(half, vd));
-    auto s_lo = hn::PromoteTo(d16, hn::LowerHalf(half, vs));
-    auto d_hi = hn::PromoteUpperTo(d16, vd);
-    auto s_hi = hn::PromoteUpperTo(d16, vs);
-
-    // Path 1 (s < 128): 2*d*s/255 ≈ (d*s) >> 7
-    auto p1_lo = hn::ShiftRight<7>(hn::Mul(d_lo, s_lo));
-    auto p1_hi = hn::ShiftRight<7>(hn::Mul(d_hi, s_hi));
-    auto path1 = hn::OrderedDemote2To(d8, p1_lo, p1_hi);
-
-    // Path 2 (s >= 128): 2*(d+s) - 2*d*s/256 - 255
-    auto ds_lo = hn::Add(d_lo, s_lo);
-    auto ds_hi = hn::Add(d_hi, s_hi);
-    auto mul_lo = hn::ShiftRight<7>(hn::Mul(d_lo, s_lo));
-    auto mul_hi = hn::ShiftRight<7>(hn::Mul(d_hi, s_hi));
-    auto p2_lo = hn::Sub(hn::Sub(hn::ShiftLeft<1>(ds_lo), mul_lo), v255_16);
-    auto p2_hi = hn::Sub(hn::Sub(hn::ShiftLeft<1>(ds_hi), mul_hi), v255_16);
-    auto path2 = hn::OrderedDemote2To(d8, p2_lo, p2_hi);
-
-    return hn::IfThenElse(mask, path1, path2);
+// ps_color_dodge_table[s][d]
+static HWY_INLINE VI32 ColorDodgeChannel(DI32 di, VI32 s, VI32 d) {
+    const auto v255 = hn::Set(di, 255);
+    auto den = hn::Sub(v255, s);
+    auto q = DivTrunc(di, hn::Mul(d, v255), hn::Max(den, hn::Set(di, 1)));
+    return hn::IfThenElse(hn::Lt(d, den), q, v255);
 }
 
-// Exclusion core: s - 2*s*d/255 per channel
-// result = d + (s - 2*s*d/255) * a >> 8
-// s_eff = s - 2*s*d/255, applied via PsApplyAlpha
-static HWY_INLINE hn::Vec<hn::ScalableTag<uint8_t>> ExclusionCore(
-    hn::ScalableTag<uint8_t> d8,
-    hn::Vec<hn::ScalableTag<uint8_t>> vd,
-    hn::Vec<hn::ScalableTag<uint8_t>> vs) {
-
-    const hn::Repartition<uint16_t, decltype(d8)> d16;
-    const auto half = hn::Half<decltype(d8)>();
-
-    auto d_lo = hn::PromoteTo(d16, hn::LowerHalf(half, vd));
-    auto s_lo = hn::PromoteTo(d16, hn::LowerHalf(half, vs));
-    auto d_hi = hn::PromoteUpperTo(d16, vd);
-    auto s_hi = hn::PromoteUpperTo(d16, vs);
-
-    // 2*s*d / 255 ≈ (2*s*d) >> 8
-    // But we need: s + d - 2*s*d/255
-    // Which is the exclusion formula
-    auto sd2_lo = hn::ShiftRight<7>(hn::Mul(s_lo, d_lo));  // 2*s*d/256
-    auto sd2_hi = hn::ShiftRight<7>(hn::Mul(s_hi, d_hi));
-
-    // result = s + d - 2*s*d/255
-    auto r_lo = hn::Sub(hn::Add(s_lo, d_lo), sd2_lo);
-    auto r_hi = hn::Sub(hn::Add(s_hi, d_hi), sd2_hi);
-
-    return hn::OrderedDemote2To(d8, r_lo, r_hi);
+// ps_color_burn_table[s][d]
+static HWY_INLINE VI32 ColorBurnChannel(DI32 di, VI32 s, VI32 d) {
+    const auto v255 = hn::Set(di, 255);
+    auto id = hn::Sub(v255, d);
+    auto q = DivTrunc(di, hn::Mul(id, v255), hn::Max(s, hn::Set(di, 1)));
+    return hn::IfThenElse(hn::Lt(id, s), hn::Sub(v255, q), hn::Zero(di));
 }
 
-// =========================================================================
-// Helper macro for 4 variants generation
-// =========================================================================
-#define MAKE_PS_4V(Name, simd_blend_expr)                                     \
-void Ps##Name##Blend_HWY(tjs_uint32 *dest, const tjs_uint32 *src,            \
-                          tjs_int len) {                                       \
-    const hn::ScalableTag<uint8_t> d8;                                        \
-    const size_t N_PIXELS = hn::Lanes(d8) / 4;                               \
-    tjs_int i = 0;                                                            \
-    for (; i + (tjs_int)N_PIXELS <= len; i += N_PIXELS) {                     \
-        auto vs = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(src + i));   \
-        auto vd = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(dest + i)); \
-        auto va = ExtractAlpha(d8, vs);                                       \
-        auto vb = simd_blend_expr;                                            \
-        auto result = PsApplyAlpha(d8, vd, vb, va);                           \
-        hn::StoreU(result, d8, reinterpret_cast<uint8_t*>(dest + i));         \
-    }                                                                          \
-    for (; i < len; i++) {                                                    \
-        tjs_uint32 s = src[i], d = dest[i], a = s >> 24;                      \
-        Ps##Name##_scalar(dest + i, d, s, a);                                 \
-    }                                                                          \
-}                                                                              \
-void Ps##Name##Blend_o_HWY(tjs_uint32 *dest, const tjs_uint32 *src,          \
-                            tjs_int len, tjs_int opa) {                       \
-    const hn::ScalableTag<uint8_t> d8;                                        \
-    const hn::Repartition<uint16_t, decltype(d8)> d16;                        \
-    const size_t N_PIXELS = hn::Lanes(d8) / 4;                               \
-    const auto vopa16 = hn::Set(d16, static_cast<uint16_t>(opa));             \
-    tjs_int i = 0;                                                            \
-    for (; i + (tjs_int)N_PIXELS <= len; i += N_PIXELS) {                     \
-        auto vs = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(src + i));   \
-        auto vd = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(dest + i)); \
-        auto va = ScaleAlpha(d8, ExtractAlpha(d8, vs), vopa16);               \
-        auto vb = simd_blend_expr;                                            \
-        auto result = PsApplyAlpha(d8, vd, vb, va);                           \
-        hn::StoreU(result, d8, reinterpret_cast<uint8_t*>(dest + i));         \
-    }                                                                          \
-    for (; i < len; i++) {                                                    \
-        tjs_uint32 s = src[i], d = dest[i], a = ((s>>24)*opa)>>8;            \
-        Ps##Name##_scalar(dest + i, d, s, a);                                 \
-    }                                                                          \
-}                                                                              \
-void Ps##Name##Blend_HDA_HWY(tjs_uint32 *dest, const tjs_uint32 *src,        \
-                              tjs_int len) {                                   \
-    const hn::ScalableTag<uint8_t> d8;                                        \
-    const size_t N_PIXELS = hn::Lanes(d8) / 4;                               \
-    tjs_int i = 0;                                                            \
-    for (; i + (tjs_int)N_PIXELS <= len; i += N_PIXELS) {                     \
-        auto vs = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(src + i));   \
-        auto vd = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(dest + i)); \
-        auto va = ExtractAlpha(d8, vs);                                       \
-        auto vb = simd_blend_expr;                                            \
-        auto result = ApplyHDA(d8, PsApplyAlpha(d8, vd, vb, va), vd);         \
-        hn::StoreU(result, d8, reinterpret_cast<uint8_t*>(dest + i));         \
-    }                                                                          \
-    for (; i < len; i++) {                                                    \
-        tjs_uint32 s = src[i], d = dest[i], a = s >> 24;                      \
-        Ps##Name##_scalar(dest + i, d, s, a);                                 \
-        dest[i] = (dest[i] & 0x00ffffff) | (d & 0xff000000);                  \
-    }                                                                          \
-}                                                                              \
-void Ps##Name##Blend_HDA_o_HWY(tjs_uint32 *dest, const tjs_uint32 *src,      \
-                                tjs_int len, tjs_int opa) {                   \
-    const hn::ScalableTag<uint8_t> d8;                                        \
-    const hn::Repartition<uint16_t, decltype(d8)> d16;                        \
-    const size_t N_PIXELS = hn::Lanes(d8) / 4;                               \
-    const auto vopa16 = hn::Set(d16, static_cast<uint16_t>(opa));             \
-    tjs_int i = 0;                                                            \
-    for (; i + (tjs_int)N_PIXELS <= len; i += N_PIXELS) {                     \
-        auto vs = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(src + i));   \
-        auto vd = hn::LoadU(d8, reinterpret_cast<const uint8_t*>(dest + i)); \
-        auto va = ScaleAlpha(d8, ExtractAlpha(d8, vs), vopa16);               \
-        auto vb = simd_blend_expr;                                            \
-        auto result = ApplyHDA(d8, PsApplyAlpha(d8, vd, vb, va), vd);         \
-        hn::StoreU(result, d8, reinterpret_cast<uint8_t*>(dest + i));         \
-    }                                                                          \
-    for (; i < len; i++) {                                                    \
-        tjs_uint32 s = src[i], d = dest[i], a = ((s>>24)*opa)>>8;            \
-        Ps##Name##_scalar(dest + i, d, s, a);                                 \
-        dest[i] = (dest[i] & 0x00ffffff) | (d & 0xff000000);                  \
-    }                                                                          \
+// Applies Channel(s, d) to the three color channels; alpha byte is zero
+template <VI32 (*Channel)(DI32, VI32, VI32)>
+static HWY_INLINE VU32 PerChannelLanes(DU32 du, VU32 s, VU32 d) {
+    const DI32 di;
+    const auto ff = hn::Set(du, 0xffu);
+    auto c2 = Channel(di, hn::BitCast(di, hn::And(hn::ShiftRight<16>(s), ff)),
+                      hn::BitCast(di, hn::And(hn::ShiftRight<16>(d), ff)));
+    auto c1 = Channel(di, hn::BitCast(di, hn::And(hn::ShiftRight<8>(s), ff)),
+                      hn::BitCast(di, hn::And(hn::ShiftRight<8>(d), ff)));
+    auto c0 = Channel(di, hn::BitCast(di, hn::And(s, ff)),
+                      hn::BitCast(di, hn::And(d, ff)));
+    return hn::Or(hn::Or(hn::ShiftLeft<16>(hn::BitCast(du, c2)),
+                         hn::ShiftLeft<8>(hn::BitCast(du, c1))),
+                  hn::BitCast(du, c0));
 }
 
 // =========================================================================
@@ -387,36 +220,142 @@ static HWY_INLINE void PsDiff5_scalar(tjs_uint32 *dest, tjs_uint32 d,
 }
 
 // =========================================================================
-// SIMD implementations for Overlay, HardLight, Exclusion
+// Vector cores, one per mode; each mirrors the scalar helper above
 // =========================================================================
-MAKE_PS_4V(Overlay, OverlayCore(d8, vd, vs))
-MAKE_PS_4V(HardLight, HardLightCore(d8, vd, vs))
-MAKE_PS_4V(Exclusion, ExclusionCore(d8, vd, vs))
+
+static HWY_INLINE VU32 PsOverlayLanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    return PsAlphaBlendLanes(du, d, PerChannelLanes<OverlayChannel>(du, s, d),
+                             a);
+}
+
+// HardLight: the overlay table indexed [d][s]
+static HWY_INLINE VU32 PsHardLightLanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    return PsAlphaBlendLanes(du, d, PerChannelLanes<OverlayChannel>(du, d, s),
+                             a);
+}
+
+// Exclusion: result = ((s - 2 * s * d >> 8) * a >> 8) + d
+static HWY_INLINE VU32 PsExclusionLanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    const auto ff = hn::Set(du, 0xffu);
+    const auto rbmask = hn::Set(du, 0x00ff00ffu);
+    const auto gmask = hn::Set(du, 0x0000ff00u);
+    auto sd1 = hn::Or(
+        hn::And(hn::Mul(hn::And(hn::ShiftRight<16>(d), ff),
+                        hn::ShiftRight<7>(hn::And(s, hn::Set(du, 0x00ff0000u)))),
+                hn::Set(du, 0x01ff0000u)),
+        hn::ShiftRight<7>(hn::Mul(hn::And(d, ff), hn::And(s, ff))));
+    auto sd2 = hn::ShiftRight<7>(
+        hn::And(hn::Mul(hn::And(hn::ShiftRight<8>(d), ff), hn::And(s, gmask)),
+                hn::Set(du, 0x00ff8000u)));
+    auto rb = hn::And(
+        hn::Add(hn::ShiftRight<8>(hn::Mul(hn::Sub(hn::And(s, rbmask), sd1), a)),
+                hn::And(d, rbmask)),
+        rbmask);
+    auto g = hn::And(
+        hn::Add(hn::ShiftRight<8>(hn::Mul(hn::Sub(hn::And(s, gmask), sd2), a)),
+                hn::And(d, gmask)),
+        gmask);
+    return hn::Or(rb, g);
+}
+
+// SoftLight: pow() based table, looked up per lane
+static HWY_INLINE VU32 PsSoftLightLanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    HWY_ALIGN uint32_t sl[hn::MaxLanes(du)];
+    HWY_ALIGN uint32_t dl[hn::MaxLanes(du)];
+    hn::Store(s, du, sl);
+    hn::Store(d, du, dl);
+    const size_t N = hn::Lanes(du);
+    for (size_t k = 0; k < N; k++) {
+        const tjs_uint32 ss = sl[k], dd = dl[k];
+        sl[k] =
+            (ps_soft_light_table::TABLE[(ss >> 16) & 0xff][(dd >> 16) & 0xff]
+             << 16) |
+            (ps_soft_light_table::TABLE[(ss >> 8) & 0xff][(dd >> 8) & 0xff]
+             << 8) |
+            ps_soft_light_table::TABLE[ss & 0xff][dd & 0xff];
+    }
+    return PsAlphaBlendLanes(du, d, hn::Load(du, sl), a);
+}
+
+static HWY_INLINE VU32 PsColorDodgeLanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    return PsAlphaBlendLanes(
+        du, d, PerChannelLanes<ColorDodgeChannel>(du, s, d), a);
+}
+
+static HWY_INLINE VU32 PsColorBurnLanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    return PsAlphaBlendLanes(
+        du, d, PerChannelLanes<ColorBurnChannel>(du, s, d), a);
+}
+
+// ColorDodge5: fade src, then the dodge table; no alpha blend step
+static HWY_INLINE VU32 PsColorDodge5Lanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    return PerChannelLanes<ColorDodgeChannel>(du, PsFadeLanes(du, s, a), d);
+}
+
+// Diff5: fade src, then |d - s|; the alpha byte is d's
+static HWY_INLINE VU32 PsDiff5Lanes(DU32 du, VU32 d, VU32 s, VU32 a) {
+    s = PsFadeLanes(du, s, a);
+    auto n = hn::And(
+        hn::Add(hn::ShiftLeft<1>(hn::AndNot(d, s)),
+                hn::And(hn::Xor(hn::Not(d), s), hn::Set(du, 0x00fefefeu))),
+        hn::Set(du, 0x01010100u));
+    const auto v7f = hn::Set(du, 0x007f7f7fu);
+    n = hn::Xor(hn::Add(hn::ShiftRight<8>(n), v7f), v7f);
+    return hn::Or(hn::Sub(hn::And(s, n), hn::And(d, n)),
+                  hn::Sub(hn::AndNot(n, d), hn::AndNot(n, s)));
+}
 
 // =========================================================================
-// Table-based modes: SoftLight, ColorDodge, ColorBurn, ColorDodge5, Diff5
-// These use per-pixel scalar table lookups - still vectorize the alpha blend step
+// 4 variants of each mode: Ps##Name##Lanes for whole vectors,
+// Ps##Name##_scalar for the tail
 // =========================================================================
-
-// Generic scalar-core + SIMD-alpha pattern for table-based blend
-#define MAKE_PS_TABLE_4V(Name)                                                \
+#define MAKE_PS_4V(Name)                                                      \
 void Ps##Name##Blend_HWY(tjs_uint32 *dest, const tjs_uint32 *src,            \
                           tjs_int len) {                                       \
-    for (tjs_int i = 0; i < len; i++) {                                       \
+    const DU32 du;                                                            \
+    const tjs_int N = (tjs_int)hn::Lanes(du);                                 \
+    tjs_int i = 0;                                                            \
+    for (; i + N <= len; i += N) {                                            \
+        auto vs = hn::LoadU(du, src + i);                                     \
+        auto vd = hn::LoadU(du, dest + i);                                    \
+        auto va = hn::ShiftRight<24>(vs);                                     \
+        hn::StoreU(Ps##Name##Lanes(du, vd, vs, va), du, dest + i);           \
+    }                                                                          \
+    for (; i < len; i++) {                                                    \
         tjs_uint32 s = src[i], d = dest[i], a = s >> 24;                      \
         Ps##Name##_scalar(dest + i, d, s, a);                                 \
     }                                                                          \
 }                                                                              \
 void Ps##Name##Blend_o_HWY(tjs_uint32 *dest, const tjs_uint32 *src,          \
                             tjs_int len, tjs_int opa) {                       \
-    for (tjs_int i = 0; i < len; i++) {                                       \
-        tjs_uint32 s = src[i], d = dest[i], a = ((s >> 24) * opa) >> 8;      \
+    const DU32 du;                                                            \
+    const tjs_int N = (tjs_int)hn::Lanes(du);                                 \
+    const auto vopa = hn::Set(du, (uint32_t)opa);                             \
+    tjs_int i = 0;                                                            \
+    for (; i + N <= len; i += N) {                                            \
+        auto vs = hn::LoadU(du, src + i);                                     \
+        auto vd = hn::LoadU(du, dest + i);                                    \
+        auto va = hn::ShiftRight<8>(hn::Mul(hn::ShiftRight<24>(vs), vopa));   \
+        hn::StoreU(Ps##Name##Lanes(du, vd, vs, va), du, dest + i);           \
+    }                                                                          \
+    for (; i < len; i++) {                                                    \
+        tjs_uint32 s = src[i], d = dest[i], a = ((s>>24)*opa)>>8;            \
         Ps##Name##_scalar(dest + i, d, s, a);                                 \
     }                                                                          \
 }                                                                              \
 void Ps##Name##Blend_HDA_HWY(tjs_uint32 *dest, const tjs_uint32 *src,        \
                               tjs_int len) {                                   \
-    for (tjs_int i = 0; i < len; i++) {                                       \
+    const DU32 du;                                                            \
+    const tjs_int N = (tjs_int)hn::Lanes(du);                                 \
+    tjs_int i = 0;                                                            \
+    for (; i + N <= len; i += N) {                                            \
+        auto vs = hn::LoadU(du, src + i);                                     \
+        auto vd = hn::LoadU(du, dest + i);                                    \
+        auto va = hn::ShiftRight<24>(vs);                                     \
+        auto result = ApplyHDA(du, Ps##Name##Lanes(du, vd, vs, va), vd);      \
+        hn::StoreU(result, du, dest + i);                                     \
+    }                                                                          \
+    for (; i < len; i++) {                                                    \
         tjs_uint32 s = src[i], d = dest[i], a = s >> 24;                      \
         Ps##Name##_scalar(dest + i, d, s, a);                                 \
         dest[i] = (dest[i] & 0x00ffffff) | (d & 0xff000000);                  \
@@ -424,18 +363,32 @@ void Ps##Name##Blend_HDA_HWY(tjs_uint32 *dest, const tjs_uint32 *src,        \
 }                                                                              \
 void Ps##Name##Blend_HDA_o_HWY(tjs_uint32 *dest, const tjs_uint32 *src,      \
                                 tjs_int len, tjs_int opa) {                   \
-    for (tjs_int i = 0; i < len; i++) {                                       \
-        tjs_uint32 s = src[i], d = dest[i], a = ((s >> 24) * opa) >> 8;      \
+    const DU32 du;                                                            \
+    const tjs_int N = (tjs_int)hn::Lanes(du);                                 \
+    const auto vopa = hn::Set(du, (uint32_t)opa);                             \
+    tjs_int i = 0;                                                            \
+    for (; i + N <= len; i += N) {                                            \
+        auto vs = hn::LoadU(du, src + i);                                     \
+        auto vd = hn::LoadU(du, dest + i);                                    \
+        auto va = hn::ShiftRight<8>(hn::Mul(hn::ShiftRight<24>(vs), vopa));   \
+        auto result = ApplyHDA(du, Ps##Name##Lanes(du, vd, vs, va), vd);      \
+        hn::StoreU(result, du, dest + i);                                     \
+    }                                                                          \
+    for (; i < len; i++) {                                                    \
+        tjs_uint32 s = src[i], d = dest[i], a = ((s>>24)*opa)>>8;            \
         Ps##Name##_scalar(dest + i, d, s, a);                                 \
         dest[i] = (dest[i] & 0x00ffffff) | (d & 0xff000000);                  \
     }                                                                          \
 }
 
-MAKE_PS_TABLE_4V(SoftLight)
-MAKE_PS_TABLE_4V(ColorDodge)
-MAKE_PS_TABLE_4V(ColorBurn)
-MAKE_PS_TABLE_4V(ColorDodge5)
-MAKE_PS_TABLE_4V(Diff5)
+MAKE_PS_4V(Overlay)
+MAKE_PS_4V(HardLight)
+MAKE_PS_4V(Exclusion)
+MAKE_PS_4V(SoftLight)
+MAKE_PS_4V(ColorDodge)
+MAKE_PS_4V(ColorBurn)
+MAKE_PS_4V(ColorDodge5)
+MAKE_PS_4V(Diff5)
 
 }  // namespace HWY_NAMESPACE
 }  // namespace krkr2
@@ -459,27 +412,27 @@ HWY_EXPORT(PsExclusionBlend_HWY);
 HWY_EXPORT(PsExclusionBlend_o_HWY);
 HWY_EXPORT(PsExclusionBlend_HDA_HWY);
 HWY_EXPORT(PsExclusionBlend_HDA_o_HWY);
-// SoftLight (table)
+// SoftLight
 HWY_EXPORT(PsSoftLightBlend_HWY);
 HWY_EXPORT(PsSoftLightBlend_o_HWY);
 HWY_EXPORT(PsSoftLightBlend_HDA_HWY);
 HWY_EXPORT(PsSoftLightBlend_HDA_o_HWY);
-// ColorDodge (table)
+// ColorDodge
 HWY_EXPORT(PsColorDodgeBlend_HWY);
 HWY_EXPORT(PsColorDodgeBlend_o_HWY);
 HWY_EXPORT(PsColorDodgeBlend_HDA_HWY);
 HWY_EXPORT(PsColorDodgeBlend_HDA_o_HWY);
-// ColorBurn (table)
+// ColorBurn
 HWY_EXPORT(PsColorBurnBlend_HWY);
 HWY_EXPORT(PsColorBurnBlend_o_HWY);
 HWY_EXPORT(PsColorBurnBlend_HDA_HWY);
 HWY_EXPORT(PsColorBurnBlend_HDA_o_HWY);
-// ColorDodge5 (table)
+// ColorDodge5
 HWY_EXPORT(PsColorDodge5Blend_HWY);
 HWY_EXPORT(PsColorDodge5Blend_o_HWY);
 HWY_EXPORT(PsColorDodge5Blend_HDA_HWY);
 HWY_EXPORT(PsColorDodge5Blend_HDA_o_HWY);
-// Diff5 (table)
+// Diff5
 HWY_EXPORT(PsDiff5Blend_HWY);
 HWY_EXPORT(PsDiff5Blend_o_HWY);
 HWY_EXPORT(PsDiff5Blend_HDA_HWY);
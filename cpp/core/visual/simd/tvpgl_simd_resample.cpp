@@ -0,0 +1,152 @@
+/*
+ * KrKr2 Engine - Highway SIMD Resampler Rows
+ *
+ * Implements the two passes of the fixed-point separable resampler
+ * (gl/ResampleImage.cpp):
+ *   TVPResampleRowH, TVPResampleRowV
+ *
+ * Weights are signed fixed point with TVP_RESAMPLE_WEIGHT_BITS fractional
+ * bits; every weight set sums to 1 << TVP_RESAMPLE_WEIGHT_BITS, so the
+ * result of either pass is rounded, shifted back and saturated to 8 bits,
+ * bit-exact with the C versions.
+ *
+ * The horizontal pass holds the four channels of one destination pixel in
+ * the int32 lanes of a 128-bit vector and accumulates its taps. The
+ * vertical pass runs across the bytes of the row, one int32 lane per byte,
+ * accumulating the same byte of every source line.
+ */
+
+#include "tjsTypes.h"
+#include "tvpgl.h"
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "tvpgl_simd_resample.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+HWY_BEFORE_NAMESPACE();
+namespace krkr2 {
+namespace HWY_NAMESPACE {
+
+namespace hn = hwy::HWY_NAMESPACE;
+
+// one BGRA pixel, one channel per lane
+using DPix32 = hn::FixedTag<int32_t, 4>;
+using DPix8 = hn::Rebind<uint8_t, DPix32>;
+
+using DI32 = hn::ScalableTag<int32_t>;
+using DU8 = hn::Rebind<uint8_t, DI32>;
+
+static constexpr tjs_int kResampleRound =
+    1 << (TVP_RESAMPLE_WEIGHT_BITS - 1);
+
+static HWY_INLINE tjs_uint8 ResampleClampByte(tjs_int v) {
+    v = (v + kResampleRound) >> TVP_RESAMPLE_WEIGHT_BITS;
+    return (tjs_uint8)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+// =========================================================================
+// TVPResampleRowH: dest[x] = sum(src[start[x] + i] * weight[i]),
+// i < length[x]; the weights of consecutive pixels are packed back to back
+// =========================================================================
+
+void ResampleRowH_HWY(tjs_uint32 *dest, const tjs_uint32 *src,
+                      const tjs_int *start, const tjs_int *length,
+                      const tjs_int *weight, tjs_int len) {
+    const DPix32 d32;
+    const DPix8 d8;
+    const auto round = hn::Set(d32, kResampleRound);
+
+    for(tjs_int x = 0; x < len; x++) {
+        const tjs_uint8 *s = (const tjs_uint8 *)(src + start[x]);
+        const tjs_int n = length[x];
+        auto acc = round;
+        for(tjs_int i = 0; i < n; i++) {
+            const auto px = hn::PromoteTo(d32, hn::LoadU(d8, s + i * 4));
+            acc = hn::MulAdd(px, hn::Set(d32, weight[i]), acc);
+        }
+        weight += n;
+        const auto res = hn::DemoteTo(
+            d8, hn::ShiftRight<TVP_RESAMPLE_WEIGHT_BITS>(acc));
+        hn::StoreU(res, d8, (tjs_uint8 *)(dest + x));
+    }
+}
+
+// =========================================================================
+// TVPResampleRowV: dest[x] = sum(lines[i][x] * weight[i]), i < taps
+// =========================================================================
+
+void ResampleRowV_HWY(tjs_uint32 *dest, const tjs_uint32 *const *lines,
+                      const tjs_int *weight, tjs_int taps, tjs_int len) {
+    const DI32 di;
+    const DU8 d8;
+    const size_t N = hn::Lanes(di);
+    const auto round = hn::Set(di, kResampleRound);
+    const size_t bytes = (size_t)len * 4;
+    tjs_uint8 *out = (tjs_uint8 *)dest;
+
+    size_t i = 0;
+    for(; i + 2 * N <= bytes; i += 2 * N) {
+        auto acc0 = round;
+        auto acc1 = round;
+        for(tjs_int k = 0; k < taps; k++) {
+            const tjs_uint8 *l = (const tjs_uint8 *)lines[k] + i;
+            const auto w = hn::Set(di, weight[k]);
+            acc0 = hn::MulAdd(hn::PromoteTo(di, hn::LoadU(d8, l)), w, acc0);
+            acc1 =
+                hn::MulAdd(hn::PromoteTo(di, hn::LoadU(d8, l + N)), w, acc1);
+        }
+        hn::StoreU(
+            hn::DemoteTo(d8, hn::ShiftRight<TVP_RESAMPLE_WEIGHT_BITS>(acc0)),
+            d8, out + i);
+        hn::StoreU(
+            hn::DemoteTo(d8, hn::ShiftRight<TVP_RESAMPLE_WEIGHT_BITS>(acc1)),
+            d8, out + i + N);
+    }
+    for(; i + N <= bytes; i += N) {
+        auto acc = round;
+        for(tjs_int k = 0; k < taps; k++) {
+            const tjs_uint8 *l = (const tjs_uint8 *)lines[k] + i;
+            acc = hn::MulAdd(hn::PromoteTo(di, hn::LoadU(d8, l)),
+                             hn::Set(di, weight[k]), acc);
+        }
+        hn::StoreU(
+            hn::DemoteTo(d8, hn::ShiftRight<TVP_RESAMPLE_WEIGHT_BITS>(acc)),
+            d8, out + i);
+    }
+    // tail (less than one vector of bytes)
+    for(; i < bytes; i++) {
+        tjs_int acc = 0;
+        for(tjs_int k = 0; k < taps; k++)
+            acc += (tjs_int)((const tjs_uint8 *)lines[k])[i] * weight[k];
+        out[i] = ResampleClampByte(acc);
+    }
+}
+
+}  // namespace HWY_NAMESPACE
+}  // namespace krkr2
+HWY_AFTER_NAMESPACE();
+
+// ===========================================================================
+// Export and C wrappers
+// ===========================================================================
+#if HWY_ONCE
+namespace krkr2 {
+HWY_EXPORT(ResampleRowH_HWY);
+HWY_EXPORT(ResampleRowV_HWY);
+}  // namespace krkr2
+
+extern "C" {
+void TVPResampleRowH_hwy(tjs_uint32 *dest, const tjs_uint32 *src,
+                         const tjs_int *start, const tjs_int *length,
+                         const tjs_int *weight, tjs_int len) {
+    krkr2::HWY_DYNAMIC_DISPATCH(ResampleRowH_HWY)(dest, src, start, length,
+                                                  weight, len);
+}
+void TVPResampleRowV_hwy(tjs_uint32 *dest, const tjs_uint32 *const *lines,
+                         const tjs_int *weight, tjs_int taps, tjs_int len) {
+    krkr2::HWY_DYNAMIC_DISPATCH(ResampleRowV_HWY)(dest, lines, weight, taps,
+                                                  len);
+}
+}  // extern "C"
+#endif
@@ -0,0 +1,604 @@
+/*
+ * KrKr2 Engine - Highway SIMD Stretch / Affine Operations
+ *
+ * Implements the nearest and bilinear stretch and linear transformation
+ * (affine) families using Highway SIMD:
+ *   TVPStretch*          - nearest neighbour horizontal stretch
+ *   TVPLinTrans*         - nearest neighbour affine transformation
+ *   TVPInterpStretch*    - bilinear horizontal stretch
+ *   TVPInterpLinTrans*   - bilinear affine transformation
+ *
+ * Each row is processed in chunks: the source pixels are sampled into a
+ * line buffer by a per-target kernel, then the buffer is composited with
+ * the non-stretch blend function (TVPAlphaBlend etc., which are the
+ * Highway versions where they exist). The results are bit-exact with the
+ * C references in tvpgl.cpp.
+ *
+ * Sampling uses hardware gathers on targets which have them (AVX2 and
+ * better); other targets walk the 16.16 fixed point coordinates
+ * incrementally and only vectorize the bilinear interpolation.
+ *
+ * TVPStretchConstAlphaBlend_d is not covered: it scales the source alpha
+ * by the opacity, unlike TVPConstAlphaBlend_d, and stays in C.
+ */
+
+#include "tjsTypes.h"
+#include "tvpgl.h"
+
+#include <cstring>
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "tvpgl_simd_stretch.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+#include "tvpgl_simd_lanes.h"
+
+HWY_BEFORE_NAMESPACE();
+namespace krkr2 {
+namespace HWY_NAMESPACE {
+
+namespace hn = hwy::HWY_NAMESPACE;
+
+using DU32 = hn::ScalableTag<uint32_t>;
+using DI32 = hn::ScalableTag<int32_t>;
+
+/*
+ * Nearest stretch sampling: dest[i] = src[(srcstart + i * srcstep) >> 16]
+ */
+void StretchGather_HWY(tjs_uint32 *dest, tjs_int len, const tjs_uint32 *src,
+                       tjs_int srcstart, tjs_int srcstep) {
+    if(len <= 0) return;
+    if(srcstep == 65536) {
+        // unscaled: plain copy of a source span
+        memcpy(dest, src + (srcstart >> 16), len * sizeof(tjs_uint32));
+        return;
+    }
+
+    tjs_int i = 0;
+    if constexpr(kUseGather) {
+        const DU32 du;
+        const DI32 di;
+        const tjs_int N = static_cast<tjs_int>(hn::Lanes(du));
+        auto pos = hn::Add(hn::Mul(hn::Iota(di, 0), hn::Set(di, srcstep)),
+                           hn::Set(di, srcstart));
+        const auto inc = hn::Set(di, srcstep * N);
+        for(; i + N <= len; i += N) {
+            auto v = hn::GatherIndex(du, src, hn::ShiftRight<16>(pos));
+            hn::StoreU(v, du, dest + i);
+            pos = hn::Add(pos, inc);
+        }
+        srcstart += srcstep * i;
+    }
+
+    for(; i < len; i++) {
+        dest[i] = src[srcstart >> 16];
+        srcstart += srcstep;
+    }
+}
+
+/*
+ * Nearest affine sampling; srcpitch is in bytes
+ */
+void LinTransGather_HWY(tjs_uint32 *dest, tjs_int len, const tjs_uint32 *src,
+                        tjs_int sx, tjs_int sy, tjs_int stepx, tjs_int stepy,
+                        tjs_int srcpitch) {
+    if(len <= 0) return;
+    if(stepx == 65536 && stepy == 0) {
+        // unscaled, unrotated: plain copy of a source span
+        const tjs_uint32 *line = reinterpret_cast<const tjs_uint32 *>(
+            reinterpret_cast<const tjs_uint8 *>(src) + (sy >> 16) * srcpitch);
+        memcpy(dest, line + (sx >> 16), len * sizeof(tjs_uint32));
+        return;
+    }
+
+    tjs_int i = 0;
+    if constexpr(kUseGather) {
+        const DU32 du;
+        const DI32 di;
+        const tjs_int N = static_cast<tjs_int>(hn::Lanes(du));
+        const auto iota = hn::Iota(di, 0);
+        const auto pitch = hn::Set(di, srcpitch);
+        auto vx = hn::Add(hn::Mul(iota, hn::Set(di, stepx)), hn::Set(di, sx));
+        auto vy = hn::Add(hn::Mul(iota, hn::Set(di, stepy)), hn::Set(di, sy));
+        const auto incx = hn::Set(di, stepx * N);
+        const auto incy = hn::Set(di, stepy * N);
+        for(; i + N <= len; i += N) {
+            auto ofs = hn::Add(hn::Mul(hn::ShiftRight<16>(vy), pitch),
+                               hn::ShiftLeft<2>(hn::ShiftRight<16>(vx)));
+            hn::StoreU(hn::GatherOffset(du, src, ofs), du, dest + i);
+            vx = hn::Add(vx, incx);
+            vy = hn::Add(vy, incy);
+        }
+        sx += stepx * i;
+        sy += stepy * i;
+    }
+
+    for(; i < len; i++) {
+        dest[i] = *(reinterpret_cast<const tjs_uint32 *>(
+                        reinterpret_cast<const tjs_uint8 *>(src) +
+                        (sy >> 16) * srcpitch) +
+                    (sx >> 16));
+        sx += stepx;
+        sy += stepy;
+    }
+}
+
+/*
+ * Bilinear stretch sampling between two source lines. blend_y is the
+ * vertical ratio (0..255); the horizontal ratio is not adjusted, as in
+ * TVPInterpStretchCopy_c.
+ */
+void InterpStretchGather_HWY(tjs_uint32 *dest, tjs_int len,
+                             const tjs_uint32 *src1, const tjs_uint32 *src2,
+                             tjs_int blend_y, tjs_int srcstart,
+                             tjs_int srcstep) {
+    blend_y += blend_y >> 7; /* adjust blend ratio */
+
+    const DU32 du;
+    const DI32 di;
+    const tjs_int N = static_cast<tjs_int>(hn::Lanes(du));
+    const auto vby = hn::Set(du, static_cast<uint32_t>(blend_y));
+    const auto fracmask = hn::Set(di, 0xffff);
+    auto pos = hn::Add(hn::Mul(hn::Iota(di, 0), hn::Set(di, srcstep)),
+                       hn::Set(di, srcstart));
+    const auto inc = hn::Set(di, srcstep * N);
+
+    tjs_int i = 0;
+    for(; i + N <= len; i += N) {
+        auto bx = hn::BitCast(du, hn::ShiftRight<8>(hn::And(pos, fracmask)));
+        hn::Vec<DU32> a0, a1, b0, b1;
+        if constexpr(kUseGather) {
+            auto idx = hn::ShiftRight<16>(pos);
+            a0 = hn::GatherIndex(du, src1, idx);
+            a1 = hn::GatherIndex(du, src1 + 1, idx);
+            b0 = hn::GatherIndex(du, src2, idx);
+            b1 = hn::GatherIndex(du, src2 + 1, idx);
+        } else {
+            HWY_ALIGN uint32_t la0[hn::MaxLanes(du)], la1[hn::MaxLanes(du)];
+            HWY_ALIGN uint32_t lb0[hn::MaxLanes(du)], lb1[hn::MaxLanes(du)];
+            tjs_int ss = srcstart;
+            for(tjs_int k = 0; k < N; k++) {
+                tjs_int sp = ss >> 16;
+                la0[k] = src1[sp];
+                la1[k] = src1[sp + 1];
+                lb0[k] = src2[sp];
+                lb1[k] = src2[sp + 1];
+                ss += srcstep;
+            }
+            a0 = hn::Load(du, la0);
+            a1 = hn::Load(du, la1);
+            b0 = hn::Load(du, lb0);
+            b1 = hn::Load(du, lb1);
+        }
+        auto v = BlendARGBLanes(du, BlendARGBLanes(du, a0, a1, bx),
+                                BlendARGBLanes(du, b0, b1, bx), vby);
+        hn::StoreU(v, du, dest + i);
+        pos = hn::Add(pos, inc);
+        srcstart += srcstep * N;
+    }
+
+    for(; i < len; i++) {
+        tjs_int blend_x = (srcstart & 0xffff) >> 8;
+        tjs_int sp = srcstart >> 16;
+        dest[i] = TVPBlendARGB(TVPBlendARGB(src1[sp], src1[sp + 1], blend_x),
+                               TVPBlendARGB(src2[sp], src2[sp + 1], blend_x),
+                               blend_y);
+        srcstart += srcstep;
+    }
+}
+
+/*
+ * Bilinear affine sampling; srcpitch is in bytes
+ */
+void InterpLinTransGather_HWY(tjs_uint32 *dest, tjs_int len,
+                              const tjs_uint32 *src, tjs_int sx, tjs_int sy,
+                              tjs_int stepx, tjs_int stepy,
+                              tjs_int srcpitch) {
+    const tjs_uint8 *base = reinterpret_cast<const tjs_uint8 *>(src);
+
+    const DU32 du;
+    const DI32 di;
+    const tjs_int N = static_cast<tjs_int>(hn::Lanes(du));
+    const auto iota = hn::Iota(di, 0);
+    const auto pitch = hn::Set(di, srcpitch);
+    const auto fracmask = hn::Set(di, 0xffff);
+    auto vx = hn::Add(hn::Mul(iota, hn::Set(di, stepx)), hn::Set(di, sx));
+    auto vy = hn::Add(hn::Mul(iota, hn::Set(di, stepy)), hn::Set(di, sy));
+    const auto incx = hn::Set(di, stepx * N);
+    const auto incy = hn::Set(di, stepy * N);
+
+    tjs_int i = 0;
+    for(; i + N <= len; i += N) {
+        auto bx = hn::ShiftRight<8>(hn::And(vx, fracmask));
+        bx = hn::Add(bx, hn::ShiftRight<7>(bx));
+        auto by = hn::ShiftRight<8>(hn::And(vy, fracmask));
+        by = hn::Add(by, hn::ShiftRight<7>(by));
+        hn::Vec<DU32> a0, a1, b0, b1;
+        if constexpr(kUseGather) {
+            auto ofs = hn::Add(hn::Mul(hn::ShiftRight<16>(vy), pitch),
+                               hn::ShiftLeft<2>(hn::ShiftRight<16>(vx)));
+            const tjs_uint32 *line1 =
+                reinterpret_cast<const tjs_uint32 *>(base + srcpitch);
+            a0 = hn::GatherOffset(du, src, ofs);
+            a1 = hn::GatherOffset(du, src + 1, ofs);
+            b0 = hn::GatherOffset(du, line1, ofs);
+            b1 = hn::GatherOffset(du, line1 + 1, ofs);
+        } else {
+            HWY_ALIGN uint32_t la0[hn::MaxLanes(du)], la1[hn::MaxLanes(du)];
+            HWY_ALIGN uint32_t lb0[hn::MaxLanes(du)], lb1[hn::MaxLanes(du)];
+            tjs_int x = sx, y = sy;
+            for(tjs_int k = 0; k < N; k++) {
+                const tjs_uint32 *p0 = reinterpret_cast<const tjs_uint32 *>(
+                                           base + (y >> 16) * srcpitch) +
+                    (x >> 16);
+                const tjs_uint32 *p1 = reinterpret_cast<const tjs_uint32 *>(
+                    reinterpret_cast<const tjs_uint8 *>(p0) + srcpitch);
+                la0[k] = p0[0];
+                la1[k] = p0[1];
+                lb0[k] = p1[0];
+                lb1[k] = p1[1];
+                x += stepx;
+                y += stepy;
+            }
+            a0 = hn::Load(du, la0);
+            a1 = hn::Load(du, la1);
+            b0 = hn::Load(du, lb0);
+            b1 = hn::Load(du, lb1);
+        }
+        const auto ubx = hn::BitCast(du, bx);
+        auto v = BlendARGBLanes(du, BlendARGBLanes(du, a0, a1, ubx),
+                                BlendARGBLanes(du, b0, b1, ubx),
+                                hn::BitCast(du, by));
+        hn::StoreU(v, du, dest + i);
+        vx = hn::Add(vx, incx);
+        vy = hn::Add(vy, incy);
+        sx += stepx * N;
+        sy += stepy * N;
+    }
+
+    for(; i < len; i++) {
+        tjs_int blend_x = (sx & 0xffff) >> 8;
+        blend_x += blend_x >> 7;
+        tjs_int blend_y = (sy & 0xffff) >> 8;
+        blend_y += blend_y >> 7;
+        const tjs_uint32 *p0 =
+            reinterpret_cast<const tjs_uint32 *>(base + (sy >> 16) * srcpitch) +
+            (sx >> 16);
+        const tjs_uint32 *p1 = reinterpret_cast<const tjs_uint32 *>(
+            reinterpret_cast<const tjs_uint8 *>(p0) + srcpitch);
+        dest[i] = TVPBlendARGB(TVPBlendARGB(p0[0], p0[1], blend_x),
+                               TVPBlendARGB(p1[0], p1[1], blend_x), blend_y);
+        sx += stepx;
+        sy += stepy;
+    }
+}
+
+/*
+ * dest[i] = TVPBlendARGB(dest[i], src[i], opa); opa is already adjusted
+ * to 0..256. Used by the bilinear const alpha variants.
+ */
+void BlendARGBConst_HWY(tjs_uint32 *dest, const tjs_uint32 *src, tjs_int len,
+                        tjs_int opa) {
+    const DU32 du;
+    const tjs_int N = static_cast<tjs_int>(hn::Lanes(du));
+    const auto vopa = hn::Set(du, static_cast<uint32_t>(opa));
+
+    tjs_int i = 0;
+    for(; i + N <= len; i += N) {
+        auto d = hn::LoadU(du, dest + i);
+        auto s = hn::LoadU(du, src + i);
+        hn::StoreU(BlendARGBLanes(du, d, s, vopa), du, dest + i);
+    }
+
+    for(; i < len; i++) {
+        dest[i] = TVPBlendARGB(dest[i], src[i], opa);
+    }
+}
+
+/*
+ * Scales premultiplied ARGB by opa (0..256) the way TVPAddAlphaBlend_n_a_o
+ * does before the additive blend.
+ */
+void ScaleARGB_HWY(tjs_uint32 *buf, tjs_int len, tjs_int opa) {
+    const DU32 du;
+    const tjs_int N = static_cast<tjs_int>(hn::Lanes(du));
+    const auto vopa = hn::Set(du, static_cast<uint32_t>(opa));
+    const auto mask = hn::Set(du, 0x00ff00ffu);
+    const auto himask = hn::Set(du, 0xff00ff00u);
+
+    tjs_int i = 0;
+    for(; i + N <= len; i += N) {
+        auto s = hn::LoadU(du, buf + i);
+        auto lo = hn::And(hn::ShiftRight<8>(hn::Mul(hn::And(s, mask), vopa)),
+                          mask);
+        auto hi = hn::And(
+            hn::Mul(hn::And(hn::ShiftRight<8>(s), mask), vopa), himask);
+        hn::StoreU(hn::Add(lo, hi), du, buf + i);
+    }
+
+    for(; i < len; i++) {
+        tjs_uint32 s = buf[i];
+        buf[i] = (((s & 0xff00ff) * opa >> 8) & 0xff00ff) +
+            (((s >> 8) & 0xff00ff) * opa & 0xff00ff00);
+    }
+}
+
+}  // namespace HWY_NAMESPACE
+}  // namespace krkr2
+HWY_AFTER_NAMESPACE();
+
+// --- Export functions to C linkage ---
+#if HWY_ONCE
+namespace krkr2 {
+HWY_EXPORT(StretchGather_HWY);
+HWY_EXPORT(LinTransGather_HWY);
+HWY_EXPORT(InterpStretchGather_HWY);
+HWY_EXPORT(InterpLinTransGather_HWY);
+HWY_EXPORT(BlendARGBConst_HWY);
+HWY_EXPORT(ScaleARGB_HWY);
+
+// pixels sampled per pass; the line buffer lives on the stack
+static const tjs_int kStretchChunk = 256;
+
+template <typename BlendT>
+static void StretchBlendLoop(tjs_uint32 *dest, tjs_int len,
+                             const tjs_uint32 *src, tjs_int srcstart,
+                             tjs_int srcstep, BlendT blend) {
+    tjs_uint32 buf[kStretchChunk];
+    while(len > 0) {
+        tjs_int n = len < kStretchChunk ? len : kStretchChunk;
+        HWY_DYNAMIC_DISPATCH(StretchGather_HWY)(buf, n, src, srcstart,
+                                                srcstep);
+        blend(dest, buf, n);
+        srcstart += srcstep * n;
+        dest += n;
+        len -= n;
+    }
+}
+
+template <typename BlendT>
+static void LinTransBlendLoop(tjs_uint32 *dest, tjs_int len,
+                              const tjs_uint32 *src, tjs_int sx, tjs_int sy,
+                              tjs_int stepx, tjs_int stepy, tjs_int srcpitch,
+                              BlendT blend) {
+    tjs_uint32 buf[kStretchChunk];
+    while(len > 0) {
+        tjs_int n = len < kStretchChunk ? len : kStretchChunk;
+        HWY_DYNAMIC_DISPATCH(LinTransGather_HWY)(buf, n, src, sx, sy, stepx,
+                                                 stepy, srcpitch);
+        blend(dest, buf, n);
+        sx += stepx * n;
+        sy += stepy * n;
+        dest += n;
+        len -= n;
+    }
+}
+
+template <typename BlendT>
+static void InterpStretchBlendLoop(tjs_uint32 *dest, tjs_int len,
+                                   const tjs_uint32 *src1,
+                                   const tjs_uint32 *src2, tjs_int blend_y,
+                                   tjs_int srcstart, tjs_int srcstep,
+                                   BlendT blend) {
+    tjs_uint32 buf[kStretchChunk];
+    while(len > 0) {
+        tjs_int n = len < kStretchChunk ? len : kStretchChunk;
+        HWY_DYNAMIC_DISPATCH(InterpStretchGather_HWY)(buf, n, src1, src2,
+                                                      blend_y, srcstart,
+                                                      srcstep);
+        blend(dest, buf, n);
+        srcstart += srcstep * n;
+        dest += n;
+        len -= n;
+    }
+}
+
+template <typename BlendT>
+static void InterpLinTransBlendLoop(tjs_uint32 *dest, tjs_int len,
+                                    const tjs_uint32 *src, tjs_int sx,
+                                    tjs_int sy, tjs_int stepx, tjs_int stepy,
+                                    tjs_int srcpitch, BlendT blend) {
+    tjs_uint32 buf[kStretchChunk];
+    while(len > 0) {
+        tjs_int n = len < kStretchChunk ? len : kStretchChunk;
+        HWY_DYNAMIC_DISPATCH(InterpLinTransGather_HWY)(buf, n, src, sx, sy,
+                                                       stepx, stepy, srcpitch);
+        blend(dest, buf, n);
+        sx += stepx * n;
+        sy += stepy * n;
+        dest += n;
+        len -= n;
+    }
+}
+}  // namespace krkr2
+
+// The blend stage goes through the function pointers, so it picks up the
+// Highway blend kernels registered by TVPGL_SIMD_Init (or the C ones).
+#define EXPORT_STRETCH(Name, Blend)                                            \
+    void TVPStretch##Name##_hwy(tjs_uint32 *dest, tjs_int len,                 \
+                                const tjs_uint32 *src, tjs_int srcstart,       \
+                                tjs_int srcstep) {                             \
+        krkr2::StretchBlendLoop(                                               \
+            dest, len, src, srcstart, srcstep,                                 \
+            [](tjs_uint32 *d, const tjs_uint32 *s, tjs_int n) {                \
+                Blend(d, s, n);                                                \
+            });                                                                \
+    }                                                                          \
+    void TVPLinTrans##Name##_hwy(tjs_uint32 *dest, tjs_int len,                \
+                                 const tjs_uint32 *src, tjs_int sx,            \
+                                 tjs_int sy, tjs_int stepx, tjs_int stepy,     \
+                                 tjs_int srcpitch) {                           \
+        krkr2::LinTransBlendLoop(                                              \
+            dest, len, src, sx, sy, stepx, stepy, srcpitch,                    \
+            [](tjs_uint32 *d, const tjs_uint32 *s, tjs_int n) {                \
+                Blend(d, s, n);                                                \
+            });                                                                \
+    }
+
+#define EXPORT_STRETCH_O(Name, Blend)                                          \
+    void TVPStretch##Name##_hwy(tjs_uint32 *dest, tjs_int len,                 \
+                                const tjs_uint32 *src, tjs_int srcstart,       \
+                                tjs_int srcstep, tjs_int opa) {                \
+        krkr2::StretchBlendLoop(                                               \
+            dest, len, src, srcstart, srcstep,                                 \
+            [opa](tjs_uint32 *d, const tjs_uint32 *s, tjs_int n) {             \
+                Blend(d, s, n, opa);                                           \
+            });                                                                \
+    }                                                                          \
+    void TVPLinTrans##Name##_hwy(tjs_uint32 *dest, tjs_int len,                \
+                                 const tjs_uint32 *src, tjs_int sx,            \
+                                 tjs_int sy, tjs_int stepx, tjs_int stepy,     \
+                                 tjs_int srcpitch, tjs_int opa) {              \
+        krkr2::LinTransBlendLoop(                                              \
+            dest, len, src, sx, sy, stepx, stepy, srcpitch,                    \
+            [opa](tjs_uint32 *d, const tjs_uint32 *s, tjs_int n) {             \
+                Blend(d, s, n, opa);                                           \
+            });                                                                \
+    }
+
+extern "C" {
+
+// nearest neighbour copies
+void TVPStretchCopy_hwy(tjs_uint32 *dest, tjs_int len, const tjs_uint32 *src,
+                        tjs_int srcstart, tjs_int srcstep) {
+    krkr2::HWY_DYNAMIC_DISPATCH(StretchGather_HWY)(dest, len, src, srcstart,
+                                                   srcstep);
+}
+
+void TVPLinTransCopy_hwy(tjs_uint32 *dest, tjs_int len, const tjs_uint32 *src,
+                         tjs_int sx, tjs_int sy, tjs_int stepx, tjs_int stepy,
+                         tjs_int srcpitch) {
+    krkr2::HWY_DYNAMIC_DISPATCH(LinTransGather_HWY)(dest, len, src, sx, sy,
+                                                    stepx, stepy, srcpitch);
+}
+
+EXPORT_STRETCH(ColorCopy, TVPCopyColor)
+EXPORT_STRETCH(CopyOpaqueImage, TVPCopyOpaqueImage)
+
+// alpha blend
+EXPORT_STRETCH(AlphaBlend, TVPAlphaBlend)
+EXPORT_STRETCH(AlphaBlend_HDA, TVPAlphaBlend_HDA)
+EXPORT_STRETCH(AlphaBlend_d, TVPAlphaBlend_d)
+EXPORT_STRETCH(AlphaBlend_a, TVPAlphaBlend_a)
+EXPORT_STRETCH_O(AlphaBlend_o, TVPAlphaBlend_o)
+EXPORT_STRETCH_O(AlphaBlend_HDA_o, TVPAlphaBlend_HDA_o)
+EXPORT_STRETCH_O(AlphaBlend_do, TVPAlphaBlend_do)
+EXPORT_STRETCH_O(AlphaBlend_ao, TVPAlphaBlend_ao)
+
+// additive alpha blend
+EXPORT_STRETCH(AdditiveAlphaBlend, TVPAdditiveAlphaBlend)
+EXPORT_STRETCH(AdditiveAlphaBlend_HDA, TVPAdditiveAlphaBlend_HDA)
+EXPORT_STRETCH(AdditiveAlphaBlend_a, TVPAdditiveAlphaBlend_a)
+EXPORT_STRETCH_O(AdditiveAlphaBlend_o, TVPAdditiveAlphaBlend_o)
+EXPORT_STRETCH_O(AdditiveAlphaBlend_HDA_o, TVPAdditiveAlphaBlend_HDA_o)
+EXPORT_STRETCH_O(AdditiveAlphaBlend_ao, TVPAdditiveAlphaBlend_ao)
+
+// const alpha blend (TVPStretchConstAlphaBlend_d stays in C, see above)
+EXPORT_STRETCH_O(ConstAlphaBlend, TVPConstAlphaBlend)
+EXPORT_STRETCH_O(ConstAlphaBlend_HDA, TVPConstAlphaBlend_HDA)
+EXPORT_STRETCH_O(ConstAlphaBlend_a, TVPConstAlphaBlend_a)
+
+void TVPLinTransConstAlphaBlend_d_hwy(tjs_uint32 *dest, tjs_int len,
+                                      const tjs_uint32 *src, tjs_int sx,
+                                      tjs_int sy, tjs_int stepx, tjs_int stepy,
+                                      tjs_int srcpitch, tjs_int opa) {
+    krkr2::LinTransBlendLoop(
+        dest, len, src, sx, sy, stepx, stepy, srcpitch,
+        [opa](tjs_uint32 *d, const tjs_uint32 *s, tjs_int n) {
+            TVPConstAlphaBlend_d(d, s, n, opa);
+        });
+}
+
+// bilinear
+void TVPInterpStretchCopy_hwy(tjs_uint32 *dest, tjs_int len,
+                              const tjs_uint32 *src1, const tjs_uint32 *src2,
+                              tjs_int blend_y, tjs_int srcstart,
+                              tjs_int srcstep) {
+    krkr2::HWY_DYNAMIC_DISPATCH(InterpStretchGather_HWY)(
+        dest, len, src1, src2, blend_y, srcstart, srcstep);
+}
+
+void TVPInterpStretchAdditiveAlphaBlend_hwy(
+    tjs_uint32 *dest, tjs_int len, const tjs_uint32 *src1,
+    const tjs_uint32 *src2, tjs_int blend_y, tjs_int srcstart,
+    tjs_int srcstep) {
+    krkr2::InterpStretchBlendLoop(
+        dest, len, src1, src2, blend_y, srcstart, srcstep,
+        [](tjs_uint32 *d, const tjs_uint32 *s, tjs_int n) {
+            TVPAdditiveAlphaBlend(d, s, n);
+        });
+}
+
+void TVPInterpStretchAdditiveAlphaBlend_o_hwy(
+    tjs_uint32 *dest, tjs_int len, const tjs_uint32 *src1,
+    const tjs_uint32 *src2, tjs_int blend_y, tjs_int srcstart,
+    tjs_int srcstep, tjs_int opa) {
+    krkr2::InterpStretchBlendLoop(
+        dest, len, src1, src2, blend_y, srcstart, srcstep,
+        [opa](tjs_uint32 *d, tjs_uint32 *s, tjs_int n) {
+            krkr2::HWY_DYNAMIC_DISPATCH(ScaleARGB_HWY)(s, n, opa);
+            TVPAdditiveAlphaBlend(d, s, n);
+        });
+}
+
+void TVPInterpStretchConstAlphaBlend_hwy(tjs_uint32 *dest, tjs_int len,
+                                         const tjs_uint32 *src1,
+                                         const tjs_uint32 *src2,
+                                         tjs_int blend_y, tjs_int srcstart,
+                                         tjs_int srcstep, tjs_int opa) {
+    opa += opa >> 7; /* adjust opa */
+    krkr2::InterpStretchBlendLoop(
+        dest, len, src1, src2, blend_y, srcstart, srcstep,
+        [opa](tjs_uint32 *d, const tjs_uint32 *s, tjs_int n) {
+            krkr2::HWY_DYNAMIC_DISPATCH(BlendARGBConst_HWY)(d, s, n, opa);
+        });
+}
+
+void TVPInterpLinTransCopy_hwy(tjs_uint32 *dest, tjs_int len,
+                               const tjs_uint32 *src, tjs_int sx, tjs_int sy,
+                               tjs_int stepx, tjs_int stepy,
+                               tjs_int srcpitch) {
+    krkr2::HWY_DYNAMIC_DISPATCH(InterpLinTransGather_HWY)(
+        dest, len, src, sx, sy, stepx, stepy, srcpitch);
+}
+
+void TVPInterpLinTransAdditiveAlphaBlend_hwy(
+    tjs_uint32 *dest, tjs_int len, const tjs_uint32 *src, tjs_int sx,
+    tjs_int sy, tjs_int stepx, tjs_int stepy, tjs_int srcpitch) {
+    krkr2::InterpLinTransBlendLoop(
+        dest, len, src, sx, sy, stepx, stepy, srcpitch,
+        [](tjs_uint32 *d, const tjs_uint32 *s, tjs_int n) {
+            TVPAdditiveAlphaBlend(d, s, n);
+        });
+}
+
+void TVPInterpLinTransAdditiveAlphaBlend_o_hwy(
+    tjs_uint32 *dest, tjs_int len, const tjs_uint32 *src, tjs_int sx,
+    tjs_int sy, tjs_int stepx, tjs_int stepy, tjs_int srcpitch, tjs_int opa) {
+    opa += opa >> 7; /* the C version adjusts opa here, unlike the stretch */
+    krkr2::InterpLinTransBlendLoop(
+        dest, len, src, sx, sy, stepx, stepy, srcpitch,
+        [opa](tjs_uint32 *d, tjs_uint32 *s, tjs_int n) {
+            krkr2::HWY_DYNAMIC_DISPATCH(ScaleARGB_HWY)(s, n, opa);
+            TVPAdditiveAlphaBlend(d, s, n);
+        });
+}
+
+void TVPInterpLinTransConstAlphaBlend_hwy(tjs_uint32 *dest, tjs_int len,
+                                          const tjs_uint32 *src, tjs_int sx,
+                                          tjs_int sy, tjs_int stepx,
+                                          tjs_int stepy, tjs_int srcpitch,
+                                          tjs_int opa) {
+    opa += opa >> 7; /* adjust opacity */
+    krkr2::InterpLinTransBlendLoop(
+        dest, len, src, sx, sy, stepx, stepy, srcpitch,
+        [opa](tjs_uint32 *d, const tjs_uint32 *s, tjs_int n) {
+            krkr2::HWY_DYNAMIC_DISPATCH(BlendARGBConst_HWY)(d, s, n, opa);
+        });
+}
+
+}  // extern "C"
+
+#undef EXPORT_STRETCH
+#undef EXPORT_STRETCH_O
+#endif
@@ -0,0 +1,303 @@
+/*
+ * KrKr2 Engine - Highway SIMD TLG Decoder
+ *
+ * Implements the per-line passes of the TLG decoders:
+ *   TVPTLG5ComposeColors3To4, TVPTLG5ComposeColors4To4,
+ *   TVPTLG6DecodeLineGeneric, TVPTLG6DecodeLine
+ *
+ * TLG5 composition is a running sum along the line; it is computed four
+ * pixels at a time with a log-step prefix sum, carrying the last pixel
+ * into the next vector.
+ *
+ * The TLG6 MED/average predictor depends on the previous pixel, so pixels
+ * are processed one at a time with all four channels held in the byte
+ * lanes of one vector; Min/Max/compare replace the packed-byte bit tricks
+ * of the C version. The color correlation filter is resolved per 8-pixel
+ * block through a template, removing the per-pixel switch.
+ *
+ * LZSS and Golomb decoding are serial and stay in C; the loader expands
+ * blocks on worker threads instead (see LoadTLG.cpp).
+ */
+
+#include "tjsTypes.h"
+#include "tvpgl.h"
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "tvpgl_simd_tlg.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+HWY_BEFORE_NAMESPACE();
+namespace krkr2 {
+namespace HWY_NAMESPACE {
+
+namespace hn = hwy::HWY_NAMESPACE;
+
+// one BGRA pixel in 4 byte lanes
+using DPix = hn::FixedTag<uint8_t, 4>;
+using DWord = hn::FixedTag<uint32_t, 1>;
+using VPix = hn::Vec<DPix>;
+
+HWY_INLINE VPix PixelFromU32(tjs_uint32 v) {
+    return hn::BitCast(DPix(), hn::Set(DWord(), v));
+}
+
+HWY_INLINE tjs_uint32 PixelToU32(VPix v) {
+    return hn::GetLane(hn::BitCast(DWord(), v));
+}
+
+// Median Edge Detector: min(a,b) if c >= max(a,b), max(a,b) if c <= min(a,b),
+// a + b - c otherwise (per byte, wrapping)
+HWY_INLINE VPix Med(VPix a, VPix b, VPix c) {
+    const auto mn = hn::Min(a, b);
+    const auto mx = hn::Max(a, b);
+    const auto grad = hn::Sub(hn::Add(mn, mx), c);
+    return hn::IfThenElse(hn::Gt(c, mx), mn,
+                          hn::IfThenElse(hn::Lt(c, mn), mx, grad));
+}
+
+// =========================================================================
+// TVPTLG5ComposeColors3To4/4To4: undo the color correlation (B-G, R-G),
+// accumulate the horizontal deltas and add the upper line
+// =========================================================================
+using D8x16 = hn::Full128<uint8_t>;
+using V8x16 = hn::Vec<D8x16>;
+
+// prefix sum of 4 pixels plus the running sum of the previous pixel
+HWY_INLINE void ComposeQuad(V8x16 v, V8x16 &carry, const tjs_uint8 *upper,
+                            tjs_uint8 *outp, bool opaque) {
+    const D8x16 d8;
+    const hn::Full128<uint32_t> d32;
+    v = hn::Add(v, hn::ShiftLeftBytes<4>(d8, v));
+    v = hn::Add(v, hn::ShiftLeftBytes<8>(d8, v));
+    v = hn::Add(v, carry);
+    carry = hn::BitCast(d8, hn::Broadcast<3>(hn::BitCast(d32, v)));
+    auto o = hn::Add(v, hn::LoadU(d8, upper));
+    if(opaque)
+        o = hn::Or(o, hn::BitCast(d8, hn::Set(d32, 0xff000000u)));
+    hn::StoreU(o, d8, outp);
+}
+
+template <bool HasAlpha>
+HWY_INLINE void TLG5ComposeColors(tjs_uint8 *outp, const tjs_uint8 *upper,
+                                  tjs_uint8 *const *buf, tjs_int width) {
+    const D8x16 d8;
+    const hn::Full128<uint16_t> d16;
+    const hn::Full128<uint32_t> d32;
+    auto carry = hn::Zero(d8);
+
+    tjs_int x = 0;
+    for(; x + 16 <= width; x += 16) {
+        const auto g = hn::LoadU(d8, buf[1] + x);
+        const auto b = hn::Add(hn::LoadU(d8, buf[2] + x), g);
+        const auto r = hn::Add(hn::LoadU(d8, buf[0] + x), g);
+        const auto a = HasAlpha ? hn::LoadU(d8, buf[3] + x) : hn::Zero(d8);
+        // interleave the planes into BGRA pixels
+        const auto bg_lo = hn::BitCast(d16, hn::InterleaveLower(d8, b, g));
+        const auto bg_hi = hn::BitCast(d16, hn::InterleaveUpper(d8, b, g));
+        const auto ra_lo = hn::BitCast(d16, hn::InterleaveLower(d8, r, a));
+        const auto ra_hi = hn::BitCast(d16, hn::InterleaveUpper(d8, r, a));
+        ComposeQuad(hn::BitCast(d8, hn::InterleaveLower(d16, bg_lo, ra_lo)),
+                    carry, upper, outp, !HasAlpha);
+        ComposeQuad(hn::BitCast(d8, hn::InterleaveUpper(d16, bg_lo, ra_lo)),
+                    carry, upper + 16, outp + 16, !HasAlpha);
+        ComposeQuad(hn::BitCast(d8, hn::InterleaveLower(d16, bg_hi, ra_hi)),
+                    carry, upper + 32, outp + 32, !HasAlpha);
+        ComposeQuad(hn::BitCast(d8, hn::InterleaveUpper(d16, bg_hi, ra_hi)),
+                    carry, upper + 48, outp + 48, !HasAlpha);
+        outp += 64;
+        upper += 64;
+    }
+
+    const tjs_uint32 last = hn::GetLane(hn::BitCast(d32, carry));
+    tjs_uint8 pc[4] = { (tjs_uint8)last, (tjs_uint8)(last >> 8),
+                        (tjs_uint8)(last >> 16), (tjs_uint8)(last >> 24) };
+    for(; x < width; x++) {
+        tjs_uint8 c[4];
+        c[0] = buf[2][x];
+        c[1] = buf[1][x];
+        c[2] = buf[0][x];
+        c[3] = HasAlpha ? buf[3][x] : 0;
+        c[0] += c[1];
+        c[2] += c[1];
+        outp[0] = (tjs_uint8)((pc[0] += c[0]) + upper[0]);
+        outp[1] = (tjs_uint8)((pc[1] += c[1]) + upper[1]);
+        outp[2] = (tjs_uint8)((pc[2] += c[2]) + upper[2]);
+        outp[3] = HasAlpha ? (tjs_uint8)((pc[3] += c[3]) + upper[3]) : 0xff;
+        outp += 4;
+        upper += 4;
+    }
+}
+
+void TLG5ComposeColors3To4_HWY(tjs_uint8 *outp, const tjs_uint8 *upper,
+                               tjs_uint8 *const *buf, tjs_int width) {
+    TLG5ComposeColors<false>(outp, upper, buf, width);
+}
+
+void TLG5ComposeColors4To4_HWY(tjs_uint8 *outp, const tjs_uint8 *upper,
+                               tjs_uint8 *const *buf, tjs_int width) {
+    TLG5ComposeColors<true>(outp, upper, buf, width);
+}
+
+// =========================================================================
+// color correlation filter: returns the pixel delta with R and B swapped
+// into place, alpha passed through. N selects one of the 16 filters of
+// TVP_TLG6_DO_CHROMA_DECODE in tvpgl.cpp.
+// =========================================================================
+template <int N>
+HWY_INLINE tjs_uint32 Chroma(tjs_uint32 x) {
+    const tjs_uint32 IB = x & 0xff;
+    const tjs_uint32 IG = (x >> 8) & 0xff;
+    const tjs_uint32 IR = (x >> 16) & 0xff;
+    tjs_uint32 o2, o1, o0;
+    switch(N) {
+        case 0: o2 = IB; o1 = IG; o0 = IR; break;
+        case 1: o2 = IB + IG; o1 = IG; o0 = IR + IG; break;
+        case 2: o2 = IB; o1 = IG + IB; o0 = IR + IB + IG; break;
+        case 3: o2 = IB + IR + IG; o1 = IG + IR; o0 = IR; break;
+        case 4: o2 = IB + IR; o1 = IG + IB + IR; o0 = IR + IB + IR + IG; break;
+        case 5: o2 = IB + IR; o1 = IG + IB + IR; o0 = IR; break;
+        case 6: o2 = IB + IG; o1 = IG; o0 = IR; break;
+        case 7: o2 = IB; o1 = IG + IB; o0 = IR; break;
+        case 8: o2 = IB; o1 = IG; o0 = IR + IG; break;
+        case 9: o2 = IB + IG + IR + IB; o1 = IG + IR + IB; o0 = IR + IB; break;
+        case 10: o2 = IB + IR; o1 = IG + IR; o0 = IR; break;
+        case 11: o2 = IB; o1 = IG + IB; o0 = IR + IB; break;
+        case 12: o2 = IB; o1 = IG + IR + IB; o0 = IR + IB; break;
+        case 13: o2 = IB + IG; o1 = IG + IR + IB + IG; o0 = IR + IB + IG; break;
+        case 14: o2 = IB + IG + IR; o1 = IG + IR; o0 = IR + IB + IG + IR; break;
+        default: o2 = IB; o1 = IG + (IB << 1); o0 = IR + (IB << 1); break;
+    }
+    return (x & 0xff000000) | ((o2 & 0xff) << 16) | ((o1 & 0xff) << 8) |
+        (o0 & 0xff);
+}
+
+template <int N, bool Avg>
+HWY_INLINE void DecodeBlock(tjs_uint32 *&prevline, tjs_uint32 *&curline,
+                            const tjs_uint32 *&in, tjs_int step, int w,
+                            VPix &p, VPix &up) {
+    do {
+        const auto u = PixelFromU32(*prevline);
+        const auto pred = Avg ? hn::AverageRound(p, u) : Med(p, u, up);
+        p = hn::Add(pred, PixelFromU32(Chroma<N>(*in)));
+        up = u;
+        *curline = PixelToU32(p);
+        curline++;
+        prevline++;
+        in += step;
+    } while(--w);
+}
+
+// =========================================================================
+// TVPTLG6DecodeLineGeneric: reordering, color correlation filter and
+// MED/AVG prediction of one line of blocks [start_block, block_limit)
+// =========================================================================
+void TLG6DecodeLineGeneric_HWY(tjs_uint32 *prevline, tjs_uint32 *curline,
+                               tjs_int width, tjs_int start_block,
+                               tjs_int block_limit, tjs_uint8 *filtertypes,
+                               tjs_int skipblockbytes, tjs_uint32 *in,
+                               tjs_uint32 initialp, tjs_int oddskip,
+                               tjs_int dir) {
+    VPix p, up;
+
+    if(start_block) {
+        prevline += start_block * TVP_TLG6_W_BLOCK_SIZE;
+        curline += start_block * TVP_TLG6_W_BLOCK_SIZE;
+        p = PixelFromU32(curline[-1]);
+        up = PixelFromU32(prevline[-1]);
+    } else {
+        p = up = PixelFromU32(initialp);
+    }
+
+    const tjs_uint32 *src = in + skipblockbytes * start_block;
+    const tjs_int step = (dir & 1) ? 1 : -1;
+
+    for(tjs_int i = start_block; i < block_limit; i++) {
+        int w = width - i * TVP_TLG6_W_BLOCK_SIZE;
+        if(w > TVP_TLG6_W_BLOCK_SIZE)
+            w = TVP_TLG6_W_BLOCK_SIZE;
+        const int ww = w;
+        if(step == -1)
+            src += ww - 1;
+        if(i & 1)
+            src += oddskip * ww;
+        switch(filtertypes[i]) {
+#define TVP_TLG6_DECODE_BLOCK_CASE(N)                                          \
+    case(N << 1):                                                              \
+        DecodeBlock<N, false>(prevline, curline, src, step, w, p, up);         \
+        break;                                                                 \
+    case(N << 1) + 1:                                                          \
+        DecodeBlock<N, true>(prevline, curline, src, step, w, p, up);          \
+        break;
+            TVP_TLG6_DECODE_BLOCK_CASE(0)
+            TVP_TLG6_DECODE_BLOCK_CASE(1)
+            TVP_TLG6_DECODE_BLOCK_CASE(2)
+            TVP_TLG6_DECODE_BLOCK_CASE(3)
+            TVP_TLG6_DECODE_BLOCK_CASE(4)
+            TVP_TLG6_DECODE_BLOCK_CASE(5)
+            TVP_TLG6_DECODE_BLOCK_CASE(6)
+            TVP_TLG6_DECODE_BLOCK_CASE(7)
+            TVP_TLG6_DECODE_BLOCK_CASE(8)
+            TVP_TLG6_DECODE_BLOCK_CASE(9)
+            TVP_TLG6_DECODE_BLOCK_CASE(10)
+            TVP_TLG6_DECODE_BLOCK_CASE(11)
+            TVP_TLG6_DECODE_BLOCK_CASE(12)
+            TVP_TLG6_DECODE_BLOCK_CASE(13)
+            TVP_TLG6_DECODE_BLOCK_CASE(14)
+            TVP_TLG6_DECODE_BLOCK_CASE(15)
+#undef TVP_TLG6_DECODE_BLOCK_CASE
+            default:
+                return;
+        }
+        if(step == 1)
+            src += skipblockbytes - ww;
+        else
+            src += skipblockbytes + 1;
+        if(i & 1)
+            src -= oddskip * ww;
+    }
+}
+
+}  // namespace HWY_NAMESPACE
+}  // namespace krkr2
+HWY_AFTER_NAMESPACE();
+
+#if HWY_ONCE
+namespace krkr2 {
+HWY_EXPORT(TLG5ComposeColors3To4_HWY);
+HWY_EXPORT(TLG5ComposeColors4To4_HWY);
+HWY_EXPORT(TLG6DecodeLineGeneric_HWY);
+}  // namespace krkr2
+
+extern "C" {
+void TVPTLG5ComposeColors3To4_hwy(tjs_uint8 *outp, const tjs_uint8 *upper,
+                                  tjs_uint8 *const *buf, tjs_int width) {
+    krkr2::HWY_DYNAMIC_DISPATCH(TLG5ComposeColors3To4_HWY)(outp, upper, buf,
+                                                           width);
+}
+void TVPTLG5ComposeColors4To4_hwy(tjs_uint8 *outp, const tjs_uint8 *upper,
+                                  tjs_uint8 *const *buf, tjs_int width) {
+    krkr2::HWY_DYNAMIC_DISPATCH(TLG5ComposeColors4To4_HWY)(outp, upper, buf,
+                                                           width);
+}
+void TVPTLG6DecodeLineGeneric_hwy(tjs_uint32 *prevline, tjs_uint32 *curline,
+                                  tjs_int width, tjs_int start_block,
+                                  tjs_int block_limit, tjs_uint8 *filtertypes,
+                                  tjs_int skipblockbytes, tjs_uint32 *in,
+                                  tjs_uint32 initialp, tjs_int oddskip,
+                                  tjs_int dir) {
+    krkr2::HWY_DYNAMIC_DISPATCH(TLG6DecodeLineGeneric_HWY)(
+        prevline, curline, width, start_block, block_limit, filtertypes,
+        skipblockbytes, in, initialp, oddskip, dir);
+}
+void TVPTLG6DecodeLine_hwy(tjs_uint32 *prevline, tjs_uint32 *curline,
+                           tjs_int width, tjs_int block_count,
+                           tjs_uint8 *filtertypes, tjs_int skipblockbytes,
+                           tjs_uint32 *in, tjs_uint32 initialp,
+                           tjs_int oddskip, tjs_int dir) {
+    krkr2::HWY_DYNAMIC_DISPATCH(TLG6DecodeLineGeneric_HWY)(
+        prevline, curline, width, 0, block_count, filtertypes,
+        skipblockbytes, in, initialp, oddskip, dir);
+}
+}  // extern "C"
+#endif
@@ -0,0 +1,300 @@
+/*
+ * KrKr2 Engine - Highway SIMD Universal Transition
+ *
+ * Implements the rule image based blends used by the "universal"
+ * transition using Highway SIMD:
+ *   TVPUnivTransBlend          - lerp src1 -> src2 by table[rule]
+ *   TVPUnivTransBlend_switch   - same, src1/src2 copied outside the band
+ *   TVPUnivTransBlend_d        - destination alpha version
+ *   TVPUnivTransBlend_switch_d
+ *   TVPUnivTransBlend_a        - additive alpha version
+ *   TVPUnivTransBlend_switch_a
+ *
+ * The opacity still comes from the 256 entry table built per phase by
+ * TVPInitUnivTransBlendTable, which is part of the tvpgl interface; it is
+ * gathered on AVX2 and better and loaded per lane elsewhere. The lerp
+ * itself runs on u32 lanes with the packed arithmetic of the C versions,
+ * so the results are bit-exact.
+ */
+
+#include "tjsTypes.h"
+#include "tvpgl.h"
+
+extern "C" {
+extern unsigned char TVPOpacityOnOpacityTable[256 * 256];
+extern unsigned char TVPNegativeMulTable[256 * 256];
+}
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "tvpgl_simd_univtrans.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+#include "tvpgl_simd_lanes.h"
+
+HWY_BEFORE_NAMESPACE();
+namespace krkr2 {
+namespace HWY_NAMESPACE {
+
+namespace hn = hwy::HWY_NAMESPACE;
+
+using DU32 = hn::ScalableTag<uint32_t>;
+using DI32 = hn::ScalableTag<int32_t>;
+using DU8Q = hn::Rebind<uint8_t, DU32>; // one rule byte per u32 lane
+
+// rule values of N pixels, widened to u32 lanes
+static HWY_INLINE hn::Vec<DU32> LoadRule(DU32 du, const tjs_uint8 *rule) {
+    return hn::PromoteTo(du, hn::LoadU(DU8Q(), rule));
+}
+
+// table[rule] for N pixels
+static HWY_INLINE hn::Vec<DU32> LookupOpa(DU32 du, hn::Vec<DU32> vrule,
+                                          const tjs_uint8 *rule,
+                                          const tjs_uint32 *table) {
+    if constexpr(kUseGather) {
+        return hn::GatherIndex(du, table, hn::BitCast(DI32(), vrule));
+    } else {
+        HWY_ALIGN uint32_t lanes[hn::MaxLanes(du)];
+        const size_t N = hn::Lanes(du);
+        for(size_t k = 0; k < N; k++) lanes[k] = table[rule[k]];
+        return hn::Load(du, lanes);
+    }
+}
+
+// b + (a - b) * ratio >> 8 on the 0x00ff00ff channels and on the 0xff00
+// channel; the alpha byte of the result is zero
+static HWY_INLINE hn::Vec<DU32> LerpColor(DU32 du, hn::Vec<DU32> b,
+                                          hn::Vec<DU32> a,
+                                          hn::Vec<DU32> ratio) {
+    const auto rbmask = hn::Set(du, 0x00ff00ffu);
+    const auto gmask = hn::Set(du, 0x0000ff00u);
+    auto b_rb = hn::And(b, rbmask);
+    auto rb = hn::And(
+        hn::Add(b_rb, hn::ShiftRight<8>(
+                          hn::Mul(hn::Sub(hn::And(a, rbmask), b_rb), ratio))),
+        rbmask);
+    auto b_g = hn::And(b, gmask);
+    auto g = hn::And(
+        hn::Add(b_g, hn::ShiftRight<8>(
+                         hn::Mul(hn::Sub(hn::And(a, gmask), b_g), ratio))),
+        gmask);
+    return hn::Or(rb, g);
+}
+
+// destination alpha lerp; the opacity on opacity table gives the color
+// ratio, the alpha byte is interpolated (Switch = false) or taken from
+// TVPNegativeMulTable (Switch = true) as in the C versions
+template <bool Switch>
+static HWY_INLINE hn::Vec<DU32> LerpDestAlpha(DU32 du, hn::Vec<DU32> s1,
+                                              hn::Vec<DU32> s2,
+                                              hn::Vec<DU32> opa) {
+    const size_t N = hn::Lanes(du);
+    auto a1 = hn::ShiftRight<24>(s1);
+    auto a2 = hn::ShiftRight<24>(s2);
+    auto addr = hn::Add(
+        hn::And(hn::Mul(a2, opa), hn::Set(du, 0xff00u)),
+        hn::ShiftRight<8>(hn::Mul(a1, hn::Sub(hn::Set(du, 256u), opa))));
+
+    HWY_ALIGN uint32_t addrs[hn::MaxLanes(du)];
+    HWY_ALIGN uint32_t lanes[hn::MaxLanes(du)];
+    hn::Store(addr, du, addrs);
+    for(size_t k = 0; k < N; k++) lanes[k] = TVPOpacityOnOpacityTable[addrs[k]];
+    auto color = LerpColor(du, s1, s2, hn::Load(du, lanes));
+
+    hn::Vec<DU32> alpha;
+    if constexpr(Switch) {
+        for(size_t k = 0; k < N; k++) lanes[k] = TVPNegativeMulTable[addrs[k]];
+        alpha = hn::Load(du, lanes);
+    } else {
+        alpha = hn::Add(a1, hn::ShiftRight<8>(hn::Mul(hn::Sub(a2, a1), opa)));
+    }
+    return hn::Or(color, hn::ShiftLeft<24>(alpha));
+}
+
+// Kind: 0 = plain, 1 = destination alpha, 2 = additive alpha
+template <int Kind, bool Switch>
+static HWY_INLINE hn::Vec<DU32> BlendLanes(DU32 du, hn::Vec<DU32> s1,
+                                           hn::Vec<DU32> s2,
+                                           hn::Vec<DU32> opa) {
+    if constexpr(Kind == 0) {
+        return LerpColor(du, s1, s2, opa);
+    } else if constexpr(Kind == 1) {
+        return LerpDestAlpha<Switch>(du, s1, s2, opa);
+    } else {
+        return BlendARGBLanes(du, s1, s2, opa);
+    }
+}
+
+// scalar tail, mirrors the C versions
+template <int Kind, bool Switch>
+static HWY_INLINE tjs_uint32 BlendPixel(tjs_uint32 s1, tjs_uint32 s2,
+                                        tjs_int opa) {
+    if constexpr(Kind == 2) {
+        return TVPBlendARGB(s1, s2, opa);
+    } else {
+        tjs_uint32 ratio = opa;
+        tjs_uint32 top = 0;
+        if constexpr(Kind == 1) {
+            tjs_uint32 a1 = s1 >> 24;
+            tjs_uint32 a2 = s2 >> 24;
+            tjs_uint32 addr = (a2 * opa & 0xff00) + (a1 * (256 - opa) >> 8);
+            ratio = TVPOpacityOnOpacityTable[addr];
+            if constexpr(Switch)
+                top = TVPNegativeMulTable[addr] << 24;
+            else
+                top = (a1 + ((a2 - a1) * opa >> 8)) << 24;
+        }
+        tjs_uint32 s1_ = s1 & 0xff00ff;
+        s1_ = (s1_ + (((s2 & 0xff00ff) - s1_) * ratio >> 8)) & 0xff00ff;
+        s1 &= 0xff00;
+        s2 &= 0xff00;
+        return s1_ | top | ((s1 + ((s2 - s1) * ratio >> 8)) & 0xff00);
+    }
+}
+
+template <int Kind>
+static void UnivTransBlendT(tjs_uint32 *dest, const tjs_uint32 *src1,
+                            const tjs_uint32 *src2, const tjs_uint8 *rule,
+                            const tjs_uint32 *table, tjs_int len) {
+    const DU32 du;
+    const tjs_int N = static_cast<tjs_int>(hn::Lanes(du));
+
+    tjs_int i = 0;
+    for(; i + N <= len; i += N) {
+        auto opa = LookupOpa(du, LoadRule(du, rule + i), rule + i, table);
+        auto s1 = hn::LoadU(du, src1 + i);
+        auto s2 = hn::LoadU(du, src2 + i);
+        hn::StoreU(BlendLanes<Kind, false>(du, s1, s2, opa), du, dest + i);
+    }
+
+    for(; i < len; i++) {
+        dest[i] = BlendPixel<Kind, false>(src1[i], src2[i], table[rule[i]]);
+    }
+}
+
+template <int Kind>
+static void UnivTransBlendSwitchT(tjs_uint32 *dest, const tjs_uint32 *src1,
+                                  const tjs_uint32 *src2,
+                                  const tjs_uint8 *rule,
+                                  const tjs_uint32 *table, tjs_int len,
+                                  tjs_int src1lv, tjs_int src2lv) {
+    const DU32 du;
+    const DI32 di;
+    const tjs_int N = static_cast<tjs_int>(hn::Lanes(du));
+    const auto v1lv = hn::Set(di, src1lv);
+    const auto v2lv = hn::Set(di, src2lv);
+
+    tjs_int i = 0;
+    for(; i + N <= len; i += N) {
+        auto vrule = LoadRule(du, rule + i);
+        auto irule = hn::BitCast(di, vrule);
+        auto s1 = hn::LoadU(du, src1 + i);
+        auto s2 = hn::LoadU(du, src2 + i);
+        auto take1 = hn::Ge(irule, v1lv);
+        auto take2 = hn::Lt(irule, v2lv);
+        // most pixels of a wipe are outside the transition band
+        if(hn::AllTrue(di, take1)) {
+            hn::StoreU(s1, du, dest + i);
+            continue;
+        }
+        if(hn::AllTrue(di, take2)) {
+            hn::StoreU(s2, du, dest + i);
+            continue;
+        }
+        auto opa = LookupOpa(du, vrule, rule + i, table);
+        auto v = BlendLanes<Kind, true>(du, s1, s2, opa);
+        v = hn::IfThenElse(hn::RebindMask(du, take2), s2, v);
+        v = hn::IfThenElse(hn::RebindMask(du, take1), s1, v);
+        hn::StoreU(v, du, dest + i);
+    }
+
+    for(; i < len; i++) {
+        tjs_int opa = rule[i];
+        if(opa >= src1lv)
+            dest[i] = src1[i];
+        else if(opa < src2lv)
+            dest[i] = src2[i];
+        else
+            dest[i] = BlendPixel<Kind, true>(src1[i], src2[i], table[opa]);
+    }
+}
+
+void UnivTransBlend_HWY(tjs_uint32 *dest, const tjs_uint32 *src1,
+                        const tjs_uint32 *src2, const tjs_uint8 *rule,
+                        const tjs_uint32 *table, tjs_int len) {
+    UnivTransBlendT<0>(dest, src1, src2, rule, table, len);
+}
+
+void UnivTransBlend_d_HWY(tjs_uint32 *dest, const tjs_uint32 *src1,
+                          const tjs_uint32 *src2, const tjs_uint8 *rule,
+                          const tjs_uint32 *table, tjs_int len) {
+    UnivTransBlendT<1>(dest, src1, src2, rule, table, len);
+}
+
+void UnivTransBlend_a_HWY(tjs_uint32 *dest, const tjs_uint32 *src1,
+                          const tjs_uint32 *src2, const tjs_uint8 *rule,
+                          const tjs_uint32 *table, tjs_int len) {
+    UnivTransBlendT<2>(dest, src1, src2, rule, table, len);
+}
+
+void UnivTransBlend_switch_HWY(tjs_uint32 *dest, const tjs_uint32 *src1,
+                               const tjs_uint32 *src2, const tjs_uint8 *rule,
+                               const tjs_uint32 *table, tjs_int len,
+                               tjs_int src1lv, tjs_int src2lv) {
+    UnivTransBlendSwitchT<0>(dest, src1, src2, rule, table, len, src1lv,
+                             src2lv);
+}
+
+void UnivTransBlend_switch_d_HWY(tjs_uint32 *dest, const tjs_uint32 *src1,
+                                 const tjs_uint32 *src2, const tjs_uint8 *rule,
+                                 const tjs_uint32 *table, tjs_int len,
+                                 tjs_int src1lv, tjs_int src2lv) {
+    UnivTransBlendSwitchT<1>(dest, src1, src2, rule, table, len, src1lv,
+                             src2lv);
+}
+
+void UnivTransBlend_switch_a_HWY(tjs_uint32 *dest, const tjs_uint32 *src1,
+                                 const tjs_uint32 *src2, const tjs_uint8 *rule,
+                                 const tjs_uint32 *table, tjs_int len,
+                                 tjs_int src1lv, tjs_int src2lv) {
+    UnivTransBlendSwitchT<2>(dest, src1, src2, rule, table, len, src1lv,
+                             src2lv);
+}
+
+}  // namespace HWY_NAMESPACE
+}  // namespace krkr2
+HWY_AFTER_NAMESPACE();
+
+// --- Export functions to C linkage ---
+#if HWY_ONCE
+namespace krkr2 {
+HWY_EXPORT(UnivTransBlend_HWY);
+HWY_EXPORT(UnivTransBlend_d_HWY);
+HWY_EXPORT(UnivTransBlend_a_HWY);
+HWY_EXPORT(UnivTransBlend_switch_HWY);
+HWY_EXPORT(UnivTransBlend_switch_d_HWY);
+HWY_EXPORT(UnivTransBlend_switch_a_HWY);
+}  // namespace krkr2
+
+#define EXPORT_UNIVTRANS(Suffix)                                               \
+    void TVPUnivTransBlend##Suffix##_hwy(                                      \
+        tjs_uint32 *dest, const tjs_uint32 *src1, const tjs_uint32 *src2,      \
+        const tjs_uint8 *rule, const tjs_uint32 *table, tjs_int len) {         \
+        krkr2::HWY_DYNAMIC_DISPATCH(UnivTransBlend##Suffix##_HWY)(             \
+            dest, src1, src2, rule, table, len);                               \
+    }                                                                          \
+    void TVPUnivTransBlend_switch##Suffix##_hwy(                               \
+        tjs_uint32 *dest, const tjs_uint32 *src1, const tjs_uint32 *src2,      \
+        const tjs_uint8 *rule, const tjs_uint32 *table, tjs_int len,           \
+        tjs_int src1lv, tjs_int src2lv) {                                      \
+        krkr2::HWY_DYNAMIC_DISPATCH(UnivTransBlend_switch##Suffix##_HWY)(      \
+            dest, src1, src2, rule, table, len, src1lv, src2lv);               \
+    }
+
+extern "C" {
+EXPORT_UNIVTRANS()
+EXPORT_UNIVTRANS(_d)
+EXPORT_UNIVTRANS(_a)
+}  // extern "C"
+
+#undef EXPORT_UNIVTRANS
+#endif
@@ -8744,7 +8744,7 @@ TVP_GL_FUNC_DECL(void, TVPStretchColorCopy_c,
     destlen += 3;
 
     while(destlen > 0) {
-        dest[0] = (dest[0] & 0xff0000) + (src[srcstart >> 16] & 0xffffff);
+        dest[0] = (dest[0] & 0xff000000) + (src[srcstart >> 16] & 0xffffff);
         srcstart += srcstep;
         dest++;
         destlen--;
@@ -13087,6 +13087,56 @@ TVP_GL_FUNC_DECL(void, TVPConvert32BitTo24Bit_c,
     }
 }
 
+/* separable resampler rows; weights are fixed point, TVP_RESAMPLE_WEIGHT_BITS */
+static TVP_INLINE_FUNC tjs_uint32 TVPResampleClampChannel(tjs_int v) {
+    v = (v + (1 << (TVP_RESAMPLE_WEIGHT_BITS - 1))) >> TVP_RESAMPLE_WEIGHT_BITS;
+    return v < 0 ? 0 : v > 255 ? 255 : (tjs_uint32)v;
+}
+
+TVP_GL_FUNC_DECL(void, TVPResampleRowH_c,
+                 (tjs_uint32 * dest, const tjs_uint32 *src,
+                  const tjs_int *start, const tjs_int *length,
+                  const tjs_int *weight, tjs_int len)) {
+    for(tjs_int x = 0; x < len; x++) {
+        const tjs_uint32 *s = src + start[x];
+        tjs_int n = length[x];
+        tjs_int b = 0, g = 0, r = 0, a = 0;
+        for(tjs_int i = 0; i < n; i++) {
+            tjs_uint32 c = s[i];
+            tjs_int w = weight[i];
+            b += (tjs_int)(c & 0xff) * w;
+            g += (tjs_int)((c >> 8) & 0xff) * w;
+            r += (tjs_int)((c >> 16) & 0xff) * w;
+            a += (tjs_int)(c >> 24) * w;
+        }
+        weight += n;
+        dest[x] = TVPResampleClampChannel(b) +
+            (TVPResampleClampChannel(g) << 8) +
+            (TVPResampleClampChannel(r) << 16) +
+            (TVPResampleClampChannel(a) << 24);
+    }
+}
+
+TVP_GL_FUNC_DECL(void, TVPResampleRowV_c,
+                 (tjs_uint32 * dest, const tjs_uint32 *const *lines,
+                  const tjs_int *weight, tjs_int taps, tjs_int len)) {
+    for(tjs_int x = 0; x < len; x++) {
+        tjs_int b = 0, g = 0, r = 0, a = 0;
+        for(tjs_int i = 0; i < taps; i++) {
+            tjs_uint32 c = lines[i][x];
+            tjs_int w = weight[i];
+            b += (tjs_int)(c & 0xff) * w;
+            g += (tjs_int)((c >> 8) & 0xff) * w;
+            r += (tjs_int)((c >> 16) & 0xff) * w;
+            a += (tjs_int)(c >> 24) * w;
+        }
+        dest[x] = TVPResampleClampChannel(b) +
+            (TVPResampleClampChannel(g) << 8) +
+            (TVPResampleClampChannel(r) << 16) +
+            (TVPResampleClampChannel(a) << 24);
+    }
+}
+
 TVP_GL_FUNC_PTR_DECL(void, TVPAlphaBlend,
                      (tjs_uint32 * dest, const tjs_uint32 *src, tjs_int len));
 TVP_GL_FUNC_PTR_DECL(void, TVPAlphaBlend_HDA,
@@ -13837,6 +13887,13 @@ TVP_GL_FUNC_PTR_DECL(void, TVPReverseRGB,
 TVP_GL_FUNC_PTR_DECL(void, TVPUpscale65_255, (tjs_uint8 * dest, tjs_int len));
 TVP_GL_FUNC_PTR_DECL(void, TVPConvert32BitTo24Bit,
                      (tjs_uint8 * dest, const tjs_uint8 *buf, tjs_int len));
+TVP_GL_FUNC_PTR_DECL(void, TVPResampleRowH,
+                     (tjs_uint32 * dest, const tjs_uint32 *src,
+                      const tjs_int *start, const tjs_int *length,
+                      const tjs_int *weight, tjs_int len));
+TVP_GL_FUNC_PTR_DECL(void, TVPResampleRowV,
+                     (tjs_uint32 * dest, const tjs_uint32 *const *lines,
+                      const tjs_int *weight, tjs_int taps, tjs_int len));
 
 /* suffix "_c" : function is written in C */
 // #include "tvpgl_route.h"
@@ -14127,6 +14184,8 @@ TVP_GL_FUNC_DECL(void, TVPInitTVPGL, ()) {
     TVPReverseRGB = TVPReverseRGB_c;
     TVPUpscale65_255 = TVPUpscale65_255_c;
     TVPConvert32BitTo24Bit = TVPConvert32BitTo24Bit_c;
+    TVPResampleRowH = TVPResampleRowH_c;
+    TVPResampleRowV = TVPResampleRowV_c;
 #endif
     TVPCreateTable();
     TVPGL_C_Init();
@@ -61,6 +61,9 @@ extern unsigned char TVP252DitherPalette[3][256];
 #define TVP_TLG6_H_BLOCK_SIZE 8
 #define TVP_TLG6_W_BLOCK_SIZE 8
 
+/* fixed-point weights of TVPResampleRowH/TVPResampleRowV (sum = 1 << 14) */
+#define TVP_RESAMPLE_WEIGHT_BITS 14
+
 /* put platform dependent declaration here */
 
 /* add here compiler specific inline directives */
@@ -1087,6 +1090,14 @@ TVP_GL_FUNC_PTR_EXTERN_DECL(void, TVPUpscale65_255,
 TVP_GL_FUNC_PTR_EXTERN_DECL(void, TVPConvert32BitTo24Bit,
                             (tjs_uint8 * dest, const tjs_uint8 *buf,
                              tjs_int len));
+TVP_GL_FUNC_PTR_EXTERN_DECL(void, TVPResampleRowH,
+                            (tjs_uint32 * dest, const tjs_uint32 *src,
+                             const tjs_int *start, const tjs_int *length,
+                             const tjs_int *weight, tjs_int len));
+TVP_GL_FUNC_PTR_EXTERN_DECL(void, TVPResampleRowV,
+                            (tjs_uint32 * dest, const tjs_uint32 *const *lines,
+                             const tjs_int *weight, tjs_int taps,
+                             tjs_int len));
 /* end function list */
 
 TVP_GL_FUNC_EXTERN_DECL(void, TVPInitTVPGL, ());
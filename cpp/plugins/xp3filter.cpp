@@ -7,8 +7,11 @@
 #include "tjsDebug.h"
 #include "xp3filter.h"
 #include "ThreadIntf.h"
+#include <algorithm>
 #include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include "TextStream.h"
 
@@ -295,6 +298,197 @@ tjs_error CBinaryAccessor::FuncXor(tjs_int numparams, tTJSVariant **param) {
     return TJS_S_OK;
 }
 
+//---------------------------------------------------------------------------
+// native extraction filter
+//---------------------------------------------------------------------------
+/*
+        a declarative replacement for the per-read TJS extraction filter.
+        xp3filter.tjs may call
+
+                Storages.setXP3ArchiveNativeFilter([ step, step, ... ]);
+
+        with an array of dictionaries, each describing one step which is
+        applied in order to every byte in [begin, end) of the file:
+
+                %[ op:"xor",     value:n ]           b ^= n
+                %[ op:"add",     value:n ]           b += n
+                %[ op:"xorhash", shift:s, value:n ]  b ^= ((hash >> s) & 0xff) ^ n
+                %[ op:"xorkey",  key:<% .. %> ]      b ^= key[offset % key.length]
+                %[ op:"table",   table:[ 256 bytes ] ] b = table[b]
+
+        'key' and 'table' may also be given as arrays. 'begin' and 'end'
+        are optional file offsets ('end' <= 0 means the end of file).
+        the description is compiled once; when no TJS extraction filter is
+        registered, reads are decrypted natively without any VM call.
+*/
+class tXP3NativeFilter {
+    enum tOp { opXor, opAdd, opXorHash, opTable };
+
+    struct tStep {
+        tOp Op;
+        tjs_uint64 Begin;
+        tjs_uint64 End; // 0 for end of file
+        tjs_uint8 Value;
+        tjs_uint8 Shift;
+        tjs_uint KeyLength; // period of Pattern ( 0 for non-xor steps )
+        std::vector<tjs_uint8> Pattern; // key repeated, see BuildPattern
+        tjs_uint8 Table[256];
+    };
+
+    std::vector<tStep> Steps;
+
+    // xor loops work on this many bytes of repeated key at a time
+    static constexpr tjs_uint PatternChunk = 256;
+
+    static void BuildPattern(tStep &step, const tjs_uint8 *key, tjs_uint len) {
+        // key repeated to a multiple of its length which is at least
+        // PatternChunk, then once more so that any phase can be read as a
+        // contiguous run
+        tjs_uint span = ((PatternChunk + len - 1) / len) * len;
+        step.KeyLength = len;
+        step.Pattern.resize(span * 2);
+        for(tjs_uint i = 0; i < span * 2; i++)
+            step.Pattern[i] = key[i % len];
+    }
+
+    static void XorRun(tjs_uint8 *buf, const tjs_uint8 *pattern, tjs_uint len) {
+        // simple enough for the compiler to vectorize
+        for(tjs_uint i = 0; i < len; i++)
+            buf[i] ^= pattern[i];
+    }
+
+    static void XorPattern(tjs_uint8 *buf, tjs_uint len, tjs_uint64 offset,
+                           const tjs_uint8 *pattern, tjs_uint keylen) {
+        tjs_uint span = ((PatternChunk + keylen - 1) / keylen) * keylen;
+        const tjs_uint8 *p = pattern + (tjs_uint)(offset % keylen);
+        while(len) {
+            tjs_uint one = std::min(len, span);
+            XorRun(buf, p, one);
+            buf += one;
+            len -= one;
+        }
+    }
+
+    static bool ReadBytes(const tTJSVariant &v, std::vector<tjs_uint8> &out) {
+        if(v.Type() == tvtOctet) {
+            tTJSVariantOctet *oct = v.AsOctetNoAddRef();
+            if(!oct)
+                return false;
+            out.assign(oct->GetData(), oct->GetData() + oct->GetLength());
+            return true;
+        }
+        if(v.Type() == tvtObject && v.AsObjectNoAddRef()) {
+            ncbPropAccessor arr(v.AsObjectNoAddRef());
+            tjs_int count = arr.GetArrayCount();
+            out.resize(count);
+            for(tjs_int i = 0; i < count; i++)
+                out[i] = (tjs_uint8)arr.getIntValue(i);
+            return true;
+        }
+        return false;
+    }
+
+public:
+    // compiles 'desc'; throws on a malformed description
+    explicit tXP3NativeFilter(iTJSDispatch2 *desc) {
+        ncbPropAccessor steps(desc);
+        tjs_int count = steps.GetArrayCount();
+        for(tjs_int i = 0; i < count; i++) {
+            tTJSVariant v = steps.GetValue(i, ncbTypedefs::Tag<tTJSVariant>());
+            if(v.Type() != tvtObject || !v.AsObjectNoAddRef())
+                TVPThrowExceptionMessage(
+                    TJS_W("Invalid XP3 native filter step"));
+            ncbPropAccessor d(v.AsObjectNoAddRef());
+
+            tStep step{};
+            ttstr op = d.getStrValue(TJS_W("op"));
+            step.Begin = (tjs_uint64)std::max<tjs_int64>(
+                0, d.GetValue(TJS_W("begin"), ncbTypedefs::Tag<tjs_int64>()));
+            step.End = (tjs_uint64)std::max<tjs_int64>(
+                0, d.GetValue(TJS_W("end"), ncbTypedefs::Tag<tjs_int64>()));
+            step.Value = (tjs_uint8)d.getIntValue(TJS_W("value"));
+            step.Shift = (tjs_uint8)(d.getIntValue(TJS_W("shift")) & 31);
+
+            if(op == TJS_W("xor")) {
+                step.Op = opXor;
+                BuildPattern(step, &step.Value, 1);
+            } else if(op == TJS_W("add")) {
+                step.Op = opAdd;
+            } else if(op == TJS_W("xorhash")) {
+                step.Op = opXorHash; // pattern is made per file
+            } else if(op == TJS_W("xorkey")) {
+                std::vector<tjs_uint8> key;
+                tTJSVariant kv;
+                if(!d.checkVariant(TJS_W("key"), kv) || !ReadBytes(kv, key) ||
+                   key.empty())
+                    TVPThrowExceptionMessage(
+                        TJS_W("XP3 native filter 'xorkey' needs a key"));
+                step.Op = opXor;
+                BuildPattern(step, key.data(), (tjs_uint)key.size());
+            } else if(op == TJS_W("table")) {
+                std::vector<tjs_uint8> table;
+                tTJSVariant tv;
+                if(!d.checkVariant(TJS_W("table"), tv) ||
+                   !ReadBytes(tv, table) || table.size() != 256)
+                    TVPThrowExceptionMessage(TJS_W(
+                        "XP3 native filter 'table' needs 256 entries"));
+                step.Op = opTable;
+                std::copy(table.begin(), table.end(), step.Table);
+            } else {
+                TVPThrowExceptionMessage(
+                    TJS_W("Unknown XP3 native filter operation: %1"), op);
+            }
+            Steps.push_back(std::move(step));
+        }
+    }
+
+    void Apply(tjs_uint32 filehash, tjs_uint64 offset, tjs_uint8 *buf,
+               tjs_uint len) const {
+        for(const tStep &step : Steps) {
+            // clip to the step's range
+            tjs_uint64 from = std::max(offset, step.Begin);
+            tjs_uint64 to = offset + len;
+            if(step.End && step.End < to)
+                to = step.End;
+            if(from >= to)
+                continue;
+            tjs_uint8 *p = buf + (tjs_uint)(from - offset);
+            tjs_uint n = (tjs_uint)(to - from);
+
+            switch(step.Op) {
+                case opXor:
+                    XorPattern(p, n, from, step.Pattern.data(),
+                               step.KeyLength);
+                    break;
+                case opXorHash: {
+                    tjs_uint8 pattern[PatternChunk];
+                    memset(pattern,
+                           (tjs_uint8)(filehash >> step.Shift) ^ step.Value,
+                           PatternChunk);
+                    while(n) {
+                        tjs_uint one = std::min(n, PatternChunk);
+                        XorRun(p, pattern, one);
+                        p += one;
+                        n -= one;
+                    }
+                    break;
+                }
+                case opAdd:
+                    for(tjs_uint i = 0; i < n; i++)
+                        p[i] += step.Value;
+                    break;
+                case opTable:
+                    for(tjs_uint i = 0; i < n; i++)
+                        p[i] = step.Table[p[i]];
+                    break;
+            }
+        }
+    }
+};
+
+static std::shared_ptr<const tXP3NativeFilter> _NativeFilter;
+//---------------------------------------------------------------------------
+
 static bool _ManagedDecoderInited = false;
 static bool _ManagedFilterInited = false;
 
@@ -391,6 +585,38 @@ public:
     }
 };
 
+class XP3NativeFilterRegister : public XP3FilterRegister {
+    typedef XP3FilterRegister inherited;
+
+public:
+    XP3NativeFilterRegister(XP3FilterDecoder *decoder) :
+        XP3FilterRegister(decoder) {}
+    tjs_error FuncCall(tjs_uint32 flag, const tjs_char *membername,
+                       tjs_uint32 *hint, tTJSVariant *result, tjs_int numparams,
+                       tTJSVariant **param, iTJSDispatch2 *objthis) {
+        if(membername)
+            return inherited::FuncCall(flag, membername, hint, result,
+                                       numparams, param, objthis);
+        if(!objthis)
+            return TJS_E_NATIVECLASSCRASH;
+
+        if(result)
+            result->Clear();
+
+        if(numparams < 1)
+            return TJS_E_BADPARAMCOUNT;
+        std::shared_ptr<const tXP3NativeFilter> filter;
+        if(param[0]->Type() == tvtObject && param[0]->AsObjectNoAddRef())
+            filter = std::make_shared<tXP3NativeFilter>(
+                param[0]->AsObjectNoAddRef());
+        // every thread runs the same script; the first one to get here
+        // provides the filter for all of them
+        if(!std::atomic_load(&_NativeFilter))
+            std::atomic_store(&_NativeFilter, filter);
+        return TJS_S_OK;
+    }
+};
+
 static XP3FilterDecoder *AddXP3Decoder() {
     XP3FilterDecoder *decoder = new XP3FilterDecoder;
     tTJSVariant val;
@@ -413,6 +639,10 @@ static XP3FilterDecoder *AddXP3Decoder() {
                               new XP3ContentFilterRegister(decoder),
                               cls->GetClassName().c_str(), nitMethod,
                               TJS_STATICMEMBER);
+    TJSNativeClassRegisterNCM(cls, TJS_W("setXP3ArchiveNativeFilter"),
+                              new XP3NativeFilterRegister(decoder),
+                              cls->GetClassName().c_str(), nitMethod,
+                              TJS_STATICMEMBER);
     REGISTER_OBJECT(Storages, cls);
 
     decoder->ScriptEngine->ExecScript(sXP3FilterScript);
@@ -530,21 +760,58 @@ TVPXP3ArchiveExtractionFilterWrapper(tTVPXP3ExtractionFilterInfo *info,
     }
 }
 
+void TVP_tTVPXP3ArchiveExtractionFilter_CONVENTION
+TVPXP3ArchiveNativeExtractionFilter(tTVPXP3ExtractionFilterInfo *info,
+                                    tTJSVariant *ctx) {
+    std::shared_ptr<const tXP3NativeFilter> filter =
+        std::atomic_load(&_NativeFilter);
+    if(filter)
+        filter->Apply(info->FileHash, info->Offset,
+                      (tjs_uint8 *)info->Buffer, info->BufferSize);
+}
+
+static void InstallXP3Filters() {
+    // run the script once on this thread to learn which filters it
+    // registers, then prefer the native extraction filter when the script
+    // did not register a TJS one
+    XP3FilterDecoder *decoder;
+    try {
+        decoder = FetchXP3Decoder();
+    } catch(...) {
+        // report errors on first use, as before
+        TVPSetXP3ArchiveExtractionFilter(TVPXP3ArchiveExtractionFilterWrapper);
+        TVPSetXP3ArchiveContentFilter(TVPXP3ArchiveContentFilterWrapper);
+        return;
+    }
+    if(!decoder->ManagedDecoder.Object && std::atomic_load(&_NativeFilter))
+        TVPSetXP3ArchiveExtractionFilter(TVPXP3ArchiveNativeExtractionFilter);
+    else
+        TVPSetXP3ArchiveExtractionFilter(TVPXP3ArchiveExtractionFilterWrapper);
+    // without a content filter the archive may cache filtered contents
+    TVPSetXP3ArchiveContentFilter(decoder->ManagedFilter.Object
+                                      ? TVPXP3ArchiveContentFilterWrapper
+                                      : nullptr);
+}
+
 void TVPSetXP3FilterScript(ttstr content) {
     if(sXP3FilterScript != content) {
         for(auto it : _thread_decoders) {
             delete it.second;
         }
         _thread_decoders.clear();
+        std::atomic_store(&_NativeFilter,
+                          std::shared_ptr<const tXP3NativeFilter>());
+        // the wrappers stay the same, but cached blobs were decrypted by
+        // the old script
+        TVPClearXP3BlobCache();
     }
+    sXP3FilterScript = content;
     if(content.IsEmpty()) {
         TVPSetXP3ArchiveExtractionFilter(nullptr);
         TVPSetXP3ArchiveContentFilter(nullptr);
     } else {
-        TVPSetXP3ArchiveExtractionFilter(TVPXP3ArchiveExtractionFilterWrapper);
-        TVPSetXP3ArchiveContentFilter(TVPXP3ArchiveContentFilterWrapper);
+        InstallXP3Filters();
     }
-    sXP3FilterScript = content;
 }
 
 static void PostRegistCallback() {
@@ -558,9 +825,7 @@ static void PostRegistCallback() {
             throw;
         }
         stream->Destruct();
-        //    AddXP3Decoder();
-        TVPSetXP3ArchiveExtractionFilter(TVPXP3ArchiveExtractionFilterWrapper);
-        TVPSetXP3ArchiveContentFilter(TVPXP3ArchiveContentFilterWrapper);
+        InstallXP3Filters();
     }
     // TVPSetXP3ArchiveExtractionFilter(TVPXP3ArchiveExtractionFilter);
 }
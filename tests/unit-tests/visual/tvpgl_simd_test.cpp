@@ -0,0 +1,264 @@
+/*
+ * KrKr2 Engine - Highway SIMD conformance tests
+ *
+ * Every Photoshop blend and the Darken/Lighten blends of tvpgl_simd must
+ * give the same pixels as the C versions set by TVPGL_C_Init(), for every
+ * Highway target compiled in and supported by the running CPU.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <hwy/targets.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "tjsTypes.h"
+#include "tvpgl.h"
+#include "tvpgl_simd_init.h"
+
+extern void TVPGL_C_Init();
+
+typedef void (*tTVPTestBlend)(tjs_uint32 *dest, const tjs_uint32 *src,
+                              tjs_int len);
+typedef void (*tTVPTestBlendO)(tjs_uint32 *dest, const tjs_uint32 *src,
+                               tjs_int len, tjs_int opa);
+
+extern "C" {
+#define DECLARE_BLEND_4V(Name)                                                \
+    void TVP##Name##Blend_hwy(tjs_uint32 *dest, const tjs_uint32 *src,        \
+                              tjs_int len);                                    \
+    void TVP##Name##Blend_o_hwy(tjs_uint32 *dest, const tjs_uint32 *src,      \
+                                tjs_int len, tjs_int opa);                     \
+    void TVP##Name##Blend_HDA_hwy(tjs_uint32 *dest, const tjs_uint32 *src,    \
+                                  tjs_int len);                                \
+    void TVP##Name##Blend_HDA_o_hwy(tjs_uint32 *dest, const tjs_uint32 *src,  \
+                                    tjs_int len, tjs_int opa);
+
+DECLARE_BLEND_4V(Darken)
+DECLARE_BLEND_4V(Lighten)
+DECLARE_BLEND_4V(PsAlpha)
+DECLARE_BLEND_4V(PsAdd)
+DECLARE_BLEND_4V(PsSub)
+DECLARE_BLEND_4V(PsMul)
+DECLARE_BLEND_4V(PsScreen)
+DECLARE_BLEND_4V(PsLighten)
+DECLARE_BLEND_4V(PsDarken)
+DECLARE_BLEND_4V(PsDiff)
+DECLARE_BLEND_4V(PsOverlay)
+DECLARE_BLEND_4V(PsHardLight)
+DECLARE_BLEND_4V(PsExclusion)
+DECLARE_BLEND_4V(PsSoftLight)
+DECLARE_BLEND_4V(PsColorDodge)
+DECLARE_BLEND_4V(PsColorBurn)
+DECLARE_BLEND_4V(PsColorDodge5)
+DECLARE_BLEND_4V(PsDiff5)
+
+#undef DECLARE_BLEND_4V
+}
+
+namespace {
+
+    // the C pointers are read after TVPGL_C_Init(), hence the indirection
+    struct tTVPTestBlendEntry {
+        const char *Name;
+        tTVPTestBlend *C;
+        tTVPTestBlend Hwy;
+    };
+
+    struct tTVPTestBlendOEntry {
+        const char *Name;
+        tTVPTestBlendO *C;
+        tTVPTestBlendO Hwy;
+    };
+
+#define BLEND_ENTRIES(Name)                                                   \
+    { "TVP" #Name "Blend", &TVP##Name##Blend, TVP##Name##Blend_hwy },         \
+        { "TVP" #Name "Blend_HDA", &TVP##Name##Blend_HDA,                     \
+          TVP##Name##Blend_HDA_hwy },
+#define BLEND_O_ENTRIES(Name)                                                 \
+    { "TVP" #Name "Blend_o", &TVP##Name##Blend_o, TVP##Name##Blend_o_hwy },   \
+        { "TVP" #Name "Blend_HDA_o", &TVP##Name##Blend_HDA_o,                 \
+          TVP##Name##Blend_HDA_o_hwy },
+#define ALL_BLENDS(X)                                                         \
+    X(Darken)                                                                 \
+    X(Lighten)                                                                \
+    X(PsAlpha)                                                                \
+    X(PsAdd)                                                                  \
+    X(PsSub)                                                                  \
+    X(PsMul)                                                                  \
+    X(PsScreen)                                                               \
+    X(PsLighten)                                                              \
+    X(PsDarken)                                                               \
+    X(PsDiff)                                                                 \
+    X(PsOverlay)                                                              \
+    X(PsHardLight)                                                            \
+    X(PsExclusion)                                                            \
+    X(PsSoftLight)                                                            \
+    X(PsColorDodge)                                                           \
+    X(PsColorBurn)                                                            \
+    X(PsColorDodge5)                                                          \
+    X(PsDiff5)
+
+    const tTVPTestBlendEntry TVPTestBlends[] = { ALL_BLENDS(BLEND_ENTRIES) };
+    const tTVPTestBlendOEntry TVPTestBlendsO[] = { ALL_BLENDS(
+        BLEND_O_ENTRIES) };
+
+#undef ALL_BLENDS
+#undef BLEND_O_ENTRIES
+#undef BLEND_ENTRIES
+
+    const tjs_int TVPTestOpacities[] = { 0, 1, 2, 64, 127, 128, 129, 254, 255 };
+    const tjs_int TVPTestLengths[] = { 1,  2,  3,  5,   7,   15,  17,
+                                       31, 33, 63, 65, 129, 255, 257 };
+    const tjs_int TVPTestOffsets[] = { 0, 1, 3 };
+
+    const tjs_int TVPTestPixels = 256 * 256;
+
+    // Builds the tables and sets up the C pointers; SIMD dispatch is then
+    // chosen per test with TVPGL_SIMD_SetTarget().
+    void TVPTestInitGL() {
+        static bool inited = false;
+        if(!inited) {
+            TVPInitTVPGL();
+            TVPGL_C_Init();
+            inited = true;
+        }
+    }
+
+    /*
+     * Source and destination over every (src, dest) value pair in each of
+     * R, G and B. The source alpha, which drives most of the blends,
+     * follows the src value, the dest value or a pseudo random sequence
+     * depending on pattern.
+     */
+    void TVPTestMakePixels(std::vector<tjs_uint32> &src,
+                           std::vector<tjs_uint32> &dest, int pattern) {
+        src.resize(TVPTestPixels);
+        dest.resize(TVPTestPixels);
+        tjs_uint32 seed = 0x12345678u + pattern;
+        for(tjs_int i = 0; i < TVPTestPixels; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            tjs_uint32 s = (tjs_uint32)i >> 8, d = (tjs_uint32)i & 0xff;
+            tjs_uint32 r = seed >> 24;
+            tjs_uint32 sa = pattern == 0 ? s : pattern == 1 ? d : r;
+            src[i] = (sa << 24) | (s << 16) | (d << 8) | (s ^ 0xa5);
+            dest[i] = (((seed >> 16) & 0xff) << 24) | (d << 16) | (s << 8) | d;
+        }
+    }
+
+    tjs_int TVPTestFirstMismatch(const std::vector<tjs_uint32> &a,
+                                 const std::vector<tjs_uint32> &b) {
+        for(size_t i = 0; i < a.size(); i++)
+            if(a[i] != b[i])
+                return (tjs_int)i;
+        return -1;
+    }
+
+    // Runs body once per Highway target which is compiled in and
+    // supported here, with the _hwy wrappers dispatching to that target.
+    template <typename Body>
+    void TVPTestForEachTarget(Body body) {
+        TVPTestInitGL();
+        for(int64_t target : hwy::SupportedAndGeneratedTargets()) {
+            const char *name = hwy::TargetName(target);
+            REQUIRE(TVPGL_SIMD_SetTarget(name));
+            TVPGL_SIMD_Init();
+            TVPGL_C_Init(); // keep the C versions as the reference
+            INFO("target " << name);
+            body();
+        }
+        TVPGL_SIMD_SetTarget("auto");
+    }
+
+} // namespace
+
+TEST_CASE("blends match the C versions on whole buffers", "[tvpgl_simd]") {
+    TVPTestForEachTarget([] {
+        std::vector<tjs_uint32> src, dest, expected, actual;
+        for(int pattern = 0; pattern < 3; pattern++) {
+            TVPTestMakePixels(src, dest, pattern);
+            for(const auto &f : TVPTestBlends) {
+                expected = dest;
+                actual = dest;
+                (*f.C)(expected.data(), src.data(), TVPTestPixels);
+                f.Hwy(actual.data(), src.data(), TVPTestPixels);
+                tjs_int at = TVPTestFirstMismatch(expected, actual);
+                INFO(f.Name << " pattern " << pattern << " pixel " << at);
+                CHECK(at == -1);
+            }
+            for(const auto &f : TVPTestBlendsO) {
+                for(tjs_int opa : TVPTestOpacities) {
+                    expected = dest;
+                    actual = dest;
+                    (*f.C)(expected.data(), src.data(), TVPTestPixels, opa);
+                    f.Hwy(actual.data(), src.data(), TVPTestPixels, opa);
+                    tjs_int at = TVPTestFirstMismatch(expected, actual);
+                    INFO(f.Name << " pattern " << pattern << " opa " << opa
+                                << " pixel " << at);
+                    CHECK(at == -1);
+                }
+            }
+        }
+    });
+}
+
+TEST_CASE("blends match the C versions on short and unaligned spans",
+          "[tvpgl_simd]") {
+    // the whole buffer is compared, so writes past the span show up too
+    TVPTestForEachTarget([] {
+        std::vector<tjs_uint32> src, dest, expected, actual;
+        TVPTestMakePixels(src, dest, 2);
+        const tjs_int base = 4096;
+        for(tjs_int len : TVPTestLengths) {
+            for(tjs_int ofs : TVPTestOffsets) {
+                for(const auto &f : TVPTestBlends) {
+                    expected = dest;
+                    actual = dest;
+                    (*f.C)(expected.data() + base + ofs,
+                           src.data() + base + ofs * 2, len);
+                    f.Hwy(actual.data() + base + ofs,
+                          src.data() + base + ofs * 2, len);
+                    tjs_int at = TVPTestFirstMismatch(expected, actual);
+                    INFO(f.Name << " len " << len << " offset " << ofs
+                                << " pixel " << at);
+                    CHECK(at == -1);
+                }
+                for(const auto &f : TVPTestBlendsO) {
+                    for(tjs_int opa : TVPTestOpacities) {
+                        expected = dest;
+                        actual = dest;
+                        (*f.C)(expected.data() + base + ofs,
+                               src.data() + base + ofs * 2, len, opa);
+                        f.Hwy(actual.data() + base + ofs,
+                              src.data() + base + ofs * 2, len, opa);
+                        tjs_int at = TVPTestFirstMismatch(expected, actual);
+                        INFO(f.Name << " len " << len << " offset " << ofs
+                                    << " opa " << opa << " pixel " << at);
+                        CHECK(at == -1);
+                    }
+                }
+            }
+        }
+    });
+}
+
+// The table driven modes look the table up per lane; run with
+// "[!benchmark]" to see whether that still beats the C loop on this CPU.
+TEST_CASE("PsSoftLightBlend against the C version", "[!benchmark]") {
+    TVPTestInitGL();
+    TVPGL_SIMD_SetTarget("auto");
+    TVPGL_SIMD_Init();
+    TVPGL_C_Init();
+    std::vector<tjs_uint32> src, dest;
+    TVPTestMakePixels(src, dest, 2);
+    BENCHMARK("C") {
+        TVPPsSoftLightBlend(dest.data(), src.data(), TVPTestPixels);
+        return dest[0];
+    };
+    BENCHMARK("Highway") {
+        TVPPsSoftLightBlend_hwy(dest.data(), src.data(), TVPTestPixels);
+        return dest[0];
+    };
+}